@@ -0,0 +1,567 @@
+/**
+ * @file bej_bench.cpp
+ * @brief throughput benchmarks for the JSON parser, the BEJ codec and dictionary lookups
+ *
+ * Every benchmark runs over a synthetic corpus generated from the Memory
+ * schema dictionary, one document per shape (see corpus_shapes). Results
+ * report MB/s of the input format (bytes_per_second) and docs/s
+ *
+ * Usage: bej_bench [--benchmark_filter=<regex>] [other Google Benchmark flags]
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+    #include "json.h"
+    #include "bej_decode.h"
+    #include "bej_encode.h"
+    #include "bej_dictionary.h"
+    #include "bej_pool.h"
+}
+
+namespace {
+
+using json_ptr = std::unique_ptr<json_value_t, void(*)(json_value_t*)>;
+using dict_ptr = std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)>;
+using file_ptr = std::unique_ptr<FILE, int(*)(FILE*)>;
+using encoder_ptr = std::unique_ptr<bej_encoder_t, void(*)(bej_encoder_t*)>;
+using decoder_ptr = std::unique_ptr<bej_decoder_t, void(*)(bej_decoder_t*)>;
+using pool_ptr = std::unique_ptr<bej_pool_t, void(*)(bej_pool_t*)>;
+
+/**
+ * @brief parameters of one generated document
+ */
+struct corpus_shape_t {
+    const char *name;           /**< benchmark suffix */
+    int max_depth;              /**< deepest Set or Array level that is filled in (root members are level 1) */
+    size_t top_array_length;    /**< elements of every root-level array */
+    size_t nested_array_length; /**< elements of every deeper array */
+    size_t string_length;       /**< characters of every string value */
+    bool annotations;           /**< add @odata.* annotations to every Set */
+    bool scalar_arrays;         /**< only fill root-level arrays of Integers, Booleans and Enums */
+};
+
+/**
+ * @brief the corpus: a flat Redfish resource, then one document per kind of stress
+ */
+const corpus_shape_t corpus_shapes[] = {
+    {"resource", 1, 2, 1, 16, false, false},
+    {"wide", 2, 1, 1, 24, false, false},
+    {"deep", 64, 2, 2, 16, false, false},
+    {"arrays", 3, 20000, 1, 12, false, false},
+    {"scalar_arrays", 1, 20000, 1, 12, false, true},
+    {"strings", 1, 1, 1, 16384, false, false},
+    {"annotations", 64, 8, 2, 24, true, false},
+};
+
+/**
+ * @brief writes JSON documents that follow a schema dictionary
+ */
+class corpus_generator {
+public:
+    corpus_generator(const bej_dictionary_t *dict, const corpus_shape_t &shape)
+        : dict(dict), shape(shape) {}
+
+    /**
+     * @brief generates the document
+     * @return JSON text
+     */
+    std::string generate()
+    {
+        bej_dict_stream_t ds;
+        bej_dict_entry_t root;
+        bej_dict_stream_init(&ds, dict);
+        if (!bej_dict_stream_next(&ds, &root))
+            return "";
+        std::string text;
+        if (!write_set(text, root, 0, "/redfish/v1/Systems/1/Memory/DIMM1"))
+            text = "{}";
+        return text;
+    }
+
+private:
+    /**
+     * @brief writes a string value of the configured length, with a few characters that need escaping
+     */
+    void write_string(std::string &text, const size_t salt)
+    {
+        text += '"';
+        for (size_t i = 0; i < shape.string_length; i++) {
+            const size_t c = (i * 7 + salt) % 64;
+            if (c == 63)
+                text += "\\\"";
+            else if (c == 62)
+                text += "\\n";
+            else
+                text += static_cast<char>(c < 26 ? 'a' + c : c < 52 ? 'A' + (c - 26) : '0' + (c - 52));
+        }
+        text += '"';
+    }
+
+    /**
+     * @brief writes the annotations a Redfish service puts on a Set
+     */
+    static void write_annotations(std::string &text, const std::string &id)
+    {
+        text += "\"@odata.id\": \"" + id + "\", \"@odata.type\": \"#Memory.v1_17_0.Memory\", "
+                "\"@odata.etag\": \"W/\\\"3f2a\\\"\"";
+    }
+
+    /**
+     * @brief writes the value of a property
+     * @return false if the property has nothing to write in this shape
+     */
+    bool write_value(std::string &text, const bej_dict_entry_t &entry, const int depth, const std::string &id)
+    {
+        bej_dict_entry_t option;
+        switch (entry.format) {
+        case BEJ_FORMAT_SET:
+            return write_set(text, entry, depth, id);
+        case BEJ_FORMAT_ARRAY:
+            return write_array(text, entry, depth, id);
+        case BEJ_FORMAT_INTEGER:
+            text += std::to_string(static_cast<long long>(counter++ * 2654435761u % 1000000007u) - 500000000);
+            return true;
+        case BEJ_FORMAT_BOOLEAN:
+            text += counter++ % 2 ? "true" : "false";
+            return true;
+        case BEJ_FORMAT_STRING:
+            write_string(text, counter++);
+            return true;
+        case BEJ_FORMAT_ENUM:
+            if (!entry.child_count ||
+                !bej_dict_find_child_by_seq(dict, entry.child_pointer, entry.child_count, counter++ % entry.child_count, &option) ||
+                !option.name)
+                return false;
+            text += std::string("\"") + option.name + "\"";
+            return true;
+        default:
+            return false; // Real and the other formats are not encodable
+        }
+    }
+
+    /**
+     * @brief tells whether a property is an Array of Integers, Booleans or Enums
+     */
+    bool scalar_array(const bej_dict_entry_t &entry) const
+    {
+        bej_dict_stream_t ds;
+        bej_dict_entry_t element;
+        if (entry.format != BEJ_FORMAT_ARRAY || !entry.child_pointer)
+            return false;
+        bej_dict_stream_init_subset(&ds, dict, entry.child_pointer, 1);
+        return bej_dict_stream_next(&ds, &element) &&
+               (element.format == BEJ_FORMAT_INTEGER || element.format == BEJ_FORMAT_BOOLEAN ||
+                element.format == BEJ_FORMAT_ENUM);
+    }
+
+    /**
+     * @brief writes a Set with a value for every member that has one
+     */
+    bool write_set(std::string &text, const bej_dict_entry_t &entry, const int depth, const std::string &id)
+    {
+        if (depth > shape.max_depth)
+            return false;
+        const size_t start = text.size();
+        bool empty = true;
+        text += '{';
+        if (shape.annotations) {
+            write_annotations(text, id);
+            empty = false;
+        }
+
+        bej_dict_stream_t ds;
+        bej_dict_entry_t member;
+        bej_dict_stream_init_subset(&ds, dict, entry.child_pointer, entry.child_count);
+        while (entry.child_count && entry.child_pointer && bej_dict_stream_next(&ds, &member)) {
+            if (!member.name || (shape.scalar_arrays && depth == 0 && !scalar_array(member)))
+                continue;
+            const size_t mark = text.size();
+            text += empty ? "" : ", ";
+            text += std::string("\"") + member.name + "\": ";
+            if (write_value(text, member, depth + 1, id + "/" + member.name))
+                empty = false;
+            else
+                text.resize(mark);
+        }
+        text += '}';
+        if (empty && depth > 0) {
+            text.resize(start);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief writes an Array of the configured length
+     */
+    bool write_array(std::string &text, const bej_dict_entry_t &entry, const int depth, const std::string &id)
+    {
+        bej_dict_stream_t ds;
+        bej_dict_entry_t element;
+        bej_dict_stream_init_subset(&ds, dict, entry.child_pointer, 1);
+        if (depth > shape.max_depth || !entry.child_pointer || !bej_dict_stream_next(&ds, &element))
+            return false;
+
+        const size_t length = depth == 1 ? shape.top_array_length : shape.nested_array_length;
+        const size_t start = text.size();
+        text += '[';
+        for (size_t i = 0; i < length; i++) {
+            text += i ? ", " : "";
+            if (!write_value(text, element, depth, id + "/" + std::to_string(i))) {
+                text.resize(start);
+                return false;
+            }
+        }
+        text += ']';
+        return true;
+    }
+
+    const bej_dictionary_t *dict;
+    const corpus_shape_t &shape;
+    size_t counter = 0;
+};
+
+/**
+ * @brief a generated document in every form the benchmarks start from
+ */
+struct corpus_document_t {
+    std::string text;         /**< JSON text */
+    json_ptr tree{nullptr, json_free}; /**< parsed tree */
+    std::vector<uint8_t> bej; /**< canonical BEJ encoding */
+};
+
+/**
+ * @brief state shared by all benchmarks
+ */
+struct bench_state_t {
+    dict_ptr schema{nullptr, bej_dictionary_free};
+    dict_ptr annot{nullptr, bej_dictionary_free};
+    file_ptr null_output{nullptr, fclose};
+    pool_ptr pool{nullptr, bej_pool_free}; /**< a worker per online CPU besides the benchmark thread */
+    std::vector<corpus_document_t> documents;
+};
+
+bench_state_t bench;
+
+/**
+ * @brief reports MB/s of the input and docs/s
+ */
+void report(benchmark::State &state, const size_t bytes)
+{
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.counters["docs/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void bm_json_parse(benchmark::State &state, const corpus_document_t *doc)
+{
+    for (auto _ : state) {
+        json_value_t *root = json_parse(doc->text.c_str());
+        if (!root) {
+            state.SkipWithError("json_parse failed");
+            break;
+        }
+        benchmark::DoNotOptimize(root);
+        json_free(root);
+    }
+    report(state, doc->text.size());
+}
+
+void bm_json_compare(benchmark::State &state, const corpus_document_t *doc)
+{
+    // the decoded tree has its keys in dictionary order, not in text order
+    const json_ptr decoded(bej_decode_buffer(doc->bej.data(), doc->bej.size(), bench.schema.get(), bench.annot.get()),
+                           json_free);
+    if (!decoded) {
+        state.SkipWithError("bej_decode_buffer failed");
+        return;
+    }
+    for (auto _ : state) {
+        if (!json_compare(doc->tree.get(), decoded.get())) {
+            state.SkipWithError("json_compare failed");
+            break;
+        }
+    }
+    report(state, doc->text.size());
+}
+
+void bm_bej_encode_stream(benchmark::State &state, const corpus_document_t *doc)
+{
+    for (auto _ : state) {
+        if (!bej_encode_stream(bench.null_output.get(), doc->tree.get(), bench.schema.get(), bench.annot.get())) {
+            state.SkipWithError("bej_encode_stream failed");
+            break;
+        }
+    }
+    report(state, doc->bej.size());
+}
+
+void bm_bej_decode_stream(benchmark::State &state, const corpus_document_t *doc)
+{
+    const file_ptr input(fmemopen(const_cast<uint8_t *>(doc->bej.data()), doc->bej.size(), "rb"), fclose);
+    if (!input) {
+        state.SkipWithError("fmemopen failed");
+        return;
+    }
+    for (auto _ : state) {
+        rewind(input.get());
+        if (!bej_decode_stream(bench.null_output.get(), input.get(), bench.schema.get(), bench.annot.get())) {
+            state.SkipWithError("bej_decode_stream failed");
+            break;
+        }
+    }
+    report(state, doc->bej.size());
+}
+
+void bm_bej_decode_buffer(benchmark::State &state, const corpus_document_t *doc)
+{
+    for (auto _ : state) {
+        json_value_t *root = bej_decode_buffer(doc->bej.data(), doc->bej.size(), bench.schema.get(), bench.annot.get());
+        if (!root) {
+            state.SkipWithError("bej_decode_buffer failed");
+            break;
+        }
+        benchmark::DoNotOptimize(root);
+        json_free(root);
+    }
+    report(state, doc->bej.size());
+}
+
+void bm_bej_decode_borrowed(benchmark::State &state, const corpus_document_t *doc)
+{
+    for (auto _ : state) {
+        json_value_t *root = bej_decode_buffer_borrowed(doc->bej.data(), doc->bej.size(), bench.schema.get(),
+                                                        bench.annot.get(), nullptr, nullptr);
+        if (!root) {
+            state.SkipWithError("bej_decode_buffer_borrowed failed");
+            break;
+        }
+        benchmark::DoNotOptimize(root);
+        json_free(root);
+    }
+    report(state, doc->bej.size());
+}
+
+void bm_bej_patch(benchmark::State &state, const corpus_document_t *doc)
+{
+    // one root property, the rest of the document is copied
+    const json_ptr patch(json_parse("{\"Name\": \"patched\"}"), json_free);
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+    for (auto _ : state) {
+        bej_buffer_clear(&out);
+        if (!bej_patch_buffer(&out, doc->bej.data(), doc->bej.size(), patch.get(), bench.schema.get(),
+                              bench.annot.get())) {
+            state.SkipWithError("bej_patch_buffer failed");
+            break;
+        }
+        benchmark::DoNotOptimize(out.data);
+    }
+    bej_buffer_free(&out);
+    report(state, doc->bej.size());
+}
+
+void bm_bej_encoder_encode(benchmark::State &state, const corpus_document_t *doc)
+{
+    const encoder_ptr encoder(bej_encoder_create(bench.schema.get(), bench.annot.get()), bej_encoder_free);
+    if (!encoder) {
+        state.SkipWithError("bej_encoder_create failed");
+        return;
+    }
+    for (auto _ : state) {
+        const uint8_t *data;
+        size_t size;
+        if (!bej_encoder_encode(encoder.get(), doc->tree.get(), BEJ_ENCODE_CANONICAL, &data, &size)) {
+            state.SkipWithError("bej_encoder_encode failed");
+            break;
+        }
+        benchmark::DoNotOptimize(data);
+    }
+    report(state, doc->bej.size());
+}
+
+void bm_bej_decoder_decode(benchmark::State &state, const corpus_document_t *doc)
+{
+    const decoder_ptr decoder(bej_decoder_create(bench.schema.get(), bench.annot.get()), bej_decoder_free);
+    if (!decoder) {
+        state.SkipWithError("bej_decoder_create failed");
+        return;
+    }
+    for (auto _ : state) {
+        json_value_t *root = bej_decoder_decode(decoder.get(), doc->bej.data(), doc->bej.size());
+        if (!root) {
+            state.SkipWithError("bej_decoder_decode failed");
+            break;
+        }
+        benchmark::DoNotOptimize(root);
+    }
+    report(state, doc->bej.size());
+}
+
+void bm_bej_decoder_decode_text(benchmark::State &state, const corpus_document_t *doc)
+{
+    const decoder_ptr decoder(bej_decoder_create(bench.schema.get(), bench.annot.get()), bej_decoder_free);
+    if (!decoder) {
+        state.SkipWithError("bej_decoder_create failed");
+        return;
+    }
+    for (auto _ : state) {
+        const char *text;
+        size_t length;
+        if (!bej_decoder_decode_text(decoder.get(), doc->bej.data(), doc->bej.size(), &text, &length)) {
+            state.SkipWithError("bej_decoder_decode_text failed");
+            break;
+        }
+        benchmark::DoNotOptimize(text);
+    }
+    report(state, doc->bej.size());
+}
+
+void bm_bej_encode_parallel(benchmark::State &state, const corpus_document_t *doc)
+{
+    const bej_parallel_t parallel = {bench.pool.get(), 0};
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+    for (auto _ : state) {
+        bej_buffer_clear(&out);
+        if (!bej_encode_buffer_parallel(&out, doc->tree.get(), bench.schema.get(), bench.annot.get(), &parallel)) {
+            state.SkipWithError("bej_encode_buffer_parallel failed");
+            break;
+        }
+        benchmark::DoNotOptimize(out.data);
+    }
+    bej_buffer_free(&out);
+    report(state, doc->bej.size());
+}
+
+void bm_bej_decode_parallel(benchmark::State &state, const corpus_document_t *doc)
+{
+    const bej_parallel_t parallel = {bench.pool.get(), 0};
+    for (auto _ : state) {
+        json_value_t *root = bej_decode_buffer_parallel(doc->bej.data(), doc->bej.size(), bench.schema.get(),
+                                                        bench.annot.get(), nullptr, &parallel);
+        if (!root) {
+            state.SkipWithError("bej_decode_buffer_parallel failed");
+            break;
+        }
+        benchmark::DoNotOptimize(root);
+        json_free(root);
+    }
+    report(state, doc->bej.size());
+}
+
+/**
+ * @brief looks up every member name of one Set, items/s counts lookups
+ * @param path names leading from the root to the Set (empty = the root)
+ */
+void bm_dict_find_child_by_name(benchmark::State &state, const std::vector<std::string> path)
+{
+    const bej_dictionary_t *dict = bench.schema.get();
+    bej_dict_stream_t ds;
+    bej_dict_entry_t set;
+    bej_dict_stream_init(&ds, dict);
+    bej_dict_stream_next(&ds, &set);
+    for (const std::string &name : path) {
+        if (!bej_dict_find_child_by_name(dict, set.child_pointer, set.child_count, name.c_str(), &set)) {
+            state.SkipWithError("unknown path");
+            return;
+        }
+    }
+
+    std::vector<const char *> names;
+    bej_dict_entry_t member;
+    bej_dict_stream_init_subset(&ds, dict, set.child_pointer, set.child_count);
+    while (bej_dict_stream_next(&ds, &member))
+        names.push_back(member.name);
+
+    for (auto _ : state) {
+        for (const char *name : names) {
+            benchmark::DoNotOptimize(bej_dict_find_child_by_name(dict, set.child_pointer, set.child_count, name, &member));
+            benchmark::DoNotOptimize(member);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+
+/**
+ * @brief loads the dictionaries and generates the corpus
+ * @return false on failure (the message is already printed)
+ */
+bool prepare()
+{
+    const std::string dir = BEJ_BENCH_DICTIONARY_DIR;
+    bench.schema.reset(bej_dictionary_load_map((dir + "/Memory_v1.bin").c_str()));
+    bench.annot.reset(bej_dictionary_load_map((dir + "/annotation.bin").c_str()));
+    bench.null_output.reset(fopen("/dev/null", "wb"));
+    if (!bench.schema || !bench.annot || !bench.null_output) {
+        fprintf(stderr, "Failed to load the dictionaries from %s\n", dir.c_str());
+        return false;
+    }
+
+    const unsigned cpus = std::thread::hardware_concurrency();
+    bench.pool.reset(bej_pool_create(cpus > 1 ? cpus - 1 : 0));
+    if (!bench.pool) {
+        fprintf(stderr, "Failed to start the thread pool\n");
+        return false;
+    }
+
+    bench.documents.resize(sizeof(corpus_shapes) / sizeof(corpus_shapes[0]));
+    for (size_t i = 0; i < bench.documents.size(); i++) {
+        corpus_document_t &doc = bench.documents[i];
+        doc.text = corpus_generator(bench.schema.get(), corpus_shapes[i]).generate();
+        doc.tree.reset(json_parse(doc.text.c_str()));
+
+        bej_buffer_t out;
+        bej_buffer_init(&out);
+        const int ok = doc.tree &&
+                       bej_encode_buffer(&out, doc.tree.get(), bench.schema.get(), bench.annot.get(), BEJ_ENCODE_CANONICAL);
+        doc.bej.assign(out.data, out.data + out.size);
+        bej_buffer_free(&out);
+        if (!ok) {
+            fprintf(stderr, "Failed to encode the %s document\n", corpus_shapes[i].name);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv) || !prepare())
+        return 1;
+
+    for (size_t i = 0; i < bench.documents.size(); i++) {
+        const std::string shape = corpus_shapes[i].name;
+        const corpus_document_t *doc = &bench.documents[i];
+        benchmark::RegisterBenchmark(("json_parse/" + shape).c_str(), bm_json_parse, doc);
+        benchmark::RegisterBenchmark(("json_compare/" + shape).c_str(), bm_json_compare, doc);
+        benchmark::RegisterBenchmark(("bej_encode_stream/" + shape).c_str(), bm_bej_encode_stream, doc);
+        benchmark::RegisterBenchmark(("bej_decode_stream/" + shape).c_str(), bm_bej_decode_stream, doc);
+        benchmark::RegisterBenchmark(("bej_decode_buffer/" + shape).c_str(), bm_bej_decode_buffer, doc);
+        benchmark::RegisterBenchmark(("bej_decode_borrowed/" + shape).c_str(), bm_bej_decode_borrowed, doc);
+        benchmark::RegisterBenchmark(("bej_patch/" + shape).c_str(), bm_bej_patch, doc);
+        benchmark::RegisterBenchmark(("bej_encoder_encode/" + shape).c_str(), bm_bej_encoder_encode, doc);
+        benchmark::RegisterBenchmark(("bej_decoder_decode/" + shape).c_str(), bm_bej_decoder_decode, doc);
+        benchmark::RegisterBenchmark(("bej_decoder_decode_text/" + shape).c_str(), bm_bej_decoder_decode_text, doc);
+        benchmark::RegisterBenchmark(("bej_encode_parallel/" + shape).c_str(), bm_bej_encode_parallel, doc);
+        benchmark::RegisterBenchmark(("bej_decode_parallel/" + shape).c_str(), bm_bej_decode_parallel, doc);
+    }
+    benchmark::RegisterBenchmark("bej_dict_find_child_by_name/Memory", bm_dict_find_child_by_name,
+                                 std::vector<std::string>{});
+    benchmark::RegisterBenchmark("bej_dict_find_child_by_name/PostalAddress", bm_dict_find_child_by_name,
+                                 std::vector<std::string>{"Location", "PostalAddress"});
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file bej.hpp
+ * @brief C++20 coroutine wrapper of the async codecs
+ *
+ * bej::convert() turns an async encoder or decoder into a coroutine that
+ * suspends whenever the codec stops on its source or sink. What it awaits is
+ * up to the caller: an awaitable that resumes the coroutine when the event
+ * loop reports the descriptor readable or writable lets one loop thread run
+ * any number of conversions. Header-only, on top of bej_encode.h and
+ * bej_decode.h
+ */
+
+#ifndef BEJ_PARSER_BEJ_HPP
+#define BEJ_PARSER_BEJ_HPP
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+extern "C" {
+    #include "bej_decode.h"
+    #include "bej_encode.h"
+}
+
+namespace bej {
+
+/**
+ * @brief owning wrapper of a bej_async_decoder_t
+ */
+class async_decoder {
+public:
+    /**
+     * @brief creates the decoder, see bej_async_decoder_create()
+     */
+    async_decoder(const bej_dictionary_t *schema_dict, const bej_dictionary_t *annot_dict,
+                  const bej_decode_limits_t *limits, bej_source_fn source, void *source_ctx,
+                  bej_sink_fn sink, void *sink_ctx)
+        : decoder(bej_async_decoder_create(schema_dict, annot_dict, limits, source, source_ctx, sink, sink_ctx),
+                  bej_async_decoder_free) {}
+
+    /**
+     * @brief tells whether the decoder was created
+     */
+    explicit operator bool() const { return decoder != nullptr; }
+
+    /**
+     * @brief advances the decode, see bej_async_decoder_run()
+     */
+    bej_io_status_t run() { return bej_async_decoder_run(decoder.get()); }
+
+private:
+    std::unique_ptr<bej_async_decoder_t, void (*)(bej_async_decoder_t *)> decoder;
+};
+
+/**
+ * @brief owning wrapper of a bej_async_encoder_t
+ */
+class async_encoder {
+public:
+    /**
+     * @brief creates the encoder, see bej_async_encoder_create()
+     */
+    async_encoder(const bej_dictionary_t *schema_dict, const bej_dictionary_t *annot_dict, unsigned flags,
+                  bej_source_fn source, void *source_ctx, bej_sink_fn sink, void *sink_ctx)
+        : encoder(bej_async_encoder_create(schema_dict, annot_dict, flags, source, source_ctx, sink, sink_ctx),
+                  bej_async_encoder_free) {}
+
+    /**
+     * @brief tells whether the encoder was created
+     */
+    explicit operator bool() const { return encoder != nullptr; }
+
+    /**
+     * @brief advances the encode, see bej_async_encoder_run()
+     */
+    bej_io_status_t run() { return bej_async_encoder_run(encoder.get()); }
+
+private:
+    std::unique_ptr<bej_async_encoder_t, void (*)(bej_async_encoder_t *)> encoder;
+};
+
+/**
+ * @brief a coroutine producing a T, started by start() or by co_await
+ *
+ * It does nothing until started. Awaited from another coroutine, it resumes
+ * that coroutine when it finishes
+ */
+template <class T>
+class task {
+public:
+    struct promise_type {
+        T value{};                          /**< the co_return value */
+        std::exception_ptr error;           /**< exception that ended the coroutine */
+        std::coroutine_handle<> continuation; /**< coroutine awaiting this one */
+
+        task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> self) noexcept
+            {
+                const std::coroutine_handle<> next = self.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept { return {}; }
+        void return_value(T result) { value = std::move(result); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    task(task &&other) noexcept : coroutine(std::exchange(other.coroutine, {})) {}
+    task &operator=(task &&other) noexcept
+    {
+        if (this != &other) {
+            if (coroutine) coroutine.destroy();
+            coroutine = std::exchange(other.coroutine, {});
+        }
+        return *this;
+    }
+    ~task()
+    {
+        if (coroutine) coroutine.destroy();
+    }
+
+    /**
+     * @brief runs the coroutine up to its first suspension
+     */
+    void start() { coroutine.resume(); }
+
+    /**
+     * @brief tells whether the coroutine has finished
+     */
+    bool done() const { return coroutine.done(); }
+
+    /**
+     * @brief returns the value of a finished coroutine, rethrowing its exception
+     */
+    T result()
+    {
+        if (coroutine.promise().error) std::rethrow_exception(coroutine.promise().error);
+        return std::move(coroutine.promise().value);
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(const std::coroutine_handle<> awaiting) noexcept
+    {
+        coroutine.promise().continuation = awaiting;
+        return coroutine;
+    }
+    T await_resume() { return result(); }
+
+private:
+    explicit task(const std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+    std::coroutine_handle<promise_type> coroutine;
+};
+
+/**
+ * @brief runs an async codec to the end of its document
+ *
+ * Whenever the codec stops with BEJ_IO_NEED_INPUT or BEJ_IO_OUTPUT_FULL the
+ * coroutine awaits `wait(status)`, which should resume it once the source or
+ * sink can make progress. The codec must outlive the task
+ *
+ * @param codec an async_encoder or async_decoder
+ * @param wait callable returning an awaitable for a status
+ * @return a task producing true if the document was converted
+ */
+template <class Codec, class Wait>
+task<bool> convert(Codec &codec, Wait wait)
+{
+    for (;;) {
+        const bej_io_status_t status = codec.run();
+        if (status == BEJ_IO_DONE) co_return true;
+        if (status == BEJ_IO_FAILED) co_return false;
+        co_await wait(status);
+    }
+}
+
+} // namespace bej
+
+#endif // BEJ_PARSER_BEJ_HPP
@@ -0,0 +1,94 @@
+/**
+ * @file bej_bind.h
+ * @brief schema-bound binding between BEJ documents and C structs
+ *
+ * A binding maps dictionary paths to struct members. It is compiled once
+ * against the dictionaries: every path is resolved to the sequence numbers
+ * the encoder uses, so bej_decode_bound() and bej_encode_bound() convert
+ * between a BEJ buffer and the struct without building a json_value_t tree
+ * and without comparing names.
+ *
+ * Bound properties take these C types:
+ * - BEJ_FORMAT_INTEGER: int64_t
+ * - BEJ_FORMAT_BOOLEAN: int (0 or 1)
+ * - BEJ_FORMAT_STRING: const char * (decoded strings point into the BEJ buffer)
+ * - BEJ_FORMAT_ENUM: int, the sequence number of the option in the dictionary
+ *
+ * Paths use the syntax of bej_view_get() and may only pass through Sets;
+ * Array contents cannot be bound
+ */
+
+#ifndef BEJ_PARSER_BEJ_BIND_H
+#define BEJ_PARSER_BEJ_BIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bej_dictionary.h"
+
+#define BEJ_BIND_MAX_FIELDS 64         /**< fields per binding, one bit each in a presence mask */
+#define BEJ_BIND_NONE       UINT32_MAX /**< no node / no field */
+
+/**
+ * @brief declares a bej_bind_field_t for a member of a struct type
+ */
+#define BEJ_BIND_FIELD(type, member, path, format) {(path), (format), offsetof(type, member)}
+
+/**
+ * @brief one bound property
+ */
+typedef struct bej_bind_field
+{
+    const char *path; /**< path of the property, e.g. "/Status/Health" */
+    uint8_t format;   /**< BEJ_FORMAT_INTEGER, BOOLEAN, STRING or ENUM (must match the dictionary) */
+    size_t offset;    /**< offset of the struct member, see BEJ_BIND_FIELD() */
+} bej_bind_field_t;
+
+/**
+ * @brief a resolved property of a binding: a bound field or a Set on the way to one
+ */
+typedef struct bej_bind_node
+{
+    bej_dict_entry_t entry; /**< dictionary entry of the property */
+    uint64_t seq;           /**< full sequence number (with selector bit) */
+    uint8_t selector;       /**< dictionary selector of the property */
+    uint32_t field;         /**< index of the bound field, or BEJ_BIND_NONE for a Set */
+    uint32_t first_child;   /**< first member of a Set node, or BEJ_BIND_NONE */
+    uint32_t next_sibling;  /**< next member of the parent, or BEJ_BIND_NONE */
+    uint64_t fields;        /**< mask of the fields bound at or below this node */
+} bej_bind_node_t;
+
+/**
+ * @brief a compiled binding (nodes[0] is the root Set)
+ */
+typedef struct bej_binding
+{
+    const bej_bind_field_t *fields;      /**< the field table (borrowed, must outlive the binding) */
+    size_t field_count;                  /**< number of fields */
+    bej_bind_node_t *nodes;              /**< the resolved properties (owned) */
+    size_t node_count;                   /**< number of nodes */
+    const bej_dictionary_t *schema_dict; /**< the main schema dictionary */
+    const bej_dictionary_t *annot_dict;  /**< the annotation dictionary (may be NULL) */
+} bej_binding_t;
+
+/**
+ * @brief compiles a field table against the dictionaries
+ * @param binding the binding to fill
+ * @param fields the field table
+ * @param field_count number of fields (at most BEJ_BIND_MAX_FIELDS)
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if no annotation is bound)
+ * @return 1 on success, 0 if a path is unknown, bound twice, passes through a
+ *         non-Set or its format does not match the dictionary
+ */
+int bej_binding_init(bej_binding_t *binding, const bej_bind_field_t *fields, size_t field_count,
+                     const bej_dictionary_t *schema_dict,
+                     const bej_dictionary_t *annot_dict);
+
+/**
+ * @brief releases the nodes of a binding
+ * @param binding the binding (NULL-safe)
+ */
+void bej_binding_free(bej_binding_t *binding);
+
+#endif // BEJ_PARSER_BEJ_BIND_H
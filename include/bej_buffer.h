@@ -0,0 +1,257 @@
+/**
+ * @file bej_buffer.h
+ * @brief growable in-memory byte buffer used as the output of the BEJ codecs
+ *
+ * The buffer owns a single heap block that grows geometrically, so appending
+ * N bytes in total costs O(N) amortized and never touches the filesystem
+ */
+
+#ifndef BEJ_PARSER_BEJ_BUFFER_H
+#define BEJ_PARSER_BEJ_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define BEJ_BUFFER_INITIAL_CAPACITY 256 /**< capacity of the first allocation */
+#define BEJ_NNINT_MAX_SIZE 9            /**< bytes of the longest nnint: the width byte and 8 value bytes */
+#define BEJ_SFL_MAX_SIZE   (2 * BEJ_NNINT_MAX_SIZE + 1) /**< bytes of the longest SFL header */
+#define BEJ_SFL_PREFIX_MAX_SEQ ((UINT64_C(1) << 40) - 1) /**< largest sequence number bej_sfl_prefix() packs */
+
+/**
+ * @brief growable byte buffer
+ */
+typedef struct bej_buffer
+{
+    uint8_t *data;     /**< buffer contents (NULL until the first append) */
+    size_t   size;     /**< number of bytes in use */
+    size_t   capacity; /**< number of bytes allocated */
+    int      borrowed; /**< 1 if `data` belongs to the caller, see bej_buffer_wrap() */
+} bej_buffer_t;
+
+/**
+ * @brief initializes an empty buffer without allocating
+ * @param buf buffer to initialize
+ */
+void bej_buffer_init(bej_buffer_t *buf);
+
+/**
+ * @brief makes an empty buffer over caller memory that never grows
+ *
+ * Appends past `capacity` fail instead of reallocating, so a buffer can
+ * write into a fixed region of a larger one. bej_buffer_free() leaves the
+ * memory alone
+ *
+ * @param buf buffer to initialize
+ * @param data the memory to write to
+ * @param capacity number of bytes at `data`
+ */
+void bej_buffer_wrap(bej_buffer_t *buf, uint8_t *data, size_t capacity);
+
+/**
+ * @brief releases the memory owned by a buffer and resets it to empty
+ * @param buf buffer to free (NULL-safe)
+ */
+void bej_buffer_free(bej_buffer_t *buf);
+
+/**
+ * @brief discards the contents of a buffer but keeps its capacity
+ * @param buf buffer to clear
+ */
+void bej_buffer_clear(bej_buffer_t *buf);
+
+/**
+ * @brief makes sure at least `additional` more bytes can be appended without reallocating
+ * @param buf buffer to grow
+ * @param additional number of bytes that will be appended
+ * @return 1 on success, 0 on allocation failure
+ */
+int bej_buffer_reserve(bej_buffer_t *buf, size_t additional);
+
+/**
+ * @brief extends the buffer by `n` uninitialized bytes
+ * @param buf buffer to extend
+ * @param n number of bytes to add
+ * @return pointer to the first new byte, or NULL on allocation failure
+ */
+uint8_t *bej_buffer_extend(bej_buffer_t *buf, size_t n);
+
+/**
+ * @brief appends `n` bytes to the end of the buffer
+ * @param buf buffer to append to
+ * @param data bytes to append
+ * @param n number of bytes
+ * @return 1 on success, 0 on allocation failure
+ */
+int bej_buffer_append(bej_buffer_t *buf, const void *data, size_t n);
+
+/**
+ * @brief appends a single byte to the end of the buffer
+ * @param buf buffer to append to
+ * @param byte value to append
+ * @return 1 on success, 0 on allocation failure
+ */
+int bej_buffer_append_byte(bej_buffer_t *buf, uint8_t byte);
+
+/**
+ * @brief returns a pointer to `n` writable bytes past the end of the buffer
+ *
+ * The bytes are not part of the buffer until `size` is advanced, so a writer
+ * may store more than it keeps. A wrapped buffer is never grown
+ *
+ * @param buf buffer to write to
+ * @param n number of bytes that may be stored
+ * @return pointer to the end of the buffer, or NULL if there is no room
+ */
+static inline uint8_t *bej_buffer_room(bej_buffer_t *buf, const size_t n) {
+    if (n <= buf->capacity - buf->size || bej_buffer_reserve(buf, n))
+        return buf->data + buf->size;
+    return NULL;
+}
+
+/**
+ * @name nnint and SFL emitters
+ *
+ * Each emitter stores a whole field with as few stores as possible and returns
+ * the number of bytes that belong to it. The destination must have room for
+ * the longest form of the field (BEJ_NNINT_MAX_SIZE, BEJ_SFL_MAX_SIZE), the
+ * bytes past the returned length are scratch
+ * @{
+ */
+
+/**
+ * @brief stores a value as 8 little-endian bytes
+ * @param p the destination (8 bytes)
+ * @param value the value
+ */
+static inline void bej_put_u64le(uint8_t *p, const uint64_t value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(p, &value, sizeof(value));
+#else
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t)(value >> (8 * i));
+#endif
+}
+
+/**
+ * @brief returns the number of bytes of the minimal nnint encoding of a value
+ * @param value the value
+ * @return encoded size including the width byte (2 to 9)
+ */
+static inline size_t bej_nnint_size(const uint64_t value) {
+    // one value byte per started octet of significant bits, 0 still takes one
+    return 1 + (size_t)(71 - __builtin_clzll(value | 1)) / 8;
+}
+
+/**
+ * @brief writes the minimal nnint encoding of a value
+ * @param p the destination (BEJ_NNINT_MAX_SIZE bytes)
+ * @param value the value
+ * @return the number of bytes of the nnint
+ */
+static inline size_t bej_put_nnint(uint8_t *p, const uint64_t value) {
+    const size_t n = bej_nnint_size(value);
+    p[0] = (uint8_t)(n - 1);
+    bej_put_u64le(p + 1, value);
+    return n;
+}
+
+/**
+ * @brief writes a value as an nnint of a fixed width, for fields patched later
+ * @param p the destination (BEJ_NNINT_MAX_SIZE bytes)
+ * @param value the value (fits the width)
+ * @param width the number of value bytes (1 to 8)
+ * @return the number of bytes of the nnint
+ */
+static inline size_t bej_put_fixed_nnint(uint8_t *p, const uint64_t value, const size_t width) {
+    p[0] = (uint8_t)width;
+    bej_put_u64le(p + 1, value);
+    return 1 + width;
+}
+
+/**
+ * @brief writes an SFL header with a minimal length field
+ * @param p the destination (BEJ_SFL_MAX_SIZE bytes)
+ * @param seq the sequence number combined with the selector bit
+ * @param format the format code (BEJ_FORMAT_*)
+ * @param length the payload length
+ * @return the number of bytes of the header
+ */
+static inline size_t bej_put_sfl(uint8_t *p, const uint64_t seq, const uint8_t format, const uint64_t length) {
+    size_t n = bej_put_nnint(p, seq);
+    p[n++] = (uint8_t)(format << 4);
+    return n + bej_put_nnint(p + n, length);
+}
+
+/**
+ * @brief writes an SFL header with a fixed-width length field
+ * @param p the destination (BEJ_SFL_MAX_SIZE bytes)
+ * @param seq the sequence number combined with the selector bit
+ * @param format the format code (BEJ_FORMAT_*)
+ * @param length the payload length (fits the width, or a placeholder)
+ * @param width the number of value bytes of the length field (1 to 8)
+ * @return the number of bytes of the header
+ */
+static inline size_t bej_put_sfl_fixed(uint8_t *p, const uint64_t seq, const uint8_t format,
+                                       const uint64_t length, const size_t width) {
+    size_t n = bej_put_nnint(p, seq);
+    p[n++] = (uint8_t)(format << 4);
+    return n + bej_put_fixed_nnint(p + n, length, width);
+}
+
+/**
+ * @brief packs the sequence number and the format byte of an SFL header, the part that precedes the length
+ *
+ * The bytes are held in output order from the lowest byte on, their count in
+ * the top byte. The selector is the low bit of the second byte, so a prefix
+ * packed with selector 0 selects the annotation dictionary with `prefix | 1 << 8`
+ *
+ * @param seq the sequence number combined with the selector bit (at most BEJ_SFL_PREFIX_MAX_SEQ)
+ * @param format the format code (BEJ_FORMAT_*)
+ * @return the packed prefix
+ */
+static inline uint64_t bej_sfl_prefix(const uint64_t seq, const uint8_t format) {
+    const size_t n = bej_nnint_size(seq);
+    return (uint64_t)(n + 1) << 56 | (uint64_t)(uint8_t)(format << 4) << (8 * n) | seq << 8 | (uint64_t)(n - 1);
+}
+
+/**
+ * @brief returns the number of bytes of a prefix packed by bej_sfl_prefix()
+ * @param prefix the prefix
+ * @return the bytes of the sequence nnint and the format byte
+ */
+static inline size_t bej_sfl_prefix_size(const uint64_t prefix) {
+    return (size_t)(prefix >> 56);
+}
+
+/**
+ * @brief writes an SFL header from a packed prefix and a minimal length field
+ * @param p the destination (BEJ_SFL_MAX_SIZE bytes)
+ * @param prefix the sequence and format, see bej_sfl_prefix()
+ * @param length the payload length
+ * @return the number of bytes of the header
+ */
+static inline size_t bej_put_sfl_prefix(uint8_t *p, const uint64_t prefix, const uint64_t length) {
+    const size_t n = bej_sfl_prefix_size(prefix);
+    bej_put_u64le(p, prefix); // the count in the top byte is overwritten by the length
+    return n + bej_put_nnint(p + n, length);
+}
+
+/**
+ * @brief writes an SFL header from a packed prefix and a fixed-width length field
+ * @param p the destination (BEJ_SFL_MAX_SIZE bytes)
+ * @param prefix the sequence and format, see bej_sfl_prefix()
+ * @param length the payload length (fits the width, or a placeholder)
+ * @param width the number of value bytes of the length field (1 to 8)
+ * @return the number of bytes of the header
+ */
+static inline size_t bej_put_sfl_prefix_fixed(uint8_t *p, const uint64_t prefix, const uint64_t length,
+                                              const size_t width) {
+    const size_t n = bej_sfl_prefix_size(prefix);
+    bej_put_u64le(p, prefix);
+    return n + bej_put_fixed_nnint(p + n, length, width);
+}
+
+/** @} */
+
+#endif // BEJ_PARSER_BEJ_BUFFER_H
@@ -0,0 +1,164 @@
+/**
+ * @file bej_cursor.h
+ * @brief bounds-checked byte cursor and inline BEJ primitive readers
+ *
+ * A cursor is a pair of pointers into a caller-owned buffer. All readers
+ * check the remaining length before touching memory and never read past
+ * `end`, so they are safe on truncated or hostile input
+ */
+
+#ifndef BEJ_PARSER_BEJ_CURSOR_H
+#define BEJ_PARSER_BEJ_CURSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define BEJ_NNINT_MAX_SIZE 9 /**< length byte plus up to 8 value bytes */
+
+/**
+ * @brief read position inside an in-memory BEJ buffer
+ */
+typedef struct bej_cursor
+{
+    const uint8_t *pos; /**< next byte to read */
+    const uint8_t *end; /**< one past the last readable byte */
+} bej_cursor_t;
+
+/**
+ * @brief initializes a cursor over a buffer
+ * @param c cursor to initialize
+ * @param data start of the buffer
+ * @param size size of the buffer in bytes
+ */
+static inline void bej_cursor_init(bej_cursor_t *c, const uint8_t *data, const size_t size) {
+    c->pos = data;
+    c->end = data + size;
+}
+
+/**
+ * @brief returns the number of unread bytes
+ * @param c cursor to query
+ * @return bytes between the current position and the end
+ */
+static inline size_t bej_cursor_remaining(const bej_cursor_t *c) {
+    return (size_t)(c->end - c->pos);
+}
+
+/**
+ * @brief reads a single byte
+ * @param c cursor to read from
+ * @param value pointer to store the byte
+ * @return 1 on success, 0 if the cursor is exhausted
+ */
+static inline int bej_cursor_read_u8(bej_cursor_t *c, uint8_t *value) {
+    if (c->pos >= c->end) return 0;
+    *value = *c->pos++;
+    return 1;
+}
+
+/**
+ * @brief advances the cursor by `n` bytes
+ * @param c cursor to advance
+ * @param n number of bytes to skip
+ * @return 1 on success, 0 if fewer than `n` bytes remain
+ */
+static inline int bej_cursor_skip(bej_cursor_t *c, const uint64_t n) {
+    if ((uint64_t)bej_cursor_remaining(c) < n) return 0;
+    c->pos += n;
+    return 1;
+}
+
+/**
+ * @brief splits `n` bytes off the front of a cursor into a separate sub-cursor
+ * @param c cursor to consume from
+ * @param n length of the region (usually an SFL length)
+ * @param sub pointer to store the cursor limited to that region
+ * @return 1 on success, 0 if fewer than `n` bytes remain
+ */
+static inline int bej_cursor_take(bej_cursor_t *c, const uint64_t n, bej_cursor_t *sub) {
+    if ((uint64_t)bej_cursor_remaining(c) < n) return 0;
+    sub->pos = c->pos;
+    sub->end = c->pos + n;
+    c->pos = sub->end;
+    return 1;
+}
+
+/**
+ * @brief reads a little-endian unsigned integer of up to 8 bytes
+ * @param c cursor to read from
+ * @param num_bytes width of the integer (0..8)
+ * @param value pointer to store the value
+ * @return 1 on success, 0 if the cursor is too short
+ */
+static inline int bej_cursor_read_uint(bej_cursor_t *c, const size_t num_bytes, uint64_t *value) {
+    if (num_bytes > 8 || bej_cursor_remaining(c) < num_bytes) return 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (bej_cursor_remaining(c) >= 8) {
+        // fast path: one unaligned load, then mask off the bytes beyond the width
+        uint64_t word;
+        memcpy(&word, c->pos, sizeof(word));
+        const uint64_t mask = (uint64_t)-(uint64_t)(num_bytes != 0) &
+                              (UINT64_MAX >> (((8 - num_bytes) * 8) & 63));
+        *value = word & mask;
+        c->pos += num_bytes;
+        return 1;
+    }
+#endif
+
+    uint64_t v = 0;
+    for (size_t i = 0; i < num_bytes; i++) {
+        v |= (uint64_t)c->pos[i] << (8 * i);
+    }
+    *value = v;
+    c->pos += num_bytes;
+    return 1;
+}
+
+/**
+ * @brief reads a non-negative integer (nnint): a length byte followed by that many value bytes
+ * @param c cursor to read from
+ * @param value pointer to store the 64-bit value
+ * @return 1 on success, 0 if the buffer is truncated or the nnint is wider than 8 bytes
+ */
+static inline int bej_cursor_read_nnint(bej_cursor_t *c, uint64_t *value) {
+    if (c->pos >= c->end) return 0;
+    const size_t num_bytes = *c->pos;
+    if (num_bytes > 8 || bej_cursor_remaining(c) <= num_bytes) return 0;
+    c->pos++;
+    return bej_cursor_read_uint(c, num_bytes, value);
+}
+
+/**
+ * @brief reads an SFL (Sequence, Format, Length) header
+ * @param c cursor to read from
+ * @param seq pointer to store the full sequence number (with selector bit)
+ * @param format pointer to store the format code (upper nibble of the format byte)
+ * @param length pointer to store the payload length
+ * @return 1 on success, 0 on failure
+ */
+static inline int bej_cursor_read_sfl(bej_cursor_t *c, uint64_t *seq, uint8_t *format, uint64_t *length) {
+    uint8_t format_and_flags;
+    if (!bej_cursor_read_nnint(c, seq) || !bej_cursor_read_u8(c, &format_and_flags)) return 0;
+    *format = (uint8_t)(format_and_flags >> 4);
+    return bej_cursor_read_nnint(c, length);
+}
+
+/**
+ * @brief reads an Enum payload: the length of the option nnint, then the option nnint
+ * @param c cursor to read from
+ * @param option pointer to store the sequence number of the option
+ * @return 1 on success, 0 if the payload is truncated, the option nnint does not take exactly
+ *         the stated length or the option does not fit a 16-bit dictionary sequence number
+ */
+static inline int bej_cursor_read_enum(bej_cursor_t *c, uint64_t *option) {
+    uint64_t len;
+    bej_cursor_t value;
+    if (!bej_cursor_read_nnint(c, &len) || !bej_cursor_take(c, len, &value) ||
+        !bej_cursor_read_nnint(&value, option))
+        return 0;
+    return value.pos == value.end && *option <= UINT16_MAX;
+}
+
+#endif // BEJ_PARSER_BEJ_CURSOR_H
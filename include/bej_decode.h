@@ -11,11 +11,128 @@
 
 #include <stdint.h>
 #include <stdio.h> // For FILE*
+#include "bej_bind.h"
 #include "bej_dictionary.h"
+#include "bej_io.h"
+#include "bej_pool.h"
 #include "json.h"
 
+#define BEJ_DECODE_CHUNK_SIZE (16u * 1024u) /**< bytes bej_decode_stream() reads per chunk */
+#define BEJ_DECODE_MAX_DEPTH  64              /**< default deepest nesting of Sets and Arrays (the root Set is level 1) */
+
+/**
+ * @brief bounds on the work a decoder does for one document
+ *
+ * Input that nests deeper than `max_depth` or produces more than
+ * `max_output` bytes fails to decode. A zero member selects the default
+ */
+typedef struct {
+    size_t max_depth;    /**< deepest nesting of Sets and Arrays, the root Set is level 1 (0 = BEJ_DECODE_MAX_DEPTH) */
+    uint64_t max_output; /**< most bytes of JSON text, or of tree nodes and strings for the tree decoders (0 = no limit) */
+} bej_decode_limits_t;
+
+/**
+ * @brief receives the JSON text produced by a bej_stream_decoder_t
+ * @param ctx the context passed to bej_stream_decoder_init()
+ * @param data the characters to write (not null-terminated)
+ * @param size the number of characters
+ * @return 1 on success, 0 to abort decoding
+ */
+typedef int (*bej_write_fn)(void* ctx, const char* data, size_t size);
+
+/**
+ * @brief an open Set or Array of a streaming decode (defined in bej_decode.c)
+ */
+typedef struct bej_decode_frame bej_decode_frame_t;
+
+/**
+ * @brief state of a resumable BEJ to JSON text decoder
+ *
+ * Input is fed in chunks of any size, a chunk may end in the middle of an
+ * SFL header or a value. Open containers are kept on an explicit frame stack,
+ * so memory stays proportional to the nesting depth, which is bounded by
+ * BEJ_DECODE_MAX_DEPTH unless other limits are set. All fields are internal
+ */
+typedef struct {
+    const bej_dictionary_t* schema_dict; /**< the main schema dictionary */
+    const bej_dictionary_t* annot_dict;  /**< the annotation dictionary (may be NULL) */
+    bej_write_fn write;                  /**< text sink */
+    void* write_ctx;                     /**< context of `write` */
+    json_writer_t text;                  /**< text produced by the current feed call */
+    int state;                           /**< what the next input byte belongs to */
+    int resume;                          /**< state to enter once a skip has finished */
+    int failed;                          /**< sticky error flag */
+    uint64_t offset;                     /**< input bytes consumed so far */
+    uint64_t limit;                      /**< end offset of the innermost open payload */
+    uint64_t skip_to;                    /**< offset a skip runs to */
+    bej_decode_frame_t* frames;          /**< open containers, outermost first */
+    size_t depth;                        /**< number of open containers */
+    size_t frame_capacity;               /**< allocated entries in `frames` */
+    size_t max_depth;                    /**< deepest nesting of open containers accepted */
+    uint64_t max_output;                 /**< most bytes of text the document may produce */
+    uint64_t written;                    /**< bytes of text passed to `write` so far */
+    int nnint_width;                     /**< width of the nnint being read, -1 before its length byte */
+    int nnint_read;                      /**< value bytes of the nnint read so far */
+    uint64_t nnint_value;                /**< value bytes of the nnint accumulated so far */
+    uint64_t seq;                        /**< sequence number of the current SFL */
+    uint64_t value_left;                 /**< payload bytes of the current scalar still to read */
+    uint64_t value_bits;                 /**< integer bytes accumulated so far */
+    uint64_t value_width;                /**< width of the current integer payload */
+    bej_dict_entry_t entry;              /**< dictionary entry of the current property */
+    uint8_t selector;                    /**< dictionary selector of the current property */
+} bej_stream_decoder_t;
+
+/**
+ * @brief prepares a streaming decoder
+ * @param dec the decoder to initialize
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if the data has no annotations)
+ * @param write the callback receiving the JSON text
+ * @param write_ctx context passed to `write`
+ */
+void bej_stream_decoder_init(bej_stream_decoder_t* dec,
+                             const bej_dictionary_t* schema_dict,
+                             const bej_dictionary_t* annot_dict,
+                             bej_write_fn write, void* write_ctx);
+
+/**
+ * @brief sets the limits of a streaming decoder
+ *
+ * Call it after bej_stream_decoder_init() and before the first chunk
+ *
+ * @param dec the decoder
+ * @param limits the limits (NULL = defaults)
+ */
+void bej_stream_decoder_set_limits(bej_stream_decoder_t* dec, const bej_decode_limits_t* limits);
+
+/**
+ * @brief decodes the next chunk of a BEJ document
+ *
+ * The text produced from the chunk (compact, escaped) is passed to the write
+ * callback in one call before returning. Bytes after the end of the root Set
+ * are ignored
+ *
+ * @param dec the decoder
+ * @param data the next input bytes
+ * @param size the number of bytes (may be 0)
+ * @return 1 on success, 0 on malformed input or a failed write (sticky)
+ */
+int bej_stream_decoder_feed(bej_stream_decoder_t* dec, const uint8_t* data, size_t size);
+
+/**
+ * @brief finishes a streaming decode and releases its memory
+ * @param dec the decoder
+ * @return 1 if a complete document was decoded without error, 0 otherwise
+ */
+int bej_stream_decoder_finish(bej_stream_decoder_t* dec);
+
 /**
  * @brief decodes a BEJ stream into a textual JSON stream
+ *
+ * The input is read from its current position in chunks of
+ * BEJ_DECODE_CHUNK_SIZE bytes and decoded with a bej_stream_decoder_t, so
+ * neither the BEJ data nor the JSON text is held in memory
+ *
  * @param output_stream the output stream to write JSON text to
  * @param input_stream the input stream containing BEJ data
  * @param schema_dict the main schema dictionary
@@ -28,14 +145,258 @@ int bej_decode_stream(FILE* output_stream, FILE* input_stream,
 
 /**
  * @brief decodes a BEJ buffer in memory into a parsed JSON object tree
+ *
+ * The tree is built directly from the BEJ bytes, no intermediate JSON text is produced.
+ * Properties with formats the decoder does not support are left out of the tree
+ *
  * @param data pointer to the buffer with BEJ data
  * @param size the size of the buffer
  * @param schema_dict the main schema dictionary
- * @param annot_dict the annotation dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if the data has no annotations)
  * @return a pointer to a `json_value_t` on success, or NULL on failure
  */
 json_value_t* bej_decode_buffer(const uint8_t* data, size_t size,
                                 const bej_dictionary_t* schema_dict,
                                 const bej_dictionary_t* annot_dict);
 
+/**
+ * @brief decodes a BEJ buffer into a JSON object tree allocated in an arena
+ *
+ * Same as bej_decode_buffer() but every node, key and string is bump-allocated
+ * from `arena`; the tree is released with the arena, json_free() on it is a no-op
+ *
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if the data has no annotations)
+ * @param arena arena for the tree (NULL = heap, same as bej_decode_buffer)
+ * @return a pointer to a `json_value_t` on success, or NULL on failure
+ */
+json_value_t* bej_decode_buffer_in(const uint8_t* data, size_t size,
+                                   const bej_dictionary_t* schema_dict,
+                                   const bej_dictionary_t* annot_dict,
+                                   json_arena_t* arena);
+
+/**
+ * @brief decodes a BEJ buffer into a JSON object tree within limits
+ *
+ * Same as bej_decode_buffer_in(), which decodes with the default limits.
+ * `max_output` counts a json_value_t per value plus the characters of every
+ * string copied into the tree
+ *
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if the data has no annotations)
+ * @param arena arena for the tree (NULL = heap)
+ * @param limits the limits (NULL = defaults)
+ * @return a pointer to a `json_value_t` on success, or NULL on failure or when a limit is exceeded
+ */
+json_value_t* bej_decode_buffer_limited(const uint8_t* data, size_t size,
+                                        const bej_dictionary_t* schema_dict,
+                                        const bej_dictionary_t* annot_dict,
+                                        json_arena_t* arena,
+                                        const bej_decode_limits_t* limits);
+
+/**
+ * @brief decodes a BEJ buffer into a JSON object tree that borrows its strings
+ *
+ * Same tree as bej_decode_buffer_limited(), without copying characters:
+ * object keys and Enum values point at the names in the dictionaries and
+ * String values at their bytes in `data` (unterminated Strings are still
+ * copied). Such values carry JSON_FLAG_BORROWED, so json_free() leaves the
+ * characters alone. `data` and the dictionaries must outlive the tree and
+ * `data` must not change while it is in use
+ *
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if the data has no annotations)
+ * @param arena arena for the tree (NULL = heap)
+ * @param limits the limits (NULL = defaults)
+ * @return a pointer to a `json_value_t` on success, or NULL on failure or when a limit is exceeded
+ */
+json_value_t* bej_decode_buffer_borrowed(const uint8_t* data, size_t size,
+                                         const bej_dictionary_t* schema_dict,
+                                         const bej_dictionary_t* annot_dict,
+                                         json_arena_t* arena,
+                                         const bej_decode_limits_t* limits);
+
+/**
+ * @brief decodes a BEJ buffer into a JSON object tree on the threads of a pool
+ *
+ * The root members and the SFL headers of the elements of large root-level
+ * arrays are scanned on the calling thread. Runs of members and of elements
+ * of at least `parallel->min_subtree` bytes are then built in parallel and
+ * joined in document order, so the tree is the same as the one of
+ * bej_decode_buffer_in(), which is also what runs when there is a single
+ * thread. In an arena, every task builds in an arena of
+ * its own that is moved into `arena` afterwards. The default depth limit
+ * applies, the output is not limited
+ *
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if the data has no annotations)
+ * @param arena arena for the tree (NULL = heap)
+ * @param parallel the pool and the task size (NULL = serial)
+ * @return a pointer to a `json_value_t` on success, or NULL on failure
+ */
+json_value_t* bej_decode_buffer_parallel(const uint8_t* data, size_t size,
+                                         const bej_dictionary_t* schema_dict,
+                                         const bej_dictionary_t* annot_dict,
+                                         json_arena_t* arena,
+                                         const bej_parallel_t* parallel);
+
+/**
+ * @brief decodes the bound properties of a BEJ document straight into a struct
+ *
+ * No JSON tree is built: members without a bound field at or below them are
+ * skipped by their length and never read. Members that are absent or null
+ * leave their struct member untouched and their bit in `present` clear
+ *
+ * @param data    pointer to the BEJ data buffer (decoded strings point into it)
+ * @param size    the size of the data buffer
+ * @param binding the compiled binding (see bej_binding_init())
+ * @param object  the struct to fill
+ * @param present pointer to store the mask of the fields found (bit i = field i), may be NULL
+ * @return 1 on success, 0 on malformed input or a format that does not match the binding
+ */
+int bej_decode_bound(const uint8_t* data, size_t size, const bej_binding_t* binding,
+                     void* object, uint64_t* present);
+
+/**
+ * @brief a reusable decoder bound to a pair of dictionaries (defined in bej_decode.c)
+ *
+ * The decoder resolves the root entry once and keeps its tree arena, frame
+ * stack and text buffer between calls, so decoding documents of a similar
+ * size allocates nothing once the first few have been decoded. A decoder
+ * must not be used by two threads at the same time
+ */
+typedef struct bej_decoder bej_decoder_t;
+
+/**
+ * @brief creates a reusable decoder
+ * @param schema_dict the main schema dictionary (must outlive the decoder)
+ * @param annot_dict the annotation dictionary (may be NULL if the data has no annotations, must outlive the decoder)
+ * @return the decoder, or NULL if the schema dictionary has no root entry or memory ran out
+ */
+bej_decoder_t* bej_decoder_create(const bej_dictionary_t* schema_dict,
+                                  const bej_dictionary_t* annot_dict);
+
+/**
+ * @brief sets the limits of every later decode of a decoder
+ * @param decoder the decoder
+ * @param limits the limits (NULL = defaults)
+ */
+void bej_decoder_set_limits(bej_decoder_t* decoder, const bej_decode_limits_t* limits);
+
+/**
+ * @brief frees a decoder, its arena and its buffers
+ * @param decoder the decoder (NULL-safe)
+ */
+void bej_decoder_free(bej_decoder_t* decoder);
+
+/**
+ * @brief decodes a BEJ buffer into a JSON object tree owned by the decoder
+ *
+ * Same tree as bej_decode_buffer(), allocated in the decoder's arena. The
+ * tree stays valid until the next bej_decoder_decode() or bej_decoder_free();
+ * json_free() on it is a no-op
+ *
+ * @param decoder the decoder
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @return a pointer to a `json_value_t` on success, or NULL on failure
+ */
+json_value_t* bej_decoder_decode(bej_decoder_t* decoder, const uint8_t* data, size_t size);
+
+/**
+ * @brief decodes a BEJ buffer into a tree owned by the decoder that borrows its strings
+ *
+ * Same tree as bej_decoder_decode(), with keys and strings pointing into the
+ * dictionaries and `data` as with bej_decode_buffer_borrowed(). It stays
+ * valid until the next tree decode or bej_decoder_free(), and while `data`
+ * is neither freed nor changed
+ *
+ * @param decoder the decoder
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @return a pointer to a `json_value_t` on success, or NULL on failure
+ */
+json_value_t* bej_decoder_decode_borrowed(bej_decoder_t* decoder, const uint8_t* data, size_t size);
+
+/**
+ * @brief decodes a BEJ buffer into compact JSON text owned by the decoder
+ *
+ * Same text as bej_decode_stream(). It stays valid until the next
+ * bej_decoder_decode_text(), bej_decoder_decode_stream() or bej_decoder_free()
+ *
+ * @param decoder the decoder
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @param text pointer to store the start of the text (not null-terminated)
+ * @param length pointer to store the length of the text
+ * @return 1 on success, 0 on malformed input
+ */
+int bej_decoder_decode_text(bej_decoder_t* decoder, const uint8_t* data, size_t size,
+                            const char** text, size_t* length);
+
+/**
+ * @brief decodes a BEJ stream into a textual JSON stream with a decoder
+ *
+ * Same as bej_decode_stream() with the decoder's dictionaries
+ *
+ * @param decoder the decoder
+ * @param output_stream the output stream to write JSON text to
+ * @param input_stream the input stream containing BEJ data
+ * @return 1 on success, 0 on failure
+ */
+int bej_decoder_decode_stream(bej_decoder_t* decoder, FILE* output_stream, FILE* input_stream);
+
+/**
+ * @brief a BEJ to JSON text conversion over a non-blocking source and sink (defined in bej_decode.c)
+ *
+ * Input is read in chunks of up to BEJ_DECODE_CHUNK_SIZE bytes and decoded
+ * with a bej_stream_decoder_t. The next chunk is read only once the sink has
+ * taken the text of the last one, so memory stays bounded by the text of a
+ * chunk. A conversion covers one document: bytes after its root Set in the
+ * last chunk read are dropped
+ */
+typedef struct bej_async_decoder bej_async_decoder_t;
+
+/**
+ * @brief creates an async decoder for one document
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if the data has no annotations)
+ * @param limits the limits (NULL = defaults)
+ * @param source the source of the BEJ data
+ * @param source_ctx context passed to `source`
+ * @param sink the sink of the compact JSON text
+ * @param sink_ctx context passed to `sink`
+ * @return the decoder, or NULL on invalid arguments or allocation failure
+ */
+bej_async_decoder_t* bej_async_decoder_create(const bej_dictionary_t* schema_dict,
+                                              const bej_dictionary_t* annot_dict,
+                                              const bej_decode_limits_t* limits,
+                                              bej_source_fn source, void* source_ctx,
+                                              bej_sink_fn sink, void* sink_ctx);
+
+/**
+ * @brief advances an async decode as far as its source and sink allow
+ *
+ * Call it again after BEJ_IO_NEED_INPUT or BEJ_IO_OUTPUT_FULL once the source
+ * or sink can make progress; it never blocks unless they do
+ *
+ * @param decoder the decoder
+ * @return BEJ_IO_DONE once the sink has the whole text, or why it stopped
+ */
+bej_io_status_t bej_async_decoder_run(bej_async_decoder_t* decoder);
+
+/**
+ * @brief frees an async decoder, finished or not
+ * @param decoder the decoder (NULL-safe)
+ */
+void bej_async_decoder_free(bej_async_decoder_t* decoder);
+
 #endif // BEJ_PARSER_BEJ_DECODE_H
@@ -4,10 +4,25 @@
  *
  * This file defines the structures and public functions for loading, parsing,
  * and iterating over BEJ schema dictionaries from binary files
+ *
+ * Dictionaries are mapped read-only from their files and shared through a
+ * process-wide cache: loading the same file again returns the same compiled
+ * dictionary with its reference count bumped. Loaded dictionaries must be
+ * treated as immutable; every load is paired with one bej_dictionary_free()
+ *
+ * Dictionaries compiled into the program by bej_dictgen register themselves
+ * as built-ins. Loading a file whose bytes equal a built-in returns the
+ * built-in instead, so neither its mapping nor its index is kept around
+ *
+ * Every dictionary is validated once when its index is built. A dictionary
+ * whose entries all check out (see bej_dictionary_validate()) is marked
+ * trusted, and streams over its subsets read entries without checking
+ * bounds and name termination again. Other dictionaries keep every check
  */
 #ifndef BEJ_DICTIONARY_H
 #define BEJ_DICTIONARY_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -42,6 +57,13 @@
 #define BEJ_DICTIONARY_SELECTOR_ANNOTATION   0x01 /**< selector for the annotation dictionary */
 /** @} */
 
+/**
+ * @name BEJ Stream Constants
+ * @{
+ */
+#define BEJ_HEADER_SIZE 7 /**< size of the BEJ encoding header (version, flags, schema class) */
+/** @} */
+
 /**
  * @name Dictionary Format Constants
  * @{
@@ -90,13 +112,67 @@ enum {
 };
 /** @} */
 
+/**
+ * @name Dictionary Index Constants
+ * @{
+ */
+#define BEJ_DICT_INDEX_NONE      0xFFFFu     /**< empty slot in a sequence or name table */
+#define BEJ_DICT_NO_SUBSET       0xFFFFFFFFu /**< entry that does not start a child subset */
+#define BEJ_DICT_NO_SEQ_TABLE    0xFFFFFFFFu /**< subset whose sequence numbers are too sparse for a table */
+#define BEJ_DICT_MAX_BUILTINS    32          /**< number of built-in dictionaries a program can register */
+/** @} */
+
+/**
+ * @brief lookup tables of one child subset (the children of one or more parent entries)
+ */
+typedef struct bej_dict_subset
+{
+    uint16_t first;      /**< entry index of the first child */
+    uint16_t count;      /**< number of children */
+    uint32_t seq_table;  /**< offset of the dense sequence -> entry table in `tables`, or BEJ_DICT_NO_SEQ_TABLE */
+    uint32_t seq_limit;  /**< number of slots in the sequence table (largest sequence + 1) */
+    uint32_t name_table; /**< offset of the open-addressing name hash table in `tables` */
+    uint32_t name_mask;  /**< number of hash slots minus one (a power of two minus one) */
+} bej_dict_subset_t;
+
+/**
+ * @brief compiled form of a dictionary, built once at load time
+ *
+ * Entries are decoded into parallel arrays indexed by entry number, where entry
+ * `i` lives at byte offset BEJ_OFFSET_ENTRIES_START + i * BEJ_DICTIONARY_ENTRY_SIZE.
+ * Each distinct child subset gets a sequence table and a name hash table, so
+ * child lookups cost O(1) regardless of how wide the subset is
+ */
+typedef struct bej_dict_index
+{
+    uint16_t           entry_count;     /**< number of decoded entries */
+    uint8_t           *format;          /**< BEJ_FORMAT_* of each entry */
+    uint8_t           *flags;           /**< flags of each entry */
+    uint16_t          *sequence;        /**< sequence number of each entry */
+    uint16_t          *child_pointer;   /**< child subset offset of each entry */
+    uint16_t          *child_count;     /**< child count of each entry */
+    const char       **name;            /**< name of each entry (into dictionary bytes) or NULL */
+    uint32_t          *name_hash;       /**< FNV-1a hash of each name (0 for NULL names) */
+    uint64_t          *sfl_prefix;      /**< SFL sequence and format bytes of each entry, see bej_sfl_prefix() */
+    uint32_t          *subset_by_entry; /**< subset starting at each entry, or BEJ_DICT_NO_SUBSET */
+    bej_dict_subset_t *subsets;         /**< all child subsets */
+    uint32_t           subset_count;    /**< number of child subsets */
+    uint16_t          *tables;          /**< pooled sequence and name tables (entry indices) */
+    size_t             table_size;      /**< number of slots in `tables` */
+    uint32_t           root_subset;     /**< subset holding the children of the root entry, or BEJ_DICT_NO_SUBSET */
+} bej_dict_index_t;
+
 /**
  * @brief represents a loaded BEJ dictionary in memory
  */
 typedef struct bej_dictionary
 {
-    uint8_t *bytes; /**< pointer to raw dictionary bytes */
-    size_t   size;  /**< size of the dictionary in bytes */
+    const uint8_t    *bytes;  /**< pointer to raw dictionary bytes (read-only) */
+    size_t            size;   /**< size of the dictionary in bytes */
+    bej_dict_index_t *index;  /**< compiled lookup tables (NULL if not built) */
+    int               mapped; /**< 1 if `bytes` is a file mapping, 0 if it is a heap buffer */
+    int               builtin; /**< 1 if bytes and index are constant tables compiled into the program (never freed) */
+    int               trusted; /**< 1 if bej_dictionary_validate() accepted the bytes (set by bej_dictionary_build_index()) */
 } bej_dictionary_t;
 
 /**
@@ -109,6 +185,7 @@ typedef struct bej_dict_stream
     size_t         index;         /**< current index in the stream */
     int            child_count;   /**< number of entries in the current subset (-1 = until end) */
     int            current_entry; /**< index of current entry in subset */
+    int            trusted;       /**< 1 if every entry of the subset is a validated entry, read without checks */
 } bej_dict_stream_t;
 
 /**
@@ -122,12 +199,17 @@ typedef struct bej_dict_entry
     uint16_t     child_pointer; /**< binary offset to children (0 if none) */
     uint16_t     child_count;   /**< number of children or 0xFFFF for an array element */
     const char  *name;          /**< pointer into dictionary bytes (null-terminated) or NULL */
+    uint64_t     sfl_prefix;    /**< SFL header bytes before the length, for `sequence` and selector 0 (see bej_sfl_prefix()) */
 } bej_dict_entry_t;
 
 /**
  * @brief loads a BEJ dictionary from a .bin file
+ *
+ * The file is memory-mapped and indexed on the first load. Later loads of the
+ * same file (same device, inode, size and mtime) return the cached dictionary
+ *
  * @param path path to .bin dictionary
- * @return pointer to allocated bej_dictionary_t or NULL on failure
+ * @return pointer to a shared bej_dictionary_t or NULL on failure
  */
 bej_dictionary_t *bej_dictionary_load(const char *path);
 
@@ -140,11 +222,21 @@ bej_dictionary_t *bej_dictionary_load(const char *path);
 bej_dictionary_t *bej_dictionary_load_map(const char *path);
 
 /**
- * @brief frees memory allocated for a BEJ dictionary
- * @param dict dictionary to free
+ * @brief releases a reference to a BEJ dictionary
+ *
+ * Cached dictionaries stay resident when their last reference is dropped
+ * so that the next load is a cache hit; see bej_dictionary_cache_flush()
+ *
+ * @param dict dictionary to release (NULL-safe)
  */
 void bej_dictionary_free(bej_dictionary_t *dict);
 
+/**
+ * @brief unmaps and frees every cached dictionary that is no longer referenced
+ * @return number of dictionaries released
+ */
+size_t bej_dictionary_cache_flush(void);
+
 /**
  * @brief initializes a stream over the entire dictionary (skipping header)
  * @param s stream to initialize
@@ -187,4 +279,68 @@ int bej_dict_stream_next(bej_dict_stream_t *s, bej_dict_entry_t *dest);
  */
 int bej_dict_find_child_by_name(const bej_dictionary_t *dict, uint16_t offset, uint16_t child_count, const char *name, bej_dict_entry_t *dest);
 
+/**
+ * @brief finds a child entry by sequence number within a subset
+ * @param dict dictionary to search
+ * @param offset binary offset of subset
+ * @param child_count number of entries in a subset
+ * @param sequence sequence number to search for
+ * @param dest output entry if found
+ * @return 1 if found, 0 otherwise
+ */
+int bej_dict_find_child_by_seq(const bej_dictionary_t *dict, uint16_t offset, uint16_t child_count, uint64_t sequence, bej_dict_entry_t *dest);
+
+/**
+ * @brief finds a top-level annotation (a child of the annotation dictionary root) by name
+ *
+ * Annotation properties such as `@odata.id` are not scoped to the enclosing set,
+ * they resolve against the children of the annotation dictionary's root entry
+ *
+ * @param annot_dict annotation dictionary
+ * @param name annotation name (e.g. "@odata.id")
+ * @param dest output entry if found
+ * @return 1 if found, 0 otherwise
+ */
+int bej_dict_find_annotation_by_name(const bej_dictionary_t *annot_dict, const char *name, bej_dict_entry_t *dest);
+
+/**
+ * @brief finds a top-level annotation (a child of the annotation dictionary root) by sequence number
+ * @param annot_dict annotation dictionary
+ * @param sequence sequence number from an SFL header with the annotation selector
+ * @param dest output entry if found
+ * @return 1 if found, 0 otherwise
+ */
+int bej_dict_find_annotation_by_seq(const bej_dictionary_t *annot_dict, uint64_t sequence, bej_dict_entry_t *dest);
+
+/**
+ * @brief registers a dictionary compiled into the program (called by the code bej_dictgen generates)
+ * @param dict the built-in dictionary (`builtin` set, index present)
+ * @return 1 on success, 0 if the dictionary is invalid or the registry is full
+ */
+int bej_dictionary_register_builtin(bej_dictionary_t *dict);
+
+/**
+ * @brief checks every entry of a dictionary once, so that its subsets can be read without checks
+ *
+ * The header must hold at least the root entry and all entries must fit the
+ * bytes. Every child subset (other than a wildcard one) must start at an
+ * entry and end inside the entry table, a wildcard child pointer must point
+ * at an entry, and every name must lie inside the bytes with its
+ * terminator as its last byte
+ *
+ * @param dict dictionary to check
+ * @return 1 if the dictionary can be trusted, 0 otherwise
+ */
+int bej_dictionary_validate(const bej_dictionary_t *dict);
+
+/**
+ * @brief builds the compiled index of a dictionary (done by the loaders automatically)
+ *
+ * Also validates the dictionary and sets `trusted`, even if the index cannot be built
+ *
+ * @param dict dictionary to index; a previous index is replaced
+ * @return 1 on success, 0 on allocation failure (lookups then fall back to linear scans)
+ */
+int bej_dictionary_build_index(bej_dictionary_t *dict);
+
 #endif /* BEJ_DICTIONARY_H */
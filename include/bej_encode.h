@@ -10,9 +10,64 @@
 #define BEJ_PARSER_BEJ_ENCODE_H
 
 #include <stdio.h>
+#include "bej_bind.h"
+#include "bej_buffer.h"
 #include "bej_dictionary.h"
+#include "bej_io.h"
+#include "bej_pool.h"
 #include "json.h"
 
+/**
+ * @name Encoder Flags
+ * @{
+ */
+#define BEJ_ENCODE_CANONICAL   0x00u /**< minimal-width length fields (sizing pass + emit pass) */
+#define BEJ_ENCODE_FIXED_WIDTH 0x01u /**< single pass, fixed-width length fields back-patched in place */
+/** @} */
+
+#define BEJ_ENCODE_READ_SIZE (16u * 1024u) /**< bytes an async encoder asks its source for at a time */
+
+/**
+ * @brief encodes a JSON value tree into the BEJ binary format and appends it to a buffer
+ *
+ * With BEJ_ENCODE_CANONICAL the output is identical to bej_encode_stream().
+ * With BEJ_ENCODE_FIXED_WIDTH every SFL length is written as a 4-byte nnint,
+ * which is still valid BEJ but skips the sizing pass
+ *
+ * @param out         the buffer the BEJ document is appended to
+ * @param json_data   the root JSON value to be encoded
+ * @param schema_dict the schema dictionary used for encoding
+ * @param annot_dict  the annotation dictionary used for encoding metadata
+ * @param flags       a combination of BEJ_ENCODE_* flags
+ * @return 1 on success, 0 on failure (the buffer is left as it was)
+ */
+int bej_encode_buffer(bej_buffer_t* out, const json_value_t* json_data,
+                      const bej_dictionary_t* schema_dict,
+                      const bej_dictionary_t* annot_dict,
+                      unsigned flags);
+
+/**
+ * @brief encodes a JSON value tree on the threads of a pool and appends it to a buffer
+ *
+ * The root members and chunks of the elements of large root-level arrays
+ * are sized in parallel, the document is laid out from their sizes and the
+ * pieces are written into their places in parallel, grouped so that a task
+ * has at least `parallel->min_subtree` bytes. The output is identical to
+ * bej_encode_buffer() with BEJ_ENCODE_CANONICAL, which is also what runs
+ * when there is a single thread
+ *
+ * @param out         the buffer the BEJ document is appended to
+ * @param json_data   the root JSON value to be encoded
+ * @param schema_dict the schema dictionary used for encoding
+ * @param annot_dict  the annotation dictionary used for encoding metadata
+ * @param parallel    the pool and the task size (NULL = serial)
+ * @return 1 on success, 0 on failure (the buffer is left as it was)
+ */
+int bej_encode_buffer_parallel(bej_buffer_t* out, const json_value_t* json_data,
+                               const bej_dictionary_t* schema_dict,
+                               const bej_dictionary_t* annot_dict,
+                               const bej_parallel_t* parallel);
+
 /**
  * @brief encodes a JSON value tree into the BEJ binary format and writes it to a stream
  *
@@ -26,4 +81,189 @@ int bej_encode_stream(FILE* output_stream, const json_value_t* json_data,
                       const bej_dictionary_t* schema_dict,
                       const bej_dictionary_t* annot_dict);
 
+/**
+ * @brief encodes the JSON document of a streaming reader and appends it to a buffer
+ *
+ * No value tree is built: every key is resolved as the reader returns it.
+ * Lengths and set/array counts are written as fixed-width nnints, like with
+ * BEJ_ENCODE_FIXED_WIDTH
+ *
+ * @param out         the buffer the BEJ document is appended to
+ * @param reader      a reader positioned at the start of the document (root must be an object)
+ * @param schema_dict the schema dictionary used for encoding
+ * @param annot_dict  the annotation dictionary used for encoding metadata
+ * @return 1 on success, 0 on failure (the buffer is left as it was)
+ */
+int bej_encode_reader_buffer(bej_buffer_t* out, json_reader_t* reader,
+                             const bej_dictionary_t* schema_dict,
+                             const bej_dictionary_t* annot_dict);
+
+/**
+ * @brief encodes the JSON document of a streaming reader and writes it to a stream
+ *
+ * Output to a seekable stream is flushed as it is produced and length fields
+ * are patched in place, so memory stays bounded by the nesting depth. Other
+ * streams receive the document in one write at the end. On failure part of
+ * the document may already have been written
+ *
+ * @param output_stream the output file stream to write BEJ data to
+ * @param reader        a reader positioned at the start of the document (root must be an object)
+ * @param schema_dict   the schema dictionary used for encoding
+ * @param annot_dict    the annotation dictionary used for encoding metadata
+ * @return 1 on success, 0 on failure
+ */
+int bej_encode_reader(FILE* output_stream, json_reader_t* reader,
+                      const bej_dictionary_t* schema_dict,
+                      const bej_dictionary_t* annot_dict);
+
+/**
+ * @brief encodes the bound fields of a struct into the BEJ binary format and appends it to a buffer
+ *
+ * No JSON tree is involved: values are read from the struct members named
+ * by the binding. Members are written in field table order with canonical
+ * length fields, Sets without a present field are left out
+ *
+ * @param out     the buffer the BEJ document is appended to
+ * @param binding the compiled binding (see bej_binding_init())
+ * @param object  the struct
+ * @param present mask of the fields to encode (bit i = field i)
+ * @return 1 on success, 0 on failure (a NULL string or an unknown enum option; the buffer is left as it was)
+ */
+int bej_encode_bound(bej_buffer_t* out, const bej_binding_t* binding, const void* object, uint64_t present);
+
+/**
+ * @brief applies a JSON merge patch to a BEJ document and appends the patched document to a buffer
+ *
+ * Follows RFC 7396: a patch member replaces the first member of the same
+ * name, a null removes it, a Set patched with an object is merged with it
+ * member by member, and members the document lacks are added after the
+ * existing ones (nulls for them are ignored). Only the patch values are
+ * encoded: every other member is copied verbatim and only the length fields
+ * on the way to the root are rewritten (canonically), so the work beyond
+ * copying scales with the patch. Keys outside the dictionary are skipped
+ * like bej_encode_buffer() does
+ *
+ * @param out the buffer the patched document is appended to
+ * @param data the BEJ document
+ * @param size the size of the document
+ * @param patch the patch, a JSON object
+ * @param schema_dict the schema dictionary of the document
+ * @param annot_dict the annotation dictionary (may be NULL if the patch has no annotations)
+ * @return 1 on success, 0 on malformed input or a value the dictionary cannot encode (the buffer is left as it was)
+ */
+int bej_patch_buffer(bej_buffer_t* out, const uint8_t* data, size_t size, const json_value_t* patch,
+                     const bej_dictionary_t* schema_dict, const bej_dictionary_t* annot_dict);
+
+/**
+ * @brief a reusable encoder bound to a pair of dictionaries (defined in bej_encode.c)
+ *
+ * The encoder resolves the root entry once and keeps its scratch tables and
+ * output buffer between calls, so encoding documents of a similar shape
+ * allocates nothing once the first few have been encoded. An encoder must
+ * not be used by two threads at the same time
+ */
+typedef struct bej_encoder bej_encoder_t;
+
+/**
+ * @brief creates a reusable encoder
+ * @param schema_dict the schema dictionary used for encoding (must outlive the encoder)
+ * @param annot_dict  the annotation dictionary used for encoding metadata (may be NULL, must outlive the encoder)
+ * @return the encoder, or NULL if the schema dictionary has no root entry or memory ran out
+ */
+bej_encoder_t* bej_encoder_create(const bej_dictionary_t* schema_dict,
+                                  const bej_dictionary_t* annot_dict);
+
+/**
+ * @brief frees an encoder and its output buffer
+ * @param encoder the encoder (NULL-safe)
+ */
+void bej_encoder_free(bej_encoder_t* encoder);
+
+/**
+ * @brief encodes a JSON value tree into the output buffer of an encoder
+ *
+ * The output replaces that of the previous call; it stays valid until the
+ * next call on the encoder or bej_encoder_free()
+ *
+ * @param encoder   the encoder
+ * @param json_data the root JSON value to be encoded
+ * @param flags     a combination of BEJ_ENCODE_* flags
+ * @param data      pointer to store the start of the BEJ document
+ * @param size      pointer to store the size of the BEJ document
+ * @return 1 on success, 0 on failure
+ */
+int bej_encoder_encode(bej_encoder_t* encoder, const json_value_t* json_data, unsigned flags,
+                       const uint8_t** data, size_t* size);
+
+/**
+ * @brief encodes a JSON value tree with an encoder and appends it to a caller's buffer
+ *
+ * Same output as bej_encode_buffer() with the encoder's dictionaries
+ *
+ * @param encoder   the encoder
+ * @param out       the buffer the BEJ document is appended to
+ * @param json_data the root JSON value to be encoded
+ * @param flags     a combination of BEJ_ENCODE_* flags
+ * @return 1 on success, 0 on failure (the buffer is left as it was)
+ */
+int bej_encoder_encode_buffer(bej_encoder_t* encoder, bej_buffer_t* out,
+                              const json_value_t* json_data, unsigned flags);
+
+/**
+ * @brief encodes a JSON value tree with an encoder and writes it to a stream
+ *
+ * Same output as bej_encode_stream() with the encoder's dictionaries
+ *
+ * @param encoder       the encoder
+ * @param output_stream the output file stream to write BEJ data to
+ * @param json_data     the root JSON value to be encoded
+ * @return 1 on success, 0 on failure
+ */
+int bej_encoder_encode_stream(bej_encoder_t* encoder, FILE* output_stream, const json_value_t* json_data);
+
+/**
+ * @brief a JSON text to BEJ conversion over a non-blocking source and sink (defined in bej_encode.c)
+ *
+ * Every chunk of text from the source is fed to a json_reader_t and encoded
+ * event by event like bej_encode_reader_buffer() does, so only a token split
+ * across chunks and the document being built are held, never the whole text.
+ * With BEJ_ENCODE_CANONICAL the length fields are shrunk in place once the
+ * text has ended, and the document is handed to the sink. A conversion covers
+ * one document
+ */
+typedef struct bej_async_encoder bej_async_encoder_t;
+
+/**
+ * @brief creates an async encoder for one document
+ * @param schema_dict the schema dictionary used for encoding
+ * @param annot_dict the annotation dictionary used for encoding metadata
+ * @param flags BEJ_ENCODE_* flags
+ * @param source the source of the JSON text
+ * @param source_ctx context passed to `source`
+ * @param sink the sink of the BEJ data
+ * @param sink_ctx context passed to `sink`
+ * @return the encoder, or NULL on invalid arguments or allocation failure
+ */
+bej_async_encoder_t* bej_async_encoder_create(const bej_dictionary_t* schema_dict,
+                                              const bej_dictionary_t* annot_dict, unsigned flags,
+                                              bej_source_fn source, void* source_ctx,
+                                              bej_sink_fn sink, void* sink_ctx);
+
+/**
+ * @brief advances an async encode as far as its source and sink allow
+ *
+ * Call it again after BEJ_IO_NEED_INPUT or BEJ_IO_OUTPUT_FULL once the source
+ * or sink can make progress; it never blocks unless they do
+ *
+ * @param encoder the encoder
+ * @return BEJ_IO_DONE once the sink has the whole document, or why it stopped
+ */
+bej_io_status_t bej_async_encoder_run(bej_async_encoder_t* encoder);
+
+/**
+ * @brief frees an async encoder, finished or not
+ * @param encoder the encoder (NULL-safe)
+ */
+void bej_async_encoder_free(bej_async_encoder_t* encoder);
+
 #endif //BEJ_PARSER_BEJ_ENCODE_H
@@ -0,0 +1,52 @@
+/**
+ * @file bej_file.h
+ * @brief read-only access to whole files as a contiguous byte range
+ *
+ * Regular files are memory-mapped, anything else (pipes, terminals) is read
+ * into a heap buffer. Either way the caller gets a pointer and a size
+ */
+
+#ifndef BEJ_PARSER_BEJ_FILE_H
+#define BEJ_PARSER_BEJ_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief contents of a file held in memory
+ */
+typedef struct bej_file_view
+{
+    const uint8_t *data;   /**< file contents (valid until bej_file_view_release) */
+    size_t         size;   /**< number of bytes */
+    int            mapped; /**< 1 if `data` is an mmap region, 0 if it is a heap buffer */
+} bej_file_view_t;
+
+/**
+ * @brief maps or reads the whole contents of an open stream
+ *
+ * Regular files are mapped from offset 0 regardless of the stream position.
+ * Other streams are read from their current position until EOF
+ *
+ * @param stream the stream to read
+ * @param view pointer to store the contents
+ * @return 1 on success, 0 on failure
+ */
+int bej_file_view_stream(FILE *stream, bej_file_view_t *view);
+
+/**
+ * @brief maps or reads the whole contents of a file by path
+ * @param path path to the file
+ * @param view pointer to store the contents
+ * @return 1 on success, 0 on failure
+ */
+int bej_file_view_path(const char *path, bej_file_view_t *view);
+
+/**
+ * @brief releases the memory held by a view
+ * @param view view to release (NULL-safe)
+ */
+void bej_file_view_release(bej_file_view_t *view);
+
+#endif // BEJ_PARSER_BEJ_FILE_H
@@ -0,0 +1,120 @@
+/**
+ * @file bej_index.h
+ * @brief offset index sidecar for encoded BEJ documents
+ *
+ * A bej_view_t finds a value by skipping siblings, which is linear in the
+ * number of members before it. An index records where values start, so a
+ * lookup binary-searches the index instead and does bounds-checked reads only
+ * on the way down.
+ *
+ * The sidecar is a flat little-endian file:
+ * - header (BEJ_INDEX_HEADER_SIZE bytes): magic "BEJI", u16 version, u16
+ *   reserved, u32 path count, u32 array count, u32 name pool size, u32
+ *   reserved, u64 length of the root Set payload, u64 64-bit FNV-1a hash of the
+ *   root Set payload
+ * - path records (BEJ_INDEX_PATH_RECORD_SIZE bytes each), sorted by path: u32
+ *   name offset, u32 name length, u64 offset of the member's SFL header
+ * - array records (BEJ_INDEX_ARRAY_RECORD_SIZE bytes each), sorted by path:
+ *   u32 name offset, u32 name length, u64 element count, u64 sidecar offset
+ *   of the element table
+ * - name pool: the escaped JSON Pointer paths of all records
+ * - element tables: one u64 SFL header offset per element
+ *
+ * Offsets into the document are relative to the start of the root Set payload.
+ * The hash ties the sidecar to one document: bej_index_attach() compares it
+ * with the document once, and bej_index_get() only uses the offsets of an
+ * index attached to the document it is given.
+ *
+ * Every Set member outside an Array gets a path record. Every Array outside
+ * another Array gets an element table, as does any nested Array with at least
+ * BEJ_INDEX_MIN_NESTED_ELEMENTS elements, so the size of the index stays
+ * proportional to the number of array elements rather than the number of
+ * values
+ */
+
+#ifndef BEJ_PARSER_BEJ_INDEX_H
+#define BEJ_PARSER_BEJ_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bej_buffer.h"
+#include "bej_dictionary.h"
+#include "bej_view.h"
+
+#define BEJ_INDEX_VERSION             2  /**< version written to and accepted from the header */
+#define BEJ_INDEX_HEADER_SIZE         40 /**< size of the sidecar header in bytes */
+#define BEJ_INDEX_PATH_RECORD_SIZE    16 /**< size of one path record in bytes */
+#define BEJ_INDEX_ARRAY_RECORD_SIZE   24 /**< size of one array record in bytes */
+#define BEJ_INDEX_MIN_NESTED_ELEMENTS 64 /**< smallest Array inside another Array that gets an element table */
+#define BEJ_INDEX_MAX_DEPTH           64 /**< deepest container nesting bej_index_build() accepts */
+
+/**
+ * @brief an opened index sidecar (read-only, borrows the sidecar bytes)
+ */
+typedef struct bej_index
+{
+    const uint8_t *data;    /**< the sidecar bytes */
+    size_t size;            /**< size of the sidecar */
+    uint32_t path_count;    /**< number of path records */
+    uint32_t array_count;   /**< number of array records */
+    const uint8_t *paths;   /**< first path record */
+    const uint8_t *arrays;  /**< first array record */
+    const uint8_t *names;   /**< start of the name pool */
+    uint64_t root_length;   /**< length of the root Set payload of the indexed document */
+    uint64_t root_hash;     /**< FNV-1a hash of the root Set payload of the indexed document */
+    const uint8_t *root;    /**< root Set payload the index was attached to, NULL until bej_index_attach() succeeds */
+} bej_index_t;
+
+/**
+ * @brief builds the index sidecar of a BEJ document
+ * @param out buffer receiving the sidecar (appended to)
+ * @param data the BEJ document
+ * @param size the size of the document
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if the document has no annotations)
+ * @return 1 on success, 0 on malformed input or allocation failure
+ */
+int bej_index_build(bej_buffer_t *out, const uint8_t *data, size_t size,
+                    const bej_dictionary_t *schema_dict,
+                    const bej_dictionary_t *annot_dict);
+
+/**
+ * @brief validates a sidecar and opens it for lookups
+ * @param index the index to fill
+ * @param data the sidecar bytes (must outlive the index)
+ * @param size the size of the sidecar
+ * @return 1 on success, 0 if the sidecar is truncated, has a different version or is inconsistent
+ */
+int bej_index_open(bej_index_t *index, const uint8_t *data, size_t size);
+
+/**
+ * @brief checks that an opened index was built for a document and enables its offsets for it
+ *
+ * Hashes the root Set payload once, so a sidecar of another document is
+ * rejected even when both root Sets have the same length. The document must
+ * not change while the index is attached to it
+ *
+ * @param index the opened index
+ * @param root a view on the root Set of the document (see bej_view_open())
+ * @return 1 if the index belongs to the document, 0 otherwise (the index is then detached)
+ */
+int bej_index_attach(bej_index_t *index, const bej_view_t *root);
+
+/**
+ * @brief resolves a path like bej_view_get(), jumping to indexed offsets where possible
+ *
+ * Segments the index does not cover are resolved by scanning, as is every
+ * path when the index is not attached to this document (see
+ * bej_index_attach()), so the result is always the one bej_view_get() would
+ * return
+ *
+ * @param index the opened index
+ * @param root a view on the root Set of the indexed document (see bej_view_open())
+ * @param path the path
+ * @param out the view to fill
+ * @return 1 if the path exists, 0 otherwise
+ */
+int bej_index_get(const bej_index_t *index, const bej_view_t *root, const char *path, bej_view_t *out);
+
+#endif // BEJ_PARSER_BEJ_INDEX_H
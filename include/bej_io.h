@@ -0,0 +1,61 @@
+/**
+ * @file bej_io.h
+ * @brief non-blocking sources and sinks for the async codecs
+ *
+ * An async codec (bej_async_encoder_t, bej_async_decoder_t) pulls its input
+ * from a source callback and pushes its output into a sink callback. Either
+ * may refuse to move bytes right now instead of blocking: the codec keeps its
+ * state and returns BEJ_IO_NEED_INPUT or BEJ_IO_OUTPUT_FULL, and the caller
+ * runs it again once its event loop reports the descriptor ready
+ */
+
+#ifndef BEJ_PARSER_BEJ_IO_H
+#define BEJ_PARSER_BEJ_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BEJ_IO_AGAIN ((size_t)-1) /**< returned by a source or sink that cannot move bytes right now */
+#define BEJ_IO_ERROR ((size_t)-2) /**< returned by a source or sink that failed for good */
+
+/**
+ * @brief reads input of an async codec without blocking
+ * @param ctx the context given with the source
+ * @param data where to store the bytes
+ * @param size room at `data`
+ * @return the bytes stored (at most `size`), 0 at the end of the input, BEJ_IO_AGAIN or BEJ_IO_ERROR
+ */
+typedef size_t (*bej_source_fn)(void *ctx, uint8_t *data, size_t size);
+
+/**
+ * @brief writes output of an async codec without blocking
+ * @param ctx the context given with the sink
+ * @param data the bytes to write
+ * @param size the number of bytes (never 0)
+ * @return the bytes accepted (at most `size`, 0 or BEJ_IO_AGAIN when full right now), or BEJ_IO_ERROR
+ */
+typedef size_t (*bej_sink_fn)(void *ctx, const uint8_t *data, size_t size);
+
+/**
+ * @brief where an async codec stopped
+ */
+typedef enum
+{
+    BEJ_IO_DONE,        /**< the document was converted and the sink took all of it */
+    BEJ_IO_NEED_INPUT,  /**< the source has no bytes right now */
+    BEJ_IO_OUTPUT_FULL, /**< the sink takes no bytes right now */
+    BEJ_IO_FAILED       /**< malformed input, a failed source or sink, or a limit (sticky) */
+} bej_io_status_t;
+
+/**
+ * @brief passes pending output to a sink until it is drained or the sink is full
+ * @param sink the sink
+ * @param sink_ctx context of `sink`
+ * @param data the pending output
+ * @param size the number of pending bytes
+ * @param done bytes of `data` the sink has taken, advanced by the call
+ * @return BEJ_IO_DONE once `*done` reaches `size`, BEJ_IO_OUTPUT_FULL or BEJ_IO_FAILED
+ */
+bej_io_status_t bej_sink_drain(bej_sink_fn sink, void *sink_ctx, const uint8_t *data, size_t size, size_t *done);
+
+#endif // BEJ_PARSER_BEJ_IO_H
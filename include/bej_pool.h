@@ -0,0 +1,94 @@
+/**
+ * @file bej_pool.h
+ * @brief task pool for intra-document parallel encoding and decoding
+ *
+ * A pool owns a fixed set of worker threads. bej_pool_run() hands them a
+ * batch of independent tasks and the calling thread works on the batch too,
+ * so a pool with 0 workers runs everything on the caller. One batch runs at
+ * a time: concurrent callers take turns, and a task must not start a batch
+ * on the pool it runs on.
+ *
+ * The parallel codecs (bej_encode_buffer_parallel(), bej_decode_buffer_parallel())
+ * split a document at its root: root members and the elements of large
+ * root-level arrays become tasks of at least `min_subtree` encoded bytes
+ */
+
+#ifndef BEJ_PARSER_BEJ_POOL_H
+#define BEJ_PARSER_BEJ_POOL_H
+
+#include <stddef.h>
+
+#define BEJ_POOL_MAX_THREADS     1024          /**< upper bound of worker threads of a pool */
+#define BEJ_PARALLEL_MIN_SUBTREE (64u * 1024u) /**< default encoded bytes per task */
+#define BEJ_PARALLEL_MIN_ELEMENTS 256          /**< fewest elements of a root-level array split into a piece of its own */
+
+/**
+ * @brief a set of worker threads (defined in bej_pool.c)
+ */
+typedef struct bej_pool bej_pool_t;
+
+/**
+ * @brief runs task `index` of a batch
+ * @param arg the argument passed to bej_pool_run()
+ * @param index the task number, below the task count
+ */
+typedef void (*bej_task_fn)(void *arg, size_t index);
+
+/**
+ * @brief how a parallel codec splits a document
+ */
+typedef struct bej_parallel
+{
+    bej_pool_t *pool;   /**< pool running the tasks (NULL = everything on the calling thread) */
+    size_t min_subtree; /**< encoded bytes below which subtrees are grouped into one task (0 = BEJ_PARALLEL_MIN_SUBTREE) */
+} bej_parallel_t;
+
+/**
+ * @brief starts a pool
+ * @param threads number of worker threads besides the callers (at most BEJ_POOL_MAX_THREADS)
+ * @return the pool, or NULL if a thread could not be started or memory ran out
+ */
+bej_pool_t *bej_pool_create(size_t threads);
+
+/**
+ * @brief stops the workers of a pool and frees it (no batch may be running)
+ * @param pool the pool (NULL-safe)
+ */
+void bej_pool_free(bej_pool_t *pool);
+
+/**
+ * @brief returns the number of threads that work on a batch
+ * @param pool the pool (NULL = the calling thread alone)
+ * @return the workers plus the calling thread
+ */
+size_t bej_pool_concurrency(const bej_pool_t *pool);
+
+/**
+ * @brief runs fn(arg, i) for every i below `count` and waits until all have returned
+ * @param pool the pool (NULL = run the tasks in order on the calling thread)
+ * @param fn the task function
+ * @param arg the argument of every task
+ * @param count number of tasks
+ */
+void bej_pool_run(bej_pool_t *pool, bej_task_fn fn, void *arg, size_t count);
+
+/**
+ * @brief returns how many elements of a root-level array the parallel codecs put into one piece
+ *
+ * A few pieces per thread even out elements of different sizes
+ *
+ * @param count number of elements of the array
+ * @param threads the threads working on the document
+ * @return the elements per piece, 0 if the array is too small to split
+ */
+size_t bej_parallel_chunk(size_t count, size_t threads);
+
+/**
+ * @brief returns the encoded bytes the parallel codecs put into one task
+ * @param parallel the pool and the task size
+ * @param total encoded size of the document
+ * @return `min_subtree` (or its default), more for documents that would make many pieces per thread
+ */
+size_t bej_parallel_task_size(const bej_parallel_t *parallel, size_t total);
+
+#endif // BEJ_PARSER_BEJ_POOL_H
@@ -0,0 +1,122 @@
+/**
+ * @file bej_stats.h
+ * @brief opt-in counters and phase timings of the BEJ codecs
+ *
+ * Statistics are compiled in only when BEJ_ENABLE_STATS is defined (the
+ * CMake option of the same name). Without it the BEJ_STATS_* macros expand
+ * to nothing and bej_stats_snapshot() reports zeros.
+ *
+ * Every thread accumulates into its own bej_stats_t and is the only one
+ * writing it, so the hot paths need no locks or read-modify-write atomics:
+ * a counter is bumped with a relaxed atomic load and store, which compile
+ * to plain moves and let bej_stats_snapshot() read it from another thread
+ * without a data race. bej_stats_snapshot() adds up the live threads and
+ * the threads that have exited, and bej_stats_reset() records where every
+ * counter stood instead of writing into live accumulators. Counters are always
+ * collected once compiled in; the phase timings cost two clock reads each
+ * and are collected only after bej_stats_set_timing(1).
+ *
+ * The phases overlap: dictionary lookups and SFL reads happen inside the
+ * encoder and decoder entry points, so `dict_ns` and `sfl_ns` are part of
+ * `encode_ns`/`decode_ns`, as are writes through a decoder's callback or
+ * an encoder's stream
+ */
+
+#ifndef BEJ_PARSER_BEJ_STATS_H
+#define BEJ_PARSER_BEJ_STATS_H
+
+#include <stdint.h>
+
+/**
+ * @brief counters and timings, summed over threads (all members are uint64_t)
+ */
+typedef struct bej_stats
+{
+    uint64_t documents;    /**< documents encoded or decoded */
+    uint64_t bytes_in;     /**< bytes consumed: BEJ by the decoders, JSON text by the CLI encoder */
+    uint64_t bytes_out;    /**< bytes produced: BEJ by the encoders, JSON text by the streaming decoder and the CLI */
+    uint64_t properties;   /**< SFL tuples encoded or decoded, root Sets included */
+    uint64_t dict_lookups; /**< dictionary lookups by name or sequence number */
+    uint64_t dict_probes;  /**< hash slots or entries those lookups examined */
+    uint64_t allocations;  /**< heap allocations and reallocations made by the codecs */
+    uint64_t encode_ns;    /**< time spent in encoder entry points */
+    uint64_t decode_ns;    /**< time spent in decoder entry points */
+    uint64_t dict_ns;      /**< time spent in dictionary lookups */
+    uint64_t sfl_ns;       /**< time spent reading SFL headers in the tree and bound decoders */
+    uint64_t format_ns;    /**< time spent rendering decoded trees as JSON text */
+    uint64_t io_ns;        /**< time spent reading input and writing output */
+} bej_stats_t;
+
+#ifdef BEJ_ENABLE_STATS
+
+extern __thread bej_stats_t *bej_stats_local; /**< accumulator of the calling thread (NULL until first use) */
+extern int bej_stats_timing;                  /**< 1 while phase timings are collected */
+
+/**
+ * @brief returns the accumulator of the calling thread, creating it on first use
+ * @return the accumulator (never NULL)
+ */
+bej_stats_t *bej_stats_thread(void);
+
+/**
+ * @brief reads the monotonic clock
+ * @return nanoseconds since an arbitrary origin
+ */
+uint64_t bej_stats_now(void);
+
+/**
+ * @brief adds to a counter only the calling thread writes
+ * @param counter the counter
+ * @param n the amount to add
+ */
+static inline void bej_stats_bump(uint64_t *counter, const uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+/** @brief adds `n` to a counter of the calling thread */
+#define BEJ_STATS_ADD(counter, n) \
+    bej_stats_bump(&(bej_stats_local ? bej_stats_local : bej_stats_thread())->counter, (uint64_t)(n))
+
+/** @brief starts a phase timer (declares `timer`, 0 while timings are off) */
+#define BEJ_STATS_TIME_BEGIN(timer) \
+    const uint64_t timer = __atomic_load_n(&bej_stats_timing, __ATOMIC_RELAXED) ? bej_stats_now() : 0
+
+/** @brief adds the time since BEJ_STATS_TIME_BEGIN(timer) to a timing of the calling thread */
+#define BEJ_STATS_TIME_END(counter, timer) \
+    do { if (timer) BEJ_STATS_ADD(counter, bej_stats_now() - (timer)); } while (0)
+
+#else
+
+#define BEJ_STATS_ADD(counter, n) ((void)0)
+#define BEJ_STATS_TIME_BEGIN(timer) ((void)0)
+#define BEJ_STATS_TIME_END(counter, timer) ((void)0)
+
+#endif // BEJ_ENABLE_STATS
+
+/**
+ * @brief tells whether the library was built with BEJ_ENABLE_STATS
+ * @return 1 if statistics are collected, 0 if they are compiled out
+ */
+int bej_stats_enabled(void);
+
+/**
+ * @brief turns the collection of phase timings on or off (off by default)
+ * @param enabled 1 to collect timings
+ */
+void bej_stats_set_timing(int enabled);
+
+/**
+ * @brief adds up the statistics of all threads
+ *
+ * Threads that are still running may be counted mid-document
+ *
+ * @param out pointer to store the totals
+ */
+void bej_stats_snapshot(bej_stats_t *out);
+
+/**
+ * @brief sets every counter and timing of all threads back to zero
+ */
+void bej_stats_reset(void);
+
+#endif // BEJ_PARSER_BEJ_STATS_H
@@ -0,0 +1,165 @@
+/**
+ * @file bej_view.h
+ * @brief read-only random access into an encoded BEJ document
+ *
+ * A view is a cursor over the payload of one value plus the dictionary entry
+ * that describes it. Looking up a member walks the SFL headers of its parent
+ * and skips every sibling by its encoded length, so only the headers on the
+ * way to the requested value are read, never the payloads in between
+ */
+
+#ifndef BEJ_PARSER_BEJ_VIEW_H
+#define BEJ_PARSER_BEJ_VIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bej_cursor.h"
+#include "bej_dictionary.h"
+
+#define BEJ_VIEW_MAX_NAME 256 /**< longest property name accepted in a path segment (including terminator) */
+
+/**
+ * @brief one value inside a BEJ buffer
+ */
+typedef struct bej_view
+{
+    bej_cursor_t payload;                /**< the payload bytes of the value (after its SFL header) */
+    bej_dict_entry_t entry;              /**< dictionary entry of the value */
+    uint8_t selector;                    /**< dictionary selector of the value (0 = schema, 1 = annotation) */
+    const bej_dictionary_t *schema_dict; /**< the main schema dictionary */
+    const bej_dictionary_t *annot_dict;  /**< the annotation dictionary (may be NULL) */
+} bej_view_t;
+
+/**
+ * @brief opens a view on the root Set of a BEJ document
+ * @param view the view to fill
+ * @param data the BEJ document (must outlive every view into it)
+ * @param size the size of the document
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL if no annotations are queried)
+ * @return 1 on success, 0 on failure
+ */
+int bej_view_open(bej_view_t *view, const uint8_t *data, size_t size,
+                  const bej_dictionary_t *schema_dict,
+                  const bej_dictionary_t *annot_dict);
+
+/**
+ * @brief finds a member of a Set by property name
+ *
+ * Names starting with '@' on a schema Set are looked up in the global
+ * annotation scope, like the encoder does
+ *
+ * @param set a view on a Set
+ * @param name the property name
+ * @param child the view to fill
+ * @return 1 if the member is present, 0 otherwise
+ */
+int bej_view_member(const bej_view_t *set, const char *name, bej_view_t *child);
+
+/**
+ * @brief opens a member of a Set whose SFL header is known to start at `at`
+ *
+ * The position usually comes from an index (see bej_index.h). It is checked
+ * against the bounds of the Set and the sequence number of `name`, so a
+ * stale position fails instead of returning the wrong value
+ *
+ * @param set a view on a Set
+ * @param name the property name
+ * @param at start of the member's SFL header inside the payload of `set`
+ * @param child the view to fill
+ * @return 1 if `at` holds the member, 0 otherwise
+ */
+int bej_view_member_at(const bej_view_t *set, const char *name, const uint8_t *at, bej_view_t *child);
+
+/**
+ * @brief finds an element of an Array by position
+ * @param array a view on an Array
+ * @param index zero-based element index
+ * @param element the view to fill
+ * @return 1 if the element exists, 0 otherwise
+ */
+int bej_view_element(const bej_view_t *array, uint64_t index, bej_view_t *element);
+
+/**
+ * @brief opens an element of an Array whose SFL header is known to start at `at`
+ * @param array a view on an Array
+ * @param index zero-based element index
+ * @param at start of the element's SFL header inside the payload of `array`
+ * @param element the view to fill
+ * @return 1 if `at` holds the element, 0 otherwise
+ */
+int bej_view_element_at(const bej_view_t *array, uint64_t index, const uint8_t *at, bej_view_t *element);
+
+/**
+ * @brief splits the next segment off a path
+ * @param path pointer to the path, advanced past the segment (must start with '/')
+ * @param name buffer of BEJ_VIEW_MAX_NAME bytes receiving the unescaped segment
+ * @return 1 on success, 0 if the path is malformed or the segment is too long
+ */
+int bej_view_next_segment(const char **path, char *name);
+
+/**
+ * @brief parses an Array index path segment
+ * @param name the unescaped segment
+ * @param index pointer to store the index
+ * @return 1 if the segment is a decimal number without leading zeros, 0 otherwise
+ */
+int bej_view_parse_index(const char *name, uint64_t *index);
+
+/**
+ * @brief resolves a JSON Pointer style path such as "/Status/Health" or "/Regions/1/SizeMiB"
+ *
+ * Segments address Set members by name and Array elements by decimal index.
+ * "~1" and "~0" inside a segment stand for '/' and '~'. The empty path is the
+ * view itself
+ *
+ * @param view the view to start from (usually the root)
+ * @param path the path
+ * @param out the view to fill
+ * @return 1 if the path exists, 0 otherwise
+ */
+int bej_view_get(const bej_view_t *view, const char *path, bej_view_t *out);
+
+/**
+ * @brief returns the number of members of a Set or elements of an Array
+ * @param view a view on a Set or Array
+ * @param count pointer to store the count
+ * @return 1 on success, 0 on failure
+ */
+int bej_view_count(const bej_view_t *view, uint64_t *count);
+
+/**
+ * @brief reads an Integer value
+ * @param view a view on an Integer
+ * @param value pointer to store the value
+ * @return 1 on success, 0 on failure
+ */
+int bej_view_integer(const bej_view_t *view, int64_t *value);
+
+/**
+ * @brief reads a Boolean value
+ * @param view a view on a Boolean
+ * @param value pointer to store the value (0 or 1)
+ * @return 1 on success, 0 on failure
+ */
+int bej_view_boolean(const bej_view_t *view, int *value);
+
+/**
+ * @brief reads a String value without copying it
+ * @param view a view on a String
+ * @param str pointer to store the characters (inside the BEJ buffer, null-terminated)
+ * @param len pointer to store the length without the terminator
+ * @return 1 on success, 0 on failure
+ */
+int bej_view_string(const bej_view_t *view, const char **str, size_t *len);
+
+/**
+ * @brief reads an Enum value and resolves its option name
+ * @param view a view on an Enum
+ * @param name pointer to store the option name (inside the dictionary)
+ * @return 1 on success, 0 on failure
+ */
+int bej_view_enum(const bej_view_t *view, const char **name);
+
+#endif // BEJ_PARSER_BEJ_VIEW_H
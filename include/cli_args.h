@@ -10,27 +10,47 @@
 #define CLI_ARGS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#define CLI_MAX_JOBS 1024 /**< upper bound for `-j` */
 
 /**
  * @brief structure holding parsed command-line arguments
  */
 typedef struct {
-    const char *input_path;    /**< path to input file (JSON or BEJ) */
+    const char **input_paths;  /**< input files or directories (JSON or BEJ), in command-line order */
+    size_t input_count;        /**< number of entries in `input_paths` */
+    const char *list_path;     /**< file with one input path per line, "-" for stdin (or NULL) */
     const char *schema_path;   /**< path to schema dictionary (required) */
     const char *annot_path;    /**< path to annotation dictionary (optional) */
     const char *output_path;   /**< path to output file (or NULL for stdout) */
+    const char *output_dir;    /**< directory receiving one output file per input (or NULL) */
+    int framed;                /**< 1 = write all outputs to `output_path` as a framed stream */
+    int streaming;             /**< 1 = convert with the streaming reader/decoder instead of a tree */
+    int jobs;                  /**< number of worker threads (at least 1) */
     int mode_encode;           /**< operation mode: 1 = encode, 0 = decode */
+    int mode_index;            /**< 1 = build index sidecars of BEJ inputs (mode_encode is then 0) */
+    int stats;                 /**< 1 = print codec statistics as JSON to stderr after the run */
 } args_t;
 
 /**
  * @brief parses command-line arguments into an args_t structure
  *
  * This function handles the following arguments:
- * - `encode` or `decode` to set the operation mode
- * - `<input-file>` for the source file (JSON or BEJ)
+ * - `encode`, `decode` or `index` to set the operation mode
+ * - `<input>...` for one or more source files (JSON or BEJ) or directories
+ * - `-l <list>` for a file listing input paths, one per line (`-` for stdin)
  * - `-s <schema>` for the required schema dictionary
  * - `-a <annotation>` for the optional annotation dictionary
  * - `-o <output>` for the output file
+ * - `-O <dir>` to write one output file per input into a directory
+ * - `-f` to write all outputs to the output file (or stdout) as a framed stream
+ * - `-j <n>` to convert with `n` worker threads (0 = one per online CPU); a
+ *   single input without `-S` is split across them
+ * - `-S` to convert without building a JSON tree (encode: fixed-width length
+ *   fields, decode: compact JSON text)
+ * - `--stats` to print counters and phase timings to stderr (needs a build
+ *   with BEJ_ENABLE_STATS)
  *
  * @param argc the number of command-line arguments
  * @param argv the array of command-line arguments
@@ -39,4 +59,10 @@ typedef struct {
  */
 int parse_args(int argc, char **argv, args_t *out);
 
+/**
+ * @brief releases the memory held by a parsed args_t structure
+ * @param args the structure filled by parse_args (NULL-safe)
+ */
+void free_args(args_t *args);
+
 #endif // CLI_ARGS_H
@@ -0,0 +1,86 @@
+/**
+* @file cli_batch.h
+ * @brief batch processing of many inputs in one process
+ *
+ * The encode and decode commands expand their inputs (files, directories and
+ * path lists) into a batch, run one conversion per input and route the results
+ * to a single output, an output directory, or a framed stream.
+ *
+ * A framed stream is a sequence of frames, one per successfully converted
+ * input, in input order:
+ * - 4 bytes: payload length (little-endian)
+ * - 2 bytes: name length (little-endian)
+ * - name: the input path as given (not null-terminated)
+ * - payload: the converted document
+ *
+ * With `-j` the inputs are spread over worker threads that each own a range
+ * of the batch and steal half of another worker's remaining range once their
+ * own is exhausted. Jobs must therefore be reentrant; the dictionaries they
+ * share are read-only, the output buffer and JSON arena are per worker. Frames are then written in completion order
+ */
+
+#ifndef CLI_BATCH_H
+#define CLI_BATCH_H
+
+#include <stddef.h>
+
+#include "bej_buffer.h"
+#include "cli_args.h"
+#include "json.h"
+
+#define CLI_FRAME_HEADER_SIZE 6 /**< payload length (u32) and name length (u16) */
+
+/**
+ * @brief the expanded list of input paths of one run
+ */
+typedef struct {
+    char **paths;    /**< input file paths (owned) */
+    size_t count;    /**< number of paths */
+    size_t capacity; /**< allocated slots in `paths` */
+} cli_batch_t;
+
+/**
+ * @brief converts a single input file into an output buffer
+ * @param input_path path of the input file
+ * @param ctx caller context (dictionaries)
+ * @param arena the worker's arena for JSON trees, reset after every input
+ * @param out buffer receiving the converted document
+ * @return 1 on success, 0 on failure
+ */
+typedef int (*cli_job_fn)(const char *input_path, void *ctx, json_arena_t *arena, bej_buffer_t *out);
+
+/**
+ * @brief expands the inputs of a command line into a list of files
+ *
+ * Directories contribute their regular files (sorted by name, hidden files
+ * skipped), and the list file contributes one path per non-empty line
+ *
+ * @param args the parsed arguments
+ * @param batch pointer to the batch to fill
+ * @return 1 on success, 0 on failure (an error is printed)
+ */
+int cli_batch_collect(const args_t *args, cli_batch_t *batch);
+
+/**
+ * @brief releases the memory held by a batch
+ * @param batch the batch to release (NULL-safe)
+ */
+void cli_batch_free(cli_batch_t *batch);
+
+/**
+ * @brief runs a job for every input of a batch and writes the results
+ *
+ * A failing input is reported on stderr and skipped, the remaining inputs are
+ * still processed. `args->jobs` worker threads run the job concurrently
+ *
+ * @param args the parsed arguments (selects the output mode)
+ * @param batch the inputs to process
+ * @param job the conversion to run for each input
+ * @param ctx context passed to the job
+ * @param output_extension extension of files written to an output directory (e.g. ".bej")
+ * @return 0 if every input succeeded, non-zero otherwise
+ */
+int cli_batch_run(const args_t *args, const cli_batch_t *batch,
+                  cli_job_fn job, void *ctx, const char *output_extension);
+
+#endif // CLI_BATCH_H
@@ -13,9 +13,9 @@
 
 /**
  * @brief runs the BEJ decoding process
- * * This function opens the input BEJ file, loads the necessary dictionaries,
- * decodes the data into a JSON tree, and writes the result to the
- * specified output file or to stdout
+ * * This function loads the necessary dictionaries once, then decodes every
+ * input BEJ file into a JSON tree and writes the results to the specified
+ * output file, output directory, framed stream or stdout
  *
  * @param args a pointer to a populated args_t structure with all required paths
  * @return 0 on success, or a non-zero value on failure
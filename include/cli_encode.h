@@ -14,9 +14,9 @@
 /**
  * @brief runs the BEJ encoding process
  *
- * This function opens the input JSON file, parses it, loads the necessary
- * dictionaries, encodes the data into BEJ format, and writes the result
- * to the specified output file or to stdout
+ * This function loads the necessary dictionaries once, then parses and
+ * encodes every input JSON file and writes the results to the specified
+ * output file, output directory, framed stream or stdout
  *
  * @param args a pointer to a populated args_t structure with all required paths
  * @return 0 on success, or a non-zero value on failure
@@ -0,0 +1,26 @@
+/**
+* @file cli_index.h
+ * @brief command-line interface for building BEJ index sidecars
+ *
+ * This file provides the function to run the index building process from
+ * command-line arguments
+ */
+
+#ifndef CLI_INDEX_H
+#define CLI_INDEX_H
+
+#include "cli_args.h"
+
+/**
+ * @brief runs the BEJ index building process
+ *
+ * This function loads the necessary dictionaries once, then builds the offset
+ * index (see bej_index.h) of every input BEJ file and writes the results to
+ * the specified output file, output directory, framed stream or stdout
+ *
+ * @param args a pointer to a populated args_t structure with all required paths
+ * @return 0 on success, or a non-zero value on failure
+ */
+int cli_run_index(const args_t *args);
+
+#endif // CLI_INDEX_H
@@ -0,0 +1,21 @@
+/**
+* @file cli_stats.h
+ * @brief command-line report of the codec statistics
+ *
+ * This file provides the function that prints the bej_stats_t totals of a
+ * run for `bej_parser --stats`
+ */
+
+#ifndef CLI_STATS_H
+#define CLI_STATS_H
+
+#include <stdio.h>
+
+/**
+ * @brief writes the statistics of all threads as a JSON object
+ * @param out the stream to write to
+ * @return 0 on success, or a non-zero value on a write error
+ */
+int cli_print_stats(FILE *out);
+
+#endif // CLI_STATS_H
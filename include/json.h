@@ -10,11 +10,25 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #define JSON_INITIAL_CAPACITY 8    /**< Initial array/object capacity */
+#define JSON_OBJECT_INDEX_MIN 32   /**< Entries from which an object keeps a hash index of its keys */
 #define JSON_MAX_UNICODE_LENGTH 6  /**< Max estimated length for Unicode escape sequence */
 
+#define JSON_ARENA_BLOCK_SIZE     (16u * 1024u)   /**< Size of the first arena block */
+#define JSON_ARENA_MAX_BLOCK_SIZE (1024u * 1024u) /**< Arena blocks stop doubling at this size */
+
+/**
+ * @name Value Flags
+ * @{
+ */
+#define JSON_FLAG_ARENA    0x01u /**< Value, its strings and containers live in a json_arena_t */
+#define JSON_FLAG_BORROWED 0x02u /**< The string of a JSON_STRING, or the keys of a JSON_OBJECT, are not owned by the value */
+/** @} */
+
 /**
  * @typedef json_value_t
  * @brief Represents a JSON value of any type (null, bool, number, string, array, object)
@@ -73,7 +87,8 @@ typedef struct {
 typedef struct {
     json_object_entry_t *entries; /**< Array of object entries */
     size_t count;                 /**< Number of entries */
-    size_t capacity;              /**< Allocated capacity */
+    size_t capacity;              /**< Allocated capacity (a power of two) */
+    uint32_t *index;              /**< 2 * capacity hash slots holding entry positions + 1 (NULL below JSON_OBJECT_INDEX_MIN entries) */
 } json_object_t;
 
 /**
@@ -82,6 +97,7 @@ typedef struct {
  */
 struct json_value {
     json_type_t type; /**< Type of this value */
+    uint8_t flags;    /**< JSON_FLAG_* bits */
 
     /**
      * @brief Value data (union depends on type)
@@ -101,6 +117,24 @@ struct json_value {
 };
 
 
+/**
+ * @brief Single block of an arena
+ */
+typedef struct json_arena_block json_arena_block_t;
+
+/**
+ * @brief Bump allocator for JSON trees
+ *
+ * Every node, key, string and container of a tree built in an arena is carved
+ * out of a few large blocks and released at once by json_arena_reset() or
+ * json_arena_destroy(). json_free() on such a tree does nothing. Arena
+ * containers must only hold values from the same arena
+ */
+typedef struct {
+    json_arena_block_t *head; /**< Block currently allocated from (newest) */
+    size_t block_size;        /**< Size of the next block to allocate */
+} json_arena_t;
+
 /**
  * @struct json_parser_t
  * @brief Parser context for JSON parsing
@@ -111,8 +145,47 @@ typedef struct {
     size_t line;         /**< Current line number */
     size_t column;       /**< Current column number */
     json_error_t error;  /**< Last error encountered */
+    json_arena_t *arena; /**< Arena for the parsed tree (NULL = heap) */
 } json_parser_t;
 
+/**
+ * @brief Initialize an empty arena (no memory is allocated until first use)
+ * @param arena Arena to initialize
+ */
+void json_arena_init(json_arena_t *arena);
+
+/**
+ * @brief Release every allocation of an arena, keeping its largest block for reuse
+ * @param arena Arena to reset
+ */
+void json_arena_reset(json_arena_t *arena);
+
+/**
+ * @brief Release all memory held by an arena
+ * @param arena Arena to destroy (NULL-safe)
+ */
+void json_arena_destroy(json_arena_t *arena);
+
+/**
+ * @brief Move every block of one arena into another
+ *
+ * Trees built in `src` then live in `dst` and are released with it, so
+ * trees built on several threads in arenas of their own can be joined into
+ * one. `src` is left empty and can be reused
+ *
+ * @param dst Arena receiving the blocks
+ * @param src Arena giving them up (no longer allocated from by any thread)
+ */
+void json_arena_adopt(json_arena_t *dst, json_arena_t *src);
+
+/**
+ * @brief Allocate memory from an arena
+ * @param arena Arena to allocate from
+ * @param size Number of bytes
+ * @return Pointer aligned for any JSON value, or NULL on allocation failure
+ */
+void *json_arena_alloc(json_arena_t *arena, size_t size);
+
 
 /**
  * @brief Allocate a new JSON value of a specified type
@@ -121,12 +194,101 @@ typedef struct {
  */
 json_value_t *json_create(json_type_t type);
 
+/**
+ * @brief Allocate a new JSON value of a specified type in an arena
+ * @param arena Arena to allocate from (NULL = heap, same as json_create)
+ * @param type JSON type
+ * @return Pointer to allocated json_value_t or NULL on failure
+ */
+json_value_t *json_create_in(json_arena_t *arena, json_type_t type);
+
+/**
+ * @brief Copy a string of known length into an arena (or the heap)
+ * @param arena Arena to allocate from (NULL = heap)
+ * @param str Characters to copy
+ * @param len Number of characters
+ * @return Null-terminated copy or NULL on allocation failure
+ */
+char *json_strndup_in(json_arena_t *arena, const char *str, size_t len);
+
+/**
+ * @brief Create a JSON string that points to characters it does not own
+ *
+ * The value is flagged JSON_FLAG_BORROWED: json_free() leaves the characters
+ * alone, so they must outlive the value
+ *
+ * @param arena Arena to allocate the value from (NULL = heap)
+ * @param str Null-terminated characters
+ * @return JSON_STRING value or NULL on allocation failure
+ */
+json_value_t *json_create_borrowed_string_in(json_arena_t *arena, const char *str);
+
 /**
  * @brief Free a JSON value and all children recursively
+ *
+ * Storage of values flagged JSON_FLAG_BORROWED is left to its owner
+ *
  * @param value JSON value to free (NULL-safe)
  */
 void json_free(json_value_t *value);
 
+/**
+ * @brief Append an item to a JSON array, growing it if needed
+ * @param array JSON_ARRAY value to append to
+ * @param item Value to append (ownership moves to the array on success)
+ * @return true on success, false on invalid input or allocation failure
+ */
+bool json_array_append(json_value_t *array, json_value_t *item);
+
+/**
+ * @brief Append a key/value pair to a JSON object, growing it if needed
+ * @param object JSON_OBJECT value to append to
+ * @param key Key string (copied)
+ * @param value Value to append (ownership moves to the object on success)
+ * @return true on success, false on invalid input or allocation failure
+ */
+bool json_object_append(json_value_t *object, const char *key, json_value_t *value);
+
+/**
+ * @brief Append an item to a JSON array created by json_create_in
+ * @param arena Arena the array was created in (NULL = heap)
+ * @param array JSON_ARRAY value to append to
+ * @param item Value to append (from the same arena)
+ * @return true on success, false on invalid input or allocation failure
+ */
+bool json_array_append_in(json_arena_t *arena, json_value_t *array, json_value_t *item);
+
+/**
+ * @brief Grow a JSON array created by json_create_in so it holds `capacity` items without growing again
+ * @param arena Arena the array was created in (NULL = heap)
+ * @param array JSON_ARRAY value to grow
+ * @param capacity Number of items to make room for (a smaller value leaves the array as it is)
+ * @return true on success, false on invalid input or allocation failure
+ */
+bool json_array_reserve_in(json_arena_t *arena, json_value_t *array, size_t capacity);
+
+/**
+ * @brief Append a key/value pair to a JSON object created by json_create_in
+ * @param arena Arena the object was created in (NULL = heap)
+ * @param object JSON_OBJECT value to append to
+ * @param key Key string (copied into the arena, or kept as is if the object is flagged JSON_FLAG_BORROWED)
+ * @param value Value to append (from the same arena)
+ * @return true on success, false on invalid input or allocation failure
+ */
+bool json_object_append_in(json_arena_t *arena, json_value_t *object, const char *key, json_value_t *value);
+
+/**
+ * @brief Look up the value of a key in a JSON object
+ *
+ * Objects of JSON_OBJECT_INDEX_MIN entries or more answer from their hash
+ * index, smaller ones are scanned in order
+ *
+ * @param object JSON_OBJECT value to search
+ * @param key Key to find
+ * @return Value of the first entry with the key, or NULL if there is none
+ */
+json_value_t *json_object_get(const json_value_t *object, const char *key);
+
 /**
  * @brief Parse a JSON string into value tree
  * @param input JSON input string
@@ -141,6 +303,22 @@ json_value_t *json_parse(const char *input);
  */
 json_value_t *json_parse_file(const char *filename);
 
+/**
+ * @brief Parse a JSON string into a value tree allocated in an arena
+ * @param input JSON input string
+ * @param arena Arena for the tree (NULL = heap, same as json_parse)
+ * @return Pointer to root value or NULL on error
+ */
+json_value_t *json_parse_in(const char *input, json_arena_t *arena);
+
+/**
+ * @brief Parse a JSON file into a value tree allocated in an arena
+ * @param filename Path to JSON file
+ * @param arena Arena for the tree (NULL = heap, same as json_parse_file)
+ * @return Pointer to root value or NULL on error
+ */
+json_value_t *json_parse_file_in(const char *filename, json_arena_t *arena);
+
 /**
  * @brief Write indentation using tabs
  * @param f Output file stream
@@ -169,7 +347,7 @@ void json_write_bool(FILE *f, bool b);
 void json_write_number(FILE *f, double num);
 
 /**
- * @brief Write JSON string value (without escaping)
+ * @brief Write JSON string value (escaped)
  * @param f Output file stream
  * @param s Null-terminated UTF-8 string
  */
@@ -203,14 +381,125 @@ void json_write_value(FILE *f, const json_value_t *value, int indent);
  * @brief Write a JSON value to a file (formatted)
  * @param file FILE pointer
  * @param root Root JSON value
- * @return 0 on success
+ * @return 0 on success, -1 on allocation or write failure
  */
 int json_write_file(FILE* file, const json_value_t *root);
 
+/**
+ * @name Text Writer
+ * @brief serializer that appends JSON text to a growable buffer
+ *
+ * Numbers and strings are formatted by hand and nothing touches stdio until
+ * json_writer_flush(), which is a single fwrite(). The json_write_* functions
+ * above are thin wrappers around it. Appends never fail separately: the first
+ * allocation failure sets `failed` and every later call is a no-op
+ * @{
+ */
+
+#define JSON_WRITE_COMPACT 0x00u /**< No whitespace at all */
+#define JSON_WRITE_PRETTY  0x01u /**< One object member per line, tab indentation (json_write_file layout) */
+
+#define JSON_WRITER_INITIAL_CAPACITY 4096u /**< First allocation of a writer buffer */
+
+/**
+ * @brief Output buffer and formatting state of a writer
+ */
+typedef struct {
+    char *data;      /**< Text written so far (not null-terminated) */
+    size_t size;     /**< Length of the text */
+    size_t capacity; /**< Allocated bytes of `data` */
+    unsigned mode;   /**< JSON_WRITE_* mode */
+    int indent;      /**< Base indentation level of pretty output */
+    bool failed;     /**< Sticky allocation/write error flag */
+} json_writer_t;
+
+/**
+ * @brief Initialize an empty writer
+ * @param writer Writer to initialize
+ * @param mode JSON_WRITE_COMPACT or JSON_WRITE_PRETTY
+ */
+void json_writer_init(json_writer_t *writer, unsigned mode);
+
+/**
+ * @brief Release the buffer of a writer
+ * @param writer Writer to release (NULL-safe)
+ */
+void json_writer_free(json_writer_t *writer);
+
+/**
+ * @brief Append characters as they are
+ * @param writer Writer to append to
+ * @param data Characters to append
+ * @param size Number of characters
+ * @return false if the writer has failed
+ */
+bool json_writer_raw(json_writer_t *writer, const char *data, size_t size);
+
+/**
+ * @brief Append string contents with JSON escaping, without quotes
+ *
+ * Quotes, backslashes and control characters are escaped, everything else
+ * (including UTF-8 sequences) is copied
+ *
+ * @param writer Writer to append to
+ * @param s Characters to escape
+ * @param length Number of characters
+ * @return false if the writer has failed
+ */
+bool json_writer_escaped(json_writer_t *writer, const char *s, size_t length);
+
+/**
+ * @brief Append a quoted, escaped JSON string
+ * @param writer Writer to append to
+ * @param s Characters of the string
+ * @param length Number of characters
+ * @return false if the writer has failed
+ */
+bool json_writer_string(json_writer_t *writer, const char *s, size_t length);
+
+/**
+ * @brief Append an integer
+ * @param writer Writer to append to
+ * @param value Value to format
+ * @return false if the writer has failed
+ */
+bool json_writer_int(json_writer_t *writer, int64_t value);
+
+/**
+ * @brief Append a number with the fewest digits that parse back to the same double
+ *
+ * Integral values are written without a fraction or exponent, NaN and
+ * infinities (which JSON cannot represent) as null
+ *
+ * @param writer Writer to append to
+ * @param num Value to format
+ * @return false if the writer has failed
+ */
+bool json_writer_number(json_writer_t *writer, double num);
+
+/**
+ * @brief Append a whole value tree in the writer's mode
+ * @param writer Writer to append to
+ * @param value Root of the tree
+ * @return false if the writer has failed
+ */
+bool json_writer_value(json_writer_t *writer, const json_value_t *value);
+
+/**
+ * @brief Write the buffered text to a stream with one fwrite() and empty the buffer
+ * @param writer Writer to flush
+ * @param file Output stream
+ * @return true on success, false if the writer had failed or the write failed
+ */
+bool json_writer_flush(json_writer_t *writer, FILE *file);
+
+/** @} */
+
 /**
  * @brief recursively compares two JSON values for equality
  * * This function performs a deep comparison of two JSON trees. Object keys
- * are compared without regard to their order
+ * are compared without regard to their order, in linear time for objects
+ * with a hash index
  *
  * @param a the first JSON value
  * @param b the second JSON value
@@ -218,4 +507,121 @@ int json_write_file(FILE* file, const json_value_t *root);
  */
 bool json_compare(const json_value_t* a, const json_value_t* b);
 
+/**
+ * @name Streaming Reader
+ * @brief pull parser producing one event per JSON token
+ *
+ * The reader keeps only a fixed-size input window, the current token and one
+ * byte per open container, so memory is bounded by nesting depth and the
+ * longest string instead of the document size
+ *
+ * A fed reader gets its text in chunks from json_reader_feed() instead of a
+ * stream. When a chunk ends inside an event it returns JSON_EVENT_NEED_INPUT
+ * and takes the partial event back, so the caller can wait for more text
+ * without blocking; only the bytes of that event stay buffered
+ * @{
+ */
+
+#define JSON_READER_BUFFER_SIZE (64u * 1024u) /**< Input window of a stream-backed reader */
+
+/**
+ * @enum json_event_t
+ * @brief Events returned by json_reader_next()
+ */
+typedef enum {
+    JSON_EVENT_BEGIN_OBJECT = 0, /**< '{' */
+    JSON_EVENT_END_OBJECT,       /**< '}' */
+    JSON_EVENT_BEGIN_ARRAY,      /**< '[' */
+    JSON_EVENT_END_ARRAY,        /**< ']' */
+    JSON_EVENT_KEY,              /**< Object key, in `token` */
+    JSON_EVENT_STRING,           /**< String value, in `token` */
+    JSON_EVENT_NUMBER,           /**< Number value, in `number` */
+    JSON_EVENT_BOOL,             /**< Boolean value, in `boolean` */
+    JSON_EVENT_NULL,             /**< Null value */
+    JSON_EVENT_END,              /**< End of the document */
+    JSON_EVENT_ERROR,            /**< Syntax, I/O or allocation error, see `error` (sticky) */
+    JSON_EVENT_NEED_INPUT        /**< A fed reader needs the next chunk, nothing was consumed */
+} json_event_t;
+
+/**
+ * @brief Pull parser state
+ */
+typedef struct {
+    FILE *stream;           /**< Source stream (NULL for in-memory input) */
+    char *buffer;           /**< Input window of a stream-backed reader */
+    const char *pos;        /**< Next unread character */
+    const char *end;        /**< End of the readable window */
+    int at_eof;             /**< 1 once the stream is exhausted */
+    unsigned char *stack;   /**< Kind of every open container (object or array) */
+    size_t depth;           /**< Number of open containers */
+    size_t stack_capacity;  /**< Allocated entries in `stack` */
+    int expect;             /**< What the grammar allows next (internal) */
+    char *token;            /**< Characters of the last KEY or STRING event (null-terminated) */
+    size_t token_length;    /**< Length of `token` */
+    size_t token_capacity;  /**< Allocated bytes of `token` */
+    double number;          /**< Value of the last NUMBER event */
+    bool boolean;           /**< Value of the last BOOL event */
+    size_t line;            /**< Current line number */
+    size_t column;          /**< Current column number */
+    json_error_t error;     /**< Error behind a JSON_EVENT_ERROR */
+    size_t buffer_capacity; /**< Allocated bytes of `buffer` of a fed reader */
+    int feeding;            /**< 1 while a fed reader may get more input */
+    int starved;            /**< 1 once the current event ran out of fed input (internal) */
+} json_reader_t;
+
+/**
+ * @brief Initialize a reader over an open stream
+ * @param reader Reader to initialize
+ * @param stream Stream to read JSON text from
+ * @return true on success, false on allocation failure
+ */
+bool json_reader_init_stream(json_reader_t *reader, FILE *stream);
+
+/**
+ * @brief Initialize a reader over text in memory
+ * @param reader Reader to initialize
+ * @param input JSON text (does not need to be null-terminated)
+ * @param length Length of the text
+ */
+void json_reader_init_string(json_reader_t *reader, const char *input, size_t length);
+
+/**
+ * @brief Initialize a reader that is given its text with json_reader_feed()
+ * @param reader Reader to initialize
+ */
+void json_reader_init_feed(json_reader_t *reader);
+
+/**
+ * @brief Append the next chunk of text to a fed reader
+ * @param reader Reader initialized with json_reader_init_feed()
+ * @param input The chunk (does not need to be null-terminated)
+ * @param length Length of the chunk, 0 marks the end of the text
+ * @return true on success, false on allocation failure
+ */
+bool json_reader_feed(json_reader_t *reader, const char *input, size_t length);
+
+/**
+ * @brief Read the next event
+ * @param reader Reader to advance
+ * @return The event; JSON_EVENT_END after the root value, JSON_EVENT_ERROR on failure,
+ *         JSON_EVENT_NEED_INPUT if a fed reader needs another chunk first
+ */
+json_event_t json_reader_next(json_reader_t *reader);
+
+/**
+ * @brief Skip the rest of a value whose first event was just returned
+ * @param reader Reader to advance
+ * @param event The first event of the value (scalars are skipped already)
+ * @return true on success, false on error or if a fed reader runs out of input
+ */
+bool json_reader_skip(json_reader_t *reader, json_event_t event);
+
+/**
+ * @brief Release the memory held by a reader (does not close the stream)
+ * @param reader Reader to release (NULL-safe)
+ */
+void json_reader_free(json_reader_t *reader);
+
+/** @} */
+
 #endif
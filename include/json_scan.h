@@ -0,0 +1,60 @@
+/**
+ * @file json_scan.h
+ * @brief Character scanning and escape helpers shared by the JSON parser and reader
+ *
+ * The scanners look at 16 or 32 bytes per step with SSE2, AVX2 or NEON. The
+ * widest variant the CPU supports is selected once at startup, builds with
+ * JSON_SCAN_NO_SIMD (or other architectures) use the scalar loops. The vector
+ * loops only issue aligned loads, so they never touch a page that does not
+ * contain a byte of the string
+ */
+
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_UTF8_MAX_LENGTH 4           /**< Longest UTF-8 encoding of a code point */
+#define JSON_REPLACEMENT_CHARACTER 0xFFFDu /**< Substitute for unpaired surrogates */
+
+/**
+ * @brief Find the first quote, backslash or terminator of string contents
+ * @param s Null-terminated text
+ * @return Pointer to the first '"', '\\' or '\0' at or after `s`
+ */
+const char *json_scan_string(const char *s);
+
+/**
+ * @brief Skip JSON whitespace (space, tab, newline, carriage return)
+ * @param s Null-terminated text
+ * @param newlines Incremented by the number of '\n' skipped
+ * @param last_newline Set to the last '\n' skipped (left unchanged if there is none)
+ * @return Pointer to the first non-whitespace character
+ */
+const char *json_scan_whitespace(const char *s, size_t *newlines, const char **last_newline);
+
+/**
+ * @brief Name of the scanner variant in use
+ * @return "avx2", "sse2", "neon" or "scalar"
+ */
+const char *json_scan_variant(void);
+
+/**
+ * @brief Parse the four hex digits of a \\u escape
+ * @param hex The four characters after "\\u"
+ * @param value Pointer to store the UTF-16 code unit
+ * @return true if all four characters are hex digits
+ */
+bool json_scan_hex4(const char *hex, uint32_t *value);
+
+/**
+ * @brief Encode a code point as UTF-8, surrogates become U+FFFD
+ * @param code_point Unicode code point
+ * @param out Receives up to JSON_UTF8_MAX_LENGTH bytes
+ * @return Number of bytes written
+ */
+size_t json_scan_utf8(uint32_t code_point, char *out);
+
+#endif // JSON_SCAN_H
@@ -0,0 +1,150 @@
+/**
+ * @file bej_bind.c
+ * @brief compilation of struct bindings against BEJ dictionaries
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_bind.h"
+#include "bej_view.h"
+
+/**
+ * @brief resolves a property name inside a Set node, like the encoder does
+ * @param binding the binding
+ * @param set the Set node
+ * @param name the property name
+ * @param entry pointer to store the dictionary entry
+ * @param selector pointer to store the dictionary selector
+ * @return 1 if the name is known, 0 otherwise
+ */
+static int resolve_name(const bej_binding_t *binding, const bej_bind_node_t *set, const char *name,
+                        bej_dict_entry_t *entry, uint8_t *selector) {
+    *selector = set->selector;
+    if (set->selector == 0 && name[0] == '@') {
+        *selector = 1; // annotations on schema properties live in the global annotation scope
+        return binding->annot_dict && bej_dict_find_annotation_by_name(binding->annot_dict, name, entry);
+    }
+    const bej_dictionary_t *dict = set->selector ? binding->annot_dict : binding->schema_dict;
+    return dict && bej_dict_find_child_by_name(dict, set->entry.child_pointer, set->entry.child_count, name, entry);
+}
+
+/**
+ * @brief checks that a field format is one a struct member can hold
+ * @param format the format
+ * @return 1 for Integer, Boolean, String and Enum
+ */
+static int bindable_format(const uint8_t format) {
+    return format == BEJ_FORMAT_INTEGER || format == BEJ_FORMAT_BOOLEAN ||
+           format == BEJ_FORMAT_STRING || format == BEJ_FORMAT_ENUM;
+}
+
+/**
+ * @brief returns the member node of a Set node for a sequence number, appending it if needed
+ * @param binding the binding (nodes has room for one more)
+ * @param parent the Set node
+ * @param entry dictionary entry of the member
+ * @param selector dictionary selector of the member
+ * @return the node index
+ */
+static uint32_t member_node(bej_binding_t *binding, const uint32_t parent, const bej_dict_entry_t *entry,
+                            const uint8_t selector) {
+    const uint64_t seq = ((uint64_t)entry->sequence << 1) | selector;
+    uint32_t *link = &binding->nodes[parent].first_child;
+    while (*link != BEJ_BIND_NONE) {
+        if (binding->nodes[*link].seq == seq)
+            return *link;
+        link = &binding->nodes[*link].next_sibling;
+    }
+
+    // members keep the order of the field table, the encoder writes them in that order
+    const uint32_t node = (uint32_t)binding->node_count++;
+    binding->nodes[node] = (bej_bind_node_t){
+        .entry = *entry,
+        .seq = seq,
+        .selector = selector,
+        .field = BEJ_BIND_NONE,
+        .first_child = BEJ_BIND_NONE,
+        .next_sibling = BEJ_BIND_NONE,
+    };
+    *link = node;
+    return node;
+}
+
+int bej_binding_init(bej_binding_t *binding, const bej_bind_field_t *fields, const size_t field_count,
+                     const bej_dictionary_t *schema_dict,
+                     const bej_dictionary_t *annot_dict) {
+    if (!binding)
+        return 0;
+    memset(binding, 0, sizeof(*binding));
+    if ((!fields && field_count) || field_count > BEJ_BIND_MAX_FIELDS || !schema_dict)
+        return 0;
+
+    // every segment adds at most one node
+    size_t capacity = 1;
+    for (size_t i = 0; i < field_count; i++) {
+        if (!fields[i].path)
+            return 0;
+        for (const char *c = fields[i].path; *c; c++)
+            capacity += *c == '/';
+    }
+
+    bej_dict_stream_t ds;
+    bej_dict_entry_t root;
+    bej_dict_stream_init(&ds, schema_dict);
+    binding->nodes = malloc(capacity * sizeof(*binding->nodes));
+    if (!binding->nodes || !bej_dict_stream_next(&ds, &root)) {
+        bej_binding_free(binding);
+        return 0;
+    }
+    root.format = BEJ_FORMAT_SET;
+
+    binding->fields = fields;
+    binding->field_count = field_count;
+    binding->schema_dict = schema_dict;
+    binding->annot_dict = annot_dict;
+    binding->nodes[0] = (bej_bind_node_t){
+        .entry = root,
+        .field = BEJ_BIND_NONE,
+        .first_child = BEJ_BIND_NONE,
+        .next_sibling = BEJ_BIND_NONE,
+    };
+    binding->node_count = 1;
+
+    for (size_t i = 0; i < field_count; i++) {
+        const uint64_t bit = (uint64_t)1 << i;
+        const char *p = fields[i].path;
+        uint32_t node = 0;
+        int ok = *p && bindable_format(fields[i].format);
+        while (ok && *p) {
+            char name[BEJ_VIEW_MAX_NAME];
+            bej_dict_entry_t entry;
+            uint8_t selector;
+            const bej_bind_node_t *set = &binding->nodes[node];
+            ok = set->entry.format == BEJ_FORMAT_SET && set->field == BEJ_BIND_NONE &&
+                 bej_view_next_segment(&p, name) && resolve_name(binding, set, name, &entry, &selector);
+            if (ok) {
+                binding->nodes[node].fields |= bit;
+                node = member_node(binding, node, &entry, selector);
+            }
+        }
+
+        bej_bind_node_t *leaf = &binding->nodes[node];
+        if (!ok || node == 0 || leaf->field != BEJ_BIND_NONE || leaf->first_child != BEJ_BIND_NONE ||
+            leaf->entry.format != fields[i].format) {
+            bej_binding_free(binding);
+            return 0;
+        }
+        leaf->field = (uint32_t)i;
+        leaf->fields |= bit;
+    }
+    return 1;
+}
+
+void bej_binding_free(bej_binding_t *binding) {
+    if (!binding)
+        return;
+    free(binding->nodes);
+    binding->nodes = NULL;
+    binding->node_count = 0;
+}
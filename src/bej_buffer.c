@@ -0,0 +1,89 @@
+/**
+ * @file bej_buffer.c
+ * @brief implementation of the growable byte buffer
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_buffer.h"
+#include "bej_stats.h"
+
+void bej_buffer_init(bej_buffer_t *buf) {
+    buf->data = NULL;
+    buf->size = 0;
+    buf->capacity = 0;
+    buf->borrowed = 0;
+}
+
+void bej_buffer_wrap(bej_buffer_t *buf, uint8_t *data, const size_t capacity) {
+    buf->data = data;
+    buf->size = 0;
+    buf->capacity = capacity;
+    buf->borrowed = 1;
+}
+
+void bej_buffer_free(bej_buffer_t *buf) {
+    if (!buf)
+        return;
+    if (!buf->borrowed)
+        free(buf->data);
+    bej_buffer_init(buf);
+}
+
+void bej_buffer_clear(bej_buffer_t *buf) {
+    buf->size = 0;
+}
+
+int bej_buffer_reserve(bej_buffer_t *buf, const size_t additional) {
+    if (additional <= buf->capacity - buf->size)
+        return 1;
+
+    if (buf->borrowed || additional > SIZE_MAX - buf->size)
+        return 0;
+    const size_t required = buf->size + additional;
+
+    // grow geometrically so a sequence of appends stays linear overall
+    size_t new_capacity = buf->capacity ? buf->capacity : BEJ_BUFFER_INITIAL_CAPACITY;
+    while (new_capacity < required) {
+        if (new_capacity > SIZE_MAX / 2) {
+            new_capacity = required;
+            break;
+        }
+        new_capacity *= 2;
+    }
+
+    uint8_t *new_data = realloc(buf->data, new_capacity);
+    if (!new_data)
+        return 0;
+    BEJ_STATS_ADD(allocations, 1);
+
+    buf->data = new_data;
+    buf->capacity = new_capacity;
+    return 1;
+}
+
+uint8_t *bej_buffer_extend(bej_buffer_t *buf, const size_t n) {
+    if (!bej_buffer_reserve(buf, n))
+        return NULL;
+    uint8_t *p = buf->data + buf->size;
+    buf->size += n;
+    return p;
+}
+
+int bej_buffer_append(bej_buffer_t *buf, const void *data, const size_t n) {
+    if (n == 0)
+        return 1;
+    uint8_t *p = bej_buffer_extend(buf, n);
+    if (!p)
+        return 0;
+    memcpy(p, data, n);
+    return 1;
+}
+
+int bej_buffer_append_byte(bej_buffer_t *buf, const uint8_t byte) {
+    if (buf->size == buf->capacity && !bej_buffer_reserve(buf, 1))
+        return 0;
+    buf->data[buf->size++] = byte;
+    return 1;
+}
@@ -2,69 +2,116 @@
  * @file bej_decode.c
  * @brief implementation of the BEJ (Binary Encoded JSON) decoder
  *
- * This file contains the internal (static) functions to parse a BEJ binary stream
- * into a JSON text stream, using a schema dictionary to interpret the data
+ * This file contains two decoders that interpret BEJ data with a schema dictionary:
+ * - a tree builder that turns an in-memory BEJ buffer directly into
+ *   json_value_t nodes. It runs on a bej_cursor_t over the whole document;
+ *   every property payload is split off as a sub-cursor bounded by its SFL
+ *   length, so a value can never read into its siblings and skipping is a
+ *   pointer bump. Open containers are kept on an explicit frame stack
+ *   instead of the C stack
+ * - a resumable streaming decoder that turns BEJ chunks into JSON text. It is
+ *   a state machine over single input bytes with an explicit stack of open
+ *   containers; every payload end is tracked as an absolute input offset
+ *
+ * Neither recurses, both stop at the depth and output size of their
+ * bej_decode_limits_t, so untrusted input cannot exhaust the stack or memory
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-#include <inttypes.h>
 
 #include "bej_decode.h"
+#include "bej_bind.h"
+#include "bej_buffer.h"
+#include "bej_cursor.h"
 #include "bej_dictionary.h"
+#include "bej_io.h"
+#include "bej_stats.h"
 #include "json.h"
 
-// Prototypes for static functions
-static int decode_value(FILE* out, FILE* in,
-                        const bej_dictionary_t* schema_dict,
-                        const bej_dictionary_t* annot_dict,
-                        const bej_dict_entry_t* entry,
-                        uint64_t length);
-static int bej_decode_stream_internal(FILE* output_stream, FILE* input_stream,
-                                      const bej_dictionary_t* schema_dict,
-                                      const bej_dictionary_t* annot_dict,
-                                      const bej_dictionary_t* current_dict,
-                                      uint16_t child_ptr, uint16_t child_count,
-                                      uint64_t prop_count,
-                                      int add_name);
-
-/**
- * @brief unpacks a non-negative integer (nnint) from the stream
- * @param stream the input stream to read from
- * @param value pointer to store the unpacked 64-bit value
- * @return 1 on success, 0 on failure
+#define BEJ_ENUM_OPTION_CACHE 64 /**< Enum options (by sequence number) an array decode remembers */
+#define BEJ_BUILD_STACK_FRAMES 16 /**< frames of the tree builder kept on the C stack before it allocates */
+
+/**
+ * @brief an open Set or Array of the tree builder
  */
-static int unpack_nnint(FILE* stream, uint64_t* value) {
-    uint8_t num_bytes;
-    if (fread(&num_bytes, 1, 1, stream) != 1 || num_bytes > 8) return 0;
-    uint8_t bytes[8] = {0};
-    if (num_bytes > 0 && fread(bytes, 1, num_bytes, stream) != num_bytes) return 0;
-    *value = 0;
-    for (int i = 0; i < num_bytes; i++) {
-        *value |= ((uint64_t)bytes[i] << (8 * i));
-    }
-    return 1;
+typedef struct {
+    bej_cursor_t in;         /**< the members not read yet */
+    uint64_t remaining;      /**< members still to build */
+    json_value_t* container; /**< the JSON_OBJECT or JSON_ARRAY being filled */
+    bej_dict_entry_t entry;  /**< the Set entry, or the element entry of an Array */
+    uint8_t selector;        /**< dictionary selector of the container */
+} build_frame_t;
+
+/**
+ * @brief state of the tree builder shared by all nesting levels
+ */
+typedef struct {
+    const bej_dictionary_t* schema_dict; /**< the main schema dictionary */
+    const bej_dictionary_t* annot_dict;  /**< the annotation dictionary (may be NULL) */
+    json_arena_t* arena;                 /**< arena for the built tree (NULL = heap) */
+    build_frame_t* frames;               /**< stack of open containers, outermost first */
+    size_t frame_capacity;               /**< entries in `frames` */
+    int frames_on_heap;                  /**< 1 if `frames` is allocated (and reallocated when it grows) */
+    size_t max_depth;                    /**< deepest nesting of Sets and Arrays, the root Set is level 1 */
+    uint64_t output_left;                /**< bytes of nodes and strings the tree may still take */
+    int borrow;                          /**< 1 if keys point into the dictionaries and strings into the input */
+} build_ctx_t;
+
+/**
+ * @brief returns the depth limit of a decode
+ * @param limits the limits (may be NULL)
+ * @return max_depth, or BEJ_DECODE_MAX_DEPTH if it is 0
+ */
+static size_t limit_depth(const bej_decode_limits_t* limits) {
+    return limits && limits->max_depth ? limits->max_depth : BEJ_DECODE_MAX_DEPTH;
 }
 
 /**
- * @brief unpacks an SFL (Sequence, Format, Length) header from the stream
- * @param stream the input stream to read from
- * @param seq pointer to store the full sequence number (with selector)
- * @param format pointer to store the format code
- * @param length pointer to store the payload length
- * @return 1 on success, 0 on failure
+ * @brief returns the output limit of a decode
+ * @param limits the limits (may be NULL)
+ * @return max_output, or UINT64_MAX if it is 0
  */
-static int unpack_sfl(FILE* stream, uint64_t* seq, uint8_t* format, uint64_t* length) {
-    if (!unpack_nnint(stream, seq)) return 0;
-    uint8_t format_and_flags;
-    if (fread(&format_and_flags, 1, 1, stream) != 1) return 0;
-    *format = format_and_flags >> 4;
-    if (!unpack_nnint(stream, length)) return 0;
-    return 1;
+static uint64_t limit_output(const bej_decode_limits_t* limits) {
+    return limits && limits->max_output ? limits->max_output : UINT64_MAX;
 }
 
+/**
+ * @brief prepares the tree builder state
+ * @param ctx the state to initialize
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL)
+ * @param arena arena for the built tree (NULL = heap)
+ * @param limits the limits of the decode (NULL = defaults)
+ * @param stack frames on the caller's stack, used until the nesting gets deeper
+ */
+static void build_ctx_init(build_ctx_t* ctx, const bej_dictionary_t* schema_dict,
+                           const bej_dictionary_t* annot_dict, json_arena_t* arena,
+                           const bej_decode_limits_t* limits, build_frame_t stack[BEJ_BUILD_STACK_FRAMES]) {
+    ctx->schema_dict = schema_dict;
+    ctx->annot_dict = annot_dict;
+    ctx->arena = arena;
+    ctx->frames = stack;
+    ctx->frame_capacity = stack ? BEJ_BUILD_STACK_FRAMES : 0;
+    ctx->frames_on_heap = 0;
+    ctx->max_depth = limit_depth(limits);
+    ctx->output_left = limit_output(limits);
+    ctx->borrow = 0;
+}
+
+/**
+ * @brief releases the frames the tree builder allocated
+ * @param ctx the builder state
+ */
+static void build_ctx_release(build_ctx_t* ctx) {
+    if (ctx->frames_on_heap) free(ctx->frames);
+    ctx->frames = NULL;
+    ctx->frame_capacity = 0;
+}
+
+
 /**
  * @brief decodes a full sequence number into its sequence part and selector bit
  * @param seq the full sequence number from the SFL header
@@ -76,17 +123,6 @@ static void decode_sequence_number(const uint64_t seq, uint64_t* sequence_num, u
     *selector = seq & 0x01;
 }
 
-/**
- * @brief prints the JSON property name (e.g., "Key":) for a given dictionary entry
- * @param entry the dictionary entry whose name to print
- * @param output_stream the stream to write to
- */
-static void decode_name(const bej_dict_entry_t* entry, FILE* output_stream) {
-    if (entry->name) {
-        fprintf(output_stream, "\"%s\":", entry->name);
-    }
-}
-
 /**
  * @brief finds a dictionary entry by its sequence number within a specific subset of a dictionary
  * @param dict the dictionary to search in
@@ -99,327 +135,1730 @@ static void decode_name(const bej_dict_entry_t* entry, FILE* output_stream) {
 static int get_entry_by_seq(const bej_dictionary_t* dict, const uint16_t child_ptr,
                             const uint16_t child_count, const uint64_t seq, bej_dict_entry_t* entry) {
     if (dict == NULL) return 0;
-    bej_dict_stream_t subset_stream;
-    bej_dict_stream_init_subset(&subset_stream, dict, child_ptr, child_count);
-    while (bej_dict_stream_next(&subset_stream, entry)) {
-        if (entry->sequence == seq) {
-            return 1;
-        }
-    }
-    return 0;
+    return bej_dict_find_child_by_seq(dict, child_ptr, child_count, seq, entry);
 }
 
 /**
- * @brief unpacks an Integer payload from the stream and prints it as a JSON number
- * @param out the output stream to write the JSON number to
- * @param in the input stream to read the BEJ payload from
- * @return 1 on success, 0 on failure
+ * @brief returns the dictionary an entry (and therefore its children) belongs to
+ * @param selector the dictionary selector of the entry (0 = schema, 1 = annotation)
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary
+ * @return annot_dict for annotation entries, schema_dict otherwise
  */
-static int unpack_integer_value(FILE* out, FILE* in) {
-    uint64_t val_len;
-    if (!unpack_nnint(in, &val_len)) return 0;
+static const bej_dictionary_t* selector_dict(const uint8_t selector,
+                                             const bej_dictionary_t* schema_dict,
+                                             const bej_dictionary_t* annot_dict) {
+    return selector ? annot_dict : schema_dict;
+}
 
-    int64_t value = 0;
-    uint8_t bytes[8];
-    if (val_len == 0 || val_len > 8 || fread(bytes, 1, val_len, in) != val_len) return 0;
+/**
+ * @brief resolves the dictionary entry of a property from its SFL sequence number
+ *
+ * Inside a schema set, a selector of 1 refers to the global annotation scope
+ * (the top-level entries of the annotation dictionary). Inside a set that is
+ * itself an annotation, both the parent and its members live in the annotation
+ * dictionary and are looked up in the parent's subset
+ *
+ * @param seq the full sequence number (with selector)
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary
+ * @param parent_selector the dictionary selector of the enclosing set
+ * @param child_ptr the child subset offset of the enclosing set
+ * @param child_count the child count of the enclosing set
+ * @param entry pointer to store the entry
+ * @param selector pointer to store the dictionary selector of the entry
+ * @return 1 on success, 0 if not found
+ */
+static int resolve_property(const uint64_t seq,
+                            const bej_dictionary_t* schema_dict,
+                            const bej_dictionary_t* annot_dict,
+                            const uint8_t parent_selector,
+                            const uint16_t child_ptr, const uint16_t child_count,
+                            bej_dict_entry_t* entry,
+                            uint8_t* selector) {
+    uint64_t seq_num;
+    decode_sequence_number(seq, &seq_num, selector);
+
+    if (*selector && !parent_selector) // annotation on a schema property
+        return annot_dict && bej_dict_find_annotation_by_seq(annot_dict, seq_num, entry);
+
+    return get_entry_by_seq(selector_dict(parent_selector, schema_dict, annot_dict),
+                            child_ptr, child_count, seq_num, entry);
+}
+
+/**
+ * @brief reads the SFL header of a member and splits off its payload
+ * @param in the cursor of the enclosing Set or Array payload
+ * @param seq pointer to store the full sequence number
+ * @param format pointer to store the format
+ * @param payload pointer to store the cursor over exactly the member's payload
+ * @return 1 on success, 0 on malformed input
+ */
+static int read_member(bej_cursor_t* in, uint64_t* seq, uint8_t* format, bej_cursor_t* payload) {
+    BEJ_STATS_ADD(properties, 1);
+    BEJ_STATS_TIME_BEGIN(started);
+    uint64_t length;
+    const int ok = bej_cursor_read_sfl(in, seq, format, &length) && bej_cursor_take(in, length, payload);
+    BEJ_STATS_TIME_END(sfl_ns, started);
+    return ok;
+}
+
+/**
+ * @brief takes bytes of the tree from the output budget of the decode
+ * @param ctx the builder state
+ * @param n the number of bytes
+ * @return 1 on success, 0 if the tree would get larger than bej_decode_limits_t::max_output
+ */
+static int charge_output(build_ctx_t* ctx, const size_t n) {
+    if (n > ctx->output_left) return 0;
+    ctx->output_left -= n;
+    return 1;
+}
+
+/**
+ * @brief creates a node of the built tree
+ * @param ctx the builder state
+ * @param type the type of the node
+ * @return the node, or NULL on allocation failure or when the output limit is reached
+ */
+static json_value_t* create_value(build_ctx_t* ctx, const json_type_t type) {
+    if (!charge_output(ctx, sizeof(json_value_t))) return NULL;
+    if (!ctx->arena) BEJ_STATS_ADD(allocations, 1);
+    return json_create_in(ctx->arena, type);
+}
+
+/**
+ * @brief reads an Integer payload
+ * @param in the payload cursor
+ * @param value pointer to store the sign-extended value
+ * @return 1 on success, 0 on failure
+ */
+static int read_integer_value(bej_cursor_t* in, int64_t* value) {
+    uint64_t val_len, raw;
+    if (!bej_cursor_read_nnint(in, &val_len)) return 0;
+    if (val_len == 0 || val_len > 8 || !bej_cursor_read_uint(in, (size_t)val_len, &raw)) return 0;
 
-    for (uint64_t i = 0; i < val_len; i++) {
-        value |= ((uint64_t)bytes[i] << (8 * i));
-    }
     // sign-extend if negative
-    if (val_len < sizeof(int64_t) && (bytes[val_len - 1] & 0x80)) {
-        const uint64_t shift = (sizeof(int64_t) - val_len) * 8;
-        value = (value << shift) >> shift;
-    }
-    fprintf(out, "%" PRId64, value);
+    const uint64_t shift = (sizeof(int64_t) - val_len) * 8;
+    *value = (int64_t)(raw << shift) >> shift;
     return 1;
 }
 
 /**
- * @brief unpacks a String payload from the stream and prints it as a JSON string
- * @param out the output stream to write the JSON string to
- * @param in the input stream to read the BEJ payload from
+ * @brief reads a String payload without copying it
+ * @param in the payload cursor
+ * @param str pointer to store the start of the characters (inside the BEJ buffer)
+ * @param len pointer to store the length without the null terminator
  * @return 1 on success, 0 on failure
  */
-static int unpack_string_value(FILE* out, FILE* in) {
+static int read_string_value(bej_cursor_t* in, const char** str, size_t* len) {
     uint64_t str_len;
-    if (!unpack_nnint(in, &str_len)) return 0;
-
-    if (str_len == 0) {
-        fprintf(out, "\"\"");
-        return 1;
-    }
-    char* buf = malloc(str_len);
-    if (!buf) return 0;
-    if (fread(buf, 1, str_len, in) != str_len) {
-        free(buf);
-        return 0;
-    }
-    buf[str_len - 1] = '\0'; // bej strings are null-terminated
-    fprintf(out, "\"%s\"", buf);
-    free(buf);
+    if (!bej_cursor_read_nnint(in, &str_len)) return 0;
+    *str = (const char*)in->pos;
+    if (!bej_cursor_skip(in, str_len)) return 0;
+    // bej strings are null-terminated, the terminator is not part of the value
+    *len = str_len ? (size_t)str_len - 1 : 0;
     return 1;
 }
 
 /**
- * @brief unpacks a Boolean payload from the stream and prints it as a JSON boolean
- * @param out the output stream to write the JSON boolean to
- * @param in the input stream to read the BEJ payload from
+ * @brief reads a Boolean payload
+ * @param in the payload cursor
+ * @param value pointer to store the value (0 or 1)
  * @return 1 on success, 0 on failure
  */
-static int unpack_boolean_value(FILE* out, FILE* in) {
+static int read_boolean_value(bej_cursor_t* in, int* value) {
     uint64_t bool_len;
-    if (!unpack_nnint(in, &bool_len) || bool_len != 1) return 0;
     uint8_t b;
-    if (fread(&b, 1, 1, in) != 1) return 0;
-    fprintf(out, b ? "true" : "false");
+    if (!bej_cursor_read_nnint(in, &bool_len) || bool_len != 1 || !bej_cursor_read_u8(in, &b)) return 0;
+    *value = b != 0;
     return 1;
 }
 
 /**
- * @brief unpacks an Enum payload from the stream and prints it as a JSON string
- * @param out the output stream to write the JSON string to
- * @param in the input stream to read the BEJ payload from
+ * @brief reads an Enum payload and resolves the option name
+ * @param in the payload cursor
  * @param dict the dictionary to find the enum value in
  * @param entry the dictionary entry for this Enum property
+ * @param name pointer to store the option name (inside the dictionary)
  * @return 1 on success, 0 on failure
  */
-static int unpack_enum_value(FILE* out, FILE* in,
-                             const bej_dictionary_t* dict,
-                             const bej_dict_entry_t* entry) {
-    uint64_t len, enum_val;
-    if (!unpack_nnint(in, &len) || !unpack_nnint(in, &enum_val)) return 0;
+static int read_enum_value(bej_cursor_t* in,
+                           const bej_dictionary_t* dict,
+                           const bej_dict_entry_t* entry,
+                           const char** name) {
+    uint64_t enum_val;
+    if (!bej_cursor_read_enum(in, &enum_val)) return 0;
 
-    bej_dict_stream_t stream;
-    bej_dict_stream_init_subset(&stream, dict, entry->child_pointer, entry->child_count);
     bej_dict_entry_t enum_entry;
-    while (bej_dict_stream_next(&stream, &enum_entry)) {
-        if (enum_entry.sequence == enum_val) {
-            fprintf(out, "\"%s\"", enum_entry.name);
-            return 1;
-        }
-    }
-    return 0;
+    if (!get_entry_by_seq(dict, entry->child_pointer, entry->child_count, enum_val, &enum_entry) ||
+        !enum_entry.name)
+        return 0;
+    *name = enum_entry.name;
+    return 1;
 }
 
 /**
- * @brief decodes an Array payload. Finds the element type and decodes each element in a loop
- * @param out the output stream
- * @param in the input stream containing the array payload
- * @param schema_dict the main schema dictionary
- * @param annot_dict the annotation dictionary
- * @param entry the dictionary entry for this Array property
- * @return 1 on success, 0 on failure
+ * @brief looks up the element entry of an Array: the single child of the array entry
+ * @param entry the dictionary entry for the Array property
+ * @param dict the dictionary holding the children
+ * @param element_entry pointer to store the element entry
+ * @return 1 if the array has an element definition, 0 otherwise
  */
-static int decode_array(FILE* out, FILE* in,
-                        const bej_dictionary_t* schema_dict,
-                        const bej_dictionary_t* annot_dict,
-                        const bej_dict_entry_t* entry) {
-    uint64_t count;
-    if (!unpack_nnint(in, &count)) return 0;
-    fprintf(out, "[");
+static int get_array_element_entry(const bej_dict_entry_t* entry,
+                                   const bej_dictionary_t* dict,
+                                   bej_dict_entry_t* element_entry) {
+    bej_dict_stream_t subset_stream;
+    bej_dict_stream_init_subset(&subset_stream, dict, entry->child_pointer, entry->child_count);
+    return bej_dict_stream_next(&subset_stream, element_entry);
+}
 
-    const bej_dictionary_t* dict_for_children = (entry->name[0] == '@') ? annot_dict : schema_dict;
+/**
+ * @brief builds a JSON number from an Integer payload
+ * @param ctx the builder state
+ * @param in the payload cursor
+ * @return a JSON_NUMBER value, or NULL on failure
+ */
+static json_value_t* build_integer(build_ctx_t* ctx, bej_cursor_t* in) {
+    int64_t value;
+    if (!read_integer_value(in, &value)) return NULL;
 
-    bej_dict_stream_t subset_stream;
-    bej_dict_stream_init_subset(&subset_stream, dict_for_children,
-                                entry->child_pointer, entry->child_count);
-    bej_dict_entry_t element_entry;
-    if (!bej_dict_stream_next(&subset_stream, &element_entry)) {
-        fprintf(out, "]");
-        return 1; // array with no element type definition
+    json_value_t* number = create_value(ctx, JSON_NUMBER);
+    if (number) number->data.number = (double)value;
+    return number;
+}
+
+/**
+ * @brief builds a JSON string from characters of a String or Enum payload
+ *
+ * While borrowing, terminated characters are pointed to instead of copied
+ *
+ * @param ctx the builder state
+ * @param str the characters
+ * @param len the number of characters
+ * @param terminated 1 if `str[len]` is a null terminator that outlives the tree
+ * @return a JSON_STRING value, or NULL on failure
+ */
+static json_value_t* build_string(build_ctx_t* ctx, const char* str, const size_t len, const int terminated) {
+    if (ctx->borrow && terminated) {
+        if (!charge_output(ctx, sizeof(json_value_t))) return NULL;
+        if (!ctx->arena) BEJ_STATS_ADD(allocations, 1);
+        return json_create_borrowed_string_in(ctx->arena, str);
+    }
+
+    if (!charge_output(ctx, len + 1)) return NULL;
+    char* copy = json_strndup_in(ctx->arena, str, len);
+    if (!copy) return NULL;
+    if (!ctx->arena) BEJ_STATS_ADD(allocations, 1);
+
+    json_value_t* value = create_value(ctx, JSON_STRING);
+    if (!value) {
+        if (!ctx->arena) free(copy);
+        return NULL;
     }
+    value->data.string = copy;
+    return value;
+}
+
+/**
+ * @brief an Enum option resolved by an array decode
+ */
+typedef struct {
+    uint64_t option;  /**< sequence number of the option */
+    const char* name; /**< option name (inside the dictionary), NULL while unresolved */
+    size_t len;       /**< length of `name` */
+    char* copy;       /**< copy of the name shared by the arena items, or NULL */
+} enum_option_t;
+
+/**
+ * @brief tells whether Array elements of a format take the scalar fast path
+ * @param format the format of the element entry
+ * @return 1 for Integer, Boolean and Enum
+ */
+static int scalar_element_format(const uint8_t format) {
+    return format == BEJ_FORMAT_INTEGER || format == BEJ_FORMAT_BOOLEAN || format == BEJ_FORMAT_ENUM;
+}
+
+/**
+ * @brief builds the items of an Array of Integers, Booleans or Enums in one tight loop
+ *
+ * The items table is sized from the count up front, element SFLs are read
+ * in line and every Enum option is looked up once per array. In an arena
+ * the items share one copy of each option name
+ *
+ * @param ctx the builder state
+ * @param in the payload cursor, positioned after the count
+ * @param count the element count
+ * @param element_entry the element entry
+ * @param selector the dictionary selector of the Array property
+ * @param array the JSON_ARRAY to fill (empty)
+ * @return 1 on success, 0 on failure (the items built so far stay in the array)
+ */
+static int build_scalar_items(build_ctx_t* ctx, bej_cursor_t* in, const uint64_t count,
+                              const bej_dict_entry_t* element_entry, const uint8_t selector,
+                              json_value_t* array) {
+    // every element takes several bytes, a larger count is malformed
+    if (count > bej_cursor_remaining(in) || !json_array_reserve_in(ctx->arena, array, (size_t)count)) return 0;
+
+    const bej_dictionary_t* dict = selector_dict(selector, ctx->schema_dict, ctx->annot_dict);
+    const uint8_t format = element_entry->format;
+    const json_type_t type = format == BEJ_FORMAT_INTEGER ? JSON_NUMBER :
+                             format == BEJ_FORMAT_BOOLEAN ? JSON_BOOL : JSON_STRING;
+    json_array_t* items = &array->data.array;
+    enum_option_t options[BEJ_ENUM_OPTION_CACHE]; // slot i holds option i once its bit in `cached` is set
+    enum_option_t spare = {.name = NULL};         // the last option beyond the table
+    uint64_t cached = 0;
 
-    // decode each element in the array
+    BEJ_STATS_ADD(properties, count);
     for (uint64_t i = 0; i < count; i++) {
-        uint64_t elem_seq, elem_len;
+        uint64_t seq, length;
         uint8_t elem_fmt;
-        if (unpack_sfl(in, &elem_seq, &elem_fmt, &elem_len) == 0) return 0;
+        bej_cursor_t payload;
+        if (!bej_cursor_read_sfl(in, &seq, &elem_fmt, &length) || !bej_cursor_take(in, length, &payload)) return 0;
 
-        decode_value(out, in, schema_dict, annot_dict, &element_entry, elem_len);
-        if (i < count - 1) fprintf(out, ",");
-    }
+        // appended before it is filled, so a failure leaves it to json_free(array)
+        json_value_t* item = create_value(ctx, type);
+        if (!item) return 0;
+        items->items[items->count++] = item;
 
-    fprintf(out, "]");
+        switch (format) {
+        case BEJ_FORMAT_INTEGER: {
+            int64_t value;
+            if (!read_integer_value(&payload, &value)) return 0;
+            item->data.number = (double)value;
+            break;
+        }
+        case BEJ_FORMAT_BOOLEAN: {
+            int value;
+            if (!read_boolean_value(&payload, &value)) return 0;
+            item->data.boolean = value;
+            break;
+        }
+        default: {
+            uint64_t option;
+            if (!bej_cursor_read_enum(&payload, &option)) return 0;
+            enum_option_t* slot = option < BEJ_ENUM_OPTION_CACHE ? &options[option] : &spare;
+            const uint64_t bit = option < BEJ_ENUM_OPTION_CACHE ? (uint64_t)1 << option : 0;
+            if (!(cached & bit) && (slot != &spare || !spare.name || spare.option != option)) {
+                bej_dict_entry_t option_entry;
+                if (!get_entry_by_seq(dict, element_entry->child_pointer, element_entry->child_count, option,
+                                      &option_entry) || !option_entry.name)
+                    return 0;
+                *slot = (enum_option_t){.option = option, .name = option_entry.name,
+                                        .len = strlen(option_entry.name), .copy = NULL};
+                cached |= bit;
+            }
+            if (ctx->borrow) {
+                item->flags |= JSON_FLAG_BORROWED;
+                item->data.string = (char*)slot->name; // dictionary names outlive the tree by contract
+                break;
+            }
+            // arena strings are never freed one by one, equal options can share one copy
+            char* copy = ctx->arena ? slot->copy : NULL;
+            if (!copy) {
+                if (!charge_output(ctx, slot->len + 1)) return 0;
+                copy = json_strndup_in(ctx->arena, slot->name, slot->len);
+                if (!copy) return 0;
+                if (!ctx->arena) BEJ_STATS_ADD(allocations, 1);
+                slot->copy = copy;
+            }
+            item->data.string = copy;
+            break;
+        }
+        }
+    }
     return 1;
 }
 
 /**
- * @brief decodes a Set (object) payload by recursively calling the main stream decoder for its properties
- * @param out the output stream
- * @param in the input stream containing the set payload
- * @param schema_dict the main schema dictionary
- * @param annot_dict the annotation dictionary
- * @param entry the dictionary entry for this Set property
- * @return 1 on success, 0 on failure
+ * @brief builds a scalar value: an Integer, String, Boolean, Enum or Null
+ * @param ctx the builder state
+ * @param in the cursor over exactly the property's payload
+ * @param entry the dictionary entry for the property being decoded
+ * @param selector the dictionary selector of the property
+ * @param skipped set to 1 when the format is not supported and the payload was skipped
+ * @return the built value, or NULL on failure or when skipped
  */
-static int decode_set(FILE* out, FILE* in,
-                      const bej_dictionary_t* schema_dict,
-                      const bej_dictionary_t* annot_dict,
-                      const bej_dict_entry_t* entry) {
+static json_value_t* build_scalar(build_ctx_t* ctx, bej_cursor_t* in,
+                                  const bej_dict_entry_t* entry,
+                                  const uint8_t selector,
+                                  int* skipped) {
+    switch (entry->format) {
+    case BEJ_FORMAT_INTEGER:
+        return build_integer(ctx, in);
+    case BEJ_FORMAT_STRING: {
+        const char* str;
+        size_t len;
+        if (!read_string_value(in, &str, &len)) return NULL;
+        // an empty String may have no bytes at all, a literal stands in for its terminator
+        if (str == (const char*)in->pos) return build_string(ctx, "", 0, 1);
+        return build_string(ctx, str, len, str[len] == '\0');
+    }
+    case BEJ_FORMAT_BOOLEAN: {
+        int b;
+        if (!read_boolean_value(in, &b)) return NULL;
+        json_value_t* value = create_value(ctx, JSON_BOOL);
+        if (value) value->data.boolean = b;
+        return value;
+    }
+    case BEJ_FORMAT_ENUM: {
+        const char* name;
+        if (!read_enum_value(in, selector_dict(selector, ctx->schema_dict, ctx->annot_dict), entry, &name))
+            return NULL;
+        return build_string(ctx, name, strlen(name), 1);
+    }
+    case BEJ_FORMAT_NULL:
+        return create_value(ctx, JSON_NULL);
+    default:
+        *skipped = 1; // the payload cursor is discarded by the caller
+        return NULL;
+    }
+}
+
+/**
+ * @brief creates the JSON value of a Set or Array and prepares the frame that fills it
+ *
+ * An Array of Integers, Booleans or Enums is filled right away, as is an
+ * Array without an element definition (it stays empty); their frame has no
+ * members left
+ *
+ * @param ctx the builder state
+ * @param in the cursor over exactly the container's payload
+ * @param entry the dictionary entry for the Set or Array property
+ * @param selector the dictionary selector of the property
+ * @param level the nesting level of the container (the root Set is 1)
+ * @param frame pointer to store the frame
+ * @return the JSON_OBJECT or JSON_ARRAY, or NULL on failure or beyond the depth limit
+ */
+static json_value_t* open_container(build_ctx_t* ctx, bej_cursor_t* in,
+                                    const bej_dict_entry_t* entry,
+                                    const uint8_t selector, const size_t level,
+                                    build_frame_t* frame) {
     uint64_t count;
-    if (!unpack_nnint(in, &count)) return 0;
-    fprintf(out, "{");
+    if (level > ctx->max_depth || !bej_cursor_read_nnint(in, &count)) return NULL;
 
-    const bej_dictionary_t* dict_for_children = (entry->name[0] == '@') ? annot_dict : schema_dict;
+    json_value_t* container = create_value(ctx, entry->format == BEJ_FORMAT_SET ? JSON_OBJECT : JSON_ARRAY);
+    if (!container) return NULL;
+    if (ctx->borrow && entry->format == BEJ_FORMAT_SET) container->flags |= JSON_FLAG_BORROWED; // keys are dictionary names
+    *frame = (build_frame_t){.in = *in, .remaining = count, .container = container, .entry = *entry,
+                             .selector = selector};
+    if (entry->format == BEJ_FORMAT_SET) return container;
 
-    if (count > 0) {
-        // recursively decode the inner properties
-        bej_decode_stream_internal(out, in, schema_dict, annot_dict,
-                                   dict_for_children, entry->child_pointer, entry->child_count,
-                                   count, 1);
+    if (!get_array_element_entry(entry, selector_dict(selector, ctx->schema_dict, ctx->annot_dict),
+                                 &frame->entry)) {
+        frame->remaining = 0;
+        return container; // array with no element type definition
     }
+    if (scalar_element_format(frame->entry.format)) {
+        if (!build_scalar_items(ctx, &frame->in, count, &frame->entry, selector, container)) {
+            json_free(container);
+            return NULL;
+        }
+        frame->remaining = 0;
+    }
+    return container;
+}
 
-    fprintf(out, "}");
+/**
+ * @brief makes room for one more frame of the tree builder
+ * @param ctx the builder state
+ * @param depth the number of frames in use
+ * @return 1 on success, 0 on allocation failure
+ */
+static int reserve_frame(build_ctx_t* ctx, const size_t depth) {
+    if (depth < ctx->frame_capacity) return 1;
+
+    const size_t new_capacity = ctx->frame_capacity ? ctx->frame_capacity * 2 : BEJ_BUILD_STACK_FRAMES;
+    build_frame_t* new_frames = ctx->frames_on_heap ? realloc(ctx->frames, new_capacity * sizeof(*new_frames))
+                                                    : malloc(new_capacity * sizeof(*new_frames));
+    if (!new_frames) return 0;
+    BEJ_STATS_ADD(allocations, 1);
+    if (!ctx->frames_on_heap && depth) memcpy(new_frames, ctx->frames, depth * sizeof(*new_frames));
+    ctx->frames = new_frames;
+    ctx->frame_capacity = new_capacity;
+    ctx->frames_on_heap = 1;
     return 1;
 }
 
 /**
- * @brief the central dispatcher function. Decodes a single property's value based on its format
- * @param out the output stream
- * @param in the input stream, positioned at the start of the property's payload
- * @param schema_dict the main schema dictionary
- * @param annot_dict the annotation dictionary
+ * @brief fills a container and every container below it, without recursion
+ *
+ * A nested Set or Array is appended to its parent as soon as it is created
+ * and its frame is pushed; the frame is popped once its last member is
+ * built. On failure every node built so far is reachable from the outer
+ * container, so freeing it frees them
+ *
+ * @param ctx the builder state
+ * @param outer the frame of the outer container, as prepared by open_container()
+ * @param level the nesting level of the outer container (the root Set is 1)
+ * @return 1 on success, 0 on malformed input, allocation failure or a limit
+ */
+static int build_members(build_ctx_t* ctx, const build_frame_t* outer, const size_t level) {
+    if (!outer->remaining) return 1;
+    if (!reserve_frame(ctx, 0)) return 0;
+    ctx->frames[0] = *outer;
+    size_t top = 0;
+
+    for (;;) {
+        build_frame_t* frame = &ctx->frames[top];
+        if (!frame->remaining) {
+            if (top == 0) return 1;
+            top--;
+            continue;
+        }
+        frame->remaining--;
+
+        uint64_t seq;
+        uint8_t format;
+        bej_cursor_t payload;
+        bej_dict_entry_t child;
+        uint8_t child_selector;
+        const int in_array = frame->container->type == JSON_ARRAY;
+        if (!read_member(&frame->in, &seq, &format, &payload)) return 0;
+        if (in_array) {
+            child = frame->entry;
+            child_selector = frame->selector;
+        } else if (!resolve_property(seq, ctx->schema_dict, ctx->annot_dict, frame->selector,
+                                     frame->entry.child_pointer, frame->entry.child_count,
+                                     &child, &child_selector) || !child.name) {
+            return 0;
+        }
+
+        json_value_t* value;
+        build_frame_t inner;
+        const int nested = child.format == BEJ_FORMAT_SET || child.format == BEJ_FORMAT_ARRAY;
+        if (nested) {
+            value = open_container(ctx, &payload, &child, child_selector, level + top + 1, &inner);
+        } else {
+            int skipped = 0;
+            value = build_scalar(ctx, &payload, &child, child_selector, &skipped);
+            if (skipped) continue;
+        }
+        if (!value || !(in_array ? json_array_append_in(ctx->arena, frame->container, value)
+                                 : json_object_append_in(ctx->arena, frame->container, child.name, value))) {
+            json_free(value);
+            return 0;
+        }
+
+        if (nested && inner.remaining) {
+            if (!reserve_frame(ctx, top + 1)) return 0;
+            ctx->frames[++top] = inner;
+        }
+    }
+}
+
+/**
+ * @brief the central dispatcher of the tree builder. Builds a single property's value based on its format
+ * @param ctx the builder state
+ * @param in the cursor over exactly the property's payload
  * @param entry the dictionary entry for the property being decoded
- * @param length the total length of the payload to be consumed
+ * @param selector the dictionary selector of the property
+ * @param level the nesting level of the value (the root Set is 1)
+ * @param skipped set to 1 when the format is not supported and the payload was skipped
+ * @return the built value, or NULL on failure or when skipped
+ */
+static json_value_t* build_value(build_ctx_t* ctx, bej_cursor_t* in,
+                                 const bej_dict_entry_t* entry,
+                                 const uint8_t selector, const size_t level,
+                                 int* skipped) {
+    if (entry->format != BEJ_FORMAT_SET && entry->format != BEJ_FORMAT_ARRAY)
+        return build_scalar(ctx, in, entry, selector, skipped);
+
+    build_frame_t frame;
+    json_value_t* container = open_container(ctx, in, entry, selector, level, &frame);
+    if (container && !build_members(ctx, &frame, level)) {
+        json_free(container);
+        return NULL;
+    }
+    return container;
+}
+
+/**
+ * @brief state of a bound decode
+ */
+typedef struct {
+    const bej_binding_t* binding; /**< the compiled binding */
+    uint8_t* object;              /**< the struct being filled */
+    uint64_t present;             /**< mask of the fields found so far */
+} bound_ctx_t;
+
+/**
+ * @brief stores a bound value into its struct member
+ * @param ctx the bound decode state
+ * @param node the field node
+ * @param in the payload cursor
+ * @return 1 on success, 0 on malformed input
+ */
+static int decode_bound_field(bound_ctx_t* ctx, const bej_bind_node_t* node, bej_cursor_t* in) {
+    const bej_bind_field_t* field = &ctx->binding->fields[node->field];
+    uint8_t* member = ctx->object + field->offset;
+
+    // members may be unaligned in packed structs, copy them in
+    switch (field->format) {
+    case BEJ_FORMAT_INTEGER: {
+        int64_t value;
+        if (!read_integer_value(in, &value)) return 0;
+        memcpy(member, &value, sizeof(value));
+        break;
+    }
+    case BEJ_FORMAT_STRING: {
+        const char* str;
+        size_t len;
+        // the member points into the BEJ buffer, so the terminator must be there
+        if (!read_string_value(in, &str, &len) || str == (const char*)in->pos || str[len] != '\0') return 0;
+        memcpy(member, &str, sizeof(str));
+        break;
+    }
+    case BEJ_FORMAT_BOOLEAN: {
+        int value;
+        if (!read_boolean_value(in, &value)) return 0;
+        memcpy(member, &value, sizeof(value));
+        break;
+    }
+    case BEJ_FORMAT_ENUM: {
+        uint64_t enum_val;
+        bej_dict_entry_t option;
+        if (!bej_cursor_read_enum(in, &enum_val) ||
+            !get_entry_by_seq(selector_dict(node->selector, ctx->binding->schema_dict, ctx->binding->annot_dict),
+                              node->entry.child_pointer, node->entry.child_count, enum_val, &option))
+            return 0;
+        const int value = (int)enum_val; // bej_cursor_read_enum() keeps options to 16 bits
+        memcpy(member, &value, sizeof(value));
+        break;
+    }
+    default:
+        return 0;
+    }
+
+    ctx->present |= (uint64_t)1 << node->field;
+    return 1;
+}
+
+/**
+ * @brief fills the struct from the members of a bound Set, skipping unbound members by length
+ * @param ctx the bound decode state
+ * @param set the Set node
+ * @param in the Set payload cursor
+ * @return 1 on success, 0 on malformed input or a format that does not match the binding
+ */
+static int decode_bound_set(bound_ctx_t* ctx, const uint32_t set, bej_cursor_t* in) {
+    const bej_bind_node_t* nodes = ctx->binding->nodes;
+    uint64_t count;
+    if (!bej_cursor_read_nnint(in, &count)) return 0;
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t seq;
+        uint8_t format;
+        bej_cursor_t payload;
+        if (!read_member(in, &seq, &format, &payload))
+            return 0;
+
+        uint32_t c = nodes[set].first_child;
+        while (c != BEJ_BIND_NONE && nodes[c].seq != seq)
+            c = nodes[c].next_sibling;
+        if (c == BEJ_BIND_NONE || format == BEJ_FORMAT_NULL)
+            continue; // unbound subtree or null value, never read
+        if (format != nodes[c].entry.format)
+            return 0;
+
+        const int ok = nodes[c].field == BEJ_BIND_NONE ? decode_bound_set(ctx, c, &payload)
+                                                       : decode_bound_field(ctx, &nodes[c], &payload);
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief an open Set or Array of a streaming decode
+ */
+struct bej_decode_frame {
+    bej_dict_entry_t entry;   /**< dictionary entry of the container (format SET or ARRAY) */
+    bej_dict_entry_t element; /**< element entry of an Array */
+    uint64_t end;             /**< input offset where the container payload ends */
+    uint64_t remaining;       /**< members still to decode */
+    uint64_t index;           /**< members decoded so far */
+    uint8_t selector;         /**< dictionary selector of the container */
+};
+
+/**
+ * @brief states of the streaming decoder
+ */
+enum {
+    DEC_HEADER = 0,    /**< the 7-byte BEJ header */
+    DEC_SFL_SEQ,       /**< sequence nnint of an SFL */
+    DEC_SFL_FORMAT,    /**< format byte of an SFL */
+    DEC_SFL_LENGTH,    /**< length nnint of an SFL */
+    DEC_COUNT,         /**< member count of a Set or Array */
+    DEC_INT_LENGTH,    /**< width nnint of an Integer */
+    DEC_INT_BYTES,     /**< value bytes of an Integer */
+    DEC_STRING_LENGTH, /**< length nnint of a String */
+    DEC_STRING_BYTES,  /**< characters of a String */
+    DEC_BOOL_LENGTH,   /**< length nnint of a Boolean */
+    DEC_BOOL_BYTE,     /**< value byte of a Boolean */
+    DEC_ENUM_LENGTH,   /**< length nnint of an Enum */
+    DEC_ENUM_VALUE,    /**< option nnint of an Enum */
+    DEC_SKIP,          /**< unread payload bytes up to `skip_to` */
+    DEC_MEMBER_DONE,   /**< a member of the innermost container is complete (no input) */
+    DEC_CLOSE,         /**< the innermost container is complete (no input) */
+    DEC_DONE           /**< the root Set is complete, input is ignored */
+};
+
+/**
+ * @brief appends JSON text to the output of the current feed call
+ * @param dec the decoder
+ * @param data the characters
+ * @param size the number of characters
+ */
+static void stream_emit(bej_stream_decoder_t* dec, const char* data, const size_t size) {
+    if (!json_writer_raw(&dec->text, data, size)) dec->failed = 1;
+}
+
+/**
+ * @brief appends a quoted, escaped dictionary name (property or enum option)
+ * @param dec the decoder
+ * @param name the null-terminated name
+ */
+static void stream_emit_name(bej_stream_decoder_t* dec, const char* name) {
+    if (!json_writer_string(&dec->text, name, strlen(name))) dec->failed = 1;
+}
+
+/**
+ * @brief passes the text of the current feed call to the write callback
+ * @param dec the decoder
+ */
+static void stream_flush(bej_stream_decoder_t* dec) {
+    if (!dec->failed && dec->text.size) {
+        BEJ_STATS_ADD(bytes_out, dec->text.size);
+        dec->written += dec->text.size;
+        BEJ_STATS_TIME_BEGIN(started);
+        if (!dec->write(dec->write_ctx, dec->text.data, dec->text.size)) dec->failed = 1;
+        BEJ_STATS_TIME_END(io_ns, started);
+    }
+    dec->text.size = 0;
+}
+
+/**
+ * @brief accounts for consumed input, failing if it runs past the innermost payload
+ * @param dec the decoder
+ * @param n the number of bytes
  * @return 1 on success, 0 on failure
  */
-static int decode_value(FILE* out, FILE* in,
-                        const bej_dictionary_t* schema_dict,
-                        const bej_dictionary_t* annot_dict,
-                        const bej_dict_entry_t* entry,
-                        const uint64_t length) {
-    switch (entry->format) {
+static int stream_consume(bej_stream_decoder_t* dec, const uint64_t n) {
+    if (n > dec->limit - dec->offset) {
+        dec->failed = 1;
+        return 0;
+    }
+    dec->offset += n;
+    return 1;
+}
+
+/**
+ * @brief reads an nnint that may be split across chunks
+ * @param dec the decoder
+ * @param p the input position, advanced past the consumed bytes
+ * @param end the end of the input chunk
+ * @param value pointer to store the value once it is complete
+ * @return 1 once the nnint is complete, 0 if more input is needed or on failure
+ */
+static int stream_nnint(bej_stream_decoder_t* dec, const uint8_t** p, const uint8_t* end, uint64_t* value) {
+    while (*p < end) {
+        if (!stream_consume(dec, 1)) return 0;
+        const uint8_t b = *(*p)++;
+        if (dec->nnint_width < 0) {
+            if (b > 8) {
+                dec->failed = 1;
+                return 0;
+            }
+            dec->nnint_width = b;
+            dec->nnint_read = 0;
+            dec->nnint_value = 0;
+        } else {
+            dec->nnint_value |= (uint64_t)b << (8 * dec->nnint_read++);
+        }
+        if (dec->nnint_read == dec->nnint_width) {
+            *value = dec->nnint_value;
+            dec->nnint_width = -1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief finishes the current value, the rest of its payload is skipped
+ * @param dec the decoder
+ */
+static void stream_value_done(bej_stream_decoder_t* dec) {
+    dec->skip_to = dec->limit;
+    dec->resume = DEC_MEMBER_DONE;
+    dec->state = DEC_SKIP;
+}
+
+/**
+ * @brief resolves the member whose SFL was just read and starts decoding its value
+ * @param dec the decoder
+ * @param length the payload length from the SFL
+ */
+static void stream_begin_value(bej_stream_decoder_t* dec, const uint64_t length) {
+    BEJ_STATS_ADD(properties, 1);
+    if (length > dec->limit - dec->offset) {
+        dec->failed = 1;
+        return;
+    }
+
+    if (dec->depth == 0) {
+        // the entire payload is one large SET
+        bej_dict_stream_t ds;
+        bej_dict_stream_init(&ds, dec->schema_dict);
+        if (dec->entry.format != BEJ_FORMAT_SET || !bej_dict_stream_next(&ds, &dec->entry)) {
+            dec->failed = 1;
+            return;
+        }
+        dec->entry.format = BEJ_FORMAT_SET;
+        dec->selector = 0;
+    } else {
+        const bej_decode_frame_t* parent = &dec->frames[dec->depth - 1];
+        if (parent->index > 0) stream_emit(dec, ",", 1);
+
+        if (parent->entry.format == BEJ_FORMAT_ARRAY) {
+            dec->entry = parent->element;
+            dec->selector = parent->selector;
+        } else {
+            if (!resolve_property(dec->seq, dec->schema_dict, dec->annot_dict, parent->selector,
+                                  parent->entry.child_pointer, parent->entry.child_count,
+                                  &dec->entry, &dec->selector) || !dec->entry.name) {
+                // a member without a name has no key to write, the tree builder rejects it too
+                dec->failed = 1;
+                return;
+            }
+            stream_emit_name(dec, dec->entry.name);
+            stream_emit(dec, ":", 1);
+        }
+    }
+    dec->limit = dec->offset + length;
+
+    switch (dec->entry.format) {
     case BEJ_FORMAT_SET:
-        return decode_set(out, in, schema_dict, annot_dict, entry);
     case BEJ_FORMAT_ARRAY:
-        return decode_array(out, in, schema_dict, annot_dict, entry);
+        dec->state = DEC_COUNT;
+        break;
     case BEJ_FORMAT_INTEGER:
-        return unpack_integer_value(out, in);
+        dec->state = DEC_INT_LENGTH;
+        break;
     case BEJ_FORMAT_STRING:
-        return unpack_string_value(out, in);
+        dec->state = DEC_STRING_LENGTH;
+        break;
     case BEJ_FORMAT_BOOLEAN:
-        return unpack_boolean_value(out, in);
+        dec->state = DEC_BOOL_LENGTH;
+        break;
     case BEJ_FORMAT_ENUM:
-        {
-            const bej_dictionary_t* dict_to_use = (entry->name[0] == '@') ? annot_dict : schema_dict;
-            return unpack_enum_value(out, in, dict_to_use, entry);
-        }
+        dec->state = DEC_ENUM_LENGTH;
+        break;
     case BEJ_FORMAT_NULL:
-        fprintf(out, "null");
-        return 1;
+        stream_emit(dec, "null", 4);
+        stream_value_done(dec);
+        break;
     default:
-        fseek(in, length, SEEK_CUR); // skip unknown types
-        return 1;
+        stream_value_done(dec); // skip unknown types
     }
 }
 
 /**
- * @brief the main recursive function. Decodes a sequence of properties within a Set
- * @param output_stream the main output stream
- * @param input_stream the main input stream
- * @param schema_dict the main schema dictionary
- * @param annot_dict the annotation dictionary
- * @param current_dict the dictionary for the current context (either schema_dict or annot_dict)
- * @param child_ptr the starting index for the property lookup in the current context
- * @param child_count the number of properties in the current context
- * @param prop_count the number of properties to decode from the stream
- * @param add_name flag indicating whether to print property names (true for objects, false for arrays)
- * @return 1 on success, 0 on failure
+ * @brief opens a Set or Array once its member count has been read
+ * @param dec the decoder
+ * @param count the member count
  */
-static int bej_decode_stream_internal(FILE* output_stream, FILE* input_stream,
-                                      const bej_dictionary_t* schema_dict,
-                                      const bej_dictionary_t* annot_dict,
-                                      const bej_dictionary_t* current_dict,
-                                      const uint16_t child_ptr,
-                                      const uint16_t child_count,
-                                      const uint64_t prop_count,
-                                      const int add_name) {
-    for (uint64_t i = 0; i < prop_count; i++) {
-        uint64_t seq, length;
-        uint8_t format;
-        if (unpack_sfl(input_stream, &seq, &format, &length) == 0) return 0;
+static void stream_push_frame(bej_stream_decoder_t* dec, uint64_t count) {
+    if (dec->depth == dec->max_depth) {
+        dec->failed = 1;
+        return;
+    }
+    if (dec->depth == dec->frame_capacity) {
+        const size_t new_capacity = dec->frame_capacity ? dec->frame_capacity * 2 : 16;
+        bej_decode_frame_t* new_frames = realloc(dec->frames, new_capacity * sizeof(*new_frames));
+        if (!new_frames) {
+            dec->failed = 1;
+            return;
+        }
+        BEJ_STATS_ADD(allocations, 1);
+        dec->frames = new_frames;
+        dec->frame_capacity = new_capacity;
+    }
 
-        uint64_t seq_num;
-        uint8_t selector;
-        decode_sequence_number(seq, &seq_num, &selector);
+    bej_decode_frame_t* frame = &dec->frames[dec->depth++];
+    frame->entry = dec->entry;
+    frame->selector = dec->selector;
+    frame->end = dec->limit;
+    frame->index = 0;
 
-        bej_dict_entry_t entry;
-        if (selector == 0) { // search in schema context
-            if (!get_entry_by_seq(current_dict, child_ptr, child_count, seq_num, &entry)) return 0;
-        } else { // search in annotation dictionary (globally)
-            if (!get_entry_by_seq(annot_dict, 0, annot_dict->size, seq_num, &entry)) return 0;
-        }
+    if (frame->entry.format == BEJ_FORMAT_ARRAY) {
+        stream_emit(dec, "[", 1);
+        if (!get_array_element_entry(&frame->entry, selector_dict(frame->selector, dec->schema_dict, dec->annot_dict),
+                                     &frame->element))
+            count = 0; // array with no element type definition
+    } else {
+        stream_emit(dec, "{", 1);
+    }
+    frame->remaining = count;
 
-        if (add_name) {
-            decode_name(&entry, output_stream);
-        }
+    if (count) {
+        dec->state = DEC_SFL_SEQ;
+    } else {
+        dec->skip_to = frame->end;
+        dec->resume = DEC_CLOSE;
+        dec->state = DEC_SKIP;
+    }
+}
 
-        if (!decode_value(output_stream, input_stream, schema_dict, annot_dict, &entry, length)) return 0;
+void bej_stream_decoder_init(bej_stream_decoder_t* dec,
+                             const bej_dictionary_t* schema_dict,
+                             const bej_dictionary_t* annot_dict,
+                             const bej_write_fn write, void* write_ctx) {
+    memset(dec, 0, sizeof(*dec));
+    dec->schema_dict = schema_dict;
+    dec->annot_dict = annot_dict;
+    dec->write = write;
+    dec->write_ctx = write_ctx;
+    dec->state = DEC_HEADER;
+    dec->limit = UINT64_MAX;
+    dec->nnint_width = -1;
+    dec->max_depth = BEJ_DECODE_MAX_DEPTH;
+    dec->max_output = UINT64_MAX;
+    dec->failed = !schema_dict || !write;
+    json_writer_init(&dec->text, JSON_WRITE_COMPACT);
+}
+
+void bej_stream_decoder_set_limits(bej_stream_decoder_t* dec, const bej_decode_limits_t* limits) {
+    dec->max_depth = limit_depth(limits);
+    dec->max_output = limit_output(limits);
+}
 
-        if (i < prop_count - 1) {
-            fprintf(output_stream, ",");
+/**
+ * @brief runs the state machine over one input chunk
+ * @param dec the decoder
+ * @param data the input bytes
+ * @param size the number of bytes
+ * @return 1 once the chunk is consumed, 0 on failure
+ */
+static int stream_decode_chunk(bej_stream_decoder_t* dec, const uint8_t* data, const size_t size) {
+    const uint8_t* p = data;
+    const uint8_t* const end = data + size;
+    uint64_t value;
+
+    while (!dec->failed) {
+        // the text of a step counts against the output limit before the next step runs
+        if (dec->text.size > dec->max_output - dec->written) {
+            dec->failed = 1;
+            break;
+        }
+        switch (dec->state) {
+        case DEC_HEADER: {
+            // skip 7-byte BEJ header
+            const size_t n = (size_t)(end - p) < BEJ_HEADER_SIZE - dec->offset ?
+                (size_t)(end - p) : (size_t)(BEJ_HEADER_SIZE - dec->offset);
+            p += n;
+            dec->offset += n;
+            if (dec->offset < BEJ_HEADER_SIZE) return 1;
+            dec->state = DEC_SFL_SEQ;
+            break;
+        }
+        case DEC_SFL_SEQ:
+            if (!stream_nnint(dec, &p, end, &dec->seq)) return !dec->failed;
+            dec->state = DEC_SFL_FORMAT;
+            break;
+        case DEC_SFL_FORMAT:
+            if (p == end) return 1;
+            if (!stream_consume(dec, 1)) break;
+            dec->entry.format = (uint8_t)(*p++ >> 4); // only checked for the root
+            dec->state = DEC_SFL_LENGTH;
+            break;
+        case DEC_SFL_LENGTH:
+            if (!stream_nnint(dec, &p, end, &value)) return !dec->failed;
+            stream_begin_value(dec, value);
+            break;
+        case DEC_COUNT:
+            if (!stream_nnint(dec, &p, end, &value)) return !dec->failed;
+            stream_push_frame(dec, value);
+            break;
+        case DEC_INT_LENGTH:
+            if (!stream_nnint(dec, &p, end, &value)) return !dec->failed;
+            if (value == 0 || value > 8) {
+                dec->failed = 1;
+                break;
+            }
+            dec->value_width = dec->value_left = value;
+            dec->value_bits = 0;
+            dec->state = DEC_INT_BYTES;
+            break;
+        case DEC_INT_BYTES:
+            if (p == end) return 1;
+            if (!stream_consume(dec, 1)) break;
+            dec->value_bits |= (uint64_t)*p++ << (8 * (dec->value_width - dec->value_left));
+            if (--dec->value_left == 0) {
+                // sign-extend if negative
+                const uint64_t shift = (sizeof(int64_t) - dec->value_width) * 8;
+                if (!json_writer_int(&dec->text, (int64_t)(dec->value_bits << shift) >> shift)) dec->failed = 1;
+                stream_value_done(dec);
+            }
+            break;
+        case DEC_STRING_LENGTH:
+            if (!stream_nnint(dec, &p, end, &dec->value_left)) return !dec->failed;
+            stream_emit(dec, "\"", 1);
+            if (dec->value_left == 0) {
+                stream_emit(dec, "\"", 1);
+                stream_value_done(dec);
+            } else {
+                dec->state = DEC_STRING_BYTES;
+            }
+            break;
+        case DEC_STRING_BYTES: {
+            if (p == end) return 1;
+            const size_t n = (uint64_t)(end - p) < dec->value_left ? (size_t)(end - p) : (size_t)dec->value_left;
+            if (!stream_consume(dec, n)) break;
+            // bej strings are null-terminated, the terminator is not part of the value
+            if (!json_writer_escaped(&dec->text, (const char*)p, n == dec->value_left ? n - 1 : n)) dec->failed = 1;
+            p += n;
+            dec->value_left -= n;
+            if (dec->value_left == 0) {
+                stream_emit(dec, "\"", 1);
+                stream_value_done(dec);
+            }
+            break;
+        }
+        case DEC_BOOL_LENGTH:
+            if (!stream_nnint(dec, &p, end, &value)) return !dec->failed;
+            if (value != 1) dec->failed = 1;
+            dec->state = DEC_BOOL_BYTE;
+            break;
+        case DEC_BOOL_BYTE:
+            if (p == end) return 1;
+            if (!stream_consume(dec, 1)) break;
+            if (*p++) stream_emit(dec, "true", 4);
+            else stream_emit(dec, "false", 5);
+            stream_value_done(dec);
+            break;
+        case DEC_ENUM_LENGTH:
+            if (!stream_nnint(dec, &p, end, &value)) return !dec->failed;
+            dec->state = DEC_ENUM_VALUE;
+            break;
+        case DEC_ENUM_VALUE: {
+            if (!stream_nnint(dec, &p, end, &value)) return !dec->failed;
+            bej_dict_entry_t enum_entry;
+            if (!get_entry_by_seq(selector_dict(dec->selector, dec->schema_dict, dec->annot_dict),
+                                  dec->entry.child_pointer, dec->entry.child_count, value, &enum_entry) ||
+                !enum_entry.name) {
+                dec->failed = 1;
+                break;
+            }
+            stream_emit_name(dec, enum_entry.name);
+            stream_value_done(dec);
+            break;
+        }
+        case DEC_SKIP: {
+            const uint64_t left = dec->skip_to - dec->offset;
+            const size_t n = (uint64_t)(end - p) < left ? (size_t)(end - p) : (size_t)left;
+            p += n;
+            dec->offset += n;
+            if (dec->offset < dec->skip_to) return 1;
+            dec->state = dec->resume;
+            break;
+        }
+        case DEC_MEMBER_DONE: {
+            bej_decode_frame_t* frame = &dec->frames[dec->depth - 1];
+            dec->limit = frame->end;
+            frame->index++;
+            if (--frame->remaining) {
+                dec->state = DEC_SFL_SEQ;
+            } else {
+                dec->skip_to = frame->end;
+                dec->resume = DEC_CLOSE;
+                dec->state = DEC_SKIP;
+            }
+            break;
+        }
+        case DEC_CLOSE:
+            stream_emit(dec, dec->frames[dec->depth - 1].entry.format == BEJ_FORMAT_ARRAY ? "]" : "}", 1);
+            if (--dec->depth) {
+                dec->state = DEC_MEMBER_DONE;
+            } else {
+                dec->limit = UINT64_MAX;
+                dec->state = DEC_DONE;
+            }
+            break;
+        case DEC_DONE:
+            return 1;
+        default:
+            dec->failed = 1;
         }
     }
-    return 1;
+    return 0;
 }
 
-int bej_decode_stream(FILE* output_stream, FILE* input_stream,
-                      const bej_dictionary_t* schema_dict,
-                      const bej_dictionary_t* annot_dict) {
-    if (!output_stream || !input_stream || !schema_dict || !annot_dict) return 0;
+int bej_stream_decoder_feed(bej_stream_decoder_t* dec, const uint8_t* data, const size_t size) {
+    BEJ_STATS_ADD(bytes_in, size);
+    BEJ_STATS_TIME_BEGIN(started);
+    const int ok = stream_decode_chunk(dec, data, size);
+    stream_flush(dec);
+    BEJ_STATS_TIME_END(decode_ns, started);
+    return ok && !dec->failed;
+}
 
-    // skip 7-byte BEJ header
-    fseek(input_stream, 7, SEEK_SET);
+/**
+ * @brief tells whether a streaming decode has completed its document
+ * @param dec the decoder
+ * @return 1 if the root Set was decoded without error
+ */
+static int stream_complete(const bej_stream_decoder_t* dec) {
+    return !dec->failed && dec->state == DEC_DONE;
+}
+
+/**
+ * @brief prepares a streaming decoder for the next document, keeping its memory and limits
+ * @param dec a decoder that was initialized once and not finished since
+ * @param write the callback receiving the JSON text
+ * @param write_ctx context passed to `write`
+ */
+static void stream_restart(bej_stream_decoder_t* dec, const bej_write_fn write, void* write_ctx) {
+    bej_decode_frame_t* frames = dec->frames;
+    const size_t frame_capacity = dec->frame_capacity;
+    const size_t max_depth = dec->max_depth;
+    const uint64_t max_output = dec->max_output;
+    json_writer_t text = dec->text;
+
+    bej_stream_decoder_init(dec, dec->schema_dict, dec->annot_dict, write, write_ctx);
+    dec->max_depth = max_depth;
+    dec->max_output = max_output;
+    dec->frames = frames;
+    dec->frame_capacity = frame_capacity;
+    dec->text = text;
+    dec->text.size = 0;
+    dec->text.failed = false;
+}
 
-    // get the root entry from the dictionary
+int bej_stream_decoder_finish(bej_stream_decoder_t* dec) {
+    BEJ_STATS_ADD(documents, 1);
+    const int ok = stream_complete(dec);
+    free(dec->frames);
+    dec->frames = NULL;
+    dec->depth = dec->frame_capacity = 0;
+    json_writer_free(&dec->text);
+    return ok;
+}
+
+/**
+ * @brief write callback of bej_decode_stream()
+ * @param ctx the output FILE*
+ * @param data the characters to write
+ * @param size the number of characters
+ * @return 1 on success, 0 on a write error
+ */
+static int write_to_file(void* ctx, const char* data, const size_t size) {
+    return fwrite(data, 1, size, (FILE*)ctx) == size;
+}
+
+/**
+ * @brief reads the root entry of a schema dictionary
+ * @param schema_dict the main schema dictionary
+ * @param root_entry pointer to store the root entry, with the Set format
+ * @return 1 on success, 0 if the dictionary has no entry
+ */
+static int read_root_entry(const bej_dictionary_t* schema_dict, bej_dict_entry_t* root_entry) {
     bej_dict_stream_t ds;
     bej_dict_stream_init(&ds, schema_dict);
-    bej_dict_entry_t root_entry;
-    if (!bej_dict_stream_next(&ds, &root_entry)) return 0;
+    if (!bej_dict_stream_next(&ds, root_entry)) return 0;
+    root_entry->format = BEJ_FORMAT_SET;
+    return 1;
+}
 
-    // the entire payload is one large SET, so we call decode_value for it
+/**
+ * @brief positions a cursor at the root SFL of a BEJ document and reads it
+ * @param data the BEJ document
+ * @param size the size of the document
+ * @param payload pointer to store the cursor over the root Set payload
+ * @return 1 on success, 0 on failure
+ */
+static int open_root(const uint8_t* data, const size_t size, bej_cursor_t* payload) {
+    if (!data || size < BEJ_HEADER_SIZE) return 0;
+
+    // skip 7-byte BEJ header
+    bej_cursor_t cursor;
+    bej_cursor_init(&cursor, data + BEJ_HEADER_SIZE, size - BEJ_HEADER_SIZE);
+
+    // the entire payload is one large SET
     uint64_t seq, length;
     uint8_t format;
-    if (unpack_sfl(input_stream, &seq, &format, &length) == 0 || format != BEJ_FORMAT_SET) return 0;
+    BEJ_STATS_ADD(properties, 1);
+    return bej_cursor_read_sfl(&cursor, &seq, &format, &length) && format == BEJ_FORMAT_SET &&
+           bej_cursor_take(&cursor, length, payload);
+}
+
+/**
+ * @brief feeds a whole input stream to a streaming decoder
+ * @param dec the decoder
+ * @param input_stream the input stream containing BEJ data
+ * @return 1 if every chunk was read and decoded, 0 otherwise
+ */
+static int stream_feed_file(bej_stream_decoder_t* dec, FILE* input_stream) {
+    uint8_t chunk[BEJ_DECODE_CHUNK_SIZE];
+    int ok = 1;
+    while (ok) {
+        BEJ_STATS_TIME_BEGIN(started);
+        const size_t n = fread(chunk, 1, sizeof(chunk), input_stream);
+        BEJ_STATS_TIME_END(io_ns, started);
+        if (n == 0) break;
+        ok = bej_stream_decoder_feed(dec, chunk, n);
+    }
+    return ok && !ferror(input_stream);
+}
+
+int bej_decode_stream(FILE* output_stream, FILE* input_stream,
+                      const bej_dictionary_t* schema_dict,
+                      const bej_dictionary_t* annot_dict) {
+    if (!output_stream || !input_stream || !schema_dict || !annot_dict) return 0;
 
-    root_entry.format = BEJ_FORMAT_SET;
-    return decode_value(output_stream, input_stream, schema_dict, annot_dict, &root_entry, length);
+    bej_stream_decoder_t dec;
+    bej_stream_decoder_init(&dec, schema_dict, annot_dict, write_to_file, output_stream);
+    const int ok = stream_feed_file(&dec, input_stream);
+    return bej_stream_decoder_finish(&dec) && ok;
 }
 
 json_value_t* bej_decode_buffer(const uint8_t* data, const size_t size,
                                 const bej_dictionary_t* schema_dict,
                                 const bej_dictionary_t* annot_dict) {
-    // this function is a convenient wrapper around bej_decode_stream
-    FILE* input_stream = fmemopen((void*)data, size, "r");
-    if (!input_stream) return NULL;
+    return bej_decode_buffer_in(data, size, schema_dict, annot_dict, NULL);
+}
 
-    FILE* output_stream = tmpfile();
-    if (!output_stream) {
-        fclose(input_stream);
-        return NULL;
+json_value_t* bej_decode_buffer_in(const uint8_t* data, const size_t size,
+                                   const bej_dictionary_t* schema_dict,
+                                   const bej_dictionary_t* annot_dict,
+                                   json_arena_t* arena) {
+    return bej_decode_buffer_limited(data, size, schema_dict, annot_dict, arena, NULL);
+}
+
+/**
+ * @brief decodes a BEJ buffer into a tree, the body of the one-shot tree decoders
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @param schema_dict the main schema dictionary
+ * @param annot_dict the annotation dictionary (may be NULL)
+ * @param arena arena for the tree (NULL = heap)
+ * @param limits the limits (NULL = defaults)
+ * @param borrow 1 to point keys into the dictionaries and strings into `data`
+ * @return the tree, or NULL on failure
+ */
+static json_value_t* decode_tree(const uint8_t* data, const size_t size,
+                                 const bej_dictionary_t* schema_dict,
+                                 const bej_dictionary_t* annot_dict,
+                                 json_arena_t* arena,
+                                 const bej_decode_limits_t* limits,
+                                 const int borrow) {
+    if (!schema_dict) return NULL;
+
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_in, size);
+    BEJ_STATS_TIME_BEGIN(started);
+    bej_dict_entry_t root_entry;
+    bej_cursor_t payload;
+    json_value_t* root = NULL;
+    if (read_root_entry(schema_dict, &root_entry) && open_root(data, size, &payload)) {
+        build_frame_t stack[BEJ_BUILD_STACK_FRAMES];
+        build_ctx_t ctx;
+        build_ctx_init(&ctx, schema_dict, annot_dict, arena, limits, stack);
+        ctx.borrow = borrow;
+        int skipped = 0;
+        root = build_value(&ctx, &payload, &root_entry, 0, 1, &skipped);
+        build_ctx_release(&ctx);
+    }
+    BEJ_STATS_TIME_END(decode_ns, started);
+    return root;
+}
+
+json_value_t* bej_decode_buffer_limited(const uint8_t* data, const size_t size,
+                                        const bej_dictionary_t* schema_dict,
+                                        const bej_dictionary_t* annot_dict,
+                                        json_arena_t* arena,
+                                        const bej_decode_limits_t* limits) {
+    return decode_tree(data, size, schema_dict, annot_dict, arena, limits, 0);
+}
+
+json_value_t* bej_decode_buffer_borrowed(const uint8_t* data, const size_t size,
+                                         const bej_dictionary_t* schema_dict,
+                                         const bej_dictionary_t* annot_dict,
+                                         json_arena_t* arena,
+                                         const bej_decode_limits_t* limits) {
+    return decode_tree(data, size, schema_dict, annot_dict, arena, limits, 1);
+}
+
+/**
+ * @brief a root member, or a run of elements of a root Array, built by one task
+ */
+typedef struct {
+    bej_dict_entry_t entry;         /**< the root member */
+    uint8_t selector;               /**< the dictionary selector of the member */
+    int split;                      /**< 1 if the piece is a run of elements of the member */
+    int first;                      /**< 1 for the first run of a split Array */
+    bej_dict_entry_t element_entry; /**< element entry of a split Array */
+    uint64_t count;                 /**< number of elements in the run */
+    bej_cursor_t payload;           /**< the member payload, or the bytes of the run */
+    json_value_t* value;            /**< the built value, or an array of the elements of the run */
+    int skipped;                    /**< 1 if the member has an unsupported format */
+    int ok;                         /**< 1 once the piece was built */
+} decode_piece_t;
+
+/**
+ * @brief the pieces of a parallel decode and the tasks building them
+ */
+typedef struct {
+    const bej_dictionary_t* schema_dict; /**< the main schema dictionary */
+    const bej_dictionary_t* annot_dict;  /**< the annotation dictionary (may be NULL) */
+    decode_piece_t* pieces;              /**< the pieces in document order */
+    size_t piece_count;                  /**< number of pieces */
+    size_t piece_capacity;               /**< allocated entries in `pieces` */
+    size_t* groups;                      /**< first piece of every task, followed by the piece count */
+    json_arena_t* arenas;                /**< an arena per task (NULL = heap) */
+} decode_job_t;
+
+/**
+ * @brief bej_task_fn of a parallel decode: builds a group of pieces
+ * @param arg the decode_job_t
+ * @param index the group
+ */
+static void build_group_task(void* arg, const size_t index) {
+    const decode_job_t* job = arg;
+    build_frame_t stack[BEJ_BUILD_STACK_FRAMES];
+    build_ctx_t ctx;
+    build_ctx_init(&ctx, job->schema_dict, job->annot_dict, job->arenas ? &job->arenas[index] : NULL, NULL, stack);
+    for (size_t i = job->groups[index]; i < job->groups[index + 1]; ++i) {
+        decode_piece_t* piece = &job->pieces[i];
+        // root members are level 2, below the root Set
+        if (!piece->split) {
+            piece->value = build_value(&ctx, &piece->payload, &piece->entry, piece->selector, 2, &piece->skipped);
+            piece->ok = piece->value || piece->skipped;
+            continue;
+        }
+        piece->value = create_value(&ctx, JSON_ARRAY);
+        const build_frame_t run = {.in = piece->payload, .remaining = piece->count, .container = piece->value,
+                                   .entry = piece->element_entry, .selector = piece->selector};
+        piece->ok = piece->value && ctx.max_depth >= 2 && (scalar_element_format(piece->element_entry.format) ?
+            build_scalar_items(&ctx, &piece->payload, piece->count, &piece->element_entry, piece->selector, piece->value) :
+            build_members(&ctx, &run, 2));
     }
+    build_ctx_release(&ctx);
+}
 
-    const int success = bej_decode_stream(output_stream, input_stream, schema_dict, annot_dict);
-
-    json_value_t* result = NULL;
-    if (success) {
-        fseek(output_stream, 0, SEEK_END);
-        const long json_size = ftell(output_stream);
-        rewind(output_stream);
-        if (json_size > 0) {
-            char* json_str = malloc(json_size + 1);
-            if (json_str) {
-                if (fread(json_str, 1, json_size, output_stream) == (size_t)json_size) {
-                    json_str[json_size] = '\0';
-                    result = json_parse(json_str);
-                }
-                free(json_str);
+/**
+ * @brief appends a piece to a parallel decode
+ * @param job the decode
+ * @param piece the piece
+ * @return 1 on success, 0 on allocation failure
+ */
+static int push_piece(decode_job_t* job, const decode_piece_t* piece) {
+    if (job->piece_count == job->piece_capacity) {
+        const size_t new_capacity = job->piece_capacity ? job->piece_capacity * 2 : 32;
+        decode_piece_t* new_pieces = realloc(job->pieces, new_capacity * sizeof(*new_pieces));
+        if (!new_pieces) return 0;
+        BEJ_STATS_ADD(allocations, 1);
+        job->pieces = new_pieces;
+        job->piece_capacity = new_capacity;
+    }
+    job->pieces[job->piece_count++] = *piece;
+    return 1;
+}
+
+/**
+ * @brief splits a root Array into runs of elements, scanning their SFL headers
+ * @param job the decode
+ * @param member the piece of the whole member, with its element entry
+ * @param chunk the elements per run
+ * @return 1 on success, 0 on malformed input or allocation failure
+ */
+static int split_array(decode_job_t* job, const decode_piece_t* member, const uint64_t chunk) {
+    bej_cursor_t in = member->payload;
+    uint64_t count;
+    if (!bej_cursor_read_nnint(&in, &count)) return 0;
+
+    for (uint64_t first = 0; first < count; first += chunk) {
+        decode_piece_t run = *member;
+        run.split = 1;
+        run.first = first == 0;
+        run.count = count - first < chunk ? count - first : chunk;
+        const uint8_t* start = in.pos;
+        for (uint64_t i = 0; i < run.count; i++) {
+            uint64_t seq, length;
+            uint8_t format;
+            if (!bej_cursor_read_sfl(&in, &seq, &format, &length) || !bej_cursor_skip(&in, length)) return 0;
+        }
+        run.payload.pos = start;
+        run.payload.end = in.pos;
+        if (!push_piece(job, &run)) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief scans the root Set of a document into pieces
+ * @param job the decode
+ * @param in the cursor over the root Set payload
+ * @param root_entry the root entry of the schema dictionary
+ * @param threads the threads working on the document
+ * @return 1 on success, 0 on malformed input or allocation failure
+ */
+static int scan_root(decode_job_t* job, bej_cursor_t* in, const bej_dict_entry_t* root_entry,
+                     const size_t threads) {
+    uint64_t prop_count;
+    if (!bej_cursor_read_nnint(in, &prop_count)) return 0;
+
+    for (uint64_t i = 0; i < prop_count; i++) {
+        decode_piece_t member = {.value = NULL};
+        uint64_t seq;
+        uint8_t format;
+        if (!read_member(in, &seq, &format, &member.payload) ||
+            !resolve_property(seq, job->schema_dict, job->annot_dict, 0, root_entry->child_pointer,
+                              root_entry->child_count, &member.entry, &member.selector) ||
+            !member.entry.name)
+            return 0;
+
+        uint64_t count = 0;
+        bej_cursor_t elements = member.payload;
+        const int splittable = member.entry.format == BEJ_FORMAT_ARRAY && bej_cursor_read_nnint(&elements, &count) &&
+            count <= SIZE_MAX && get_array_element_entry(&member.entry, selector_dict(member.selector,
+                job->schema_dict, job->annot_dict), &member.element_entry);
+        const size_t chunk = splittable ? bej_parallel_chunk((size_t)count, threads) : 0;
+        if (!(chunk ? split_array(job, &member, chunk) : push_piece(job, &member))) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief joins the built pieces into the root object, in document order
+ * @param job the decode
+ * @param arena arena of the tree (NULL = heap)
+ * @param root the root object
+ * @return 1 on success, 0 on failure (the pieces not moved into `root` are left in the job)
+ */
+static int join_pieces(decode_job_t* job, json_arena_t* arena, json_value_t* root) {
+    for (size_t i = 0; i < job->piece_count; i++) {
+        decode_piece_t* piece = &job->pieces[i];
+        if (!piece->ok) return 0;
+        if (piece->skipped) continue;
+
+        size_t end = i + 1;
+        if (piece->split) {
+            // the first run becomes the array, the elements of the others move into it
+            size_t total = piece->value->data.array.count;
+            for (; end < job->piece_count && job->pieces[end].split && !job->pieces[end].first; end++) {
+                if (!job->pieces[end].ok) return 0;
+                total += job->pieces[end].value->data.array.count;
+            }
+            json_array_t* items = &piece->value->data.array;
+            if (!json_array_reserve_in(arena, piece->value, total)) return 0;
+            for (size_t j = i + 1; j < end; j++) {
+                json_value_t* run = job->pieces[j].value;
+                memcpy(items->items + items->count, run->data.array.items, run->data.array.count * sizeof(*items->items));
+                items->count += run->data.array.count;
+                run->data.array.count = 0;
+                json_free(run);
+                job->pieces[j].value = NULL;
+            }
+        }
+        if (!json_object_append_in(arena, root, piece->entry.name, piece->value)) return 0;
+        piece->value = NULL;
+        i = end - 1;
+    }
+    return 1;
+}
+
+json_value_t* bej_decode_buffer_parallel(const uint8_t* data, const size_t size,
+                                         const bej_dictionary_t* schema_dict,
+                                         const bej_dictionary_t* annot_dict,
+                                         json_arena_t* arena,
+                                         const bej_parallel_t* parallel) {
+    bej_pool_t* pool = parallel ? parallel->pool : NULL;
+    const size_t threads = bej_pool_concurrency(pool);
+    if (!schema_dict || threads < 2) return bej_decode_buffer_in(data, size, schema_dict, annot_dict, arena);
+
+    BEJ_STATS_TIME_BEGIN(started);
+    decode_job_t job = {.schema_dict = schema_dict, .annot_dict = annot_dict};
+    bej_dict_entry_t root_entry;
+    bej_cursor_t in;
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_in, size);
+    int ok = read_root_entry(schema_dict, &root_entry) && open_root(data, size, &in) &&
+             scan_root(&job, &in, &root_entry, threads);
+
+    size_t group_count = 0;
+    if (ok) {
+        job.groups = malloc((job.piece_count + 1) * sizeof(*job.groups));
+        BEJ_STATS_ADD(allocations, 1);
+        ok = job.groups != NULL;
+    }
+    if (ok) {
+        // runs of small pieces share a task so that a task is worth handing to a thread
+        const size_t group_size = bej_parallel_task_size(parallel, size);
+        size_t grouped = group_size;
+        for (size_t i = 0; i < job.piece_count; i++) {
+            if (grouped >= group_size) {
+                job.groups[group_count++] = i;
+                grouped = 0;
             }
+            grouped += bej_cursor_remaining(&job.pieces[i].payload);
+        }
+        job.groups[group_count] = job.piece_count;
+    }
+    if (ok && arena) {
+        job.arenas = malloc(group_count * sizeof(*job.arenas));
+        BEJ_STATS_ADD(allocations, 1);
+        ok = job.arenas != NULL || group_count == 0;
+        for (size_t i = 0; ok && i < group_count; i++)
+            json_arena_init(&job.arenas[i]);
+    }
+
+    json_value_t* root = NULL;
+    if (ok) {
+        bej_pool_run(pool, build_group_task, &job, group_count);
+        // the trees of the tasks now belong to the caller's arena
+        for (size_t i = 0; job.arenas && i < group_count; i++)
+            json_arena_adopt(arena, &job.arenas[i]);
+
+        build_ctx_t ctx;
+        build_ctx_init(&ctx, schema_dict, annot_dict, arena, NULL, NULL);
+        root = create_value(&ctx, JSON_OBJECT);
+        if (!root || !join_pieces(&job, arena, root)) {
+            json_free(root);
+            root = NULL;
         }
     }
 
-    fclose(input_stream);
-    fclose(output_stream);
-    return result;
+    for (size_t i = 0; i < job.piece_count; i++)
+        json_free(job.pieces[i].value);
+    free(job.pieces);
+    free(job.groups);
+    free(job.arenas);
+    BEJ_STATS_TIME_END(decode_ns, started);
+    return root;
+}
+
+int bej_decode_bound(const uint8_t* data, const size_t size, const bej_binding_t* binding,
+                     void* object, uint64_t* present) {
+    if (!binding || !binding->nodes || !object) return 0;
+
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_in, size);
+    BEJ_STATS_TIME_BEGIN(started);
+    bej_dict_entry_t root_entry;
+    bej_cursor_t payload;
+    bound_ctx_t ctx = {.binding = binding, .object = object};
+    const int ok = read_root_entry(binding->schema_dict, &root_entry) && open_root(data, size, &payload) &&
+                   decode_bound_set(&ctx, 0, &payload);
+    BEJ_STATS_TIME_END(decode_ns, started);
+    if (ok && present) *present = ctx.present;
+    return ok;
+}
+
+/**
+ * @brief a reusable decoder: the dictionaries, their root entry and the memory of past calls
+ */
+struct bej_decoder {
+    bej_dict_entry_t root_entry;  /**< the root entry of the schema dictionary */
+    bej_decode_limits_t limits;   /**< limits of every decode */
+    json_arena_t arena;           /**< arena of the tree returned by bej_decoder_decode() */
+    build_frame_t* frames;        /**< frame stack of the tree builder */
+    size_t frame_capacity;        /**< entries in `frames` */
+    bej_stream_decoder_t stream;  /**< text decoder, its frame stack and text buffer are kept */
+};
+
+/**
+ * @brief write callback of bej_decoder_decode_text(), which reads the text buffer directly
+ * @param ctx unused
+ * @param data unused
+ * @param size unused
+ * @return 1
+ */
+static int keep_text(void* ctx, const char* data, const size_t size) {
+    (void)ctx;
+    (void)data;
+    (void)size;
+    return 1;
+}
+
+bej_decoder_t* bej_decoder_create(const bej_dictionary_t* schema_dict,
+                                  const bej_dictionary_t* annot_dict) {
+    if (!schema_dict) return NULL;
+
+    bej_decoder_t* decoder = calloc(1, sizeof(*decoder));
+    if (!decoder) return NULL;
+    if (!read_root_entry(schema_dict, &decoder->root_entry)) {
+        free(decoder);
+        return NULL;
+    }
+    json_arena_init(&decoder->arena);
+    bej_stream_decoder_init(&decoder->stream, schema_dict, annot_dict, keep_text, NULL);
+    return decoder;
+}
+
+void bej_decoder_set_limits(bej_decoder_t* decoder, const bej_decode_limits_t* limits) {
+    if (!decoder) return;
+    decoder->limits = limits ? *limits : (bej_decode_limits_t){0, 0};
+    bej_stream_decoder_set_limits(&decoder->stream, limits);
+}
+
+void bej_decoder_free(bej_decoder_t* decoder) {
+    if (!decoder) return;
+    json_arena_destroy(&decoder->arena);
+    free(decoder->frames);
+    free(decoder->stream.frames);
+    json_writer_free(&decoder->stream.text);
+    free(decoder);
+}
+
+/**
+ * @brief decodes a BEJ buffer into a tree in the decoder's arena, the body of the tree decode calls
+ * @param decoder the decoder
+ * @param data pointer to the buffer with BEJ data
+ * @param size the size of the buffer
+ * @param borrow 1 to point keys into the dictionaries and strings into `data`
+ * @return the tree, or NULL on failure
+ */
+static json_value_t* decoder_build(bej_decoder_t* decoder, const uint8_t* data, const size_t size,
+                                   const int borrow) {
+    if (!decoder) return NULL;
+
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_in, size);
+    BEJ_STATS_TIME_BEGIN(started);
+    json_arena_reset(&decoder->arena);
+    bej_cursor_t payload;
+    json_value_t* root = NULL;
+    if (open_root(data, size, &payload)) {
+        // the frames of the builder are kept between calls like the arena
+        build_ctx_t ctx;
+        build_ctx_init(&ctx, decoder->stream.schema_dict, decoder->stream.annot_dict, &decoder->arena,
+                       &decoder->limits, NULL);
+        ctx.frames = decoder->frames;
+        ctx.frame_capacity = decoder->frame_capacity;
+        ctx.frames_on_heap = 1;
+        ctx.borrow = borrow;
+        int skipped = 0;
+        root = build_value(&ctx, &payload, &decoder->root_entry, 0, 1, &skipped);
+        decoder->frames = ctx.frames;
+        decoder->frame_capacity = ctx.frame_capacity;
+    }
+    BEJ_STATS_TIME_END(decode_ns, started);
+    return root;
+}
+
+json_value_t* bej_decoder_decode(bej_decoder_t* decoder, const uint8_t* data, const size_t size) {
+    return decoder_build(decoder, data, size, 0);
+}
+
+json_value_t* bej_decoder_decode_borrowed(bej_decoder_t* decoder, const uint8_t* data, const size_t size) {
+    return decoder_build(decoder, data, size, 1);
+}
+
+int bej_decoder_decode_text(bej_decoder_t* decoder, const uint8_t* data, const size_t size,
+                            const char** text, size_t* length) {
+    if (!decoder || !data || !text || !length) return 0;
+
+    bej_stream_decoder_t* dec = &decoder->stream;
+    stream_restart(dec, keep_text, NULL);
+
+    // no flush: the whole document stays in the text buffer
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_in, size);
+    BEJ_STATS_TIME_BEGIN(started);
+    const int ok = stream_decode_chunk(dec, data, size) && stream_complete(dec);
+    if (ok) BEJ_STATS_ADD(bytes_out, dec->text.size);
+    BEJ_STATS_TIME_END(decode_ns, started);
+    if (!ok) return 0;
+
+    *text = dec->text.data;
+    *length = dec->text.size;
+    return 1;
+}
+
+int bej_decoder_decode_stream(bej_decoder_t* decoder, FILE* output_stream, FILE* input_stream) {
+    if (!decoder || !output_stream || !input_stream) return 0;
+
+    bej_stream_decoder_t* dec = &decoder->stream;
+    stream_restart(dec, write_to_file, output_stream);
+    const int ok = stream_feed_file(dec, input_stream);
+    BEJ_STATS_ADD(documents, 1);
+    return stream_complete(dec) && ok;
+}
+
+struct bej_async_decoder {
+    bej_stream_decoder_t stream;         /**< the resumable decoder */
+    bej_source_fn source;                /**< source of the BEJ data */
+    void* source_ctx;                    /**< context of `source` */
+    bej_sink_fn sink;                    /**< sink of the text */
+    void* sink_ctx;                      /**< context of `sink` */
+    bej_buffer_t pending;                /**< text of the last chunk */
+    size_t drained;                      /**< bytes of `pending` the sink has taken */
+    int failed;                          /**< sticky error flag */
+    uint8_t chunk[BEJ_DECODE_CHUNK_SIZE]; /**< the chunk being decoded */
+};
+
+/**
+ * @brief write callback of an async decoder, keeps the text until the sink takes it
+ * @param ctx the bej_async_decoder_t
+ * @param data the characters
+ * @param size the number of characters
+ * @return 1 on success, 0 on allocation failure
+ */
+static int write_to_pending(void* ctx, const char* data, const size_t size) {
+    return bej_buffer_append(&((bej_async_decoder_t*)ctx)->pending, data, size);
+}
+
+bej_async_decoder_t* bej_async_decoder_create(const bej_dictionary_t* schema_dict,
+                                              const bej_dictionary_t* annot_dict,
+                                              const bej_decode_limits_t* limits,
+                                              const bej_source_fn source, void* source_ctx,
+                                              const bej_sink_fn sink, void* sink_ctx) {
+    if (!schema_dict || !source || !sink) return NULL;
+
+    bej_async_decoder_t* decoder = malloc(sizeof(*decoder));
+    if (!decoder) return NULL;
+    BEJ_STATS_ADD(allocations, 1);
+    bej_stream_decoder_init(&decoder->stream, schema_dict, annot_dict, write_to_pending, decoder);
+    bej_stream_decoder_set_limits(&decoder->stream, limits);
+    decoder->source = source;
+    decoder->source_ctx = source_ctx;
+    decoder->sink = sink;
+    decoder->sink_ctx = sink_ctx;
+    bej_buffer_init(&decoder->pending);
+    decoder->drained = 0;
+    decoder->failed = 0;
+    return decoder;
+}
+
+bej_io_status_t bej_async_decoder_run(bej_async_decoder_t* decoder) {
+    if (!decoder || decoder->failed) return BEJ_IO_FAILED;
+
+    for (;;) {
+        const bej_io_status_t status = bej_sink_drain(decoder->sink, decoder->sink_ctx, decoder->pending.data,
+                                                      decoder->pending.size, &decoder->drained);
+        if (status != BEJ_IO_DONE) {
+            decoder->failed = status == BEJ_IO_FAILED;
+            return status;
+        }
+        bej_buffer_clear(&decoder->pending);
+        decoder->drained = 0;
+        if (stream_complete(&decoder->stream)) return BEJ_IO_DONE;
+
+        const size_t n = decoder->source(decoder->source_ctx, decoder->chunk, sizeof(decoder->chunk));
+        if (n == BEJ_IO_AGAIN) return BEJ_IO_NEED_INPUT;
+        // the input ending before the root Set is as malformed as a bad byte
+        if (n == BEJ_IO_ERROR || n == 0 || n > sizeof(decoder->chunk) ||
+            !bej_stream_decoder_feed(&decoder->stream, decoder->chunk, n)) {
+            decoder->failed = 1;
+            return BEJ_IO_FAILED;
+        }
+    }
+}
+
+void bej_async_decoder_free(bej_async_decoder_t* decoder) {
+    if (!decoder) return;
+    bej_stream_decoder_finish(&decoder->stream);
+    bej_buffer_free(&decoder->pending);
+    free(decoder);
 }
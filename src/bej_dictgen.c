@@ -0,0 +1,268 @@
+/**
+ * @file bej_dictgen.c
+ * @brief build-time compiler from a .bin dictionary to C tables
+ *
+ * Usage: bej_dictgen <dictionary.bin> <symbol> <output.c> <output.h>
+ *
+ * The generated source holds the dictionary bytes and its compiled index
+ * (see bej_dict_index_t) as constant arrays, so a program linking it needs
+ * neither the file nor the index build at run time. The header declares
+ * `bej_dictionary_t *bej_dictionary_<symbol>(void)`, and a constructor
+ * registers the dictionary as a built-in (see bej_dictionary_register_builtin())
+ * so that loading a byte-identical file returns it as well
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_dictionary.h"
+
+#define VALUES_PER_LINE 16 /**< numbers per line in the generated arrays */
+
+/**
+ * @brief checks that a symbol is a valid C identifier suffix
+ * @param symbol the symbol
+ * @return 1 if it is non-empty and made of letters, digits and underscores
+ */
+static int valid_symbol(const char *symbol) {
+    if (!*symbol)
+        return 0;
+    for (const char *c = symbol; *c; c++) {
+        if (!(*c == '_' || (*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z')))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief checks whether a name can be repeated inside a generated comment
+ * @param name the entry name
+ * @return 1 if it is printable ASCII and cannot end the comment
+ */
+static int printable_name(const char *name) {
+    for (const char *c = name; *c; c++) {
+        if (*c < 0x20 || *c > 0x7E || (c[0] == '*' && c[1] == '/'))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief writes the opening line of a constant array (at least one element, C has no empty arrays)
+ * @param out the generated source
+ * @param type element type
+ * @param name array name
+ * @param count number of elements
+ */
+static void open_array(FILE *out, const char *type, const char *name, const size_t count) {
+    fprintf(out, "\nstatic const %s %s[%zu] = {", type, name, count ? count : 1);
+    if (!count)
+        fputs("0", out);
+}
+
+/**
+ * @brief writes one element of an array opened by open_array()
+ * @param out the generated source
+ * @param i position of the element
+ * @param value the element
+ * @param suffix integer suffix of the literal ("" for none)
+ */
+static void array_literal(FILE *out, const size_t i, const uint64_t value, const char *suffix) {
+    fputs(i ? "," : "", out);
+    fputs(i % VALUES_PER_LINE ? " " : "\n    ", out);
+    fprintf(out, "%" PRIu64 "%s", value, suffix);
+}
+
+/**
+ * @brief writes one element of an array of at most 32-bit values opened by open_array()
+ * @param out the generated source
+ * @param i position of the element
+ * @param value the element
+ */
+static void array_value(FILE *out, const size_t i, const uint32_t value) {
+    array_literal(out, i, value, "");
+}
+
+/**
+ * @brief writes the generated source
+ * @param out the source file
+ * @param dict the loaded dictionary with its index
+ * @param symbol the symbol
+ * @param header_name file name of the generated header
+ * @param source_name file name of the dictionary (for the banner)
+ */
+static void write_source(FILE *out, const bej_dictionary_t *dict, const char *symbol,
+                         const char *header_name, const char *source_name) {
+    const bej_dict_index_t *index = dict->index;
+    const size_t n = index->entry_count;
+
+    fprintf(out, "/* generated by bej_dictgen from %s, do not edit */\n\n", source_name);
+    fprintf(out, "#include <stddef.h>\n#include <stdint.h>\n\n#include \"%s\"\n", header_name);
+
+    open_array(out, "uint8_t", "dict_bytes", dict->size);
+    for (size_t i = 0; i < dict->size; i++)
+        array_value(out, i, dict->bytes[i]);
+    fputs("\n};\n", out);
+
+    open_array(out, "uint8_t", "dict_format", n);
+    for (size_t i = 0; i < n; i++)
+        array_value(out, i, index->format[i]);
+    fputs("\n};\n", out);
+
+    open_array(out, "uint8_t", "dict_flags", n);
+    for (size_t i = 0; i < n; i++)
+        array_value(out, i, index->flags[i]);
+    fputs("\n};\n", out);
+
+    open_array(out, "uint16_t", "dict_sequence", n);
+    for (size_t i = 0; i < n; i++)
+        array_value(out, i, index->sequence[i]);
+    fputs("\n};\n", out);
+
+    open_array(out, "uint16_t", "dict_child_pointer", n);
+    for (size_t i = 0; i < n; i++)
+        array_value(out, i, index->child_pointer[i]);
+    fputs("\n};\n", out);
+
+    open_array(out, "uint16_t", "dict_child_count", n);
+    for (size_t i = 0; i < n; i++)
+        array_value(out, i, index->child_count[i]);
+    fputs("\n};\n", out);
+
+    open_array(out, "uint32_t", "dict_name_hash", n);
+    for (size_t i = 0; i < n; i++)
+        array_value(out, i, index->name_hash[i]);
+    fputs("\n};\n", out);
+
+    open_array(out, "uint64_t", "dict_sfl_prefix", n);
+    for (size_t i = 0; i < n; i++)
+        array_literal(out, i, index->sfl_prefix[i], "ULL");
+    fputs("\n};\n", out);
+
+    open_array(out, "uint32_t", "dict_subset_by_entry", n);
+    for (size_t i = 0; i < n; i++)
+        array_value(out, i, index->subset_by_entry[i]);
+    fputs("\n};\n", out);
+
+    open_array(out, "uint16_t", "dict_tables", index->table_size);
+    for (size_t i = 0; i < index->table_size; i++)
+        array_value(out, i, index->tables[i]);
+    fputs("\n};\n", out);
+
+    // names point into the dictionary bytes, exactly like a runtime index
+    fprintf(out, "\nstatic const char *const dict_name[%zu] = {", n ? n : 1);
+    if (!n)
+        fputs("NULL", out);
+    for (size_t i = 0; i < n; i++) {
+        const char *name = index->name[i];
+        fprintf(out, "%s\n    ", i ? "," : "");
+        if (!name) {
+            fputs("NULL", out);
+            continue;
+        }
+        fprintf(out, "(const char *)dict_bytes + %zu", (size_t)((const uint8_t *)name - dict->bytes));
+        if (printable_name(name))
+            fprintf(out, " /* %s */", name);
+    }
+    fputs("\n};\n", out);
+
+    fprintf(out, "\nstatic const bej_dict_subset_t dict_subsets[%u] = {", index->subset_count ? index->subset_count : 1u);
+    if (!index->subset_count)
+        fputs("{0}", out);
+    for (uint32_t i = 0; i < index->subset_count; i++) {
+        const bej_dict_subset_t *s = &index->subsets[i];
+        fprintf(out, "%s\n    {%u, %u, %" PRIu32 "u, %" PRIu32 "u, %" PRIu32 "u, %" PRIu32 "u}", i ? "," : "",
+                s->first, s->count, s->seq_table, s->seq_limit, s->name_table, s->name_mask);
+    }
+    fputs("\n};\n", out);
+
+    // the index fields are not const-qualified, nothing writes through them for a built-in
+    fprintf(out, "\nstatic bej_dict_index_t dict_index = {\n"
+                 "    .entry_count = %zu,\n"
+                 "    .format = (uint8_t *)dict_format,\n"
+                 "    .flags = (uint8_t *)dict_flags,\n"
+                 "    .sequence = (uint16_t *)dict_sequence,\n"
+                 "    .child_pointer = (uint16_t *)dict_child_pointer,\n"
+                 "    .child_count = (uint16_t *)dict_child_count,\n"
+                 "    .name = (const char **)dict_name,\n"
+                 "    .name_hash = (uint32_t *)dict_name_hash,\n"
+                 "    .sfl_prefix = (uint64_t *)dict_sfl_prefix,\n"
+                 "    .subset_by_entry = (uint32_t *)dict_subset_by_entry,\n"
+                 "    .subsets = (bej_dict_subset_t *)dict_subsets,\n"
+                 "    .subset_count = %" PRIu32 "u,\n"
+                 "    .tables = (uint16_t *)dict_tables,\n"
+                 "    .table_size = %zu,\n"
+                 "    .root_subset = %" PRIu32 "u,\n"
+                 "};\n",
+            n, index->subset_count, index->table_size, index->root_subset);
+
+    fprintf(out, "\nstatic bej_dictionary_t dictionary = {\n"
+                 "    .bytes = dict_bytes,\n"
+                 "    .size = sizeof(dict_bytes),\n"
+                 "    .index = &dict_index,\n"
+                 "    .mapped = 0,\n"
+                 "    .builtin = 1,\n"
+                 "    .trusted = %d,\n"
+                 "};\n", dict->trusted);
+
+    fprintf(out, "\nbej_dictionary_t *bej_dictionary_%s(void) {\n    return &dictionary;\n}\n", symbol);
+    fprintf(out, "\n__attribute__((constructor)) static void register_dictionary(void) {\n"
+                 "    bej_dictionary_register_builtin(&dictionary);\n}\n");
+}
+
+/**
+ * @brief writes the generated header
+ * @param out the header file
+ * @param symbol the symbol
+ * @param source_name file name of the dictionary (for the banner)
+ */
+static void write_header(FILE *out, const char *symbol, const char *source_name) {
+    fprintf(out, "/* generated by bej_dictgen from %s, do not edit */\n\n", source_name);
+    fprintf(out, "#ifndef BEJ_DICT_%s_H\n#define BEJ_DICT_%s_H\n\n", symbol, symbol);
+    fprintf(out, "#include \"bej_dictionary.h\"\n\n");
+    fprintf(out, "/**\n * @brief returns the built-in %s dictionary (never freed, bej_dictionary_free() is a no-op)\n"
+                 " * @return the dictionary\n */\n", symbol);
+    fprintf(out, "bej_dictionary_t *bej_dictionary_%s(void);\n\n#endif\n", symbol);
+}
+
+int main(const int argc, char **argv) {
+    if (argc != 5 || !valid_symbol(argv[2])) {
+        fprintf(stderr, "Usage: bej_dictgen <dictionary.bin> <symbol> <output.c> <output.h>\n");
+        return 1;
+    }
+
+    bej_dictionary_t *dict = bej_dictionary_load(argv[1]);
+    if (!dict || !dict->index) {
+        fprintf(stderr, "Failed to load dictionary: %s\n", argv[1]);
+        bej_dictionary_free(dict);
+        return 1;
+    }
+
+    // the generated files refer to their inputs by file name only, so they do not depend on the build directory
+    const char *header_name = strrchr(argv[4], '/');
+    header_name = header_name ? header_name + 1 : argv[4];
+    const char *source_name = strrchr(argv[1], '/');
+    source_name = source_name ? source_name + 1 : argv[1];
+
+    FILE *source = fopen(argv[3], "w");
+    FILE *header = source ? fopen(argv[4], "w") : NULL;
+    int status = 1;
+    if (header) {
+        write_source(source, dict, argv[2], header_name, source_name);
+        write_header(header, argv[2], source_name);
+        status = ferror(source) || ferror(header);
+    } else {
+        perror(source ? argv[4] : argv[3]);
+    }
+
+    if (header && fclose(header) != 0)
+        status = 1;
+    if (source && fclose(source) != 0)
+        status = 1;
+    bej_dictionary_free(dict);
+    if (status)
+        fprintf(stderr, "Failed to write %s\n", argv[3]);
+    return status;
+}
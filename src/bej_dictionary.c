@@ -3,11 +3,16 @@
  * @brief implementation of the BEJ dictionary parser and iterator
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include "bej_buffer.h"
 #include "bej_dictionary.h"
+#include "bej_file.h"
+#include "bej_stats.h"
 
 /**
  * @brief reads a little-endian 16-bit unsigned integer from a byte buffer
@@ -58,52 +63,534 @@ static int read_dictionary_header(const bej_dictionary_t *dict,
     return (*name_table_offset <= dict->size);
 }
 
-bej_dictionary_t *bej_dictionary_load(const char *path) {
-    FILE *file = fopen(path, "rb");
-    if (!file) return NULL;
+/**
+ * @brief checks that entries starting at a binary offset lie inside the entry table
+ * @param offset binary offset of the first entry
+ * @param entry_count number of entries of the dictionary
+ * @param count number of entries that must follow from the offset on
+ * @return 1 if the offset is the start of an entry and `count` entries fit, 0 otherwise
+ */
+static int entries_in_table(const uint16_t offset, const uint16_t entry_count, const uint32_t count) {
+    if (offset < BEJ_OFFSET_ENTRIES_START || (offset - BEJ_OFFSET_ENTRIES_START) % BEJ_DICTIONARY_ENTRY_SIZE != 0)
+        return 0;
+    return (uint32_t)(offset - BEJ_OFFSET_ENTRIES_START) / BEJ_DICTIONARY_ENTRY_SIZE + count <= entry_count;
+}
 
-    // get file size by seeking to the end
-    if (fseek(file, 0, SEEK_END) != 0) {
-        fclose(file);
-        return NULL;
+/**
+ * @brief checks that a name starts inside the dictionary bytes and is terminated there
+ * @param bytes the dictionary bytes
+ * @param size the size of the dictionary
+ * @param name_offset binary offset of the name
+ * @return 1 if the name can be read as a C string, 0 otherwise
+ */
+static int name_in_bounds(const uint8_t *bytes, const size_t size, const size_t name_offset) {
+    return name_offset < size && memchr(bytes + name_offset, '\0', size - name_offset) != NULL;
+}
+
+/**
+ * @brief computes the 32-bit FNV-1a hash of a string
+ * @param s null-terminated string
+ * @return the hash value
+ */
+static uint32_t hash_name(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
     }
+    return h;
+}
 
-    const long file_size = ftell(file);
-    if (file_size <= 0) {
-        fclose(file);
+/**
+ * @brief converts a binary entry offset into an entry index
+ * @param index the compiled index
+ * @param offset binary offset of an entry
+ * @param entry pointer to store the entry index
+ * @return 1 if the offset is the start of a decoded entry, 0 otherwise
+ */
+static int entry_index_of(const bej_dict_index_t *index, const uint16_t offset, uint16_t *entry) {
+    if (offset < BEJ_OFFSET_ENTRIES_START)
+        return 0;
+    const uint16_t rel = (uint16_t)(offset - BEJ_OFFSET_ENTRIES_START);
+    if (rel % BEJ_DICTIONARY_ENTRY_SIZE != 0)
+        return 0;
+    const uint16_t i = (uint16_t)(rel / BEJ_DICTIONARY_ENTRY_SIZE);
+    if (i >= index->entry_count)
+        return 0;
+    *entry = i;
+    return 1;
+}
+
+/**
+ * @brief fills a bej_dict_entry_t from the decoded arrays
+ * @param index the compiled index
+ * @param i entry index
+ * @param dest output entry
+ */
+static void fill_entry(const bej_dict_index_t *index, const uint16_t i, bej_dict_entry_t *dest) {
+    dest->format = index->format[i];
+    dest->flags = index->flags[i];
+    dest->sequence = index->sequence[i];
+    dest->child_pointer = index->child_pointer[i];
+    dest->child_count = index->child_count[i];
+    dest->name = index->name[i];
+    dest->sfl_prefix = index->sfl_prefix[i];
+}
+
+/**
+ * @brief returns the subset for a child pointer / child count pair
+ * @param index the compiled index
+ * @param offset binary offset of the subset
+ * @param child_count number of entries in the subset
+ * @return the subset, or NULL if it is not indexed
+ */
+static const bej_dict_subset_t *find_subset(const bej_dict_index_t *index,
+                                           const uint16_t offset,
+                                           const uint16_t child_count) {
+    uint16_t first;
+    if (!index || !entry_index_of(index, offset, &first))
         return NULL;
+    const uint32_t id = index->subset_by_entry[first];
+    if (id == BEJ_DICT_NO_SUBSET || index->subsets[id].count != child_count)
+        return NULL;
+    return &index->subsets[id];
+}
+
+/**
+ * @brief releases a compiled index
+ * @param index index to free (NULL-safe)
+ */
+static void free_index(bej_dict_index_t *index) {
+    if (!index)
+        return;
+    free(index->format);
+    free(index->flags);
+    free(index->sequence);
+    free(index->child_pointer);
+    free(index->child_count);
+    free((void *)index->name);
+    free(index->name_hash);
+    free(index->sfl_prefix);
+    free(index->subset_by_entry);
+    free(index->subsets);
+    free(index->tables);
+    free(index);
+}
+
+/**
+ * @brief decides whether a subset's sequence numbers are dense enough for a direct table
+ * @param max_seq largest sequence number in the subset
+ * @param count number of entries in the subset
+ * @return 1 if a table of max_seq + 1 slots should be built
+ */
+static int use_seq_table(const uint32_t max_seq, const uint32_t count) {
+    return max_seq < 4 * count + 16;
+}
+
+/**
+ * @brief returns the number of name hash slots for a subset (a power of two, load factor <= 0.5)
+ * @param count number of entries in the subset
+ * @return number of slots
+ */
+static uint32_t name_table_slots(const uint32_t count) {
+    uint32_t slots = 4;
+    while (slots < 2 * count)
+        slots <<= 1;
+    return slots;
+}
+
+/**
+ * @brief decodes all entries into the index arrays
+ * @param dict the dictionary
+ * @param index the index to fill (arrays already allocated)
+ */
+static void decode_entries(const bej_dictionary_t *dict, bej_dict_index_t *index) {
+    for (uint16_t i = 0; i < index->entry_count; i++) {
+        const uint8_t *entry_data = dict->bytes + BEJ_OFFSET_ENTRIES_START + (size_t)i * BEJ_DICTIONARY_ENTRY_SIZE;
+
+        const uint8_t format_flags = entry_data[BEJ_ENTRY_OFFSET_FORMAT_FLAGS];
+        index->format[i] = (uint8_t)(format_flags >> 4);
+        index->flags[i] = (uint8_t)(format_flags & 0x0F);
+        index->sequence[i] = read_u16(entry_data + BEJ_ENTRY_OFFSET_SEQUENCE);
+        index->child_pointer[i] = read_u16(entry_data + BEJ_ENTRY_OFFSET_CHILD_POINTER);
+        index->child_count[i] = read_u16(entry_data + BEJ_ENTRY_OFFSET_CHILD_COUNT);
+        index->subset_by_entry[i] = BEJ_DICT_NO_SUBSET;
+        index->sfl_prefix[i] = bej_sfl_prefix((uint64_t)index->sequence[i] << 1, index->format[i]);
+
+        const uint8_t name_length = entry_data[BEJ_ENTRY_OFFSET_NAME_LEN];
+        const uint16_t name_offset = read_u16(entry_data + BEJ_ENTRY_OFFSET_NAME_OFFSET);
+
+        // only keep names that are terminated inside the dictionary, so hashing stays in bounds
+        index->name[i] = NULL;
+        index->name_hash[i] = 0;
+        if (name_length > 0 && (dict->trusted || name_in_bounds(dict->bytes, dict->size, name_offset))) {
+            index->name[i] = (const char *)(dict->bytes + name_offset);
+            index->name_hash[i] = hash_name(index->name[i]);
+        }
     }
-    rewind(file);
+}
 
-    // allocate a single buffer for the entire file
-    uint8_t *buffer = malloc((size_t)file_size);
-    if (!buffer) {
-        fclose(file);
-        return NULL;
+/**
+ * @brief registers the child subset of every parent entry and sizes its tables
+ * @param index the index with decoded entries
+ * @return total number of table slots needed
+ */
+static size_t collect_subsets(bej_dict_index_t *index) {
+    size_t table_size = 0;
+
+    for (uint16_t i = 0; i < index->entry_count; i++) {
+        const uint16_t count = index->child_count[i];
+        uint16_t first;
+        if (count == 0 || count == BEJ_CHILD_COUNT_WILDCARD ||
+            !entry_index_of(index, index->child_pointer[i], &first) ||
+            (uint32_t)first + count > index->entry_count)
+            continue;
+
+        // subsets are shared by parents with the same children (e.g. common enums)
+        if (index->subset_by_entry[first] != BEJ_DICT_NO_SUBSET)
+            continue;
+
+        bej_dict_subset_t *subset = &index->subsets[index->subset_count];
+        index->subset_by_entry[first] = index->subset_count++;
+        subset->first = first;
+        subset->count = count;
+
+        uint32_t max_seq = 0;
+        for (uint16_t k = 0; k < count; k++) {
+            if (index->sequence[first + k] > max_seq)
+                max_seq = index->sequence[first + k];
+        }
+
+        subset->seq_table = BEJ_DICT_NO_SEQ_TABLE;
+        subset->seq_limit = 0;
+        if (use_seq_table(max_seq, count)) {
+            subset->seq_table = (uint32_t)table_size;
+            subset->seq_limit = max_seq + 1;
+            table_size += subset->seq_limit;
+        }
+
+        const uint32_t slots = name_table_slots(count);
+        subset->name_table = (uint32_t)table_size;
+        subset->name_mask = slots - 1;
+        table_size += slots;
     }
+    return table_size;
+}
 
-    if (fread(buffer, 1, (size_t)file_size, file) != (size_t)file_size) {
-        free(buffer);
-        fclose(file);
-        return NULL;
+/**
+ * @brief fills the sequence and name tables of every subset
+ * @param index the index with registered subsets and allocated tables
+ */
+static void fill_tables(bej_dict_index_t *index) {
+    for (uint32_t s = 0; s < index->subset_count; s++) {
+        const bej_dict_subset_t *subset = &index->subsets[s];
+
+        for (uint16_t k = 0; k < subset->count; k++) {
+            const uint16_t e = (uint16_t)(subset->first + k);
+
+            // the first entry wins on duplicates, like a linear scan would
+            if (subset->seq_table != BEJ_DICT_NO_SEQ_TABLE) {
+                uint16_t *slot = &index->tables[subset->seq_table + index->sequence[e]];
+                if (*slot == BEJ_DICT_INDEX_NONE)
+                    *slot = e;
+            }
+
+            const char *name = index->name[e];
+            if (!name)
+                continue;
+            uint16_t *names = &index->tables[subset->name_table];
+            uint32_t h = index->name_hash[e] & subset->name_mask;
+            while (names[h] != BEJ_DICT_INDEX_NONE && strcmp(index->name[names[h]], name) != 0)
+                h = (h + 1) & subset->name_mask;
+            if (names[h] == BEJ_DICT_INDEX_NONE)
+                names[h] = e;
+        }
+    }
+}
+
+int bej_dictionary_validate(const bej_dictionary_t *dict) {
+    uint16_t entry_count;
+    size_t name_table_offset;
+    if (!dict || !dict->bytes || !read_dictionary_header(dict, &entry_count, &name_table_offset) || entry_count == 0)
+        return 0;
+
+    for (uint16_t i = 0; i < entry_count; i++) {
+        const uint8_t *entry_data = dict->bytes + BEJ_OFFSET_ENTRIES_START + (size_t)i * BEJ_DICTIONARY_ENTRY_SIZE;
+
+        // a wildcard subset runs to the end of the bytes, only its first entry (the element) is known
+        const uint16_t child_pointer = read_u16(entry_data + BEJ_ENTRY_OFFSET_CHILD_POINTER);
+        const uint16_t child_count = read_u16(entry_data + BEJ_ENTRY_OFFSET_CHILD_COUNT);
+        const uint32_t children = child_count == BEJ_CHILD_COUNT_WILDCARD ? 1u : child_count;
+        if (children > 0 && !entries_in_table(child_pointer, entry_count, children))
+            return 0;
+
+        const uint8_t name_length = entry_data[BEJ_ENTRY_OFFSET_NAME_LEN];
+        const size_t name_offset = read_u16(entry_data + BEJ_ENTRY_OFFSET_NAME_OFFSET);
+        if (name_length > 0 &&
+            (name_offset + name_length > dict->size || dict->bytes[name_offset + name_length - 1] != '\0'))
+            return 0;
+    }
+    return 1;
+}
+
+int bej_dictionary_build_index(bej_dictionary_t *dict) {
+    if (!dict)
+        return 0;
+
+    free_index(dict->index);
+    dict->index = NULL;
+    dict->trusted = bej_dictionary_validate(dict);
+
+    uint16_t entry_count;
+    size_t name_table_offset;
+    if (!read_dictionary_header(dict, &entry_count, &name_table_offset))
+        return 0;
+
+    bej_dict_index_t *index = calloc(1, sizeof(*index));
+    if (!index)
+        return 0;
+
+    const size_t n = entry_count ? entry_count : 1;
+    index->entry_count = entry_count;
+    index->format = malloc(n * sizeof(*index->format));
+    index->flags = malloc(n * sizeof(*index->flags));
+    index->sequence = malloc(n * sizeof(*index->sequence));
+    index->child_pointer = malloc(n * sizeof(*index->child_pointer));
+    index->child_count = malloc(n * sizeof(*index->child_count));
+    index->name = malloc(n * sizeof(*index->name));
+    index->name_hash = malloc(n * sizeof(*index->name_hash));
+    index->sfl_prefix = malloc(n * sizeof(*index->sfl_prefix));
+    index->subset_by_entry = malloc(n * sizeof(*index->subset_by_entry));
+    index->subsets = malloc(n * sizeof(*index->subsets));
+    if (!index->format || !index->flags || !index->sequence || !index->child_pointer ||
+        !index->child_count || !index->name || !index->name_hash || !index->sfl_prefix ||
+        !index->subset_by_entry || !index->subsets) {
+        free_index(index);
+        return 0;
     }
-    fclose(file);
+
+    decode_entries(dict, index);
+    index->table_size = collect_subsets(index);
+
+    index->tables = malloc((index->table_size ? index->table_size : 1) * sizeof(*index->tables));
+    if (!index->tables) {
+        free_index(index);
+        return 0;
+    }
+    memset(index->tables, 0xFF, index->table_size * sizeof(*index->tables)); // BEJ_DICT_INDEX_NONE
+    fill_tables(index);
+
+    // the root's children are the global annotation scope of an annotation dictionary
+    uint16_t first;
+    index->root_subset = BEJ_DICT_NO_SUBSET;
+    if (entry_count > 0 && entry_index_of(index, index->child_pointer[0], &first) &&
+        index->subset_by_entry[first] != BEJ_DICT_NO_SUBSET &&
+        index->subsets[index->subset_by_entry[first]].count == index->child_count[0])
+        index->root_subset = index->subset_by_entry[first];
+
+    dict->index = index;
+    return 1;
+}
+
+/**
+ * @brief identity of a dictionary file: the path it was loaded from and the file behind it
+ */
+typedef struct dict_cache_key
+{
+    const char *path;       /**< path as passed to the loader */
+    dev_t       dev;        /**< device of the file */
+    ino_t       ino;        /**< inode of the file */
+    off_t       size;       /**< size of the file */
+    time_t      mtime_sec;  /**< modification time, seconds */
+    long        mtime_nsec; /**< modification time, nanoseconds */
+} dict_cache_key_t;
+
+/**
+ * @brief a cached dictionary and the number of references handed out
+ */
+typedef struct dict_cache_slot
+{
+    struct dict_cache_slot *next; /**< next slot in the cache */
+    dict_cache_key_t        key;  /**< identity of the file (owns `key.path`) */
+    bej_dictionary_t       *dict; /**< the shared dictionary */
+    unsigned                refs; /**< outstanding references (0 = resident but unused) */
+} dict_cache_slot_t;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static dict_cache_slot_t *cache_head = NULL;
+static bej_dictionary_t *builtins[BEJ_DICT_MAX_BUILTINS];
+static size_t builtin_count = 0;
+
+/**
+ * @brief fills a cache key from the stat of an open dictionary file
+ * @param path path the file was opened with
+ * @param st status of the file
+ * @param key pointer to store the key
+ */
+static void make_cache_key(const char *path, const struct stat *st, dict_cache_key_t *key) {
+    key->path = path;
+    key->dev = st->st_dev;
+    key->ino = st->st_ino;
+    key->size = st->st_size;
+#if defined(__APPLE__)
+    key->mtime_sec = st->st_mtimespec.tv_sec;
+    key->mtime_nsec = st->st_mtimespec.tv_nsec;
+#else
+    key->mtime_sec = st->st_mtim.tv_sec;
+    key->mtime_nsec = st->st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ * @brief checks whether two keys describe the same, unchanged file
+ * @param a first key
+ * @param b second key
+ * @return 1 if the file identity matches, 0 otherwise (paths are not compared)
+ */
+static int same_file(const dict_cache_key_t *a, const dict_cache_key_t *b) {
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+           a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec;
+}
+
+/**
+ * @brief unmaps the bytes of a dictionary and frees it with its index
+ * @param dict dictionary to destroy
+ */
+static void destroy_dictionary(bej_dictionary_t *dict) {
+    bej_file_view_t view = {.data = dict->bytes, .size = dict->size, .mapped = dict->mapped};
+    bej_file_view_release(&view);
+    free_index(dict->index);
+    free(dict);
+}
+
+/**
+ * @brief destroys an unlinked cache slot together with its dictionary
+ * @param slot slot to destroy
+ */
+static void destroy_slot(dict_cache_slot_t *slot) {
+    destroy_dictionary(slot->dict);
+    free((char *)slot->key.path);
+    free(slot);
+}
+
+/**
+ * @brief maps a dictionary file and builds its index
+ * @param file the open dictionary file
+ * @return pointer to a new bej_dictionary_t, a matching built-in, or NULL on failure (must be called with cache_lock held)
+ */
+static bej_dictionary_t *open_dictionary(FILE *file) {
+    bej_file_view_t view;
+    if (!bej_file_view_stream(file, &view))
+        return NULL;
 
     // perform a temporary cast to validate the header before final allocation
-    const bej_dictionary_t temp_dict = {.bytes = buffer, .size = (size_t)file_size};
+    const bej_dictionary_t temp_dict = {.bytes = view.data, .size = view.size};
     if (!validate_dictionary_header(&temp_dict)) {
-        free(buffer);
+        bej_file_view_release(&view);
         return NULL;
     }
 
+    // a file with the contents of a built-in is served from the compiled tables
+    for (size_t i = 0; i < builtin_count; i++) {
+        if (builtins[i]->size == view.size && memcmp(builtins[i]->bytes, view.data, view.size) == 0) {
+            bej_file_view_release(&view);
+            return builtins[i];
+        }
+    }
+
     bej_dictionary_t *dictionary = malloc(sizeof(*dictionary));
     if (!dictionary) {
-        free(buffer);
+        bej_file_view_release(&view);
+        return NULL;
+    }
+
+    dictionary->bytes = view.data;
+    dictionary->size = view.size;
+    dictionary->mapped = view.mapped;
+    dictionary->builtin = 0;
+    dictionary->index = NULL;
+    dictionary->trusted = 0;
+    bej_dictionary_build_index(dictionary); // without an index lookups fall back to linear scans
+    return dictionary;
+}
+
+/**
+ * @brief looks up a loaded file in the cache, evicting unused slots left behind by a rewrite of the file
+ * @param key identity of the file
+ * @return the matching slot or NULL (must be called with cache_lock held)
+ */
+static dict_cache_slot_t *cache_lookup(const dict_cache_key_t *key) {
+    dict_cache_slot_t **link = &cache_head;
+    while (*link) {
+        dict_cache_slot_t *slot = *link;
+        if (strcmp(slot->key.path, key->path) == 0) {
+            if (same_file(&slot->key, key))
+                return slot;
+            if (slot->refs == 0) {
+                // the file changed on disk and nobody holds the old version
+                *link = slot->next;
+                destroy_slot(slot);
+                continue;
+            }
+        }
+        link = &slot->next;
+    }
+    return NULL;
+}
+
+/**
+ * @brief adds a freshly loaded dictionary to the cache with one reference
+ * @param key identity of the file (the path is copied)
+ * @param dict dictionary to cache
+ * @return 1 on success, 0 on allocation failure (must be called with cache_lock held)
+ */
+static int cache_insert(const dict_cache_key_t *key, bej_dictionary_t *dict) {
+    dict_cache_slot_t *slot = malloc(sizeof(*slot));
+    char *path = slot ? strdup(key->path) : NULL;
+    if (!path) {
+        free(slot);
+        return 0;
+    }
+
+    slot->key = *key;
+    slot->key.path = path;
+    slot->dict = dict;
+    slot->refs = 1;
+    slot->next = cache_head;
+    cache_head = slot;
+    return 1;
+}
+
+bej_dictionary_t *bej_dictionary_load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    // identify the file through the open descriptor so the key matches what gets mapped
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0) {
+        fclose(file);
         return NULL;
     }
+    dict_cache_key_t key;
+    make_cache_key(path, &st, &key);
+    const int cacheable = S_ISREG(st.st_mode); // pipes have no stable identity
+
+    // loading happens under the lock so concurrent first loads map the file only once
+    pthread_mutex_lock(&cache_lock);
+    dict_cache_slot_t *slot = cacheable ? cache_lookup(&key) : NULL;
+    bej_dictionary_t *dictionary;
+    if (slot) {
+        slot->refs++;
+        dictionary = slot->dict;
+    } else {
+        dictionary = open_dictionary(file);
+        // if the slot cannot be allocated the caller simply gets a private copy
+        if (dictionary && !dictionary->builtin && cacheable)
+            cache_insert(&key, dictionary);
+    }
+    pthread_mutex_unlock(&cache_lock);
 
-    dictionary->bytes = buffer;
-    dictionary->size = (size_t)file_size;
+    fclose(file); // a mapping stays valid after the descriptor is closed
     return dictionary;
 }
 
@@ -133,10 +620,51 @@ bej_dictionary_t *bej_dictionary_load_map(const char *path) {
 }
 
 void bej_dictionary_free(bej_dictionary_t *dict) {
-    if (!dict)
+    if (!dict || dict->builtin)
         return;
-    free(dict->bytes); // free the raw data buffer
-    free(dict);        // free the struct itself
+
+    pthread_mutex_lock(&cache_lock);
+    dict_cache_slot_t *slot = cache_head;
+    while (slot && slot->dict != dict)
+        slot = slot->next;
+    if (slot && slot->refs > 0)
+        slot->refs--; // stays resident for the next load
+    pthread_mutex_unlock(&cache_lock);
+
+    if (!slot)
+        destroy_dictionary(dict); // never made it into the cache
+}
+
+int bej_dictionary_register_builtin(bej_dictionary_t *dict) {
+    if (!dict || !dict->builtin || !dict->index || !validate_dictionary_header(dict))
+        return 0;
+
+    pthread_mutex_lock(&cache_lock);
+    const int ok = builtin_count < BEJ_DICT_MAX_BUILTINS;
+    if (ok)
+        builtins[builtin_count++] = dict;
+    pthread_mutex_unlock(&cache_lock);
+    return ok;
+}
+
+size_t bej_dictionary_cache_flush(void) {
+    size_t released = 0;
+
+    pthread_mutex_lock(&cache_lock);
+    dict_cache_slot_t **link = &cache_head;
+    while (*link) {
+        dict_cache_slot_t *slot = *link;
+        if (slot->refs > 0) {
+            link = &slot->next;
+            continue;
+        }
+        *link = slot->next;
+        destroy_slot(slot);
+        released++;
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    return released;
 }
 
 void bej_dict_stream_init(bej_dict_stream_t *s, const bej_dictionary_t *dict) {
@@ -145,6 +673,7 @@ void bej_dict_stream_init(bej_dict_stream_t *s, const bej_dictionary_t *dict) {
     s->index = 0;
     s->child_count = 0;
     s->current_entry = 0;
+    s->trusted = 0;
 
     if (dict && validate_dictionary_header(dict)) {
         uint16_t entry_count;
@@ -153,6 +682,7 @@ void bej_dict_stream_init(bej_dict_stream_t *s, const bej_dictionary_t *dict) {
         if (read_dictionary_header(dict, &entry_count, &name_table_offset)) {
             s->index = BEJ_OFFSET_ENTRIES_START;
             s->child_count = 1; // top-level has a single root entry
+            s->trusted = dict->trusted;
         }
     }
 }
@@ -166,6 +696,10 @@ void bej_dict_stream_init_subset(bej_dict_stream_t *s,
     s->index = offset;
     s->child_count = (child_count == BEJ_CHILD_COUNT_WILDCARD) ? -1 : (int)child_count;
     s->current_entry = 0;
+
+    // one check here instead of one per entry: a subset of validated entries needs no more
+    s->trusted = dict && dict->trusted && child_count != BEJ_CHILD_COUNT_WILDCARD &&
+                 entries_in_table(offset, read_u16(dict->bytes + BEJ_OFFSET_ENTRY_COUNT), child_count);
 }
 
 int bej_dict_stream_has_entry(const bej_dict_stream_t *s) {
@@ -185,7 +719,7 @@ int bej_dict_stream_next(bej_dict_stream_t *s, bej_dict_entry_t *dest) {
     if (!bej_dict_stream_has_entry(s))
         return 0;
 
-    if (s->index + BEJ_DICTIONARY_ENTRY_SIZE > s->size)
+    if (!s->trusted && s->index + BEJ_DICTIONARY_ENTRY_SIZE > s->size)
         return 0;
 
     // get a pointer to the start of the raw entry data
@@ -197,12 +731,13 @@ int bej_dict_stream_next(bej_dict_stream_t *s, bej_dict_entry_t *dest) {
     dest->sequence = read_u16(entry_data + BEJ_ENTRY_OFFSET_SEQUENCE);
     dest->child_pointer = read_u16(entry_data + BEJ_ENTRY_OFFSET_CHILD_POINTER);
     dest->child_count = read_u16(entry_data + BEJ_ENTRY_OFFSET_CHILD_COUNT);
+    dest->sfl_prefix = bej_sfl_prefix((uint64_t)dest->sequence << 1, dest->format);
 
     const uint8_t name_length = entry_data[BEJ_ENTRY_OFFSET_NAME_LEN];
     const uint16_t name_offset = read_u16(entry_data + BEJ_ENTRY_OFFSET_NAME_OFFSET);
 
     dest->name = NULL;
-    if (name_length > 0 && name_offset < s->size)
+    if (name_length > 0 && (s->trusted || name_in_bounds(s->bytes, s->size, name_offset)))
         dest->name = (const char*)(s->bytes + name_offset);
 
     // advance the stream to the next entry
@@ -214,13 +749,30 @@ int bej_dict_stream_next(bej_dict_stream_t *s, bej_dict_entry_t *dest) {
     return 1;
 }
 
-int bej_dict_find_child_by_name(const bej_dictionary_t *dict,
-                               const uint16_t offset,
-                               const uint16_t child_count,
-                               const char *name,
-                               bej_dict_entry_t *dest) {
-    if (!dict || !name || !dest)
+/**
+ * @brief finds a child entry by name, see bej_dict_find_child_by_name()
+ */
+static int find_child_by_name(const bej_dictionary_t *dict,
+                              const uint16_t offset,
+                              const uint16_t child_count,
+                              const char *name,
+                              bej_dict_entry_t *dest) {
+    const bej_dict_index_t *index = dict->index;
+    const bej_dict_subset_t *subset = find_subset(index, offset, child_count);
+    if (subset) {
+        const uint16_t *names = &index->tables[subset->name_table];
+        const uint32_t h = hash_name(name);
+        for (uint32_t slot = h & subset->name_mask; names[slot] != BEJ_DICT_INDEX_NONE;
+             slot = (slot + 1) & subset->name_mask) {
+            BEJ_STATS_ADD(dict_probes, 1);
+            const uint16_t e = names[slot];
+            if (index->name_hash[e] == h && strcmp(index->name[e], name) == 0) {
+                fill_entry(index, e, dest);
+                return 1;
+            }
+        }
         return 0;
+    }
 
     bej_dict_stream_t stream;
     bej_dict_stream_init_subset(&stream, dict, offset, child_count);
@@ -228,6 +780,7 @@ int bej_dict_find_child_by_name(const bej_dictionary_t *dict,
     // linear search through the subset
     bej_dict_entry_t entry;
     while (bej_dict_stream_next(&stream, &entry)) {
+        BEJ_STATS_ADD(dict_probes, 1);
         if (entry.name && strcmp(entry.name, name) == 0) {
             *dest = entry;
             return 1;
@@ -236,3 +789,118 @@ int bej_dict_find_child_by_name(const bej_dictionary_t *dict,
 
     return 0;
 }
+
+/**
+ * @brief finds a child entry by sequence number, see bej_dict_find_child_by_seq()
+ */
+static int find_child_by_seq(const bej_dictionary_t *dict,
+                             const uint16_t offset,
+                             const uint16_t child_count,
+                             const uint64_t sequence,
+                             bej_dict_entry_t *dest) {
+    const bej_dict_index_t *index = dict->index;
+    const bej_dict_subset_t *subset = find_subset(index, offset, child_count);
+    if (subset && subset->seq_table != BEJ_DICT_NO_SEQ_TABLE) {
+        BEJ_STATS_ADD(dict_probes, 1);
+        if (sequence >= subset->seq_limit)
+            return 0;
+        const uint16_t e = index->tables[subset->seq_table + sequence];
+        if (e == BEJ_DICT_INDEX_NONE)
+            return 0;
+        fill_entry(index, e, dest);
+        return 1;
+    }
+
+    if (subset) {
+        // sparse sequence numbers: scan the decoded array instead of re-parsing entries
+        for (uint16_t k = 0; k < subset->count; k++) {
+            BEJ_STATS_ADD(dict_probes, 1);
+            const uint16_t e = (uint16_t)(subset->first + k);
+            if (index->sequence[e] == sequence) {
+                fill_entry(index, e, dest);
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // not indexed: linear search through the raw subset
+    bej_dict_stream_t stream;
+    bej_dict_stream_init_subset(&stream, dict, offset, child_count);
+    while (bej_dict_stream_next(&stream, dest)) {
+        BEJ_STATS_ADD(dict_probes, 1);
+        if (dest->sequence == sequence)
+            return 1;
+    }
+    return 0;
+}
+
+int bej_dict_find_child_by_name(const bej_dictionary_t *dict,
+                               const uint16_t offset,
+                               const uint16_t child_count,
+                               const char *name,
+                               bej_dict_entry_t *dest) {
+    if (!dict || !name || !dest)
+        return 0;
+
+    BEJ_STATS_ADD(dict_lookups, 1);
+    BEJ_STATS_TIME_BEGIN(started);
+    const int found = find_child_by_name(dict, offset, child_count, name, dest);
+    BEJ_STATS_TIME_END(dict_ns, started);
+    return found;
+}
+
+int bej_dict_find_child_by_seq(const bej_dictionary_t *dict,
+                               const uint16_t offset,
+                               const uint16_t child_count,
+                               const uint64_t sequence,
+                               bej_dict_entry_t *dest) {
+    if (!dict || !dest)
+        return 0;
+
+    BEJ_STATS_ADD(dict_lookups, 1);
+    BEJ_STATS_TIME_BEGIN(started);
+    const int found = find_child_by_seq(dict, offset, child_count, sequence, dest);
+    BEJ_STATS_TIME_END(dict_ns, started);
+    return found;
+}
+
+/**
+ * @brief returns the subset holding the top-level annotations (the root entry's children)
+ * @param annot_dict the annotation dictionary
+ * @param offset pointer to store the binary offset of the subset
+ * @param child_count pointer to store the number of entries in the subset
+ * @return 1 on success, 0 if the dictionary has no root entry
+ */
+static int annotation_scope(const bej_dictionary_t *annot_dict, uint16_t *offset, uint16_t *child_count) {
+    const bej_dict_index_t *index = annot_dict->index;
+    if (index && index->root_subset != BEJ_DICT_NO_SUBSET) {
+        const bej_dict_subset_t *subset = &index->subsets[index->root_subset];
+        *offset = (uint16_t)(BEJ_OFFSET_ENTRIES_START + subset->first * BEJ_DICTIONARY_ENTRY_SIZE);
+        *child_count = subset->count;
+        return 1;
+    }
+
+    bej_dict_stream_t stream;
+    bej_dict_entry_t root;
+    bej_dict_stream_init(&stream, annot_dict);
+    if (!bej_dict_stream_next(&stream, &root))
+        return 0;
+    *offset = root.child_pointer;
+    *child_count = root.child_count;
+    return 1;
+}
+
+int bej_dict_find_annotation_by_name(const bej_dictionary_t *annot_dict, const char *name, bej_dict_entry_t *dest) {
+    uint16_t offset, child_count;
+    if (!annot_dict || !annotation_scope(annot_dict, &offset, &child_count))
+        return 0;
+    return bej_dict_find_child_by_name(annot_dict, offset, child_count, name, dest);
+}
+
+int bej_dict_find_annotation_by_seq(const bej_dictionary_t *annot_dict, const uint64_t sequence, bej_dict_entry_t *dest) {
+    uint16_t offset, child_count;
+    if (!annot_dict || !annotation_scope(annot_dict, &offset, &child_count))
+        return 0;
+    return bej_dict_find_child_by_seq(annot_dict, offset, child_count, sequence, dest);
+}
@@ -4,256 +4,638 @@
  *
  * This file contains the internal (static) functions for encoding a JSON tree
  * into the BEJ binary format, according to a schema dictionary.
+ *
+ * All output goes into a single growable bej_buffer_t. Every SFL length field
+ * is produced in one of two ways:
+ * - canonical: a sizing pass walks the tree once and records the payload size
+ *   of every SFL in pre-order, then the emit pass writes minimal-width lengths
+ *   straight from that table
+ * - fixed width: a single pass reserves a fixed-width nnint slot for every
+ *   length and back-patches it once the payload has been written
+ *
+ * The streaming encoder drives the fixed width pass from json_reader_t events
+ * instead of a tree. Set and array counts are not known up front either, so
+ * they get fixed-width slots too. When the output stream is seekable the
+ * buffer is flushed as it fills and slots that already left it are patched
+ * in the stream, so only the open containers on the C stack stay resident
  */
 
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
 
 #include "bej_encode.h"
+#include "bej_bind.h"
+#include "bej_stats.h"
+#include "bej_buffer.h"
+#include "bej_cursor.h"
 #include "bej_dictionary.h"
+#include "bej_pool.h"
 #include "json.h"
 
+#define BEJ_FIXED_LENGTH_WIDTH 4 /**< byte width of a back-patched length nnint */
+#define BEJ_STREAM_FLUSH_SIZE (64u * 1024u) /**< pending bytes that trigger a flush to a seekable stream */
+#define BEJ_SCALAR_ELEMENT_MAX 32 /**< upper bound of an encoded Integer, Boolean or Enum array element */
+
+/**
+ * @brief the pass the encoder is currently running
+ */
+typedef enum {
+    ENCODE_PASS_SIZE = 0, /**< only measure, record SFL payload sizes */
+    ENCODE_PASS_EMIT,     /**< write bytes, lengths come from the sizing pass */
+    ENCODE_PASS_FIXED     /**< write bytes, lengths are back-patched */
+} encode_pass_t;
+
+/**
+ * @brief a JSON object member whose key was found in the dictionary
+ */
+typedef struct {
+    bej_dict_entry_t entry;    /**< the dictionary entry of the key */
+    const json_value_t* value; /**< the member value */
+    uint8_t selector;          /**< the dictionary selector (0 for schema, 1 for annotation) */
+    uint8_t matched;           /**< patch state of a patch member, see patch_members() */
+} resolved_property_t;
+
+/**
+ * @brief state shared by all static functions of a single encode call
+ */
+typedef struct {
+    encode_pass_t pass;                 /**< current pass */
+    bej_buffer_t* out;                  /**< output buffer (unused during the sizing pass) */
+    size_t pos;                         /**< bytes produced so far during the sizing pass */
+    int failed;                         /**< sticky allocation/overflow error flag */
+    uint64_t* sizes;                    /**< SFL payload sizes in pre-order */
+    size_t size_count;                  /**< number of recorded sizes */
+    size_t size_capacity;               /**< allocated entries in `sizes` */
+    size_t size_cursor;                 /**< next size to consume during the emit pass */
+    resolved_property_t* props;         /**< scratch stack of resolved properties of the open sets */
+    size_t prop_top;                    /**< number of used entries in `props` */
+    size_t prop_capacity;               /**< allocated entries in `props` */
+    const bej_dictionary_t* schema_dict; /**< the main schema dictionary */
+    const bej_dictionary_t* annot_dict;  /**< the annotation dictionary */
+    json_reader_t* reader;              /**< event source of the streaming encoder (or NULL) */
+    FILE* sink;                         /**< seekable stream flushed to while streaming (or NULL) */
+    off_t sink_origin;                  /**< stream offset of the first output byte */
+    uint64_t flushed;                   /**< bytes already moved from `out` to `sink` */
+} encode_ctx_t;
+
+/**
+ * @brief handle for an open SFL length field, returned by begin_sfl()
+ */
+typedef struct {
+    uint64_t index; /**< slot in the size table (sizing pass) or output offset of the slot (fixed width pass) */
+    uint64_t start; /**< position where the payload starts */
+} length_mark_t;
+
 // Prototypes for static functions
-static int encode_properties(FILE* out, const json_value_t* json_object,
-                             const bej_dict_entry_t* parent_entry,
-                             const bej_dictionary_t* schema_dict,
-                             const bej_dictionary_t* annot_dict);
+static int encode_properties(encode_ctx_t* ctx, const json_value_t* json_object,
+                             const bej_dict_entry_t* parent_entry, uint8_t parent_selector);
+
+static int encode_value(encode_ctx_t* ctx, const bej_dict_entry_t* entry,
+                        uint8_t selector, const json_value_t* json_value);
+
+/**
+ * @brief appends raw bytes to the output (or just counts them while sizing)
+ * @param ctx the encoder state
+ * @param data the bytes to write
+ * @param n the number of bytes
+ */
+static void emit_bytes(encode_ctx_t* ctx, const void* data, const size_t n) {
+    if (ctx->pass == ENCODE_PASS_SIZE) {
+        ctx->pos += n;
+        return;
+    }
+    if (!bej_buffer_append(ctx->out, data, n))
+        ctx->failed = 1;
+}
+
+/**
+ * @brief returns where the next field of at most `n` bytes is built
+ *
+ * Fields are built in place while the output has room and in `scratch` near
+ * the end of a wrapped buffer, see emit_built()
+ *
+ * @param ctx the encoder state (not in the sizing pass)
+ * @param scratch fallback memory of `n` bytes
+ * @param n the room the field needs
+ * @return the output end or `scratch`
+ */
+static uint8_t* emit_begin(encode_ctx_t* ctx, uint8_t* scratch, const size_t n) {
+    uint8_t* p = bej_buffer_room(ctx->out, n);
+    return p ? p : scratch;
+}
+
+/**
+ * @brief adds a field built at the pointer returned by emit_begin() to the output
+ * @param ctx the encoder state
+ * @param p the pointer returned by emit_begin()
+ * @param scratch the fallback memory passed to emit_begin()
+ * @param n the bytes that belong to the field
+ */
+static void emit_built(encode_ctx_t* ctx, const uint8_t* p, const uint8_t* scratch, const size_t n) {
+    if (p == scratch)
+        emit_bytes(ctx, scratch, n);
+    else
+        ctx->out->size += n;
+}
 
-static int encode_value(FILE* out, const bej_dict_entry_t* entry,
-                        uint8_t selector, const json_value_t* json_value,
-                        const bej_dictionary_t* schema_dict,
-                        const bej_dictionary_t* annot_dict);
+/**
+ * @brief returns the number of bytes of the shortest two's complement form of an Integer
+ * @param value the value
+ * @return 1 to 8
+ */
+static size_t integer_width(const int64_t value) {
+    // negative values have as many significant bits as their complement, plus the sign bit
+    const uint64_t magnitude = (uint64_t)(value ^ (value >> 63));
+    return (size_t)(72 - __builtin_clzll(magnitude | 1)) / 8;
+}
 
 /**
  * @brief packs a 64-bit unsigned integer into the nnint format
- * @param out the output stream
+ * @param ctx the encoder state
  * @param value the value to pack
  */
-static void pack_nnint(FILE* out, const uint64_t value) {
-    uint8_t tmp[9];
-    size_t n = 0;
-    if (value == 0) {
-        tmp[0] = 1; tmp[1] = 0;
-        fwrite(tmp, 1, 2, out);
+static void pack_nnint(encode_ctx_t* ctx, const uint64_t value) {
+    if (ctx->pass == ENCODE_PASS_SIZE) {
+        ctx->pos += bej_nnint_size(value);
+        return;
+    }
+    uint8_t scratch[BEJ_NNINT_MAX_SIZE];
+    uint8_t* p = emit_begin(ctx, scratch, sizeof(scratch));
+    emit_built(ctx, p, scratch, bej_put_nnint(p, value));
+}
+
+/**
+ * @brief returns the number of bytes produced so far in the fixed width pass
+ * @param ctx the encoder state
+ * @return output offset including the bytes already flushed to the sink
+ */
+static uint64_t output_offset(const encode_ctx_t* ctx) {
+    return ctx->flushed + ctx->out->size;
+}
+
+/**
+ * @brief reserves a fixed-width nnint slot filled in later by patch_slot()
+ * @param ctx the encoder state
+ * @return the output offset of the slot
+ */
+static uint64_t reserve_slot(encode_ctx_t* ctx) {
+    const uint64_t offset = output_offset(ctx);
+    uint8_t* slot = bej_buffer_extend(ctx->out, 1 + BEJ_FIXED_LENGTH_WIDTH);
+    if (!slot) {
+        ctx->failed = 1;
+        return offset;
+    }
+    slot[0] = BEJ_FIXED_LENGTH_WIDTH;
+    return offset;
+}
+
+/**
+ * @brief writes a value into a slot returned by reserve_slot()
+ *
+ * Slots still in the buffer are patched in place, slots that were already
+ * flushed are rewritten in the sink
+ *
+ * @param ctx the encoder state
+ * @param offset the output offset of the slot
+ * @param value the value to store
+ */
+static void patch_slot(encode_ctx_t* ctx, const uint64_t offset, const uint64_t value) {
+    if (value >> (8 * BEJ_FIXED_LENGTH_WIDTH)) {
+        ctx->failed = 1;
         return;
     }
-    uint64_t v = value;
-    while (v) {
-        tmp[++n] = (uint8_t)(v & 0xFF);
-        v >>= 8;
+    uint8_t bytes[BEJ_FIXED_LENGTH_WIDTH];
+    for (int i = 0; i < BEJ_FIXED_LENGTH_WIDTH; ++i)
+        bytes[i] = (uint8_t)(value >> (8 * i));
+
+    if (offset >= ctx->flushed) {
+        memcpy(ctx->out->data + (offset - ctx->flushed) + 1, bytes, sizeof(bytes));
+        return;
     }
-    tmp[0] = (uint8_t)n;
-    fwrite(tmp, 1, n + 1, out);
+    const off_t end = ctx->sink_origin + (off_t)ctx->flushed;
+    if (fseeko(ctx->sink, ctx->sink_origin + (off_t)offset + 1, SEEK_SET) != 0 ||
+        fwrite(bytes, 1, sizeof(bytes), ctx->sink) != sizeof(bytes) ||
+        fseeko(ctx->sink, end, SEEK_SET) != 0)
+        ctx->failed = 1;
 }
 
 /**
- * @brief packs an SFL (Sequence, Format, Length) header
- * @param out the output stream
- * @param seq_with_selector the sequence number combined with the selector bit
- * @param format the format code (BEJ_FORMAT_*)
- * @param len the length of the payload (value)
+ * @brief returns the SFL prefix of a dictionary entry, precomputed with its dictionary index
+ * @param entry the dictionary entry
+ * @param selector the dictionary selector (0 for schema, 1 for annotation)
+ * @return the prefix for begin_sfl()
  */
-static void pack_sfl(FILE* out,
-                     const uint64_t seq_with_selector,
-                     const uint8_t format,
-                     const uint64_t len) {
-    pack_nnint(out, seq_with_selector);
-    const uint8_t fmt = (uint8_t)(format << 4);
-    fwrite(&fmt, 1, 1, out);
-    pack_nnint(out, len);
+static inline uint64_t entry_prefix(const bej_dict_entry_t* entry, const uint8_t selector) {
+    return entry->sfl_prefix | (uint64_t)selector << 8;
 }
 
 /**
- * @brief packs the payload for an Integer value
- * @param out the output stream
- * @param value the value to pack
- * @return 1 on success
+ * @brief points the element entry of an Array at the element with a given index
+ *
+ * The prefix is packed from the full index, so elements past the 16-bit
+ * sequence range of dictionary entries still get their own sequence number
+ *
+ * @param entry the element entry
+ * @param index the index of the element, which is its sequence number
  */
-static int pack_integer_value(FILE* out, const int64_t value) {
-    uint8_t buf[8];
-    const uint64_t u = (uint64_t)value;
-    for (int i = 0; i < 8; ++i) {
-        buf[i] = (uint8_t)(u >> (8 * i));
-    }
-    int num = 8;
-    while (num > 1) {
-        const uint8_t msb_next = buf[num - 1];
-        const uint8_t msb = buf[num - 2];
-        if ((value >= 0 && msb_next == 0x00 && (msb & 0x80) == 0) ||
-            (value < 0 && msb_next == 0xFF && (msb & 0x80) != 0)) {
-            num--;
-        } else {
+static void set_element_sequence(bej_dict_entry_t* entry, const uint64_t index) {
+    entry->sequence = (uint16_t)index;
+    entry->sfl_prefix = bej_sfl_prefix(index << 1, entry->format);
+}
+
+/**
+ * @brief reserves the next entry of the size table
+ * @param ctx the encoder state
+ * @return the index of the entry, or SIZE_MAX on allocation failure (`failed` is set)
+ */
+static size_t reserve_size(encode_ctx_t* ctx) {
+    if (ctx->size_count == ctx->size_capacity) {
+        const size_t new_capacity = ctx->size_capacity ? ctx->size_capacity * 2 : 64;
+        uint64_t* new_sizes = realloc(ctx->sizes, new_capacity * sizeof(*new_sizes));
+        if (!new_sizes) {
+            ctx->failed = 1;
+            return SIZE_MAX;
+        }
+        BEJ_STATS_ADD(allocations, 1);
+        ctx->sizes = new_sizes;
+        ctx->size_capacity = new_capacity;
+    }
+    return ctx->size_count++;
+}
+
+/**
+ * @brief writes an SFL (Sequence, Format, Length) header and opens its length field
+ *
+ * In the sizing pass a size table slot is reserved and filled by end_length().
+ * In the emit pass the recorded length is known, so the whole header is one
+ * write. In the fixed width pass the length is a BEJ_FIXED_LENGTH_WIDTH
+ * placeholder patched by end_length()
+ *
+ * @param ctx the encoder state
+ * @param prefix the sequence number and format of the header, see bej_sfl_prefix() and entry_prefix()
+ * @return a mark that must be passed to end_length() after the payload
+ */
+static length_mark_t begin_sfl(encode_ctx_t* ctx, const uint64_t prefix) {
+    length_mark_t mark = {0, 0};
+
+    if (ctx->pass == ENCODE_PASS_SIZE) {
+        const size_t index = reserve_size(ctx);
+        if (index == SIZE_MAX) return mark;
+        ctx->pos += bej_sfl_prefix_size(prefix);
+        mark.index = index;
+        mark.start = ctx->pos;
+        return mark;
+    }
+
+    BEJ_STATS_ADD(properties, 1);
+    uint8_t scratch[BEJ_SFL_MAX_SIZE];
+    uint8_t* p = emit_begin(ctx, scratch, sizeof(scratch));
+    if (ctx->pass == ENCODE_PASS_EMIT) {
+        if (ctx->size_cursor >= ctx->size_count) {
+            ctx->failed = 1;
+            return mark;
+        }
+        mark.index = ctx->size_cursor++;
+        emit_built(ctx, p, scratch, bej_put_sfl_prefix(p, prefix, ctx->sizes[mark.index]));
+        mark.start = ctx->out->size;
+    } else {
+        emit_built(ctx, p, scratch, bej_put_sfl_prefix_fixed(p, prefix, 0, BEJ_FIXED_LENGTH_WIDTH));
+        mark.start = output_offset(ctx);
+        mark.index = mark.start - (1 + BEJ_FIXED_LENGTH_WIDTH); // the slot passed to patch_slot()
+    }
+    return mark;
+}
+
+/**
+ * @brief closes a length field opened by begin_sfl()
+ * @param ctx the encoder state
+ * @param mark the mark returned by begin_sfl()
+ */
+static void end_length(encode_ctx_t* ctx, const length_mark_t mark) {
+    if (ctx->failed)
+        return;
+
+    switch (ctx->pass) {
+        case ENCODE_PASS_SIZE: {
+            const uint64_t len = ctx->pos - mark.start;
+            ctx->sizes[mark.index] = len;
+            ctx->pos += bej_nnint_size(len); // the length field precedes the payload
             break;
         }
+        case ENCODE_PASS_EMIT:
+            // both passes run the same code on the same tree, so this only trips on a bug
+            if (ctx->out->size - mark.start != ctx->sizes[mark.index])
+                ctx->failed = 1;
+            break;
+        case ENCODE_PASS_FIXED:
+            patch_slot(ctx, mark.index, output_offset(ctx) - mark.start);
+            break;
+    }
+}
+
+/**
+ * @brief packs the payload for an Integer value: its width and its two's complement bytes
+ * @param ctx the encoder state
+ * @param value the value to pack
+ * @return 1 on success
+ */
+static int pack_integer_value(encode_ctx_t* ctx, const int64_t value) {
+    const size_t width = integer_width(value);
+    if (ctx->pass == ENCODE_PASS_SIZE) {
+        ctx->pos += 2 + width;
+        return 1;
     }
-    pack_nnint(out, num);
-    fwrite(buf, 1, (size_t)num, out);
+    uint8_t scratch[2 + 8];
+    uint8_t* p = emit_begin(ctx, scratch, sizeof(scratch));
+    p[0] = 1;
+    p[1] = (uint8_t)width;
+    bej_put_u64le(p + 2, (uint64_t)value);
+    emit_built(ctx, p, scratch, 2 + width);
     return 1;
 }
 
 /**
  * @brief packs the payload for a String value
- * @param out the output stream
+ * @param ctx the encoder state
  * @param str the string to pack
  * @return 1 on success
  */
-static int pack_string_value(FILE* out, const char* str) {
+static int pack_string_value(encode_ctx_t* ctx, const char* str) {
     const size_t len = strlen(str) + 1; // including null terminator
-    pack_nnint(out, len);
-    fwrite(str, 1, len, out);
+    pack_nnint(ctx, len);
+    emit_bytes(ctx, str, len);
     return 1;
 }
 
 /**
  * @brief packs the payload for a Boolean value
- * @param out the output stream
+ * @param ctx the encoder state
  * @param value the value (0 or 1)
  * @return 1 on success
  */
-static int pack_boolean_value(FILE* out, const int value) {
-    pack_nnint(out, 1);
-    const uint8_t b = value ? 1u : 0u;
-    fwrite(&b, 1, 1, out);
+static int pack_boolean_value(encode_ctx_t* ctx, const int value) {
+    const uint8_t payload[3] = {1, 1, value ? 1u : 0u};
+    emit_bytes(ctx, payload, sizeof(payload));
     return 1;
 }
 
+/**
+ * @brief writes the payload of an Enum value: the size of the option nnint, then the option nnint
+ * @param p the destination (2 + BEJ_NNINT_MAX_SIZE bytes)
+ * @param option the sequence number of the option
+ * @return the number of bytes of the payload
+ */
+static size_t put_enum_payload(uint8_t* p, const uint64_t option) {
+    const size_t n = bej_put_nnint(p + 2, option);
+    p[0] = 1;
+    p[1] = (uint8_t)n;
+    return 2 + n;
+}
+
+/**
+ * @brief packs the payload for an Enum value given the sequence number of its option
+ * @param ctx the encoder state
+ * @param option the sequence number of the option
+ */
+static void pack_enum_sequence(encode_ctx_t* ctx, const uint64_t option) {
+    if (ctx->pass == ENCODE_PASS_SIZE) {
+        ctx->pos += 2 + bej_nnint_size(option);
+        return;
+    }
+    uint8_t scratch[2 + BEJ_NNINT_MAX_SIZE];
+    uint8_t* p = emit_begin(ctx, scratch, sizeof(scratch));
+    emit_built(ctx, p, scratch, put_enum_payload(p, option));
+}
+
 /**
  * @brief packs the payload for an Enum value
- * @param out the output stream
+ * @param ctx the encoder state
  * @param dict the dictionary to find the enum value in
  * @param entry the dictionary entry for this Enum property
  * @param enum_name the string name of the enum value
  * @return 1 on success, 0 if the value is not found
  */
-static int pack_enum_value(FILE* out,
+static int pack_enum_value(encode_ctx_t* ctx,
                            const bej_dictionary_t* dict,
                            const bej_dict_entry_t* entry,
                            const char* enum_name) {
-    bej_dict_stream_t st;
-    bej_dict_stream_init_subset(&st, dict, entry->child_pointer, entry->child_count);
     bej_dict_entry_t v;
-    uint16_t value = 0;
-    int found = 0;
-    while (bej_dict_stream_next(&st, &v)) {
-        if (v.name && strcmp(v.name, enum_name) == 0) {
-            value = v.sequence;
-            found = 1;
-            break;
+    if (!dict || !bej_dict_find_child_by_name(dict, entry->child_pointer, entry->child_count, enum_name, &v))
+        return 0;
+    pack_enum_sequence(ctx, v.sequence);
+    return 1;
+}
+
+/**
+ * @brief encodes a range of elements of an Array of Integers, Booleans or Enums in one tight loop
+ *
+ * A scalar element's length is known before it is written, so no size table
+ * slot or back-patched slot is used: the sizing pass only adds up the bytes
+ * and the other passes write every element straight into the output. An
+ * Enum option is only looked up when it differs from the previous
+ * element's. The bytes match the generic path
+ *
+ * @param ctx the encoder state
+ * @param element_entry the element entry
+ * @param selector the dictionary selector of the array, shared by its elements
+ * @param array the JSON array
+ * @param first index of the first element to encode
+ * @param count number of elements to encode
+ * @return 1 on success, 0 on failure (an element of the wrong type or an unknown enum option)
+ */
+static int encode_scalar_elements(encode_ctx_t* ctx, const bej_dict_entry_t* element_entry,
+                                  const uint8_t selector, const json_array_t* array,
+                                  const size_t first, const size_t count) {
+    const uint8_t format = element_entry->format;
+    const bej_dictionary_t* dict = selector ? ctx->annot_dict : ctx->schema_dict;
+    const int sizing = ctx->pass == ENCODE_PASS_SIZE;
+    bej_buffer_t* out = ctx->out;
+
+    if (!sizing) {
+        // one growth for the whole range; a wrapped buffer is already exactly as large as needed
+        if (!out->borrowed && count <= SIZE_MAX / BEJ_SCALAR_ELEMENT_MAX)
+            bej_buffer_reserve(out, count * BEJ_SCALAR_ELEMENT_MAX);
+        BEJ_STATS_ADD(properties, count);
+    }
+
+    const char* last_name = NULL;
+    uint16_t last_option = 0;
+    for (size_t i = first; i < first + count; ++i) {
+        const json_value_t* item = array->items[i];
+        uint8_t payload[2 + BEJ_NNINT_MAX_SIZE];
+        size_t payload_size = 0;
+        int ok;
+        switch (format) {
+            case BEJ_FORMAT_INTEGER: {
+                ok = item->type == JSON_NUMBER;
+                if (!ok) break;
+                const int64_t value = (int64_t)item->data.number;
+                payload[0] = 1;
+                payload[1] = (uint8_t)integer_width(value);
+                bej_put_u64le(payload + 2, (uint64_t)value);
+                payload_size = 2 + payload[1];
+                break;
+            }
+            case BEJ_FORMAT_BOOLEAN:
+                ok = item->type == JSON_BOOL;
+                if (!ok) break;
+                payload[0] = 1;
+                payload[1] = 1;
+                payload[2] = item->data.boolean ? 1u : 0u;
+                payload_size = 3;
+                break;
+            default:
+                ok = item->type == JSON_STRING;
+                if (ok && (!last_name || strcmp(last_name, item->data.string) != 0)) {
+                    bej_dict_entry_t option;
+                    ok = dict && bej_dict_find_child_by_name(dict, element_entry->child_pointer,
+                                                             element_entry->child_count, item->data.string, &option);
+                    if (ok) {
+                        last_name = item->data.string;
+                        last_option = option.sequence;
+                    }
+                }
+                if (ok) payload_size = put_enum_payload(payload, last_option);
+                break;
+        }
+        if (!ok) {
+            ctx->failed = 1;
+            return 0;
         }
+
+        const uint64_t seq = ((uint64_t)i << 1) | selector; // seq for array elements is their index
+        if (sizing) {
+            ctx->pos += bej_nnint_size(seq) + 1 + bej_nnint_size(payload_size) + payload_size;
+            continue;
+        }
+        uint8_t scratch[BEJ_SCALAR_ELEMENT_MAX];
+        uint8_t* const p = emit_begin(ctx, scratch, sizeof(scratch));
+        size_t n = ctx->pass == ENCODE_PASS_FIXED ?
+            bej_put_sfl_fixed(p, seq, format, payload_size, BEJ_FIXED_LENGTH_WIDTH) :
+            bej_put_sfl(p, seq, format, payload_size);
+        memcpy(p + n, payload, sizeof(payload)); // the bytes past the payload are scratch
+        n += payload_size;
+        emit_built(ctx, p, scratch, n);
     }
-    if (!found) return 0;
+    return !ctx->failed;
+}
 
-    // enum value length is its nnint representation length
-    uint8_t tmp[3]; // uint16_t + length byte
-    size_t n = 0;
-    if (value == 0) {
-        tmp[0] = 1; tmp[1] = 0; n = 2;
-    } else {
-        uint16_t v_tmp = value;
-        tmp[0] = 0; // placeholder
-        while (v_tmp) {
-            tmp[++n] = (uint8_t)(v_tmp & 0xFF);
-            v_tmp >>= 8;
+/**
+ * @brief encodes a range of elements of an Array (SFL + value each)
+ * @param ctx the encoder state
+ * @param element_entry the element entry of the array
+ * @param selector the dictionary selector of the array, shared by its elements
+ * @param array the JSON array
+ * @param first index of the first element to encode
+ * @param count number of elements to encode
+ * @return 1 on success, 0 on failure
+ */
+static int encode_elements(encode_ctx_t* ctx, const bej_dict_entry_t* element_entry,
+                           const uint8_t selector, const json_array_t* array,
+                           const size_t first, const size_t count) {
+    if (element_entry->format == BEJ_FORMAT_INTEGER || element_entry->format == BEJ_FORMAT_BOOLEAN ||
+        element_entry->format == BEJ_FORMAT_ENUM)
+        return encode_scalar_elements(ctx, element_entry, selector, array, first, count);
+
+    bej_dict_entry_t entry = *element_entry;
+    for (size_t i = first; i < first + count; ++i) {
+        set_element_sequence(&entry, i);
+        if (!encode_value(ctx, &entry, selector, array->items[i])) {
+            return 0;
         }
-        tmp[0] = (uint8_t)n;
-        n++;
     }
-    pack_nnint(out, n); // length
-    fwrite(tmp, 1, n, out); // value
     return 1;
 }
 
+/**
+ * @brief looks up the element entry of an Array: the single child of the array entry
+ * @param ctx the encoder state
+ * @param array_entry the dictionary entry for the Array
+ * @param selector the dictionary selector of the array
+ * @param element_entry pointer to store the element entry
+ * @return 1 on success, 0 if the array has no element definition
+ */
+static int array_element_entry(const encode_ctx_t* ctx, const bej_dict_entry_t* array_entry,
+                               const uint8_t selector, bej_dict_entry_t* element_entry) {
+    const bej_dictionary_t* dict_to_use = selector ? ctx->annot_dict : ctx->schema_dict;
+    if (!dict_to_use) return 0;
+
+    bej_dict_stream_t st;
+    bej_dict_stream_init_subset(&st, dict_to_use, array_entry->child_pointer, array_entry->child_count);
+    return bej_dict_stream_next(&st, element_entry);
+}
+
 /**
  * @brief encodes the payload for an Array
- * @param out the output stream
+ * @param ctx the encoder state
  * @param array_entry the dictionary entry for this Array
+ * @param selector the dictionary selector of the array, shared by its elements
  * @param json_array the JSON array
- * @param schema_dict the main schema dictionary
- * @param annot_dict the annotation dictionary
  * @return 1 on success, 0 on failure
  */
-static int encode_array_payload(FILE* out, const bej_dict_entry_t* array_entry,
-                                const json_value_t* json_array,
-                                const bej_dictionary_t* schema_dict,
-                                const bej_dictionary_t* annot_dict) {
-    const bej_dictionary_t* dict_to_use = (array_entry->name[0] == '@') ? annot_dict : schema_dict;
+static int encode_array_payload(encode_ctx_t* ctx, const bej_dict_entry_t* array_entry,
+                                const uint8_t selector, const json_value_t* json_array) {
+    if (!json_array || json_array->type != JSON_ARRAY) return 0;
 
-    bej_dict_stream_t st;
-    bej_dict_stream_init_subset(&st, dict_to_use, array_entry->child_pointer, array_entry->child_count);
     bej_dict_entry_t element_entry;
-    if (!bej_dict_stream_next(&st, &element_entry)) return 0;
-
-    pack_nnint(out, json_array->data.array.count);
-    for (size_t i = 0; i < json_array->data.array.count; ++i) {
-        uint8_t selector = (array_entry->name[0] == '@') ? 1 : 0;
-        element_entry.sequence = i; // seq for array elements is their index
-        if (!encode_value(out, &element_entry, selector,
-                          json_array->data.array.items[i], schema_dict, annot_dict)) {
-            return 0;
-        }
-    }
-    return 1;
+    if (!array_element_entry(ctx, array_entry, selector, &element_entry)) return 0;
+
+    pack_nnint(ctx, json_array->data.array.count);
+    return encode_elements(ctx, &element_entry, selector, &json_array->data.array, 0, json_array->data.array.count);
 }
 
 /**
  * @brief encodes the payload for a Set (object)
- * @param out the output stream
+ * @param ctx the encoder state
  * @param set_entry the dictionary entry for this Set
+ * @param selector the dictionary selector of the set
  * @param json_object the JSON object
- * @param schema_dict the main schema dictionary
- * @param annot_dict the annotation dictionary
  * @return 1 on success, 0 on failure
  */
-static int encode_set_payload(FILE* out, const bej_dict_entry_t* set_entry,
-                              const json_value_t* json_object,
-                              const bej_dictionary_t* schema_dict,
-                              const bej_dictionary_t* annot_dict) {
-    return encode_properties(out, json_object, set_entry, schema_dict, annot_dict);
+static int encode_set_payload(encode_ctx_t* ctx, const bej_dict_entry_t* set_entry,
+                              const uint8_t selector, const json_value_t* json_object) {
+    return json_object && encode_properties(ctx, json_object, set_entry, selector);
 }
 
 /**
  * @brief The central dispatcher function. Encodes a single complete property (SFL + value).
- * @param out the output stream.
+ * @param ctx the encoder state.
  * @param entry the dictionary entry for the property to encode.
  * @param selector the dictionary selector (0 for schema, 1 for annotation).
  * @param json_value the JSON value for this property.
- * @param schema_dict the main schema dictionary.
- * @param annot_dict the annotation dictionary.
  * @return 1 on success, 0 on failure.
  */
-static int encode_value(FILE* out, const bej_dict_entry_t* entry,
-                        uint8_t selector, const json_value_t* json_value,
-                        const bej_dictionary_t* schema_dict,
-                        const bej_dictionary_t* annot_dict) {
-    FILE* tmp_payload = tmpfile();
-    if (!tmp_payload) return 0;
+static int encode_value(encode_ctx_t* ctx, const bej_dict_entry_t* entry,
+                        uint8_t selector, const json_value_t* json_value) {
+    const length_mark_t mark = begin_sfl(ctx, entry_prefix(entry, selector));
 
     int success = 0;
     switch (entry->format) {
         case BEJ_FORMAT_SET:
-            success = encode_set_payload(tmp_payload, entry, json_value, schema_dict, annot_dict);
+            success = encode_set_payload(ctx, entry, selector, json_value);
             break;
         case BEJ_FORMAT_ARRAY:
-            success = encode_array_payload(tmp_payload, entry, json_value, schema_dict, annot_dict);
+            success = encode_array_payload(ctx, entry, selector, json_value);
             break;
         case BEJ_FORMAT_INTEGER:
             success = (json_value && json_value->type == JSON_NUMBER) ?
-                pack_integer_value(tmp_payload, (int64_t)json_value->data.number) : 0;
+                pack_integer_value(ctx, (int64_t)json_value->data.number) : 0;
             break;
         case BEJ_FORMAT_STRING:
             success = (json_value && json_value->type == JSON_STRING) ?
-                pack_string_value(tmp_payload, json_value->data.string) : 0;
+                pack_string_value(ctx, json_value->data.string) : 0;
             break;
         case BEJ_FORMAT_BOOLEAN:
             success = (json_value && json_value->type == JSON_BOOL) ?
-                pack_boolean_value(tmp_payload, json_value->data.boolean) : 0;
+                pack_boolean_value(ctx, json_value->data.boolean) : 0;
             break;
         case BEJ_FORMAT_ENUM: {
-            const bej_dictionary_t* dict_to_use = selector ? annot_dict : schema_dict;
+            const bej_dictionary_t* dict_to_use = selector ? ctx->annot_dict : ctx->schema_dict;
             success = (json_value && json_value->type == JSON_STRING) ?
-                pack_enum_value(tmp_payload, dict_to_use, entry, json_value->data.string) : 0;
+                pack_enum_value(ctx, dict_to_use, entry, json_value->data.string) : 0;
             break;
         }
         case BEJ_FORMAT_NULL:
@@ -263,72 +645,685 @@ static int encode_value(FILE* out, const bej_dict_entry_t* entry,
             success = 0;
     }
 
-    if (!success) {
-        fclose(tmp_payload);
-        return 0;
-    }
-
-    fseek(tmp_payload, 0, SEEK_END);
-    const long payload_size = ftell(tmp_payload);
-    rewind(tmp_payload);
+    end_length(ctx, mark);
+    return success && !ctx->failed;
+}
 
-    const uint64_t seq_with_selector = ((uint64_t)entry->sequence << 1) | selector;
-    pack_sfl(out, seq_with_selector, entry->format, payload_size);
+/**
+ * @brief resolves the keys of a JSON object and pushes the members found onto the property stack
+ * @param ctx the encoder state
+ * @param json_object the JSON object
+ * @param parent_entry the dictionary entry for the Set
+ * @param parent_selector the dictionary selector of the Set (0 = schema, 1 = annotation)
+ * @param base pointer to store the stack index of the first pushed member
+ * @return the number of members pushed (keys outside the dictionary are skipped), SIZE_MAX on failure
+ */
+static size_t resolve_properties(encode_ctx_t* ctx, const json_value_t* json_object,
+                                 const bej_dict_entry_t* parent_entry, const uint8_t parent_selector,
+                                 size_t* base) {
+    const bej_dictionary_t* annot_dict = ctx->annot_dict;
+    const size_t count = json_object->data.object.count;
 
-    char buf[1024];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof buf, tmp_payload)) > 0) {
-        fwrite(buf, 1, n, out);
+    // the stack is shared by all nesting levels of a call
+    *base = ctx->prop_top;
+    if (count > ctx->prop_capacity - *base) {
+        size_t new_capacity = ctx->prop_capacity ? ctx->prop_capacity : 32;
+        while (new_capacity - *base < count) new_capacity *= 2;
+        resolved_property_t* new_props = realloc(ctx->props, new_capacity * sizeof(*new_props));
+        if (!new_props) {
+            ctx->failed = 1;
+            return SIZE_MAX;
+        }
+        BEJ_STATS_ADD(allocations, 1);
+        ctx->props = new_props;
+        ctx->prop_capacity = new_capacity;
     }
-    fclose(tmp_payload);
 
-    return 1;
+    size_t prop_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const char* key = json_object->data.object.entries[i].key;
+        resolved_property_t* prop = &ctx->props[*base + prop_count];
+        int found;
+        uint8_t selector = parent_selector;
+        if (parent_selector == 0 && key[0] == '@') {
+            // annotations on schema properties resolve against the global annotation scope
+            selector = 1;
+            found = bej_dict_find_annotation_by_name(annot_dict, key, &prop->entry);
+        } else {
+            // members of a set live in the same dictionary as the set itself
+            const bej_dictionary_t* dict_to_search = selector ? annot_dict : ctx->schema_dict;
+            found = dict_to_search && bej_dict_find_child_by_name(dict_to_search, parent_entry->child_pointer,
+                                                                  parent_entry->child_count, key, &prop->entry);
+        }
+
+        if (found) {
+            prop->value = json_object->data.object.entries[i].value;
+            prop->selector = selector;
+            prop_count++;
+        }
+    }
+    ctx->prop_top = *base + prop_count;
+    return prop_count;
 }
 
 /**
  * @brief the main recursive function. Encodes the payload of a Set (object).
- * @param out the output stream.
+ * @param ctx the encoder state.
  * @param json_object the JSON object to encode.
  * @param parent_entry the dictionary entry for the parent Set.
- * @param schema_dict the main schema dictionary.
- * @param annot_dict the annotation dictionary.
+ * @param parent_selector the dictionary selector of the parent Set (0 = schema, 1 = annotation).
  * @return 1 on success, 0 on failure.
  */
-static int encode_properties(FILE* out, const json_value_t* json_object,
-                             const bej_dict_entry_t* parent_entry,
-                             const bej_dictionary_t* schema_dict,
-                             const bej_dictionary_t* annot_dict) {
+static int encode_properties(encode_ctx_t* ctx, const json_value_t* json_object,
+                             const bej_dict_entry_t* parent_entry, const uint8_t parent_selector) {
     if (json_object->type != JSON_OBJECT) return 0;
 
-    size_t prop_count = 0;
-    for (size_t i = 0; i < json_object->data.object.count; ++i) {
-        const char* key = json_object->data.object.entries[i].key;
-        bej_dict_entry_t child;
-        const bej_dictionary_t* dict_to_search = (key[0] == '@') ? annot_dict : schema_dict;
-        const uint16_t child_ptr = (key[0] == '@') ? 0 : parent_entry->child_pointer;
-        const uint16_t child_cnt = (key[0] == '@') ? (annot_dict ? annot_dict->size : 0) : parent_entry->child_count;
-        if (dict_to_search && bej_dict_find_child_by_name(dict_to_search, child_ptr, child_cnt, key, &child)) {
-            prop_count++;
+    size_t base;
+    const size_t prop_count = resolve_properties(ctx, json_object, parent_entry, parent_selector, &base);
+    if (prop_count == SIZE_MAX) return 0;
+    pack_nnint(ctx, prop_count);
+
+    int ok = 1;
+    for (size_t i = 0; i < prop_count && ok; ++i) {
+        // copy out: nested sets may grow (and move) the stack
+        const resolved_property_t prop = ctx->props[base + i];
+        ok = encode_value(ctx, &prop.entry, prop.selector, prop.value);
+    }
+    ctx->prop_top = base;
+    return ok;
+}
+
+/**
+ * @brief encodes the root Set (SFL + payload) of a document in the current pass
+ * @param ctx the encoder state
+ * @param json_data the root JSON value
+ * @param root_entry the root entry of the schema dictionary
+ * @return 1 on success, 0 on failure
+ */
+static int encode_root(encode_ctx_t* ctx, const json_value_t* json_data,
+                       const bej_dict_entry_t* root_entry) {
+    const length_mark_t mark = begin_sfl(ctx, bej_sfl_prefix(0, BEJ_FORMAT_SET));
+    const int ok = encode_properties(ctx, json_data, root_entry, 0);
+    end_length(ctx, mark);
+    return ok && !ctx->failed;
+}
+
+/**
+ * @brief a struct and the binding it is encoded with
+ */
+typedef struct {
+    const bej_binding_t* binding; /**< the compiled binding */
+    const void* object;           /**< the struct */
+    uint64_t present;             /**< mask of the fields to encode */
+} bound_document_t;
+
+static int encode_bound_value(encode_ctx_t* ctx, const bound_document_t* doc, uint32_t node);
+
+/**
+ * @brief encodes the payload of a bound Set: every member with a present field at or below it
+ * @param ctx the encoder state
+ * @param doc the bound struct
+ * @param set the Set node
+ * @return 1 on success, 0 on failure
+ */
+static int encode_bound_members(encode_ctx_t* ctx, const bound_document_t* doc, const uint32_t set) {
+    const bej_bind_node_t* nodes = doc->binding->nodes;
+    uint64_t count = 0;
+    for (uint32_t c = nodes[set].first_child; c != BEJ_BIND_NONE; c = nodes[c].next_sibling)
+        count += (nodes[c].fields & doc->present) != 0;
+
+    pack_nnint(ctx, count);
+    for (uint32_t c = nodes[set].first_child; c != BEJ_BIND_NONE; c = nodes[c].next_sibling) {
+        if ((nodes[c].fields & doc->present) && !encode_bound_value(ctx, doc, c))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief encodes a single bound property (SFL + value) read from the struct
+ * @param ctx the encoder state
+ * @param doc the bound struct
+ * @param node the property node
+ * @return 1 on success, 0 on failure (NULL string, unknown enum option)
+ */
+static int encode_bound_value(encode_ctx_t* ctx, const bound_document_t* doc, const uint32_t node) {
+    const bej_bind_node_t* n = &doc->binding->nodes[node];
+    const length_mark_t mark = begin_sfl(ctx, entry_prefix(&n->entry, n->selector));
+
+    int success = 0;
+    if (n->field == BEJ_BIND_NONE) {
+        success = encode_bound_members(ctx, doc, node);
+    } else {
+        // members may be unaligned in packed structs, copy them out
+        const uint8_t* member = (const uint8_t*)doc->object + doc->binding->fields[n->field].offset;
+        switch (n->entry.format) {
+            case BEJ_FORMAT_INTEGER: {
+                int64_t value;
+                memcpy(&value, member, sizeof(value));
+                success = pack_integer_value(ctx, value);
+                break;
+            }
+            case BEJ_FORMAT_STRING: {
+                const char* str;
+                memcpy(&str, member, sizeof(str));
+                success = str && pack_string_value(ctx, str);
+                break;
+            }
+            case BEJ_FORMAT_BOOLEAN: {
+                int value;
+                memcpy(&value, member, sizeof(value));
+                success = pack_boolean_value(ctx, value);
+                break;
+            }
+            case BEJ_FORMAT_ENUM: {
+                int value;
+                memcpy(&value, member, sizeof(value));
+                const bej_dictionary_t* dict = n->selector ? ctx->annot_dict : ctx->schema_dict;
+                bej_dict_entry_t option;
+                success = value >= 0 && value <= UINT16_MAX && dict &&
+                          bej_dict_find_child_by_seq(dict, n->entry.child_pointer, n->entry.child_count,
+                                                     (uint64_t)value, &option);
+                if (success) pack_enum_sequence(ctx, (uint16_t)value);
+                break;
+            }
+            default:
+                success = 0;
         }
     }
-    pack_nnint(out, prop_count);
 
-    for (size_t i = 0; i < json_object->data.object.count; ++i) {
-        const char* key = json_object->data.object.entries[i].key;
-        const json_value_t* val = json_object->data.object.entries[i].value;
-        bej_dict_entry_t child;
-        const uint8_t selector = (key[0] == '@') ? 1 : 0;
-        const bej_dictionary_t* dict_to_search = selector ? annot_dict : schema_dict;
-        const uint16_t child_ptr = selector ? 0 : parent_entry->child_pointer;
-        const uint16_t child_cnt = selector ? (annot_dict ? annot_dict->size : 0) : parent_entry->child_count;
-
-        if (dict_to_search && bej_dict_find_child_by_name(dict_to_search, child_ptr, child_cnt, key, &child)) {
-            if (!encode_value(out, &child, selector, val, schema_dict, annot_dict)) {
-                return 0;
+    end_length(ctx, mark);
+    return success && !ctx->failed;
+}
+
+/**
+ * @brief encode_root_fn for a bound struct
+ * @param ctx the encoder state
+ * @param arg the bound_document_t
+ * @return 1 on success, 0 on failure
+ */
+static int encode_bound_root(encode_ctx_t* ctx, const void* arg) {
+    const length_mark_t mark = begin_sfl(ctx, bej_sfl_prefix(0, BEJ_FORMAT_SET));
+    const int ok = encode_bound_members(ctx, arg, 0);
+    end_length(ctx, mark);
+    return ok && !ctx->failed;
+}
+
+/**
+ * @brief moves the pending output to the sink once enough of it has accumulated
+ * @param ctx the encoder state
+ */
+static void stream_flush(encode_ctx_t* ctx) {
+    if (!ctx->sink || ctx->failed || ctx->out->size < BEJ_STREAM_FLUSH_SIZE)
+        return;
+    BEJ_STATS_TIME_BEGIN(started);
+    const int written = fwrite(ctx->out->data, 1, ctx->out->size, ctx->sink) == ctx->out->size;
+    BEJ_STATS_TIME_END(io_ns, started);
+    if (!written) {
+        ctx->failed = 1;
+        return;
+    }
+    ctx->flushed += ctx->out->size;
+    ctx->out->size = 0;
+}
+
+/**
+ * @brief phases of a streaming encode between two reader events
+ */
+typedef enum {
+    STREAM_EXPECT_ROOT = 0, /**< the '{' of the root Set */
+    STREAM_IN_CONTAINER,    /**< a key or '}' in a Set, an element or ']' in an Array */
+    STREAM_EXPECT_MEMBER,   /**< the value of a Set member whose key was resolved */
+    STREAM_SKIP_MEMBER,     /**< the value of a Set member that is not in the dictionary */
+    STREAM_SKIPPING,        /**< the rest of a container that is not encoded */
+    STREAM_EXPECT_END,      /**< the end of the text after the root Set */
+    STREAM_DONE             /**< the document is complete */
+} stream_phase_t;
+
+/**
+ * @brief an open Set or Array of a streaming encode
+ */
+typedef struct {
+    bej_dict_entry_t entry; /**< the entry of a Set, the element entry of an Array */
+    length_mark_t mark;     /**< length field of the container's SFL */
+    uint64_t prefix;        /**< sequence and format of the container's SFL */
+    uint64_t count_slot;    /**< slot of the member or element count */
+    uint64_t count;         /**< members or elements written so far */
+    uint64_t canonical;     /**< canonical size of the members or elements written so far */
+    size_t size_index;      /**< size table entry of the container's payload (canonical streams) */
+    uint8_t selector;       /**< the dictionary selector of the container */
+    uint8_t is_array;       /**< 1 for an Array, 0 for a Set */
+} stream_frame_t;
+
+/**
+ * @brief state of a streaming encode, which advances one reader event at a time
+ *
+ * The open containers live on a heap stack instead of the C stack, so an
+ * encode can stop at any event and resume once the reader has more input
+ */
+typedef struct {
+    stream_phase_t phase;           /**< what the next event may be */
+    stream_frame_t* frames;         /**< the open containers, the root Set first */
+    size_t depth;                   /**< number of open containers */
+    size_t capacity;                /**< allocated entries in `frames` */
+    bej_dict_entry_t member;        /**< entry of the member whose value comes next (STREAM_EXPECT_MEMBER) */
+    uint8_t member_selector;        /**< dictionary selector of that member */
+    size_t skip_depth;              /**< open containers of the value being skipped (STREAM_SKIPPING) */
+    int canonical;                  /**< 1 to record canonical payload sizes for canonicalize() */
+} stream_state_t;
+
+/**
+ * @brief initializes the state of a streaming encode
+ * @param st the state
+ * @param canonical 1 to record the canonical size of every SFL payload in the size table
+ */
+static void stream_state_init(stream_state_t* st, const int canonical) {
+    memset(st, 0, sizeof(*st));
+    st->phase = STREAM_EXPECT_ROOT;
+    st->canonical = canonical;
+}
+
+/**
+ * @brief frees the container stack of a streaming encode
+ * @param st the state
+ */
+static void stream_state_free(stream_state_t* st) {
+    free(st->frames);
+    st->frames = NULL;
+    st->depth = st->capacity = 0;
+}
+
+/**
+ * @brief accounts for a complete value in its container
+ * @param st the state
+ * @param prefix the sequence and format of the value's SFL
+ * @param size the canonical size of its payload
+ */
+static void stream_value_done(stream_state_t* st, const uint64_t prefix, const uint64_t size) {
+    if (!st->depth) {
+        st->phase = STREAM_EXPECT_END;
+        return;
+    }
+    stream_frame_t* parent = &st->frames[st->depth - 1];
+    parent->count++;
+    parent->canonical += bej_sfl_prefix_size(prefix) + bej_nnint_size(size) + size;
+    st->phase = STREAM_IN_CONTAINER;
+}
+
+/**
+ * @brief opens a Set or Array whose SFL header has been written
+ * @param ctx the encoder state
+ * @param st the state
+ * @param entry the entry of the Set, the element entry of the Array
+ * @param selector the dictionary selector of the container
+ * @param is_array 1 for an Array
+ * @param prefix the sequence and format of the container's SFL
+ * @param mark the mark returned by begin_sfl()
+ * @param size_index the size table entry of the payload (canonical streams)
+ * @return 1 on success, 0 on allocation failure
+ */
+static int stream_open(encode_ctx_t* ctx, stream_state_t* st, const bej_dict_entry_t* entry,
+                       const uint8_t selector, const uint8_t is_array, const uint64_t prefix,
+                       const length_mark_t mark, const size_t size_index) {
+    if (st->depth == st->capacity) {
+        const size_t new_capacity = st->capacity ? st->capacity * 2 : 16;
+        stream_frame_t* new_frames = realloc(st->frames, new_capacity * sizeof(*new_frames));
+        if (!new_frames) return 0;
+        st->frames = new_frames;
+        st->capacity = new_capacity;
+    }
+
+    // the member or element count is only known at '}' or ']'
+    st->frames[st->depth++] = (stream_frame_t){
+        .entry = *entry,
+        .mark = mark,
+        .prefix = prefix,
+        .count_slot = reserve_slot(ctx),
+        .size_index = size_index,
+        .selector = selector,
+        .is_array = is_array
+    };
+    st->phase = STREAM_IN_CONTAINER;
+    return !ctx->failed;
+}
+
+/**
+ * @brief closes the innermost container at its '}' or ']'
+ * @param ctx the encoder state
+ * @param st the state
+ * @return 1 on success, 0 on failure
+ */
+static int stream_close(encode_ctx_t* ctx, stream_state_t* st) {
+    const stream_frame_t frame = st->frames[--st->depth];
+    const uint64_t size = frame.canonical + bej_nnint_size(frame.count);
+    if (st->canonical) ctx->sizes[frame.size_index] = size;
+    if (!ctx->failed) patch_slot(ctx, frame.count_slot, frame.count);
+    end_length(ctx, frame.mark);
+    stream_flush(ctx);
+    stream_value_done(st, frame.prefix, size);
+    return !ctx->failed;
+}
+
+/**
+ * @brief starts a property (SFL + value) with its first event
+ *
+ * Scalars are written completely; a Set or Array is opened and filled by the
+ * events that follow
+ *
+ * @param ctx the encoder state
+ * @param st the state
+ * @param entry the dictionary entry for the property to encode
+ * @param selector the dictionary selector (0 for schema, 1 for annotation)
+ * @param event the first event of the JSON value
+ * @return 1 on success, 0 on failure
+ */
+static int stream_value(encode_ctx_t* ctx, stream_state_t* st, const bej_dict_entry_t* entry,
+                        const uint8_t selector, const json_event_t event) {
+    const json_reader_t* reader = ctx->reader;
+    const uint64_t prefix = entry_prefix(entry, selector);
+    const size_t size_index = st->canonical ? reserve_size(ctx) : 0;
+    const length_mark_t mark = begin_sfl(ctx, prefix);
+    if (ctx->failed) return 0;
+
+    int success = 0;
+    switch (entry->format) {
+        case BEJ_FORMAT_SET:
+            return event == JSON_EVENT_BEGIN_OBJECT &&
+                   stream_open(ctx, st, entry, selector, 0, prefix, mark, size_index);
+        case BEJ_FORMAT_ARRAY: {
+            const bej_dictionary_t* dict_to_use = selector ? ctx->annot_dict : ctx->schema_dict;
+            if (event != JSON_EVENT_BEGIN_ARRAY || !dict_to_use) return 0;
+
+            // the single child of an array entry describes every element
+            bej_dict_stream_t ds;
+            bej_dict_entry_t element_entry;
+            bej_dict_stream_init_subset(&ds, dict_to_use, entry->child_pointer, entry->child_count);
+            return bej_dict_stream_next(&ds, &element_entry) &&
+                   stream_open(ctx, st, &element_entry, selector, 1, prefix, mark, size_index);
+        }
+        case BEJ_FORMAT_INTEGER:
+            success = event == JSON_EVENT_NUMBER ? pack_integer_value(ctx, (int64_t)reader->number) : 0;
+            break;
+        case BEJ_FORMAT_STRING:
+            success = event == JSON_EVENT_STRING ? pack_string_value(ctx, reader->token) : 0;
+            break;
+        case BEJ_FORMAT_BOOLEAN:
+            success = event == JSON_EVENT_BOOL ? pack_boolean_value(ctx, reader->boolean) : 0;
+            break;
+        case BEJ_FORMAT_ENUM: {
+            const bej_dictionary_t* dict_to_use = selector ? ctx->annot_dict : ctx->schema_dict;
+            success = event == JSON_EVENT_STRING ? pack_enum_value(ctx, dict_to_use, entry, reader->token) : 0;
+            break;
+        }
+        case BEJ_FORMAT_NULL:
+            success = 1; // payload is empty, a container value is skipped below
+            break;
+        default:
+            success = 0;
+    }
+    if (!success || ctx->failed) return 0;
+
+    const uint64_t size = output_offset(ctx) - mark.start;
+    if (st->canonical) ctx->sizes[size_index] = size;
+    end_length(ctx, mark);
+    stream_flush(ctx);
+    stream_value_done(st, prefix, size);
+    if (event == JSON_EVENT_BEGIN_OBJECT || event == JSON_EVENT_BEGIN_ARRAY) {
+        st->phase = STREAM_SKIPPING;
+        st->skip_depth = 1;
+    }
+    return !ctx->failed;
+}
+
+/**
+ * @brief resolves the key of a Set member and moves on to its value
+ *
+ * Members that are not in the dictionary are skipped without being encoded,
+ * like in encode_properties()
+ *
+ * @param ctx the encoder state
+ * @param st the state, its innermost container is a Set
+ * @param key the key
+ */
+static void stream_key(encode_ctx_t* ctx, stream_state_t* st, const char* key) {
+    const stream_frame_t* set = &st->frames[st->depth - 1];
+    const bej_dictionary_t* annot_dict = ctx->annot_dict;
+    uint8_t selector = set->selector;
+    int found;
+    if (set->selector == 0 && key[0] == '@') {
+        // annotations on schema properties resolve against the global annotation scope
+        selector = 1;
+        found = bej_dict_find_annotation_by_name(annot_dict, key, &st->member);
+    } else {
+        // members of a set live in the same dictionary as the set itself
+        const bej_dictionary_t* dict_to_search = selector ? annot_dict : ctx->schema_dict;
+        found = dict_to_search && bej_dict_find_child_by_name(dict_to_search, set->entry.child_pointer,
+                                                              set->entry.child_count, key, &st->member);
+    }
+    st->member_selector = selector;
+    st->phase = found ? STREAM_EXPECT_MEMBER : STREAM_SKIP_MEMBER;
+}
+
+/**
+ * @brief advances a streaming encode by one reader event
+ * @param ctx the encoder state, `reader` and `out` set
+ * @param st the state, STREAM_DONE once the document is complete
+ * @param event the event
+ * @return 1 on success, 0 on failure
+ */
+static int stream_event(encode_ctx_t* ctx, stream_state_t* st, const json_event_t event) {
+    if (event == JSON_EVENT_ERROR || event == JSON_EVENT_NEED_INPUT) return 0;
+
+    switch (st->phase) {
+        case STREAM_EXPECT_ROOT: {
+            bej_dict_stream_t ds;
+            bej_dict_stream_init(&ds, ctx->schema_dict);
+            bej_dict_entry_t root_entry;
+            if (event != JSON_EVENT_BEGIN_OBJECT || !bej_dict_stream_next(&ds, &root_entry)) return 0;
+
+            const uint8_t header[BEJ_HEADER_SIZE] = {0x00, 0xF0, 0xF1, 0xF1, 0x00, 0x00, 0x00};
+            emit_bytes(ctx, header, sizeof(header));
+            const uint64_t prefix = bej_sfl_prefix(0, BEJ_FORMAT_SET);
+            const size_t size_index = st->canonical ? reserve_size(ctx) : 0;
+            const length_mark_t mark = begin_sfl(ctx, prefix);
+            return !ctx->failed && stream_open(ctx, st, &root_entry, 0, 0, prefix, mark, size_index);
+        }
+        case STREAM_IN_CONTAINER: {
+            stream_frame_t* top = &st->frames[st->depth - 1];
+            if (event == (top->is_array ? JSON_EVENT_END_ARRAY : JSON_EVENT_END_OBJECT))
+                return stream_close(ctx, st);
+            if (!top->is_array) {
+                if (event != JSON_EVENT_KEY) return 0;
+                stream_key(ctx, st, ctx->reader->token);
+                return 1;
             }
+            bej_dict_entry_t element_entry = top->entry;
+            set_element_sequence(&element_entry, top->count);
+            return stream_value(ctx, st, &element_entry, top->selector, event);
         }
+        case STREAM_EXPECT_MEMBER: {
+            const bej_dict_entry_t member = st->member;
+            return stream_value(ctx, st, &member, st->member_selector, event);
+        }
+        case STREAM_SKIP_MEMBER:
+            st->phase = STREAM_IN_CONTAINER;
+            if (event == JSON_EVENT_BEGIN_OBJECT || event == JSON_EVENT_BEGIN_ARRAY) {
+                st->phase = STREAM_SKIPPING;
+                st->skip_depth = 1;
+            }
+            return 1;
+        case STREAM_SKIPPING:
+            // keys and scalars inside do not change the depth
+            if (event == JSON_EVENT_BEGIN_OBJECT || event == JSON_EVENT_BEGIN_ARRAY)
+                st->skip_depth++;
+            else if ((event == JSON_EVENT_END_OBJECT || event == JSON_EVENT_END_ARRAY) && !--st->skip_depth)
+                st->phase = st->depth ? STREAM_IN_CONTAINER : STREAM_EXPECT_END;
+            return event != JSON_EVENT_END;
+        case STREAM_EXPECT_END:
+            if (event != JSON_EVENT_END) return 0;
+            st->phase = STREAM_DONE;
+            return 1;
+        default:
+            return 0;
     }
-    return 1;
+}
+
+/**
+ * @brief streams a whole document (header, root Set and end of input)
+ * @param ctx the encoder state, `reader` and `out` set
+ * @return 1 on success, 0 on failure
+ */
+static int stream_document(encode_ctx_t* ctx) {
+    stream_state_t st;
+    stream_state_init(&st, 0);
+    int ok = 1;
+    while (ok && st.phase != STREAM_DONE)
+        ok = stream_event(ctx, &st, json_reader_next(ctx->reader));
+    stream_state_free(&st);
+    return ok && !ctx->failed;
+}
+
+/**
+ * @brief rewrites a document of a canonical stream with minimal-width lengths and counts
+ *
+ * The stream wrote fixed-width fields and recorded the canonical payload size
+ * of every SFL in pre-order. No field grows, so the document shrinks in place:
+ * every field is written at or before the position it was read from
+ *
+ * @param ctx the encoder state after the stream
+ * @param start offset of the document in the output buffer
+ * @return 1 on success, 0 if the size table does not match the document
+ */
+static int canonicalize(encode_ctx_t* ctx, const size_t start) {
+    bej_buffer_t* out = ctx->out;
+    uint8_t* w = out->data + start + BEJ_HEADER_SIZE;
+    bej_cursor_t c;
+    bej_cursor_init(&c, w, out->size - start - BEJ_HEADER_SIZE);
+
+    size_t next = 0;
+    while (bej_cursor_remaining(&c)) {
+        uint64_t seq, length;
+        uint8_t format;
+        if (!bej_cursor_read_sfl(&c, &seq, &format, &length) || next == ctx->size_count) return 0;
+        uint8_t field[BEJ_SFL_MAX_SIZE];
+        size_t n = bej_put_sfl(field, seq, format, ctx->sizes[next++]);
+        memcpy(w, field, n);
+        w += n;
+
+        // the members or elements of a container follow as SFLs of their own
+        if (format == BEJ_FORMAT_SET || format == BEJ_FORMAT_ARRAY) {
+            uint64_t count;
+            if (!bej_cursor_read_nnint(&c, &count)) return 0;
+            n = bej_put_nnint(field, count);
+            memcpy(w, field, n);
+            w += n;
+        } else {
+            if (length > bej_cursor_remaining(&c)) return 0;
+            memmove(w, c.pos, (size_t)length);
+            w += length;
+            bej_cursor_skip(&c, length);
+        }
+    }
+    out->size = (size_t)(w - out->data);
+    return next == ctx->size_count;
+}
+
+/**
+ * @brief encodes the root Set of a document, run once per pass
+ * @param ctx the encoder state
+ * @param arg the document (json_document_t or a bound struct)
+ * @return 1 on success, 0 on failure
+ */
+typedef int (*encode_root_fn)(encode_ctx_t* ctx, const void* arg);
+
+/**
+ * @brief a JSON tree and the root entry it is encoded against
+ */
+typedef struct {
+    const json_value_t* json_data; /**< the root JSON value */
+    bej_dict_entry_t root_entry;   /**< the root entry of the schema dictionary */
+} json_document_t;
+
+/**
+ * @brief encode_root_fn for a JSON tree
+ * @param ctx the encoder state
+ * @param arg the json_document_t
+ * @return 1 on success, 0 on failure
+ */
+static int encode_json_root(encode_ctx_t* ctx, const void* arg) {
+    const json_document_t* doc = arg;
+    return encode_root(ctx, doc->json_data, &doc->root_entry);
+}
+
+/**
+ * @brief runs the passes of a buffered encode and writes the header
+ *
+ * The canonical mode runs `root` twice, a sizing pass and the emit pass. The
+ * scratch tables are left allocated, see release_scratch()
+ *
+ * @param ctx the encoder state with `pass` and `out` set
+ * @param root encodes the root Set
+ * @param arg the document passed to `root`
+ * @return 1 on success, 0 on failure (the buffer is left as it was)
+ */
+static int encode_document(encode_ctx_t* ctx, const encode_root_fn root, const void* arg) {
+    BEJ_STATS_TIME_BEGIN(started);
+    bej_buffer_t* out = ctx->out;
+    int ok = 1;
+    if (ctx->pass == ENCODE_PASS_SIZE) {
+        ok = root(ctx, arg);
+        if (ok && !bej_buffer_reserve(out, BEJ_HEADER_SIZE + ctx->pos)) ok = 0;
+        ctx->pass = ENCODE_PASS_EMIT;
+    }
+
+    const size_t start = out->size;
+    if (ok) {
+        // Standard 7-byte BEJ header:
+        // - 4-byte Magic Number (0x00F0F1F1) identifies the file type
+        // - 2-byte Flags (reserved)
+        // - 1-byte Schema Class (0x00 for Major Schema)
+        const uint8_t header[BEJ_HEADER_SIZE] = {0x00, 0xF0, 0xF1, 0xF1, 0x00, 0x00, 0x00};
+        emit_bytes(ctx, header, sizeof(header));
+        ok = root(ctx, arg);
+    }
+
+    if (!ok) out->size = start; // leave no partial document behind
+
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_out, out->size - start);
+    BEJ_STATS_TIME_END(encode_ns, started);
+    return ok;
+}
+
+/**
+ * @brief frees the scratch tables of a one-shot encode
+ * @param ctx the encoder state
+ */
+static void release_scratch(encode_ctx_t* ctx) {
+    free(ctx->sizes);
+    free(ctx->props);
+}
+
+int bej_encode_buffer(bej_buffer_t* out, const json_value_t* json_data,
+                      const bej_dictionary_t* schema_dict,
+                      const bej_dictionary_t* annot_dict,
+                      const unsigned flags) {
+    if (!out || !json_data || !schema_dict) return 0;
+
+    json_document_t doc = {.json_data = json_data};
+    bej_dict_stream_t ds;
+    bej_dict_stream_init(&ds, schema_dict);
+    if (!bej_dict_stream_next(&ds, &doc.root_entry)) return 0;
+
+    encode_ctx_t ctx = {
+        .pass = (flags & BEJ_ENCODE_FIXED_WIDTH) ? ENCODE_PASS_FIXED : ENCODE_PASS_SIZE,
+        .out = out,
+        .schema_dict = schema_dict,
+        .annot_dict = annot_dict
+    };
+    const int ok = encode_document(&ctx, encode_json_root, &doc);
+    release_scratch(&ctx);
+    return ok;
 }
 
 int bej_encode_stream(FILE* output_stream, const json_value_t* json_data,
@@ -336,38 +1331,687 @@ int bej_encode_stream(FILE* output_stream, const json_value_t* json_data,
                       const bej_dictionary_t* annot_dict) {
     if (!output_stream || !json_data || !schema_dict) return 0;
 
-    // Standard 7-byte BEJ header:
-    // - 4-byte Magic Number (0x00F0F1F1) identifies the file type
-    // - 2-byte Flags (reserved)
-    // - 1-byte Schema Class (0x00 for Major Schema)
-    const uint8_t header[] = {0x00, 0xF0, 0xF1, 0xF1, 0x00, 0x00, 0x00};
-    fwrite(header, 1, sizeof(header), output_stream);
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+
+    int ok = bej_encode_buffer(&out, json_data, schema_dict, annot_dict, BEJ_ENCODE_CANONICAL);
+    BEJ_STATS_TIME_BEGIN(started);
+    if (ok && fwrite(out.data, 1, out.size, output_stream) != out.size) ok = 0;
+    BEJ_STATS_TIME_END(io_ns, started);
+
+    bej_buffer_free(&out);
+    return ok;
+}
+
+int bej_encode_reader_buffer(bej_buffer_t* out, json_reader_t* reader,
+                             const bej_dictionary_t* schema_dict,
+                             const bej_dictionary_t* annot_dict) {
+    if (!out || !reader || !schema_dict) return 0;
+
+    encode_ctx_t ctx = {
+        .pass = ENCODE_PASS_FIXED,
+        .out = out,
+        .schema_dict = schema_dict,
+        .annot_dict = annot_dict,
+        .reader = reader
+    };
+
+    BEJ_STATS_TIME_BEGIN(started);
+    const size_t start = out->size;
+    const int ok = stream_document(&ctx);
+    if (!ok) out->size = start; // leave no partial document behind
+
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_out, out->size - start);
+    BEJ_STATS_TIME_END(encode_ns, started);
+    return ok;
+}
+
+int bej_encode_reader(FILE* output_stream, json_reader_t* reader,
+                      const bej_dictionary_t* schema_dict,
+                      const bej_dictionary_t* annot_dict) {
+    if (!output_stream || !reader || !schema_dict) return 0;
+
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+
+    encode_ctx_t ctx = {
+        .pass = ENCODE_PASS_FIXED,
+        .out = &out,
+        .schema_dict = schema_dict,
+        .annot_dict = annot_dict,
+        .reader = reader
+    };
+
+    // pipes cannot be patched, their output stays buffered until the end
+    ctx.sink_origin = ftello(output_stream);
+    if (ctx.sink_origin >= 0 && fseeko(output_stream, ctx.sink_origin, SEEK_SET) == 0)
+        ctx.sink = output_stream;
+
+    BEJ_STATS_TIME_BEGIN(started);
+    int ok = stream_document(&ctx);
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_out, ctx.flushed + out.size);
+    BEJ_STATS_TIME_END(encode_ns, started);
+
+    BEJ_STATS_TIME_BEGIN(written);
+    if (ok && fwrite(out.data, 1, out.size, output_stream) != out.size) ok = 0;
+    BEJ_STATS_TIME_END(io_ns, written);
+
+    bej_buffer_free(&out);
+    return ok;
+}
+
+int bej_encode_bound(bej_buffer_t* out, const bej_binding_t* binding, const void* object, const uint64_t present) {
+    if (!out || !binding || !binding->nodes || !object) return 0;
+
+    const bound_document_t doc = {.binding = binding, .object = object, .present = present};
+    encode_ctx_t ctx = {
+        .pass = ENCODE_PASS_SIZE,
+        .out = out,
+        .schema_dict = binding->schema_dict,
+        .annot_dict = binding->annot_dict
+    };
+    const int ok = encode_document(&ctx, encode_bound_root, &doc);
+    release_scratch(&ctx);
+    return ok;
+}
+
+/**
+ * @brief states of a resolved patch member while its Set is patched
+ */
+enum {
+    PATCH_MISSING = 0, /**< not in the document, added after its members */
+    PATCH_FOUND,       /**< in the document, not yet replaced */
+    PATCH_REPLACED     /**< replaced at its first occurrence */
+};
+
+/**
+ * @brief finds the patch member for a member of the document
+ * @param ctx the encoder state
+ * @param base stack index of the first patch member of the Set
+ * @param count number of patch members of the Set
+ * @param seq the sequence number of the document member, with its selector bit
+ * @param state the state the patch member must be in
+ * @return the stack index of the patch member, SIZE_MAX if there is none
+ */
+static size_t find_patch_member(const encode_ctx_t* ctx, const size_t base, const size_t count,
+                                const uint64_t seq, const uint8_t state) {
+    for (size_t i = base; i < base + count; ++i) {
+        const resolved_property_t* prop = &ctx->props[i];
+        if (prop->matched == state && (((uint64_t)prop->entry.sequence << 1) | prop->selector) == seq) return i;
+    }
+    return SIZE_MAX;
+}
+
+static int patch_set_payload(encode_ctx_t* ctx, bej_cursor_t payload, const bej_dict_entry_t* set_entry,
+                             uint8_t selector, const json_value_t* patch);
+
+/**
+ * @brief writes the members of a patched Set: replaced ones re-encoded, the others copied verbatim
+ *
+ * Patch members whose name is present replace its first occurrence, or
+ * remove it if they are null. Sets patched with an object are merged member
+ * by member, and the patch members the document lacks follow the existing
+ * members, nulls among them being ignored
+ *
+ * @param ctx the encoder state
+ * @param members cursor at the first member of the Set
+ * @param member_count the number of members in the document
+ * @param base stack index of the first resolved patch member
+ * @param count number of resolved patch members
+ * @return 1 on success, 0 on malformed input or a patch value the dictionary cannot encode
+ */
+static int patch_members(encode_ctx_t* ctx, bej_cursor_t members, const uint64_t member_count,
+                         const size_t base, const size_t count) {
+    // the member count comes first, so find out how many members are removed and how many are new
+    uint64_t deleted = 0;
+    bej_cursor_t scan = members;
+    for (uint64_t m = 0; m < member_count; ++m) {
+        uint64_t seq, length;
+        uint8_t format;
+        if (!bej_cursor_read_sfl(&scan, &seq, &format, &length) || !bej_cursor_skip(&scan, length)) return 0;
+        const size_t i = find_patch_member(ctx, base, count, seq, PATCH_MISSING);
+        if (i != SIZE_MAX) {
+            ctx->props[i].matched = PATCH_FOUND;
+            if (ctx->props[i].value->type == JSON_NULL) deleted++;
+        }
+    }
+    uint64_t added = 0;
+    for (size_t i = base; i < base + count; ++i)
+        if (ctx->props[i].matched == PATCH_MISSING && ctx->props[i].value->type != JSON_NULL) added++;
+    pack_nnint(ctx, member_count - deleted + added);
+
+    for (uint64_t m = 0; m < member_count; ++m) {
+        const uint8_t* start = members.pos;
+        uint64_t seq, length;
+        uint8_t format;
+        bej_cursor_t payload;
+        if (!bej_cursor_read_sfl(&members, &seq, &format, &length) || !bej_cursor_take(&members, length, &payload))
+            return 0;
+
+        const size_t i = find_patch_member(ctx, base, count, seq, PATCH_FOUND);
+        if (i == SIZE_MAX) {
+            emit_bytes(ctx, start, (size_t)(members.pos - start));
+            continue;
+        }
+        ctx->props[i].matched = PATCH_REPLACED;
+        // copy out: nested sets may grow (and move) the stack
+        const resolved_property_t prop = ctx->props[i];
+        if (prop.value->type == JSON_NULL) continue;
+        int ok;
+        if (prop.entry.format == BEJ_FORMAT_SET && format == BEJ_FORMAT_SET && prop.value->type == JSON_OBJECT) {
+            const length_mark_t mark = begin_sfl(ctx, entry_prefix(&prop.entry, prop.selector));
+            ok = patch_set_payload(ctx, payload, &prop.entry, prop.selector, prop.value);
+            end_length(ctx, mark);
+        } else {
+            ok = encode_value(ctx, &prop.entry, prop.selector, prop.value);
+        }
+        if (!ok || ctx->failed) return 0;
+    }
+
+    // new Sets are merged into an empty Set, which drops the nulls nested in them
+    static const uint8_t empty_set[] = {0x01, 0x00};
+    for (size_t i = base; i < base + count; ++i) {
+        if (ctx->props[i].matched != PATCH_MISSING || ctx->props[i].value->type == JSON_NULL) continue;
+        const resolved_property_t prop = ctx->props[i];
+        int ok;
+        if (prop.entry.format == BEJ_FORMAT_SET && prop.value->type == JSON_OBJECT) {
+            bej_cursor_t empty;
+            bej_cursor_init(&empty, empty_set, sizeof(empty_set));
+            const length_mark_t mark = begin_sfl(ctx, entry_prefix(&prop.entry, prop.selector));
+            ok = patch_set_payload(ctx, empty, &prop.entry, prop.selector, prop.value);
+            end_length(ctx, mark);
+        } else {
+            ok = encode_value(ctx, &prop.entry, prop.selector, prop.value);
+        }
+        if (!ok || ctx->failed) return 0;
+    }
+    return !ctx->failed;
+}
+
+/**
+ * @brief writes the payload of a Set with a merge patch applied
+ * @param ctx the encoder state
+ * @param payload the payload of the Set in the document
+ * @param set_entry the dictionary entry of the Set
+ * @param selector the dictionary selector of the Set (0 = schema, 1 = annotation)
+ * @param patch the JSON object patching the Set
+ * @return 1 on success, 0 on failure
+ */
+static int patch_set_payload(encode_ctx_t* ctx, bej_cursor_t payload, const bej_dict_entry_t* set_entry,
+                             const uint8_t selector, const json_value_t* patch) {
+    uint64_t member_count;
+    if (!bej_cursor_read_nnint(&payload, &member_count)) return 0;
+
+    size_t base;
+    const size_t count = resolve_properties(ctx, patch, set_entry, selector, &base);
+    if (count == SIZE_MAX) return 0;
+    for (size_t i = base; i < base + count; ++i) ctx->props[i].matched = PATCH_MISSING;
+
+    const int ok = patch_members(ctx, payload, member_count, base, count);
+    ctx->prop_top = base;
+    return ok;
+}
+
+/**
+ * @brief a BEJ document and the merge patch applied to it
+ */
+typedef struct {
+    bej_cursor_t root_payload;     /**< the payload of the root Set of the document */
+    const json_value_t* patch;     /**< the patch, a JSON object */
+    bej_dict_entry_t root_entry;   /**< the root entry of the schema dictionary */
+} patch_document_t;
+
+/**
+ * @brief encode_root_fn for a patched document
+ * @param ctx the encoder state
+ * @param arg the patch_document_t
+ * @return 1 on success, 0 on failure
+ */
+static int encode_patched_root(encode_ctx_t* ctx, const void* arg) {
+    const patch_document_t* doc = arg;
+    const length_mark_t mark = begin_sfl(ctx, bej_sfl_prefix(0, BEJ_FORMAT_SET));
+    const int ok = patch_set_payload(ctx, doc->root_payload, &doc->root_entry, 0, doc->patch);
+    end_length(ctx, mark);
+    return ok && !ctx->failed;
+}
+
+int bej_patch_buffer(bej_buffer_t* out, const uint8_t* data, const size_t size, const json_value_t* patch,
+                     const bej_dictionary_t* schema_dict, const bej_dictionary_t* annot_dict) {
+    if (!out || !data || !patch || patch->type != JSON_OBJECT || !schema_dict || size < BEJ_HEADER_SIZE)
+        return 0;
+
+    patch_document_t doc = {.patch = patch};
+    bej_dict_stream_t ds;
+    bej_dict_stream_init(&ds, schema_dict);
+    if (!bej_dict_stream_next(&ds, &doc.root_entry)) return 0;
+
+    bej_cursor_t cursor;
+    bej_cursor_init(&cursor, data + BEJ_HEADER_SIZE, size - BEJ_HEADER_SIZE);
+    uint64_t seq, length;
+    uint8_t format;
+    if (!bej_cursor_read_sfl(&cursor, &seq, &format, &length) || format != BEJ_FORMAT_SET ||
+        !bej_cursor_take(&cursor, length, &doc.root_payload))
+        return 0;
+
+    encode_ctx_t ctx = {
+        .pass = ENCODE_PASS_SIZE,
+        .out = out,
+        .schema_dict = schema_dict,
+        .annot_dict = annot_dict
+    };
+    const int ok = encode_document(&ctx, encode_patched_root, &doc);
+    release_scratch(&ctx);
+    return ok;
+}
+
+/**
+ * @brief a root member, or a range of elements of a root Array, encoded by one task
+ */
+typedef struct {
+    const resolved_property_t* prop; /**< the root member */
+    int split;                       /**< 1 if the piece is a range of elements of the member */
+    bej_dict_entry_t element_entry;  /**< element entry of a split Array */
+    size_t first;                    /**< first element of a split Array */
+    size_t count;                    /**< number of elements of a split Array */
+    encode_ctx_t ctx;                /**< the state of the piece, its size table is reused by the emit pass */
+    size_t size;                     /**< encoded bytes, measured by the sizing pass */
+    uint8_t* region;                 /**< where the piece goes in the output */
+    int ok;                          /**< 1 once the current pass succeeded */
+} encode_piece_t;
+
+/**
+ * @brief the pieces of a parallel encode and how the emit pass groups them into tasks
+ */
+typedef struct {
+    encode_piece_t* pieces; /**< the pieces in document order */
+    size_t* groups;         /**< first piece of every emit task, followed by the piece count */
+} encode_job_t;
+
+/**
+ * @brief runs the current pass of a piece
+ * @param piece the piece
+ */
+static void encode_piece(encode_piece_t* piece) {
+    encode_ctx_t* ctx = &piece->ctx;
+    const resolved_property_t* prop = piece->prop;
+    const int ok = piece->split ?
+        encode_elements(ctx, &piece->element_entry, prop->selector, &prop->value->data.array, piece->first, piece->count) :
+        encode_value(ctx, &prop->entry, prop->selector, prop->value);
+    piece->ok = ok && !ctx->failed;
+}
+
+/**
+ * @brief bej_task_fn of the sizing pass: measures one piece
+ * @param arg the encode_job_t
+ * @param index the piece
+ */
+static void size_piece_task(void* arg, const size_t index) {
+    encode_piece_t* piece = &((encode_job_t*)arg)->pieces[index];
+    encode_piece(piece);
+    piece->size = piece->ctx.pos;
+}
+
+/**
+ * @brief bej_task_fn of the emit pass: writes a group of pieces into their regions
+ * @param arg the encode_job_t
+ * @param index the group
+ */
+static void emit_group_task(void* arg, const size_t index) {
+    const encode_job_t* job = arg;
+    for (size_t i = job->groups[index]; i < job->groups[index + 1]; ++i) {
+        encode_piece_t* piece = &job->pieces[i];
+        bej_buffer_t region;
+        bej_buffer_wrap(&region, piece->region, piece->size);
+        piece->ctx.pass = ENCODE_PASS_EMIT;
+        piece->ctx.out = &region;
+        encode_piece(piece);
+        piece->ok = piece->ok && region.size == piece->size;
+    }
+}
+
+/**
+ * @brief returns how many elements of a root member go into one piece
+ * @param prop the root member
+ * @param threads the threads working on the document
+ * @return the elements per piece, 0 if the member is encoded as a whole
+ */
+static size_t split_chunk(const resolved_property_t* prop, const size_t threads) {
+    if (prop->entry.format != BEJ_FORMAT_ARRAY || !prop->value || prop->value->type != JSON_ARRAY) return 0;
+    return bej_parallel_chunk(prop->value->data.array.count, threads);
+}
+
+/**
+ * @brief returns the payload length of a split Array: its count and the pieces of its elements
+ * @param pieces the first piece of the array
+ * @param end one past the last piece of the document
+ * @return the length
+ */
+static uint64_t split_array_length(const encode_piece_t* pieces, const encode_piece_t* end) {
+    const resolved_property_t* prop = pieces->prop;
+    uint64_t length = bej_nnint_size(prop->value->data.array.count);
+    for (const encode_piece_t* piece = pieces; piece < end && piece->prop == prop; ++piece)
+        length += piece->size;
+    return length;
+}
+
+int bej_encode_buffer_parallel(bej_buffer_t* out, const json_value_t* json_data,
+                               const bej_dictionary_t* schema_dict,
+                               const bej_dictionary_t* annot_dict,
+                               const bej_parallel_t* parallel) {
+    if (!out || !json_data || !schema_dict) return 0;
+    bej_pool_t* pool = parallel ? parallel->pool : NULL;
+    const size_t threads = bej_pool_concurrency(pool);
+    if (threads < 2 || json_data->type != JSON_OBJECT)
+        return bej_encode_buffer(out, json_data, schema_dict, annot_dict, BEJ_ENCODE_CANONICAL);
 
     bej_dict_stream_t ds;
     bej_dict_stream_init(&ds, schema_dict);
     bej_dict_entry_t root_entry;
     if (!bej_dict_stream_next(&ds, &root_entry)) return 0;
 
-    FILE* tmp_payload = tmpfile();
-    if (!tmp_payload) return 0;
+    // the root members, resolved once; the pieces point into this stack
+    BEJ_STATS_TIME_BEGIN(started);
+    encode_ctx_t root = {.schema_dict = schema_dict, .annot_dict = annot_dict};
+    size_t base;
+    const size_t prop_count = resolve_properties(&root, json_data, &root_entry, 0, &base);
+    if (prop_count == SIZE_MAX) return 0;
+    size_t piece_count = 0;
+    for (size_t i = 0; i < prop_count; ++i) {
+        const resolved_property_t* prop = &root.props[base + i];
+        const size_t chunk = split_chunk(prop, threads);
+        piece_count += chunk ? (prop->value->data.array.count + chunk - 1) / chunk : 1;
+    }
+
+    encode_job_t job = {
+        .pieces = calloc(piece_count, sizeof(*job.pieces)),
+        .groups = malloc((piece_count + 1) * sizeof(*job.groups))
+    };
+    BEJ_STATS_ADD(allocations, 2);
+    const size_t start = out->size;
+    int ok = (job.pieces || piece_count == 0) && job.groups;
 
-    if (!encode_properties(tmp_payload, json_data, &root_entry, schema_dict, annot_dict)) {
-        fclose(tmp_payload);
-        return 0;
+    size_t n = 0;
+    for (size_t i = 0; i < prop_count && ok; ++i) {
+        const resolved_property_t* prop = &root.props[base + i];
+        const size_t chunk = split_chunk(prop, threads);
+        bej_dict_entry_t element_entry;
+        if (chunk && !array_element_entry(&root, &prop->entry, prop->selector, &element_entry)) {
+            ok = 0;
+            break;
+        }
+        const size_t count = chunk ? prop->value->data.array.count : 1;
+        for (size_t first = 0; first < count; first += chunk ? chunk : 1) {
+            encode_piece_t* piece = &job.pieces[n++];
+            piece->prop = prop;
+            piece->ctx = (encode_ctx_t){.pass = ENCODE_PASS_SIZE, .schema_dict = schema_dict, .annot_dict = annot_dict};
+            if (chunk) {
+                piece->split = 1;
+                piece->element_entry = element_entry;
+                piece->first = first;
+                piece->count = count - first < chunk ? count - first : chunk;
+            }
+        }
+    }
+
+    if (ok) {
+        bej_pool_run(pool, size_piece_task, &job, piece_count);
+        for (size_t i = 0; i < piece_count && ok; ++i)
+            ok = job.pieces[i].ok;
+    }
+
+    uint8_t* p = NULL;
+    uint64_t root_length = bej_nnint_size(prop_count);
+    uint64_t total = 0;
+    if (ok) {
+        // lay the document out: everything above the pieces is written here, the pieces get their regions
+        for (size_t i = 0; i < piece_count; ++i) {
+            const encode_piece_t* piece = &job.pieces[i];
+            if (piece->split && piece->first == 0) {
+                const resolved_property_t* prop = piece->prop;
+                root_length += bej_sfl_prefix_size(entry_prefix(&prop->entry, prop->selector)) +
+                               bej_nnint_size(split_array_length(piece, job.pieces + piece_count)) +
+                               bej_nnint_size(prop->value->data.array.count);
+            }
+            root_length += piece->size;
+        }
+        total = BEJ_HEADER_SIZE + bej_nnint_size(0) + 1 + bej_nnint_size(root_length) + root_length;
+        // the emitters store whole words, so the last header needs slack past the document
+        p = total <= SIZE_MAX - BEJ_SFL_MAX_SIZE && bej_buffer_reserve(out, (size_t)total + BEJ_SFL_MAX_SIZE) ?
+            bej_buffer_extend(out, (size_t)total) : NULL;
+        ok = p != NULL;
     }
 
-    fseek(tmp_payload, 0, SEEK_END);
-    long payload_size = ftell(tmp_payload);
-    rewind(tmp_payload);
+    if (ok) {
+        const uint8_t header[BEJ_HEADER_SIZE] = {0x00, 0xF0, 0xF1, 0xF1, 0x00, 0x00, 0x00};
+        memcpy(p, header, sizeof(header));
+        p += sizeof(header);
+        p += bej_put_sfl(p, 0, BEJ_FORMAT_SET, root_length);
+        p += bej_put_nnint(p, prop_count);
+        BEJ_STATS_ADD(properties, 1);
+
+        const size_t group_size = bej_parallel_task_size(parallel, (size_t)total);
+        size_t group_count = 0;
+        size_t grouped = group_size;
+        for (size_t i = 0; i < piece_count; ++i) {
+            encode_piece_t* piece = &job.pieces[i];
+            if (piece->split && piece->first == 0) {
+                const resolved_property_t* prop = piece->prop;
+                p += bej_put_sfl_prefix(p, entry_prefix(&prop->entry, prop->selector),
+                                        split_array_length(piece, job.pieces + piece_count));
+                p += bej_put_nnint(p, prop->value->data.array.count);
+                BEJ_STATS_ADD(properties, 1);
+            }
+            piece->region = p;
+            p += piece->size;
 
-    pack_sfl(output_stream, 0, BEJ_FORMAT_SET, payload_size);
+            // small pieces share a task so that a task is worth handing to a thread
+            if (grouped >= group_size) {
+                job.groups[group_count++] = i;
+                grouped = 0;
+            }
+            grouped += piece->size;
+        }
+        job.groups[group_count] = piece_count;
 
-    char buf[1024];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof buf, tmp_payload)) > 0) {
-        fwrite(buf, 1, n, output_stream);
+        bej_pool_run(pool, emit_group_task, &job, group_count);
+        for (size_t i = 0; i < piece_count && ok; ++i)
+            ok = job.pieces[i].ok;
     }
-    fclose(tmp_payload);
 
+    if (!ok) out->size = start; // leave no partial document behind
+    for (size_t i = 0; job.pieces && i < piece_count; ++i)
+        release_scratch(&job.pieces[i].ctx);
+    free(job.pieces);
+    free(job.groups);
+    release_scratch(&root);
+
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_out, out->size - start);
+    BEJ_STATS_TIME_END(encode_ns, started);
+    return ok;
+}
+
+/**
+ * @brief a reusable encoder: the dictionaries, their root entry and the memory of past calls
+ */
+struct bej_encoder {
+    const bej_dictionary_t* schema_dict; /**< the main schema dictionary */
+    const bej_dictionary_t* annot_dict;  /**< the annotation dictionary (may be NULL) */
+    bej_dict_entry_t root_entry;         /**< the root entry of the schema dictionary */
+    uint64_t* sizes;                     /**< size table kept between calls */
+    size_t size_capacity;                /**< allocated entries in `sizes` */
+    resolved_property_t* props;          /**< property stack kept between calls */
+    size_t prop_capacity;                /**< allocated entries in `props` */
+    bej_buffer_t out;                    /**< output of bej_encoder_encode() */
+};
+
+bej_encoder_t* bej_encoder_create(const bej_dictionary_t* schema_dict,
+                                  const bej_dictionary_t* annot_dict) {
+    if (!schema_dict) return NULL;
+
+    bej_encoder_t* encoder = calloc(1, sizeof(*encoder));
+    if (!encoder) return NULL;
+    bej_dict_stream_t ds;
+    bej_dict_stream_init(&ds, schema_dict);
+    if (!bej_dict_stream_next(&ds, &encoder->root_entry)) {
+        free(encoder);
+        return NULL;
+    }
+    encoder->schema_dict = schema_dict;
+    encoder->annot_dict = annot_dict;
+    bej_buffer_init(&encoder->out);
+    return encoder;
+}
+
+void bej_encoder_free(bej_encoder_t* encoder) {
+    if (!encoder) return;
+    free(encoder->sizes);
+    free(encoder->props);
+    bej_buffer_free(&encoder->out);
+    free(encoder);
+}
+
+int bej_encoder_encode_buffer(bej_encoder_t* encoder, bej_buffer_t* out,
+                              const json_value_t* json_data, const unsigned flags) {
+    if (!encoder || !out || !json_data) return 0;
+
+    const json_document_t doc = {.json_data = json_data, .root_entry = encoder->root_entry};
+    encode_ctx_t ctx = {
+        .pass = (flags & BEJ_ENCODE_FIXED_WIDTH) ? ENCODE_PASS_FIXED : ENCODE_PASS_SIZE,
+        .out = out,
+        .sizes = encoder->sizes,
+        .size_capacity = encoder->size_capacity,
+        .props = encoder->props,
+        .prop_capacity = encoder->prop_capacity,
+        .schema_dict = encoder->schema_dict,
+        .annot_dict = encoder->annot_dict
+    };
+    const int ok = encode_document(&ctx, encode_json_root, &doc);
+
+    // the tables may have grown, keep them for the next document
+    encoder->sizes = ctx.sizes;
+    encoder->size_capacity = ctx.size_capacity;
+    encoder->props = ctx.props;
+    encoder->prop_capacity = ctx.prop_capacity;
+    return ok;
+}
+
+int bej_encoder_encode(bej_encoder_t* encoder, const json_value_t* json_data, const unsigned flags,
+                       const uint8_t** data, size_t* size) {
+    if (!encoder || !data || !size) return 0;
+
+    bej_buffer_clear(&encoder->out);
+    if (!bej_encoder_encode_buffer(encoder, &encoder->out, json_data, flags)) return 0;
+    *data = encoder->out.data;
+    *size = encoder->out.size;
     return 1;
 }
+
+int bej_encoder_encode_stream(bej_encoder_t* encoder, FILE* output_stream, const json_value_t* json_data) {
+    const uint8_t* data;
+    size_t size;
+    if (!output_stream || !bej_encoder_encode(encoder, json_data, BEJ_ENCODE_CANONICAL, &data, &size)) return 0;
+
+    BEJ_STATS_TIME_BEGIN(started);
+    const int ok = fwrite(data, 1, size, output_stream) == size;
+    BEJ_STATS_TIME_END(io_ns, started);
+    return ok;
+}
+
+struct bej_async_encoder {
+    encode_ctx_t ctx;                    /**< state of the streaming encode, writes to `out` */
+    stream_state_t stream;               /**< open containers between two runs */
+    json_reader_t reader;                /**< reader fed with the text as it arrives */
+    bej_buffer_t out;                    /**< the document being built */
+    bej_source_fn source;                /**< source of the JSON text */
+    void* source_ctx;                    /**< context of `source` */
+    bej_sink_fn sink;                    /**< sink of the BEJ data */
+    void* sink_ctx;                      /**< context of `sink` */
+    size_t drained;                      /**< bytes of `out` the sink has taken */
+    int failed;                          /**< sticky error flag */
+    uint8_t chunk[BEJ_ENCODE_READ_SIZE]; /**< text read from the source, handed to the reader at once */
+};
+
+bej_async_encoder_t* bej_async_encoder_create(const bej_dictionary_t* schema_dict,
+                                              const bej_dictionary_t* annot_dict, const unsigned flags,
+                                              const bej_source_fn source, void* source_ctx,
+                                              const bej_sink_fn sink, void* sink_ctx) {
+    if (!schema_dict || !source || !sink) return NULL;
+
+    bej_async_encoder_t* encoder = calloc(1, sizeof(*encoder));
+    if (!encoder) return NULL;
+    encoder->ctx = (encode_ctx_t){
+        .pass = ENCODE_PASS_FIXED,
+        .out = &encoder->out,
+        .schema_dict = schema_dict,
+        .annot_dict = annot_dict,
+        .reader = &encoder->reader
+    };
+    stream_state_init(&encoder->stream, !(flags & BEJ_ENCODE_FIXED_WIDTH));
+    json_reader_init_feed(&encoder->reader);
+    bej_buffer_init(&encoder->out);
+    encoder->source = source;
+    encoder->source_ctx = source_ctx;
+    encoder->sink = sink;
+    encoder->sink_ctx = sink_ctx;
+    return encoder;
+}
+
+/**
+ * @brief completes the document of an async encoder once the stream is done
+ * @param encoder the encoder
+ * @return 1 on success, 0 on failure
+ */
+static int async_finish(bej_async_encoder_t* encoder) {
+    BEJ_STATS_TIME_BEGIN(started);
+    const int ok = !encoder->stream.canonical || canonicalize(&encoder->ctx, 0);
+    BEJ_STATS_ADD(documents, 1);
+    BEJ_STATS_ADD(bytes_out, encoder->out.size);
+    BEJ_STATS_TIME_END(encode_ns, started);
+
+    // only the document is needed from here on
+    json_reader_free(&encoder->reader);
+    stream_state_free(&encoder->stream);
+    release_scratch(&encoder->ctx);
+    encoder->ctx.sizes = NULL;
+    encoder->ctx.props = NULL;
+    return ok;
+}
+
+bej_io_status_t bej_async_encoder_run(bej_async_encoder_t* encoder) {
+    if (!encoder || encoder->failed) return BEJ_IO_FAILED;
+
+    while (encoder->stream.phase != STREAM_DONE) {
+        const json_event_t event = json_reader_next(&encoder->reader);
+        int ok;
+        if (event == JSON_EVENT_NEED_INPUT) {
+            const size_t n = encoder->source(encoder->source_ctx, encoder->chunk, sizeof(encoder->chunk));
+            if (n == BEJ_IO_AGAIN) return BEJ_IO_NEED_INPUT;
+            ok = n != BEJ_IO_ERROR && n <= sizeof(encoder->chunk) &&
+                 json_reader_feed(&encoder->reader, (const char*)encoder->chunk, n);
+        } else {
+            ok = stream_event(&encoder->ctx, &encoder->stream, event) &&
+                 (encoder->stream.phase != STREAM_DONE || async_finish(encoder));
+        }
+        if (!ok) {
+            encoder->failed = 1;
+            return BEJ_IO_FAILED;
+        }
+    }
+
+    const bej_io_status_t status = bej_sink_drain(encoder->sink, encoder->sink_ctx, encoder->out.data,
+                                                  encoder->out.size, &encoder->drained);
+    encoder->failed = status == BEJ_IO_FAILED;
+    return status;
+}
+
+void bej_async_encoder_free(bej_async_encoder_t* encoder) {
+    if (!encoder) return;
+    json_reader_free(&encoder->reader);
+    stream_state_free(&encoder->stream);
+    release_scratch(&encoder->ctx);
+    bej_buffer_free(&encoder->out);
+    free(encoder);
+}
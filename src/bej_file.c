@@ -0,0 +1,88 @@
+/**
+ * @file bej_file.c
+ * @brief implementation of whole-file views (mmap with a read() fallback)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bej_file.h"
+#include "bej_buffer.h"
+
+/**
+ * @brief reads a stream from its current position until EOF into a heap buffer
+ * @param stream the stream to read
+ * @param view pointer to store the contents
+ * @return 1 on success, 0 on failure
+ */
+static int read_stream(FILE *stream, bej_file_view_t *view) {
+    bej_buffer_t buf;
+    bej_buffer_init(&buf);
+
+    for (;;) {
+        if (!bej_buffer_reserve(&buf, 64 * 1024)) {
+            bej_buffer_free(&buf);
+            return 0;
+        }
+        const size_t n = fread(buf.data + buf.size, 1, buf.capacity - buf.size, stream);
+        buf.size += n;
+        if (n == 0)
+            break;
+    }
+
+    if (ferror(stream)) {
+        bej_buffer_free(&buf);
+        return 0;
+    }
+
+    view->data = buf.data;
+    view->size = buf.size;
+    view->mapped = 0;
+    return 1;
+}
+
+int bej_file_view_stream(FILE *stream, bej_file_view_t *view) {
+    if (!stream || !view)
+        return 0;
+
+    struct stat st;
+    const int fd = fileno(stream);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            view->data = addr;
+            view->size = (size_t)st.st_size;
+            view->mapped = 1;
+            return 1;
+        }
+    }
+
+    // not mappable (pipe, empty file, exotic filesystem): fall back to reading
+    return read_stream(stream, view);
+}
+
+int bej_file_view_path(const char *path, bej_file_view_t *view) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    const int ok = bej_file_view_stream(file, view);
+    fclose(file); // a mapping stays valid after the descriptor is closed
+    return ok;
+}
+
+void bej_file_view_release(bej_file_view_t *view) {
+    if (!view)
+        return;
+
+    if (view->mapped)
+        munmap((void *)view->data, view->size);
+    else
+        free((void *)view->data);
+
+    view->data = NULL;
+    view->size = 0;
+    view->mapped = 0;
+}
@@ -0,0 +1,540 @@
+/**
+ * @file bej_index.c
+ * @brief implementation of the BEJ offset index sidecar
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_index.h"
+
+static const uint8_t INDEX_MAGIC[4] = {'B', 'E', 'J', 'I'};
+
+/**
+ * @brief a path record while the index is built
+ */
+typedef struct {
+    const char *name;     /**< the path inside the name pool (set once the pool is complete) */
+    uint32_t name_offset; /**< offset of the path in the name pool */
+    uint32_t name_length; /**< length of the path */
+    uint64_t offset;      /**< offset of the member's SFL header from the root payload */
+} index_path_t;
+
+/**
+ * @brief an array record while the index is built
+ */
+typedef struct {
+    const char *name;     /**< the path inside the name pool (set once the pool is complete) */
+    uint32_t name_offset; /**< offset of the path in the name pool */
+    uint32_t name_length; /**< length of the path */
+    uint64_t count;       /**< number of elements */
+    uint64_t first;       /**< position of the first element offset in the element table */
+} index_array_t;
+
+/**
+ * @brief state of one bej_index_build() call
+ */
+typedef struct {
+    const uint8_t *origin;               /**< start of the root Set payload */
+    const bej_dictionary_t *schema_dict; /**< the main schema dictionary */
+    const bej_dictionary_t *annot_dict;  /**< the annotation dictionary (may be NULL) */
+    bej_buffer_t path;                   /**< escaped path of the value being visited */
+    bej_buffer_t names;                  /**< name pool */
+    bej_buffer_t paths;                  /**< index_path_t records */
+    bej_buffer_t arrays;                 /**< index_array_t records */
+    bej_buffer_t elements;               /**< uint64_t element offsets */
+} index_builder_t;
+
+static uint16_t load_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t load_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t load_u64(const uint8_t *p) {
+    return (uint64_t)load_u32(p) | ((uint64_t)load_u32(p + 4) << 32);
+}
+
+static void store_u16(uint8_t *p, const uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store_u32(uint8_t *p, const uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void store_u64(uint8_t *p, const uint64_t v) {
+    store_u32(p, (uint32_t)v);
+    store_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+/**
+ * @brief computes the 64-bit FNV-1a hash of a byte range
+ * @param p the bytes
+ * @param size the number of bytes
+ * @return the hash value
+ */
+static uint64_t hash_bytes(const uint8_t *p, const size_t size) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/**
+ * @brief orders two paths bytewise, shorter prefixes first
+ * @return negative, zero or positive like memcmp()
+ */
+static int compare_names(const void *a, const size_t a_length, const void *b, const size_t b_length) {
+    const int c = memcmp(a, b, a_length < b_length ? a_length : b_length);
+    if (c)
+        return c;
+    return a_length < b_length ? -1 : a_length > b_length;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    const index_path_t *x = a, *y = b;
+    return compare_names(x->name, x->name_length, y->name, y->name_length);
+}
+
+static int compare_arrays(const void *a, const void *b) {
+    const index_array_t *x = a, *y = b;
+    return compare_names(x->name, x->name_length, y->name, y->name_length);
+}
+
+/**
+ * @brief appends "/" and a property name with '~' and '/' escaped to the current path
+ * @param path the path buffer
+ * @param name the property name
+ * @return 1 on success, 0 on allocation failure
+ */
+static int push_name(bej_buffer_t *path, const char *name) {
+    if (!bej_buffer_append_byte(path, '/'))
+        return 0;
+    for (const char *c = name; *c; c++) {
+        if (*c == '~' || *c == '/') {
+            if (!bej_buffer_append_byte(path, '~') || !bej_buffer_append_byte(path, *c == '~' ? '0' : '1'))
+                return 0;
+        } else if (!bej_buffer_append_byte(path, (uint8_t)*c)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief appends "/" and an Array index to the current path
+ * @param path the path buffer
+ * @param index the element index
+ * @return 1 on success, 0 on allocation failure
+ */
+static int push_index(bej_buffer_t *path, const uint64_t index) {
+    char segment[24];
+    const int n = snprintf(segment, sizeof(segment), "/%" PRIu64, index);
+    return bej_buffer_append(path, segment, (size_t)n);
+}
+
+/**
+ * @brief copies the current path into the name pool
+ * @param b the builder
+ * @param offset pointer to store the pool offset
+ * @param length pointer to store the path length
+ * @return 1 on success, 0 if the pool would exceed 4 GiB or on allocation failure
+ */
+static int pool_path(index_builder_t *b, uint32_t *offset, uint32_t *length) {
+    if (b->names.size > UINT32_MAX - b->path.size)
+        return 0;
+    *offset = (uint32_t)b->names.size;
+    *length = (uint32_t)b->path.size;
+    return bej_buffer_append(&b->names, b->path.data, b->path.size);
+}
+
+/**
+ * @brief resolves the dictionary entry of a Set member, like the decoder does
+ * @param b the builder
+ * @param seq the full sequence number of the member (with selector bit)
+ * @param parent the dictionary entry of the Set
+ * @param parent_selector the dictionary selector of the Set
+ * @param entry pointer to store the member entry
+ * @param selector pointer to store the member selector
+ * @return 1 if the member is known, 0 otherwise
+ */
+static int resolve_member(const index_builder_t *b, const uint64_t seq, const bej_dict_entry_t *parent,
+                          const uint8_t parent_selector, bej_dict_entry_t *entry, uint8_t *selector) {
+    *selector = (uint8_t)(seq & 1);
+    if (*selector && !parent_selector) // annotation on a schema property
+        return b->annot_dict && bej_dict_find_annotation_by_seq(b->annot_dict, seq >> 1, entry);
+
+    const bej_dictionary_t *dict = parent_selector ? b->annot_dict : b->schema_dict;
+    return dict && bej_dict_find_child_by_seq(dict, parent->child_pointer, parent->child_count, seq >> 1, entry);
+}
+
+static int walk_value(index_builder_t *b, const bej_cursor_t *payload, uint8_t format,
+                      const bej_dict_entry_t *entry, uint8_t selector, int in_array, int depth);
+
+/**
+ * @brief records the members of a Set and descends into nested containers
+ * @param b the builder
+ * @param payload the Set payload
+ * @param entry the dictionary entry of the Set
+ * @param selector the dictionary selector of the Set
+ * @param in_array 1 if the Set is (inside) an Array element, its members then get no path records
+ * @param depth nesting depth of the Set
+ * @return 1 on success, 0 on malformed input or allocation failure
+ */
+static int walk_set(index_builder_t *b, const bej_cursor_t *payload, const bej_dict_entry_t *entry,
+                    const uint8_t selector, const int in_array, const int depth) {
+    bej_cursor_t members = *payload;
+    uint64_t count;
+    if (!bej_cursor_read_nnint(&members, &count))
+        return 0;
+
+    for (uint64_t i = 0; i < count; i++) {
+        const uint8_t *at = members.pos;
+        uint64_t seq, length;
+        uint8_t format;
+        bej_cursor_t child_payload;
+        if (!bej_cursor_read_sfl(&members, &seq, &format, &length) ||
+            !bej_cursor_take(&members, length, &child_payload))
+            return 0;
+
+        bej_dict_entry_t child;
+        uint8_t child_selector;
+        if (!resolve_member(b, seq, entry, selector, &child, &child_selector) || !child.name)
+            return 0;
+
+        const size_t mark = b->path.size;
+        if (!push_name(&b->path, child.name))
+            return 0;
+        if (!in_array) {
+            index_path_t record = {.offset = (uint64_t)(at - b->origin)};
+            if (!pool_path(b, &record.name_offset, &record.name_length) ||
+                !bej_buffer_append(&b->paths, &record, sizeof(record)))
+                return 0;
+        }
+        if (!walk_value(b, &child_payload, format, &child, child_selector, in_array, depth + 1))
+            return 0;
+        b->path.size = mark;
+    }
+    return 1;
+}
+
+/**
+ * @brief records the element offsets of an Array and descends into its elements
+ *
+ * The offsets are collected in a first pass so the table of this Array stays
+ * contiguous; nested Arrays append theirs in the second pass
+ *
+ * @param b the builder
+ * @param payload the Array payload
+ * @param entry the dictionary entry of the Array
+ * @param selector the dictionary selector of the Array, shared by its elements
+ * @param in_array 1 if the Array is inside another Array element
+ * @param depth nesting depth of the Array
+ * @return 1 on success, 0 on malformed input or allocation failure
+ */
+static int walk_array(index_builder_t *b, const bej_cursor_t *payload, const bej_dict_entry_t *entry,
+                      const uint8_t selector, const int in_array, const int depth) {
+    bej_cursor_t members = *payload;
+    uint64_t count;
+    if (!bej_cursor_read_nnint(&members, &count))
+        return 0;
+
+    const bej_dictionary_t *dict = selector ? b->annot_dict : b->schema_dict;
+    if (!dict)
+        return 0;
+
+    // the single child of an array entry describes every element
+    bej_dict_stream_t st;
+    bej_dict_entry_t element;
+    bej_dict_stream_init_subset(&st, dict, entry->child_pointer, entry->child_count);
+    if (!bej_dict_stream_next(&st, &element))
+        return 0;
+
+    if (!in_array || count >= BEJ_INDEX_MIN_NESTED_ELEMENTS) {
+        index_array_t record = {.count = count, .first = b->elements.size / sizeof(uint64_t)};
+        if (!pool_path(b, &record.name_offset, &record.name_length) ||
+            !bej_buffer_append(&b->arrays, &record, sizeof(record)))
+            return 0;
+
+        bej_cursor_t table = members;
+        for (uint64_t i = 0; i < count; i++) {
+            const uint64_t offset = (uint64_t)(table.pos - b->origin);
+            uint64_t seq, length;
+            uint8_t format;
+            if (!bej_cursor_read_sfl(&table, &seq, &format, &length) || !bej_cursor_skip(&table, length) ||
+                !bej_buffer_append(&b->elements, &offset, sizeof(offset)))
+                return 0;
+        }
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t seq, length;
+        uint8_t format;
+        bej_cursor_t element_payload;
+        if (!bej_cursor_read_sfl(&members, &seq, &format, &length) ||
+            !bej_cursor_take(&members, length, &element_payload))
+            return 0;
+        if (format != BEJ_FORMAT_SET && format != BEJ_FORMAT_ARRAY)
+            continue;
+
+        const size_t mark = b->path.size;
+        if (!push_index(&b->path, i) ||
+            !walk_value(b, &element_payload, format, &element, selector, 1, depth + 1))
+            return 0;
+        b->path.size = mark;
+    }
+    return 1;
+}
+
+/**
+ * @brief descends into a Set or Array (other values have nothing to index)
+ * @param b the builder
+ * @param payload the payload of the value
+ * @param format the format of the value
+ * @param entry the dictionary entry of the value
+ * @param selector the dictionary selector of the value
+ * @param in_array 1 if the value is (inside) an Array element
+ * @param depth nesting depth of the value
+ * @return 1 on success, 0 on failure
+ */
+static int walk_value(index_builder_t *b, const bej_cursor_t *payload, const uint8_t format,
+                      const bej_dict_entry_t *entry, const uint8_t selector, const int in_array, const int depth) {
+    if (format != BEJ_FORMAT_SET && format != BEJ_FORMAT_ARRAY)
+        return 1;
+    if (depth > BEJ_INDEX_MAX_DEPTH)
+        return 0;
+    return format == BEJ_FORMAT_SET ? walk_set(b, payload, entry, selector, in_array, depth)
+                                    : walk_array(b, payload, entry, selector, in_array, depth);
+}
+
+/**
+ * @brief sorts the collected records and serializes the sidecar
+ * @param b the builder after a complete walk
+ * @param root_length length of the root Set payload
+ * @param root_hash hash of the root Set payload
+ * @param out buffer receiving the sidecar
+ * @return 1 on success, 0 if a table exceeds the format limits or on allocation failure
+ */
+static int write_index(index_builder_t *b, const uint64_t root_length, const uint64_t root_hash,
+                       bej_buffer_t *out) {
+    const size_t path_count = b->paths.size / sizeof(index_path_t);
+    const size_t array_count = b->arrays.size / sizeof(index_array_t);
+    const size_t element_count = b->elements.size / sizeof(uint64_t);
+    if (path_count > UINT32_MAX || array_count > UINT32_MAX || b->names.size > UINT32_MAX)
+        return 0;
+
+    // the pool no longer moves, point the records at their names for sorting
+    index_path_t *paths = (index_path_t *)b->paths.data;
+    index_array_t *arrays = (index_array_t *)b->arrays.data;
+    for (size_t i = 0; i < path_count; i++)
+        paths[i].name = (const char *)b->names.data + paths[i].name_offset;
+    for (size_t i = 0; i < array_count; i++)
+        arrays[i].name = (const char *)b->names.data + arrays[i].name_offset;
+    if (path_count > 1)
+        qsort(paths, path_count, sizeof(*paths), compare_paths);
+    if (array_count > 1)
+        qsort(arrays, array_count, sizeof(*arrays), compare_arrays);
+
+    const uint64_t elements_start = BEJ_INDEX_HEADER_SIZE + (uint64_t)path_count * BEJ_INDEX_PATH_RECORD_SIZE +
+                                    (uint64_t)array_count * BEJ_INDEX_ARRAY_RECORD_SIZE + b->names.size;
+    uint8_t *p = bej_buffer_extend(out, (size_t)elements_start + element_count * sizeof(uint64_t));
+    if (!p)
+        return 0;
+
+    memcpy(p, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    store_u16(p + 4, BEJ_INDEX_VERSION);
+    store_u16(p + 6, 0);
+    store_u32(p + 8, (uint32_t)path_count);
+    store_u32(p + 12, (uint32_t)array_count);
+    store_u32(p + 16, (uint32_t)b->names.size);
+    store_u32(p + 20, 0);
+    store_u64(p + 24, root_length);
+    store_u64(p + 32, root_hash);
+    p += BEJ_INDEX_HEADER_SIZE;
+
+    for (size_t i = 0; i < path_count; i++, p += BEJ_INDEX_PATH_RECORD_SIZE) {
+        store_u32(p, paths[i].name_offset);
+        store_u32(p + 4, paths[i].name_length);
+        store_u64(p + 8, paths[i].offset);
+    }
+    for (size_t i = 0; i < array_count; i++, p += BEJ_INDEX_ARRAY_RECORD_SIZE) {
+        store_u32(p, arrays[i].name_offset);
+        store_u32(p + 4, arrays[i].name_length);
+        store_u64(p + 8, arrays[i].count);
+        store_u64(p + 16, elements_start + arrays[i].first * sizeof(uint64_t));
+    }
+    if (b->names.size)
+        memcpy(p, b->names.data, b->names.size);
+    p += b->names.size;
+
+    const uint64_t *elements = (const uint64_t *)b->elements.data;
+    for (size_t i = 0; i < element_count; i++, p += sizeof(uint64_t))
+        store_u64(p, elements[i]);
+    return 1;
+}
+
+int bej_index_build(bej_buffer_t *out, const uint8_t *data, const size_t size,
+                    const bej_dictionary_t *schema_dict,
+                    const bej_dictionary_t *annot_dict) {
+    if (!out)
+        return 0;
+
+    bej_view_t root;
+    if (!bej_view_open(&root, data, size, schema_dict, annot_dict))
+        return 0;
+
+    index_builder_t b = {.origin = root.payload.pos, .schema_dict = schema_dict, .annot_dict = annot_dict};
+    bej_buffer_init(&b.path);
+    bej_buffer_init(&b.names);
+    bej_buffer_init(&b.paths);
+    bej_buffer_init(&b.arrays);
+    bej_buffer_init(&b.elements);
+
+    const size_t root_length = bej_cursor_remaining(&root.payload);
+    const int ok = walk_set(&b, &root.payload, &root.entry, 0, 0, 0) &&
+                   write_index(&b, root_length, hash_bytes(root.payload.pos, root_length), out);
+
+    bej_buffer_free(&b.path);
+    bej_buffer_free(&b.names);
+    bej_buffer_free(&b.paths);
+    bej_buffer_free(&b.arrays);
+    bej_buffer_free(&b.elements);
+    return ok;
+}
+
+int bej_index_open(bej_index_t *index, const uint8_t *data, const size_t size) {
+    if (!index || !data || size < BEJ_INDEX_HEADER_SIZE ||
+        memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || load_u16(data + 4) != BEJ_INDEX_VERSION)
+        return 0;
+
+    const uint32_t path_count = load_u32(data + 8);
+    const uint32_t array_count = load_u32(data + 12);
+    const uint32_t pool_size = load_u32(data + 16);
+    const uint64_t paths_start = BEJ_INDEX_HEADER_SIZE;
+    const uint64_t arrays_start = paths_start + (uint64_t)path_count * BEJ_INDEX_PATH_RECORD_SIZE;
+    const uint64_t names_start = arrays_start + (uint64_t)array_count * BEJ_INDEX_ARRAY_RECORD_SIZE;
+    const uint64_t tables_end = names_start + pool_size;
+    if (tables_end > size)
+        return 0;
+
+    // check every record once so lookups can trust the offsets
+    for (uint32_t i = 0; i < path_count; i++) {
+        const uint8_t *record = data + paths_start + (uint64_t)i * BEJ_INDEX_PATH_RECORD_SIZE;
+        if ((uint64_t)load_u32(record) + load_u32(record + 4) > pool_size)
+            return 0;
+    }
+    for (uint32_t i = 0; i < array_count; i++) {
+        const uint8_t *record = data + arrays_start + (uint64_t)i * BEJ_INDEX_ARRAY_RECORD_SIZE;
+        const uint64_t count = load_u64(record + 8);
+        const uint64_t table = load_u64(record + 16);
+        if ((uint64_t)load_u32(record) + load_u32(record + 4) > pool_size ||
+            table < tables_end || table > size || count > (size - table) / sizeof(uint64_t))
+            return 0;
+    }
+
+    index->data = data;
+    index->size = size;
+    index->path_count = path_count;
+    index->array_count = array_count;
+    index->paths = data + paths_start;
+    index->arrays = data + arrays_start;
+    index->names = data + names_start;
+    index->root_length = load_u64(data + 24);
+    index->root_hash = load_u64(data + 32);
+    index->root = NULL;
+    return 1;
+}
+
+int bej_index_attach(bej_index_t *index, const bej_view_t *root) {
+    if (!index)
+        return 0;
+    index->root = NULL;
+    if (!root)
+        return 0;
+    const size_t length = bej_cursor_remaining(&root->payload);
+    if (length != index->root_length || hash_bytes(root->payload.pos, length) != index->root_hash)
+        return 0;
+    index->root = root->payload.pos;
+    return 1;
+}
+
+/**
+ * @brief binary-searches a sorted record table by path
+ * @param index the opened index
+ * @param records the first record
+ * @param count number of records
+ * @param record_size size of one record
+ * @param key the path to look for
+ * @param key_length length of the path
+ * @return the matching record, or NULL
+ */
+static const uint8_t *find_record(const bej_index_t *index, const uint8_t *records, const uint32_t count,
+                                  const size_t record_size, const char *key, const size_t key_length) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const uint8_t *record = records + mid * record_size;
+        const int c = compare_names(key, key_length, index->names + load_u32(record), load_u32(record + 4));
+        if (c == 0)
+            return record;
+        if (c < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return NULL;
+}
+
+int bej_index_get(const bej_index_t *index, const bej_view_t *root, const char *path, bej_view_t *out) {
+    if (!index || !root || !path || !out)
+        return 0;
+    if (root->payload.pos != index->root || bej_cursor_remaining(&root->payload) != index->root_length)
+        return bej_view_get(root, path, out); // not attached to this document
+
+    const uint8_t *origin = root->payload.pos;
+    bej_view_t current = *root;
+    const char *p = path;
+    while (*p) {
+        const char *segment = p;
+        char name[BEJ_VIEW_MAX_NAME];
+        if (!bej_view_next_segment(&p, name))
+            return 0;
+
+        // an offset from the index is only a hint, the *_at functions verify it
+        bej_view_t next;
+        uint64_t offset;
+        if (current.entry.format == BEJ_FORMAT_ARRAY) {
+            uint64_t i;
+            if (!bej_view_parse_index(name, &i))
+                return 0;
+            const uint8_t *record = find_record(index, index->arrays, index->array_count,
+                                                BEJ_INDEX_ARRAY_RECORD_SIZE, path, (size_t)(segment - path));
+            const int found = record && i < load_u64(record + 8) &&
+                              (offset = load_u64(index->data + load_u64(record + 16) + i * sizeof(uint64_t))) <
+                                  index->root_length &&
+                              bej_view_element_at(&current, i, origin + offset, &next);
+            if (!found && !bej_view_element(&current, i, &next))
+                return 0;
+        } else {
+            const uint8_t *record = find_record(index, index->paths, index->path_count,
+                                                BEJ_INDEX_PATH_RECORD_SIZE, path, (size_t)(p - path));
+            const int found = record && (offset = load_u64(record + 8)) < index->root_length &&
+                              bej_view_member_at(&current, name, origin + offset, &next);
+            if (!found && !bej_view_member(&current, name, &next))
+                return 0;
+        }
+        current = next;
+    }
+
+    *out = current;
+    return 1;
+}
@@ -0,0 +1,17 @@
+/**
+ * @file bej_io.c
+ * @brief output side of the async codecs
+ */
+
+#include "bej_io.h"
+
+bej_io_status_t bej_sink_drain(const bej_sink_fn sink, void *sink_ctx, const uint8_t *data, const size_t size,
+                               size_t *done) {
+    while (*done < size) {
+        const size_t n = sink(sink_ctx, data + *done, size - *done);
+        if (n == BEJ_IO_ERROR || (n != BEJ_IO_AGAIN && n > size - *done)) return BEJ_IO_FAILED;
+        if (n == 0 || n == BEJ_IO_AGAIN) return BEJ_IO_OUTPUT_FULL;
+        *done += n;
+    }
+    return BEJ_IO_DONE;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file bej_pool.c
+ * @brief worker threads behind bej_pool_run()
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "bej_pool.h"
+
+/**
+ * @brief a pool: its workers and the batch they are working on
+ */
+struct bej_pool
+{
+    pthread_mutex_t run_lock; /**< held by the caller of bej_pool_run() for the whole batch */
+    pthread_mutex_t lock;     /**< guards the members below */
+    pthread_cond_t work;      /**< signalled when a batch starts or the pool stops */
+    pthread_cond_t done;      /**< signalled when the last task of a batch returns */
+    pthread_t *threads;       /**< the workers */
+    size_t thread_count;      /**< number of workers */
+    bej_task_fn fn;           /**< task function of the batch */
+    void *arg;                /**< argument of the batch */
+    size_t count;             /**< tasks in the batch */
+    size_t next;              /**< next task nobody has claimed */
+    size_t finished;          /**< tasks that have returned */
+    int stopping;             /**< 1 once bej_pool_free() wants the workers to exit */
+};
+
+/**
+ * @brief claims and runs tasks of the current batch until none is left
+ * @param pool the pool, locked (and locked again on return)
+ */
+static void run_tasks(bej_pool_t *pool) {
+    while (pool->next < pool->count) {
+        const size_t index = pool->next++;
+        const bej_task_fn fn = pool->fn;
+        void *arg = pool->arg;
+        pthread_mutex_unlock(&pool->lock);
+        fn(arg, index);
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->finished == pool->count)
+            pthread_cond_signal(&pool->done);
+    }
+}
+
+/**
+ * @brief body of a worker thread
+ * @param arg the pool
+ * @return NULL
+ */
+static void *worker_main(void *arg) {
+    bej_pool_t *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->next >= pool->count)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (pool->stopping)
+            break;
+        run_tasks(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * @brief stops and joins the first `started` workers of a pool, then frees it
+ * @param pool the pool
+ * @param started number of workers that are running
+ */
+static void destroy_pool(bej_pool_t *pool, const size_t started) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < started; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool->threads);
+    free(pool);
+}
+
+bej_pool_t *bej_pool_create(const size_t threads) {
+    if (threads > BEJ_POOL_MAX_THREADS)
+        return NULL;
+    bej_pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+    pool->threads = calloc(threads ? threads : 1, sizeof(*pool->threads));
+    if (!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (size_t i = 0; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+            destroy_pool(pool, i);
+            return NULL;
+        }
+    }
+    pool->thread_count = threads;
+    return pool;
+}
+
+void bej_pool_free(bej_pool_t *pool) {
+    if (pool)
+        destroy_pool(pool, pool->thread_count);
+}
+
+size_t bej_pool_concurrency(const bej_pool_t *pool) {
+    return pool ? pool->thread_count + 1 : 1;
+}
+
+void bej_pool_run(bej_pool_t *pool, const bej_task_fn fn, void *arg, const size_t count) {
+    if (!pool || pool->thread_count == 0 || count < 2) {
+        for (size_t i = 0; i < count; i++)
+            fn(arg, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->count = count;
+    pool->next = 0;
+    pool->finished = 0;
+    pthread_cond_broadcast(&pool->work);
+
+    // the caller works on its own batch instead of just waiting for it
+    run_tasks(pool);
+    while (pool->finished < pool->count)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+size_t bej_parallel_chunk(const size_t count, const size_t threads) {
+    if (count < 2 * BEJ_PARALLEL_MIN_ELEMENTS)
+        return 0;
+    const size_t pieces = 4 * (threads ? threads : 1);
+    const size_t chunk = count / pieces + (count % pieces != 0);
+    return chunk > BEJ_PARALLEL_MIN_ELEMENTS ? chunk : BEJ_PARALLEL_MIN_ELEMENTS;
+}
+
+size_t bej_parallel_task_size(const bej_parallel_t *parallel, const size_t total) {
+    const size_t min_subtree = parallel->min_subtree ? parallel->min_subtree : BEJ_PARALLEL_MIN_SUBTREE;
+    const size_t share = total / (4 * bej_pool_concurrency(parallel->pool));
+    return share > min_subtree ? share : min_subtree;
+}
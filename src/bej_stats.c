@@ -0,0 +1,159 @@
+/**
+ * @file bej_stats.c
+ * @brief per-thread accumulators behind the BEJ_STATS_* macros
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bej_stats.h"
+
+#ifdef BEJ_ENABLE_STATS
+
+#define STATS_FIELDS (sizeof(bej_stats_t) / sizeof(uint64_t)) /**< number of counters in a bej_stats_t */
+
+/**
+ * @brief accumulator of one thread, linked into the list of live threads
+ */
+typedef struct stats_block
+{
+    bej_stats_t stats;         /**< the counters of the thread, written by it alone */
+    bej_stats_t base;          /**< the counters at the last bej_stats_reset() (guarded by `stats_lock`) */
+    struct stats_block *prev;  /**< previous live block */
+    struct stats_block *next;  /**< next live block */
+} stats_block_t;
+
+__thread bej_stats_t *bej_stats_local;
+int bej_stats_timing;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER; /**< guards `live` and `retired` */
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;    /**< runs retire_block() when a thread exits */
+static int stats_key_failed;       /**< 1 if the key could not be created */
+static stats_block_t *live;        /**< blocks of running threads */
+static bej_stats_t retired;        /**< totals of exited threads */
+static bej_stats_t discard;        /**< counts of threads that could not get a block (never reported) */
+
+/**
+ * @brief adds what the counters of a block gained since the last reset to a set of totals
+ * @param to the totals
+ * @param block the block, whose thread may still be counting
+ */
+static void stats_add_block(bej_stats_t *to, const stats_block_t *block) {
+    uint64_t *t = (uint64_t *)to;
+    const uint64_t *f = (const uint64_t *)&block->stats;
+    const uint64_t *b = (const uint64_t *)&block->base;
+    for (size_t i = 0; i < STATS_FIELDS; i++)
+        t[i] += __atomic_load_n(&f[i], __ATOMIC_RELAXED) - b[i];
+}
+
+/**
+ * @brief thread exit handler: folds a thread's block into `retired` and frees it
+ * @param arg the stats_block_t of the exiting thread
+ */
+static void retire_block(void *arg) {
+    stats_block_t *block = arg;
+    pthread_mutex_lock(&stats_lock);
+    stats_add_block(&retired, block);
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        live = block->next;
+    if (block->next)
+        block->next->prev = block->prev;
+    pthread_mutex_unlock(&stats_lock);
+
+    // later thread-exit handlers of this thread may still count
+    bej_stats_local = &discard;
+    free(block);
+}
+
+/**
+ * @brief creates the thread-exit key, once per process
+ */
+static void create_key(void) {
+    stats_key_failed = pthread_key_create(&stats_key, retire_block) != 0;
+}
+
+bej_stats_t *bej_stats_thread(void) {
+    if (bej_stats_local)
+        return bej_stats_local;
+
+    pthread_once(&stats_once, create_key);
+    stats_block_t *block = calloc(1, sizeof(*block));
+    if (!block || stats_key_failed || pthread_setspecific(stats_key, block) != 0) {
+        // do not retry on every increment, this thread goes unreported
+        free(block);
+        bej_stats_local = &discard;
+        return bej_stats_local;
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    block->next = live;
+    if (live)
+        live->prev = block;
+    live = block;
+    pthread_mutex_unlock(&stats_lock);
+
+    bej_stats_local = &block->stats;
+    return bej_stats_local;
+}
+
+uint64_t bej_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int bej_stats_enabled(void) {
+    return 1;
+}
+
+void bej_stats_set_timing(const int enabled) {
+    __atomic_store_n(&bej_stats_timing, enabled != 0, __ATOMIC_RELAXED);
+}
+
+void bej_stats_snapshot(bej_stats_t *out) {
+    if (!out)
+        return;
+    pthread_mutex_lock(&stats_lock);
+    *out = retired;
+    for (const stats_block_t *block = live; block; block = block->next)
+        stats_add_block(out, block);
+    pthread_mutex_unlock(&stats_lock);
+}
+
+void bej_stats_reset(void) {
+    pthread_mutex_lock(&stats_lock);
+    memset(&retired, 0, sizeof(retired));
+    // running threads keep counting, so only their current values are recorded
+    for (stats_block_t *block = live; block; block = block->next) {
+        const uint64_t *f = (const uint64_t *)&block->stats;
+        uint64_t *b = (uint64_t *)&block->base;
+        for (size_t i = 0; i < STATS_FIELDS; i++)
+            b[i] = __atomic_load_n(&f[i], __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+#else
+
+int bej_stats_enabled(void) {
+    return 0;
+}
+
+void bej_stats_set_timing(const int enabled) {
+    (void)enabled;
+}
+
+void bej_stats_snapshot(bej_stats_t *out) {
+    if (out)
+        memset(out, 0, sizeof(*out));
+}
+
+void bej_stats_reset(void) {
+}
+
+#endif // BEJ_ENABLE_STATS
@@ -0,0 +1,376 @@
+/**
+ * @file bej_view.c
+ * @brief implementation of random access into encoded BEJ documents
+ */
+
+#include <string.h>
+
+#include "bej_view.h"
+
+/**
+ * @brief returns the dictionary the children of a view live in
+ * @param view the view
+ * @return the annotation dictionary for annotation values, the schema dictionary otherwise
+ */
+static const bej_dictionary_t *view_dict(const bej_view_t *view) {
+    return view->selector ? view->annot_dict : view->schema_dict;
+}
+
+/**
+ * @brief reads the member count of a container and positions a cursor at its first member
+ * @param view a view on a Set or Array
+ * @param members cursor to position
+ * @param count pointer to store the count
+ * @return 1 on success, 0 on failure
+ */
+static int open_members(const bej_view_t *view, bej_cursor_t *members, uint64_t *count) {
+    if (view->entry.format != BEJ_FORMAT_SET && view->entry.format != BEJ_FORMAT_ARRAY)
+        return 0;
+    *members = view->payload;
+    return bej_cursor_read_nnint(members, count);
+}
+
+/**
+ * @brief splits the next member (SFL + payload) off a container cursor
+ * @param members cursor positioned at an SFL header, advanced past the member
+ * @param seq pointer to store the full sequence number (with selector bit)
+ * @param payload cursor to set to the member payload
+ * @return 1 on success, 0 on malformed input
+ */
+static int next_member(bej_cursor_t *members, uint64_t *seq, bej_cursor_t *payload) {
+    uint64_t length;
+    uint8_t format;
+    return bej_cursor_read_sfl(members, seq, &format, &length) &&
+           bej_cursor_take(members, length, payload);
+}
+
+int bej_view_open(bej_view_t *view, const uint8_t *data, const size_t size,
+                  const bej_dictionary_t *schema_dict,
+                  const bej_dictionary_t *annot_dict) {
+    if (!view || !data || !schema_dict || size < BEJ_HEADER_SIZE)
+        return 0;
+
+    // skip 7-byte BEJ header
+    bej_cursor_t cursor;
+    bej_cursor_init(&cursor, data + BEJ_HEADER_SIZE, size - BEJ_HEADER_SIZE);
+
+    bej_dict_stream_t ds;
+    bej_dict_stream_init(&ds, schema_dict);
+    if (!bej_dict_stream_next(&ds, &view->entry))
+        return 0;
+
+    // the entire payload is one large SET
+    uint64_t seq, length;
+    uint8_t format;
+    if (!bej_cursor_read_sfl(&cursor, &seq, &format, &length) || format != BEJ_FORMAT_SET ||
+        !bej_cursor_take(&cursor, length, &view->payload))
+        return 0;
+
+    view->entry.format = BEJ_FORMAT_SET;
+    view->selector = 0;
+    view->schema_dict = schema_dict;
+    view->annot_dict = annot_dict;
+    return 1;
+}
+
+/**
+ * @brief resolves a property name to the dictionary entry and sequence number the encoder would have used
+ * @param set a view on a Set
+ * @param name the property name
+ * @param entry pointer to store the dictionary entry of the member
+ * @param selector pointer to store the dictionary selector of the member
+ * @param wanted pointer to store the full sequence number (with selector bit)
+ * @return 1 if the name is known, 0 otherwise
+ */
+static int resolve_member(const bej_view_t *set, const char *name, bej_dict_entry_t *entry,
+                          uint8_t *selector, uint64_t *wanted) {
+    *selector = set->selector;
+    if (set->selector == 0 && name[0] == '@') {
+        *selector = 1; // annotations on schema properties live in the global annotation scope
+        if (!set->annot_dict || !bej_dict_find_annotation_by_name(set->annot_dict, name, entry))
+            return 0;
+    } else {
+        const bej_dictionary_t *dict = view_dict(set);
+        if (!dict || !bej_dict_find_child_by_name(dict, set->entry.child_pointer, set->entry.child_count,
+                                                  name, entry))
+            return 0;
+    }
+    *wanted = ((uint64_t)entry->sequence << 1) | *selector;
+    return 1;
+}
+
+/**
+ * @brief returns the dictionary entry shared by every element of an Array
+ * @param array a view on an Array
+ * @param entry pointer to store the element entry
+ * @return 1 on success, 0 if the dictionary has no element entry
+ */
+static int element_entry(const bej_view_t *array, bej_dict_entry_t *entry) {
+    const bej_dictionary_t *dict = view_dict(array);
+    if (!dict)
+        return 0;
+
+    // the single child of an array entry describes every element
+    bej_dict_stream_t st;
+    bej_dict_stream_init_subset(&st, dict, array->entry.child_pointer, array->entry.child_count);
+    return bej_dict_stream_next(&st, entry);
+}
+
+/**
+ * @brief fills a child view
+ * @param parent the view the child was found in
+ * @param payload the payload of the child
+ * @param entry the dictionary entry of the child
+ * @param selector the dictionary selector of the child
+ * @param child the view to fill
+ */
+static void set_child(const bej_view_t *parent, const bej_cursor_t *payload, const bej_dict_entry_t *entry,
+                      const uint8_t selector, bej_view_t *child) {
+    child->payload = *payload;
+    child->entry = *entry;
+    child->selector = selector;
+    child->schema_dict = parent->schema_dict;
+    child->annot_dict = parent->annot_dict;
+}
+
+/**
+ * @brief reads the member whose SFL header starts at a known position of a container
+ * @param parent a view on a Set or Array
+ * @param at the start of the SFL header
+ * @param seq pointer to store the full sequence number (with selector bit)
+ * @param payload cursor to set to the member payload
+ * @return 1 if `at` lies inside the members of `parent` and holds a well-formed member, 0 otherwise
+ */
+static int member_at(const bej_view_t *parent, const uint8_t *at, uint64_t *seq, bej_cursor_t *payload) {
+    bej_cursor_t members;
+    uint64_t count;
+    if (!open_members(parent, &members, &count) || count == 0 || at < members.pos || at >= members.end)
+        return 0;
+    members.pos = at;
+    return next_member(&members, seq, payload);
+}
+
+int bej_view_member(const bej_view_t *set, const char *name, bej_view_t *child) {
+    if (!set || !name || !child || set->entry.format != BEJ_FORMAT_SET)
+        return 0;
+
+    bej_dict_entry_t entry;
+    uint8_t selector;
+    uint64_t wanted;
+    if (!resolve_member(set, name, &entry, &selector, &wanted))
+        return 0;
+
+    bej_cursor_t members;
+    uint64_t count;
+    if (!open_members(set, &members, &count))
+        return 0;
+
+    // every non-matching sibling is skipped by its length, its payload is never read
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t seq;
+        bej_cursor_t payload;
+        if (!next_member(&members, &seq, &payload))
+            return 0;
+        if (seq == wanted) {
+            set_child(set, &payload, &entry, selector, child);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int bej_view_member_at(const bej_view_t *set, const char *name, const uint8_t *at, bej_view_t *child) {
+    if (!set || !name || !at || !child || set->entry.format != BEJ_FORMAT_SET)
+        return 0;
+
+    bej_dict_entry_t entry;
+    uint8_t selector;
+    uint64_t wanted, seq;
+    bej_cursor_t payload;
+    if (!resolve_member(set, name, &entry, &selector, &wanted) ||
+        !member_at(set, at, &seq, &payload) || seq != wanted)
+        return 0;
+
+    set_child(set, &payload, &entry, selector, child);
+    return 1;
+}
+
+int bej_view_element(const bej_view_t *array, const uint64_t index, bej_view_t *element) {
+    if (!array || !element || array->entry.format != BEJ_FORMAT_ARRAY)
+        return 0;
+
+    bej_dict_entry_t entry;
+    bej_cursor_t members;
+    uint64_t count;
+    if (!element_entry(array, &entry) || !open_members(array, &members, &count) || index >= count)
+        return 0;
+
+    for (uint64_t i = 0;; i++) {
+        uint64_t seq;
+        bej_cursor_t payload;
+        if (!next_member(&members, &seq, &payload))
+            return 0;
+        if (i == index) {
+            entry.sequence = (uint16_t)index; // seq for array elements is their index
+            set_child(array, &payload, &entry, array->selector, element);
+            return 1;
+        }
+    }
+}
+
+int bej_view_element_at(const bej_view_t *array, const uint64_t index, const uint8_t *at, bej_view_t *element) {
+    if (!array || !at || !element || array->entry.format != BEJ_FORMAT_ARRAY)
+        return 0;
+
+    bej_dict_entry_t entry;
+    uint64_t seq;
+    bej_cursor_t payload;
+    if (!element_entry(array, &entry) || !member_at(array, at, &seq, &payload) || (seq >> 1) != index)
+        return 0;
+
+    entry.sequence = (uint16_t)index; // seq for array elements is their index
+    set_child(array, &payload, &entry, array->selector, element);
+    return 1;
+}
+
+/**
+ * @brief copies one path segment, undoing the "~1" and "~0" escapes
+ * @param segment start of the segment
+ * @param length length of the segment
+ * @param name buffer of BEJ_VIEW_MAX_NAME bytes receiving the null-terminated name
+ * @return 1 on success, 0 if the segment is too long or has an invalid escape
+ */
+static int unescape_segment(const char *segment, const size_t length, char *name) {
+    size_t n = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (n + 1 >= BEJ_VIEW_MAX_NAME)
+            return 0;
+        char c = segment[i];
+        if (c == '~') {
+            if (i + 1 >= length || (segment[i + 1] != '0' && segment[i + 1] != '1'))
+                return 0;
+            c = segment[++i] == '1' ? '/' : '~';
+        }
+        name[n++] = c;
+    }
+    name[n] = '\0';
+    return 1;
+}
+
+int bej_view_next_segment(const char **path, char *name) {
+    const char *p = *path;
+    if (*p != '/')
+        return 0;
+    const char *segment = ++p;
+    while (*p && *p != '/')
+        p++;
+    *path = p;
+    return unescape_segment(segment, (size_t)(p - segment), name);
+}
+
+int bej_view_parse_index(const char *name, uint64_t *index) {
+    if (!name[0] || (name[0] == '0' && name[1]))
+        return 0;
+    uint64_t value = 0;
+    for (const char *p = name; *p; p++) {
+        if (*p < '0' || *p > '9' || value > (UINT64_MAX - 9) / 10)
+            return 0;
+        value = value * 10 + (uint64_t)(*p - '0');
+    }
+    *index = value;
+    return 1;
+}
+
+int bej_view_get(const bej_view_t *view, const char *path, bej_view_t *out) {
+    if (!view || !path || !out)
+        return 0;
+
+    bej_view_t current = *view;
+    const char *p = path;
+    while (*p) {
+        char name[BEJ_VIEW_MAX_NAME];
+        if (!bej_view_next_segment(&p, name))
+            return 0;
+
+        bej_view_t next;
+        uint64_t index;
+        if (current.entry.format == BEJ_FORMAT_ARRAY) {
+            if (!bej_view_parse_index(name, &index) || !bej_view_element(&current, index, &next))
+                return 0;
+        } else if (!bej_view_member(&current, name, &next)) {
+            return 0;
+        }
+        current = next;
+    }
+
+    *out = current;
+    return 1;
+}
+
+int bej_view_count(const bej_view_t *view, uint64_t *count) {
+    bej_cursor_t members;
+    return view && count && open_members(view, &members, count);
+}
+
+int bej_view_integer(const bej_view_t *view, int64_t *value) {
+    if (!view || !value || view->entry.format != BEJ_FORMAT_INTEGER)
+        return 0;
+
+    bej_cursor_t in = view->payload;
+    uint64_t val_len, raw;
+    if (!bej_cursor_read_nnint(&in, &val_len) || val_len == 0 || val_len > 8 ||
+        !bej_cursor_read_uint(&in, (size_t)val_len, &raw))
+        return 0;
+
+    // sign-extend if negative
+    const uint64_t shift = (sizeof(int64_t) - val_len) * 8;
+    *value = (int64_t)(raw << shift) >> shift;
+    return 1;
+}
+
+int bej_view_boolean(const bej_view_t *view, int *value) {
+    if (!view || !value || view->entry.format != BEJ_FORMAT_BOOLEAN)
+        return 0;
+
+    bej_cursor_t in = view->payload;
+    uint64_t bool_len;
+    uint8_t b;
+    if (!bej_cursor_read_nnint(&in, &bool_len) || bool_len != 1 || !bej_cursor_read_u8(&in, &b))
+        return 0;
+    *value = b != 0;
+    return 1;
+}
+
+int bej_view_string(const bej_view_t *view, const char **str, size_t *len) {
+    if (!view || !str || !len || view->entry.format != BEJ_FORMAT_STRING)
+        return 0;
+
+    bej_cursor_t in = view->payload;
+    uint64_t str_len;
+    if (!bej_cursor_read_nnint(&in, &str_len) || str_len == 0 || bej_cursor_remaining(&in) < str_len ||
+        in.pos[str_len - 1] != '\0')
+        return 0;
+
+    // bej strings are null-terminated, the terminator is not part of the value
+    *str = (const char *)in.pos;
+    *len = (size_t)str_len - 1;
+    return 1;
+}
+
+int bej_view_enum(const bej_view_t *view, const char **name) {
+    if (!view || !name || view->entry.format != BEJ_FORMAT_ENUM)
+        return 0;
+
+    bej_cursor_t in = view->payload;
+    uint64_t enum_val;
+    if (!bej_cursor_read_enum(&in, &enum_val))
+        return 0;
+
+    const bej_dictionary_t *dict = view_dict(view);
+    bej_dict_entry_t option;
+    if (!dict || !bej_dict_find_child_by_seq(dict, view->entry.child_pointer, view->entry.child_count,
+                                             enum_val, &option) || !option.name)
+        return 0;
+    *name = option.name;
+    return 1;
+}
@@ -5,14 +5,25 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "cli_args.h"
+#include "bej_stats.h"
 
 // this function is documented in the header file (cli_args.h)
 int parse_args(const int argc, char **argv, args_t *out) {
     // initialize the output structure to zero
     memset(out, 0, sizeof(*out));
     out->mode_encode = -1; // use -1 to indicate mode is not set
+    out->jobs = 1;
+
+    // there can never be more inputs than arguments
+    out->input_paths = malloc((size_t)(argc > 0 ? argc : 1) * sizeof(*out->input_paths));
+    if (!out->input_paths) {
+        fprintf(stderr, "error: out of memory\n");
+        return -1;
+    }
 
     // iterate over all command-line arguments
     for (int i = 1; i < argc; i++) {
@@ -22,31 +33,80 @@ int parse_args(const int argc, char **argv, args_t *out) {
             out->annot_path = argv[++i];
         } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
             out->output_path = argv[++i];
-        } else if (strcmp(argv[i], "encode") == 0) {
-            out->mode_encode = 1;
-        } else if (strcmp(argv[i], "decode") == 0) {
-            out->mode_encode = 0;
-        } else if (argv[i][0] != '-') {
-            // assume any argument not starting with '-' is the input file
-            if (!out->input_path) {
-                out->input_path = argv[i];
+        } else if (strcmp(argv[i], "-O") == 0 && i + 1 < argc) {
+            out->output_dir = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            out->list_path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            char *end;
+            const long jobs = strtol(argv[++i], &end, 10);
+            if (*argv[i] == '\0' || *end != '\0' || jobs < 0 || jobs > CLI_MAX_JOBS) {
+                fprintf(stderr, "error: invalid job count: %s\n", argv[i]);
+                free_args(out);
+                return -1;
+            }
+            if (jobs == 0) {
+                const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+                out->jobs = cpus > 0 ? (int)(cpus < CLI_MAX_JOBS ? cpus : CLI_MAX_JOBS) : 1;
             } else {
-                fprintf(stderr, "error: multiple input files specified ('%s' and '%s')\n", out->input_path, argv[i]);
+                out->jobs = (int)jobs;
+            }
+        } else if (strcmp(argv[i], "-f") == 0) {
+            out->framed = 1;
+        } else if (strcmp(argv[i], "-S") == 0) {
+            out->streaming = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            if (!bej_stats_enabled()) {
+                fprintf(stderr, "error: --stats needs a build configured with -DBEJ_ENABLE_STATS=ON\n");
+                free_args(out);
                 return -1;
             }
+            out->stats = 1;
+        } else if (strcmp(argv[i], "encode") == 0 && out->mode_encode == -1) {
+            out->mode_encode = 1;
+        } else if (strcmp(argv[i], "decode") == 0 && out->mode_encode == -1) {
+            out->mode_encode = 0;
+        } else if (strcmp(argv[i], "index") == 0 && out->mode_encode == -1) {
+            out->mode_encode = 0;
+            out->mode_index = 1;
+        } else if (argv[i][0] != '-') {
+            // any argument not starting with '-' is an input file or directory
+            out->input_paths[out->input_count++] = argv[i];
         } else {
             fprintf(stderr, "error: unknown argument: %s\n", argv[i]);
+            free_args(out);
             return -1;
         }
     }
 
+    if (out->output_dir && (out->framed || out->output_path)) {
+        fprintf(stderr, "error: -O cannot be combined with -o or -f\n");
+        free_args(out);
+        return -1;
+    }
+
     // validate that all required arguments were provided
-    if (out->mode_encode == -1 || !out->input_path || !out->schema_path) {
+    if (out->mode_encode == -1 || (out->input_count == 0 && !out->list_path) || !out->schema_path) {
         fprintf(stderr, "Usage:\n"
-                        " - bej_parser encode <json-file> -s <schema> [-a <annotation>] [-o <output>]\n"
-                        " - bej_parser decode <bej-file>  -s <schema> [-a <annotation>] [-o <output>]\n");
+                        " - bej_parser encode <json-file> -s <schema> [-a <annotation>] [-o <output>] [-S]\n"
+                        " - bej_parser decode <bej-file>  -s <schema> [-a <annotation>] [-o <output>] [-S]\n"
+                        " - bej_parser index  <bej-file>  -s <schema> [-a <annotation>] [-o <index-output>]\n"
+                        "Any mode accepts --stats to print counters and timings as JSON to stderr\n"
+                        "Batch mode (inputs may be files or directories, -l - reads a path list from stdin):\n"
+                        " - bej_parser encode|decode|index <input>... [-l <list>] [-j <threads>] -s <schema> [-a <annotation>]\n"
+                        "       (-O <output-dir> | -f [-o <framed-output>])\n");
+        free_args(out);
         return -1;
     }
 
     return 0;
 }
+
+// this function is documented in the header file (cli_args.h)
+void free_args(args_t *args) {
+    if (!args)
+        return;
+    free((void *)args->input_paths);
+    args->input_paths = NULL;
+    args->input_count = 0;
+}
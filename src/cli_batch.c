@@ -0,0 +1,474 @@
+/**
+* @file cli_batch.c
+ * @brief implementation of batch input expansion and output routing
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "cli_batch.h"
+#include "bej_stats.h"
+
+/**
+ * @brief appends a copy of a path to a batch
+ * @param batch the batch to extend
+ * @param path the path to copy
+ * @param len the length of the path
+ * @return 1 on success, 0 on allocation failure
+ */
+static int batch_push(cli_batch_t *batch, const char *path, const size_t len) {
+    if (batch->count == batch->capacity) {
+        const size_t new_capacity = batch->capacity ? batch->capacity * 2 : 16;
+        char **new_paths = realloc(batch->paths, new_capacity * sizeof(*new_paths));
+        if (!new_paths)
+            return 0;
+        batch->paths = new_paths;
+        batch->capacity = new_capacity;
+    }
+
+    char *copy = malloc(len + 1);
+    if (!copy)
+        return 0;
+    memcpy(copy, path, len);
+    copy[len] = '\0';
+    batch->paths[batch->count++] = copy;
+    return 1;
+}
+
+/**
+ * @brief qsort comparator for C strings
+ */
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief adds the regular files of a directory to a batch, sorted by name
+ * @param batch the batch to extend
+ * @param dir_path the directory to scan
+ * @return 1 on success, 0 on failure
+ */
+static int batch_push_directory(cli_batch_t *batch, const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        perror(dir_path);
+        return 0;
+    }
+
+    const size_t first = batch->count;
+    const size_t dir_len = strlen(dir_path);
+    int ok = 1;
+    struct dirent *de;
+    while (ok && (de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue; // ".", ".." and hidden files
+
+        const size_t name_len = strlen(de->d_name);
+        char *path = malloc(dir_len + name_len + 2);
+        if (!path) {
+            ok = 0;
+            break;
+        }
+        memcpy(path, dir_path, dir_len);
+        path[dir_len] = '/';
+        memcpy(path + dir_len + 1, de->d_name, name_len + 1);
+
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode))
+            ok = batch_push(batch, path, dir_len + name_len + 1);
+        free(path);
+    }
+    closedir(dir);
+
+    if (!ok) {
+        fprintf(stderr, "error: out of memory\n");
+        return 0;
+    }
+
+    // readdir order is filesystem dependent, keep runs reproducible
+    qsort(batch->paths + first, batch->count - first, sizeof(*batch->paths), compare_paths);
+    return 1;
+}
+
+/**
+ * @brief adds one path per non-empty line of a list file to a batch
+ * @param batch the batch to extend
+ * @param list_path the list file, "-" for stdin
+ * @return 1 on success, 0 on failure
+ */
+static int batch_push_list(cli_batch_t *batch, const char *list_path) {
+    FILE *list = strcmp(list_path, "-") == 0 ? stdin : fopen(list_path, "r");
+    if (!list) {
+        perror(list_path);
+        return 0;
+    }
+
+    int ok = 1;
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t len;
+    while (ok && (len = getline(&line, &line_capacity, list)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            len--;
+        if (len > 0)
+            ok = batch_push(batch, line, (size_t)len);
+    }
+    free(line);
+    if (list != stdin)
+        fclose(list);
+
+    if (!ok)
+        fprintf(stderr, "error: out of memory\n");
+    return ok;
+}
+
+// this function is documented in the header file (cli_batch.h)
+int cli_batch_collect(const args_t *args, cli_batch_t *batch) {
+    memset(batch, 0, sizeof(*batch));
+
+    for (size_t i = 0; i < args->input_count; i++) {
+        const char *path = args->input_paths[i];
+        struct stat st;
+        int ok;
+        if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            ok = batch_push_directory(batch, path);
+        } else {
+            // missing files are reported when the job tries to open them
+            ok = batch_push(batch, path, strlen(path));
+            if (!ok) fprintf(stderr, "error: out of memory\n");
+        }
+        if (!ok) {
+            cli_batch_free(batch);
+            return 0;
+        }
+    }
+
+    if (args->list_path && !batch_push_list(batch, args->list_path)) {
+        cli_batch_free(batch);
+        return 0;
+    }
+
+    return 1;
+}
+
+// this function is documented in the header file (cli_batch.h)
+void cli_batch_free(cli_batch_t *batch) {
+    if (!batch)
+        return;
+    for (size_t i = 0; i < batch->count; i++)
+        free(batch->paths[i]);
+    free(batch->paths);
+    memset(batch, 0, sizeof(*batch));
+}
+
+/**
+ * @brief builds the output path of an input inside the output directory
+ * @param dir the output directory
+ * @param input_path the input file path
+ * @param extension the extension replacing the input's extension
+ * @return a newly allocated path, or NULL on allocation failure
+ */
+static char *output_path_for(const char *dir, const char *input_path, const char *extension) {
+    const char *base = strrchr(input_path, '/');
+    base = base ? base + 1 : input_path;
+    const char *dot = strrchr(base, '.');
+    const size_t base_len = (dot && dot != base) ? (size_t)(dot - base) : strlen(base);
+
+    const size_t dir_len = strlen(dir);
+    const size_t ext_len = strlen(extension);
+    char *path = malloc(dir_len + 1 + base_len + ext_len + 1);
+    if (!path)
+        return NULL;
+
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, base, base_len);
+    memcpy(path + dir_len + 1 + base_len, extension, ext_len + 1);
+    return path;
+}
+
+/**
+ * @brief writes one document as a frame of a framed stream
+ * @param out the framed stream
+ * @param name the input path the document was converted from
+ * @param doc the converted document
+ * @return 1 on success, 0 on failure
+ */
+static int write_frame(FILE *out, const char *name, const bej_buffer_t *doc) {
+    size_t name_len = strlen(name);
+    if (name_len > UINT16_MAX)
+        name_len = UINT16_MAX;
+    if (doc->size > UINT32_MAX)
+        return 0;
+
+    const uint8_t header[CLI_FRAME_HEADER_SIZE] = {
+        (uint8_t)doc->size, (uint8_t)(doc->size >> 8), (uint8_t)(doc->size >> 16), (uint8_t)(doc->size >> 24),
+        (uint8_t)name_len, (uint8_t)(name_len >> 8)
+    };
+    return fwrite(header, 1, sizeof(header), out) == sizeof(header) &&
+           fwrite(name, 1, name_len, out) == name_len &&
+           fwrite(doc->data, 1, doc->size, out) == doc->size;
+}
+
+/**
+ * @brief writes one converted document to its own file in the output directory
+ * @param dir the output directory
+ * @param input_path the input file path
+ * @param extension the output extension
+ * @param doc the converted document
+ * @return 1 on success, 0 on failure (an error is printed)
+ */
+static int write_to_directory(const char *dir, const char *input_path,
+                              const char *extension, const bej_buffer_t *doc) {
+    char *path = output_path_for(dir, input_path, extension);
+    if (!path) {
+        fprintf(stderr, "error: out of memory\n");
+        return 0;
+    }
+
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        perror(path);
+        free(path);
+        return 0;
+    }
+
+    int ok = fwrite(doc->data, 1, doc->size, out) == doc->size;
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) perror(path);
+    free(path);
+    return ok;
+}
+
+/**
+ * @brief a contiguous range of batch indices owned by one worker
+ *
+ * The owner takes indices from the front, thieves split off the back half,
+ * so large stolen chunks keep contention on the locks low
+ */
+typedef struct {
+    pthread_mutex_t lock; /**< guards `next` and `end` */
+    size_t next;          /**< next index the owner takes */
+    size_t end;           /**< one past the last index of the range */
+} work_range_t;
+
+/**
+ * @brief state shared by all workers of a batch run
+ */
+typedef struct {
+    const args_t *args;           /**< the parsed arguments */
+    const cli_batch_t *batch;     /**< the inputs */
+    cli_job_fn job;               /**< the conversion */
+    void *ctx;                    /**< context passed to the job */
+    const char *extension;        /**< output extension for -O */
+    FILE *out;                    /**< single or framed output (NULL with -O) */
+    pthread_mutex_t out_lock;     /**< serializes writes to `out` */
+    work_range_t *ranges;         /**< one range per worker */
+    size_t worker_count;          /**< number of workers */
+} batch_run_t;
+
+/**
+ * @brief per-thread state of a worker
+ */
+typedef struct {
+    batch_run_t *run;   /**< the shared run */
+    size_t id;          /**< index of the worker's own range */
+    size_t failures;    /**< inputs this worker failed to convert or write */
+    pthread_t thread;   /**< the worker thread (unused for worker 0) */
+} batch_worker_t;
+
+/**
+ * @brief takes the next index from a worker's own range
+ * @param range the range to take from
+ * @param index pointer to store the index
+ * @return 1 on success, 0 if the range is empty
+ */
+static int take_own(work_range_t *range, size_t *index) {
+    pthread_mutex_lock(&range->lock);
+    const int ok = range->next < range->end;
+    if (ok)
+        *index = range->next++;
+    pthread_mutex_unlock(&range->lock);
+    return ok;
+}
+
+/**
+ * @brief moves the back half of another worker's range into the thief's own range
+ * @param run the shared run
+ * @param thief the id of the stealing worker (its own range is empty)
+ * @return 1 if work was stolen, 0 if every range is empty
+ */
+static int steal(batch_run_t *run, const size_t thief) {
+    for (size_t k = 1; k < run->worker_count; k++) {
+        work_range_t *victim = &run->ranges[(thief + k) % run->worker_count];
+
+        pthread_mutex_lock(&victim->lock);
+        const size_t remaining = victim->end - victim->next;
+        size_t begin = 0, end = 0;
+        if (remaining > 0) {
+            // rounding up lets a thief take the very last document of a busy worker
+            begin = victim->end - (remaining + 1) / 2;
+            end = victim->end;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin < end) {
+            // only the owner adds work to its own range, so it is still empty here
+            work_range_t *own = &run->ranges[thief];
+            pthread_mutex_lock(&own->lock);
+            own->next = begin;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief converts one input and writes its output
+ * @param run the shared run
+ * @param index the batch index of the input
+ * @param arena the worker's JSON arena
+ * @param doc the worker's output buffer
+ * @return 1 on success, 0 on failure (an error is printed)
+ */
+static int process_input(batch_run_t *run, const size_t index, json_arena_t *arena, bej_buffer_t *doc) {
+    const char *input_path = run->batch->paths[index];
+    // the buffer and the arena keep their memory across documents
+    bej_buffer_clear(doc);
+    json_arena_reset(arena);
+
+    if (!run->job(input_path, run->ctx, arena, doc)) {
+        fprintf(stderr, "error: failed to convert %s\n", input_path);
+        return 0;
+    }
+
+    int ok;
+    BEJ_STATS_TIME_BEGIN(started);
+    if (run->args->output_dir) {
+        ok = write_to_directory(run->args->output_dir, input_path, run->extension, doc);
+    } else {
+        pthread_mutex_lock(&run->out_lock);
+        if (run->args->framed)
+            ok = write_frame(run->out, input_path, doc);
+        else
+            ok = fwrite(doc->data, 1, doc->size, run->out) == doc->size;
+        pthread_mutex_unlock(&run->out_lock);
+    }
+    BEJ_STATS_TIME_END(io_ns, started);
+
+    if (!ok)
+        fprintf(stderr, "error: failed to write output for %s\n", input_path);
+    return ok;
+}
+
+/**
+ * @brief worker loop: drains the own range, then steals until no work is left
+ * @param arg the batch_worker_t of this worker
+ * @return NULL
+ */
+static void *worker_main(void *arg) {
+    batch_worker_t *worker = arg;
+    batch_run_t *run = worker->run;
+
+    bej_buffer_t doc;
+    bej_buffer_init(&doc);
+    json_arena_t arena;
+    json_arena_init(&arena);
+
+    for (;;) {
+        size_t index;
+        if (!take_own(&run->ranges[worker->id], &index)) {
+            if (!steal(run, worker->id))
+                break; // work only moves between ranges, so empty everywhere means done
+            continue;
+        }
+        if (!process_input(run, index, &arena, &doc))
+            worker->failures++;
+    }
+
+    json_arena_destroy(&arena);
+    bej_buffer_free(&doc);
+    return NULL;
+}
+
+// this function is documented in the header file (cli_batch.h)
+int cli_batch_run(const args_t *args, const cli_batch_t *batch,
+                  const cli_job_fn job, void *ctx, const char *output_extension) {
+    if (!args->output_dir && !args->framed && batch->count != 1) {
+        fprintf(stderr, "error: %zu inputs given, use -O <dir> or -f to write more than one output\n",
+                batch->count);
+        return 1;
+    }
+
+    size_t worker_count = args->jobs > 0 ? (size_t)args->jobs : 1;
+    if (worker_count > batch->count)
+        worker_count = batch->count ? batch->count : 1;
+
+    batch_run_t run = {
+        .args = args, .batch = batch, .job = job, .ctx = ctx,
+        .extension = output_extension, .worker_count = worker_count
+    };
+    run.ranges = calloc(worker_count, sizeof(*run.ranges));
+    batch_worker_t *workers = calloc(worker_count, sizeof(*workers));
+    if (!run.ranges || !workers) {
+        fprintf(stderr, "error: out of memory\n");
+        free(run.ranges);
+        free(workers);
+        return 1;
+    }
+
+    // single documents and framed streams go to one file (or stdout)
+    if (!args->output_dir) {
+        run.out = args->output_path ? fopen(args->output_path, "wb") : stdout;
+        if (!run.out) {
+            perror("fopen output");
+            free(run.ranges);
+            free(workers);
+            return 1;
+        }
+    }
+
+    // start from an even split, stealing rebalances uneven document sizes
+    pthread_mutex_init(&run.out_lock, NULL);
+    for (size_t w = 0; w < worker_count; w++) {
+        pthread_mutex_init(&run.ranges[w].lock, NULL);
+        run.ranges[w].next = batch->count * w / worker_count;
+        run.ranges[w].end = batch->count * (w + 1) / worker_count;
+        workers[w].run = &run;
+        workers[w].id = w;
+    }
+
+    // worker 0 runs on the calling thread; if a thread cannot be started its range is stolen
+    size_t started = 1;
+    while (started < worker_count &&
+           pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) == 0)
+        started++;
+    worker_main(&workers[0]);
+
+    size_t failures = workers[0].failures;
+    for (size_t w = 1; w < started; w++) {
+        pthread_join(workers[w].thread, NULL);
+        failures += workers[w].failures;
+    }
+
+    for (size_t w = 0; w < worker_count; w++)
+        pthread_mutex_destroy(&run.ranges[w].lock);
+    pthread_mutex_destroy(&run.out_lock);
+    free(run.ranges);
+    free(workers);
+
+    if (run.out && run.out != stdout && fclose(run.out) != 0) {
+        perror("fclose output");
+        failures++;
+    }
+
+    return failures ? 1 : 0;
+}
@@ -7,44 +7,132 @@
 #include <stdlib.h>
 
 #include "cli_decode.h"
+#include "cli_batch.h"
 #include "bej_dictionary.h"
 #include "bej_decode.h"
+#include "bej_file.h"
+#include "bej_stats.h"
 #include "json.h"
 
+/**
+ * @brief dictionaries shared by every document of a run
+ */
+typedef struct {
+    const bej_dictionary_t *schema; /**< main schema dictionary */
+    const bej_dictionary_t *annot;  /**< annotation dictionary (or NULL) */
+    int streaming;                  /**< 1 = decode with a bej_stream_decoder_t, see decode_file_streaming() */
+    bej_parallel_t parallel;        /**< splits a single document across threads (pool is NULL for batches) */
+} decode_job_ctx_t;
+
+/**
+ * @brief write callback appending JSON text to a bej_buffer_t
+ * @param ctx the output buffer
+ * @param data the characters to append
+ * @param size the number of characters
+ * @return 1 on success, 0 on allocation failure
+ */
+static int append_text(void *ctx, const char *data, const size_t size) {
+    return bej_buffer_append(ctx, data, size);
+}
+
+/**
+ * @brief decodes a single BEJ file into compact JSON text without building a tree
+ *
+ * The file is fed to the decoder in BEJ_DECODE_CHUNK_SIZE pieces
+ *
+ * @param input_path path of the BEJ file
+ * @param job the decode_job_ctx_t of the run
+ * @param out buffer receiving the JSON text
+ * @return 1 on success, 0 on failure
+ */
+static int decode_file_streaming(const char *input_path, const decode_job_ctx_t *job, bej_buffer_t *out) {
+    FILE *file = fopen(input_path, "rb");
+    if (!file) {
+        perror(input_path);
+        return 0;
+    }
+
+    bej_stream_decoder_t dec;
+    bej_stream_decoder_init(&dec, job->schema, job->annot, append_text, out);
+
+    uint8_t chunk[BEJ_DECODE_CHUNK_SIZE];
+    int ok = 1;
+    while (ok) {
+        BEJ_STATS_TIME_BEGIN(started);
+        const size_t n = fread(chunk, 1, sizeof(chunk), file);
+        BEJ_STATS_TIME_END(io_ns, started);
+        if (n == 0) break;
+        ok = bej_stream_decoder_feed(&dec, chunk, n);
+    }
+    ok = bej_stream_decoder_finish(&dec) && ok && !ferror(file);
+    fclose(file);
+
+    if (!ok)
+        fprintf(stderr, "Failed to decode BEJ: %s\n", input_path);
+    return ok;
+}
+
+/**
+ * @brief decodes a single BEJ file into JSON text
+ * @param input_path path of the BEJ file
+ * @param ctx the decode_job_ctx_t of the run
+ * @param arena arena for the JSON tree (released by the caller)
+ * @param out buffer receiving the JSON text
+ * @return 1 on success, 0 on failure
+ */
+static int decode_file(const char *input_path, void *ctx, json_arena_t *arena, bej_buffer_t *out) {
+    const decode_job_ctx_t *job = ctx;
+    if (job->streaming)
+        return decode_file_streaming(input_path, job, out);
+
+    // map (or read) the entire input file
+    bej_file_view_t view;
+    if (!bej_file_view_path(input_path, &view)) {
+        perror(input_path);
+        return 0;
+    }
+
+    json_value_t *decoded = bej_decode_buffer_parallel(view.data, view.size, job->schema, job->annot, arena,
+                                                       &job->parallel);
+    bej_file_view_release(&view);
+    if (!decoded) {
+        fprintf(stderr, "Failed to decode BEJ: %s\n", input_path);
+        return 0;
+    }
+
+    // render the JSON text into memory, the caller decides where it goes
+    BEJ_STATS_TIME_BEGIN(started);
+    json_writer_t writer;
+    json_writer_init(&writer, JSON_WRITE_PRETTY);
+    json_writer_value(&writer, decoded);
+    json_writer_raw(&writer, "\n", 1);
+    BEJ_STATS_TIME_END(format_ns, started);
+    BEJ_STATS_ADD(bytes_out, writer.size);
+
+    const int ok = !writer.failed && bej_buffer_append(out, writer.data, writer.size);
+    json_writer_free(&writer);
+    return ok;
+}
+
 /**
  * @brief runs the BEJ decoding process
- * * This function opens the input BEJ file, loads the necessary dictionaries,
- * decodes the data into a JSON tree, and writes the result to the
- * specified output file or to stdout
+ * * This function loads the necessary dictionaries once, then decodes every
+ * input BEJ file into a JSON tree and writes the results to the specified
+ * output file, output directory, framed stream or stdout
  *
  * @param args a pointer to a populated args_t structure with all required paths
  * @return 0 on success, or a non-zero value on failure
  */
 int cli_run_decode(const args_t *args) {
-    // read entire input file into a memory buffer
-    FILE *in = fopen(args->input_path, "rb");
-    if (!in) {
-        perror("fopen input");
+    cli_batch_t batch;
+    if (!cli_batch_collect(args, &batch))
         return 1;
-    }
-    fseek(in, 0, SEEK_END);
-    const long sz = ftell(in);
-    rewind(in);
-
-    uint8_t *buf = malloc(sz);
-    if (!buf) {
-        fprintf(stderr, "Failed to allocate memory for input file\n");
-        fclose(in);
-        return 1;
-    }
-    fread(buf, 1, sz, in);
-    fclose(in);
 
     // load the main schema dictionary
     bej_dictionary_t *schema = bej_dictionary_load_map(args->schema_path);
     if (!schema) {
         fprintf(stderr, "Failed to load schema dictionary\n");
-        free(buf);
+        cli_batch_free(&batch);
         return 1;
     }
 
@@ -55,40 +143,22 @@ int cli_run_decode(const args_t *args) {
         if (!annot) {
             fprintf(stderr, "Failed to load annotation dictionary\n");
             bej_dictionary_free(schema);
-            free(buf);
+            cli_batch_free(&batch);
             return 1;
         }
     }
 
-    // call the main decoder function from the library
-    json_value_t *decoded = bej_decode_buffer(buf, (size_t)sz, schema, annot);
-    free(buf);
-
-    if (!decoded) {
-        fprintf(stderr, "Failed to decode BEJ\n");
-        bej_dictionary_free(schema);
-        if (annot) bej_dictionary_free(annot);
-        return 1;
-    }
-
-    // determine output stream (file or stdout)
-    FILE *out = args->output_path ? fopen(args->output_path, "w") : stdout;
-    if (!out) {
-        perror("fopen output");
-        json_free(decoded);
-        bej_dictionary_free(schema);
-        if (annot) bej_dictionary_free(annot);
-        return 1;
-    }
-    
-    // write the resulting JSON to the output
-    json_write_file(out, decoded);
+    // a lone document gets the threads of -j, a batch keeps one document per thread
+    decode_job_ctx_t ctx = {.schema = schema, .annot = annot, .streaming = args->streaming};
+    if (batch.count == 1 && args->jobs > 1 && !args->streaming)
+        ctx.parallel.pool = bej_pool_create((size_t)args->jobs - 1);
+    const int status = cli_batch_run(args, &batch, decode_file, &ctx, ".json");
 
     // cleanup all allocated resources
-    if (out != stdout) fclose(out);
-    json_free(decoded);
+    bej_pool_free(ctx.parallel.pool);
+    cli_batch_free(&batch);
     bej_dictionary_free(schema);
     if (annot) bej_dictionary_free(annot);
 
-    return 0;
+    return status;
 }
@@ -5,38 +5,122 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include "cli_encode.h"
+#include "cli_batch.h"
 #include "bej_encode.h"
 #include "bej_dictionary.h"
+#include "bej_stats.h"
 #include "json.h"
 
+/**
+ * @brief dictionaries shared by every document of a run
+ */
+typedef struct {
+    const bej_dictionary_t *schema; /**< main schema dictionary */
+    const bej_dictionary_t *annot;  /**< annotation dictionary (or NULL) */
+    int streaming;                  /**< 1 = encode from a json_reader_t, see encode_file_streaming() */
+    bej_parallel_t parallel;        /**< splits a single document across threads (pool is NULL for batches) */
+} encode_job_ctx_t;
+
+/**
+ * @brief counts the size of an input file as consumed JSON text (only with BEJ_ENABLE_STATS)
+ * @param input_path path of the JSON file
+ */
+static void count_input(const char *input_path)
+{
+#ifdef BEJ_ENABLE_STATS
+    struct stat st;
+    if (stat(input_path, &st) == 0)
+        BEJ_STATS_ADD(bytes_in, st.st_size);
+#else
+    (void)input_path;
+#endif
+}
+
+/**
+ * @brief encodes a single JSON file into a BEJ buffer without building a tree
+ *
+ * The file is read through a json_reader_t window, so neither the JSON text
+ * nor a value tree is ever resident
+ *
+ * @param input_path path of the JSON file
+ * @param job the encode_job_ctx_t of the run
+ * @param out buffer receiving the BEJ document
+ * @return 1 on success, 0 on failure
+ */
+static int encode_file_streaming(const char *input_path, const encode_job_ctx_t *job, bej_buffer_t *out)
+{
+    FILE *file = fopen(input_path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open JSON: %s\n", input_path);
+        return 0;
+    }
+
+    json_reader_t reader;
+    int ok = 0;
+    if (json_reader_init_stream(&reader, file))
+    {
+        ok = bej_encode_reader_buffer(out, &reader, job->schema, job->annot);
+        if (!ok && reader.error != JSON_OK)
+            fprintf(stderr, "Failed to parse JSON: %s:%zu:%zu\n", input_path, reader.line, reader.column);
+        json_reader_free(&reader);
+    }
+
+    fclose(file);
+    return ok;
+}
+
+/**
+ * @brief encodes a single JSON file into a BEJ buffer
+ * @param input_path path of the JSON file
+ * @param ctx the encode_job_ctx_t of the run
+ * @param arena arena for the JSON tree (released by the caller)
+ * @param out buffer receiving the BEJ document
+ * @return 1 on success, 0 on failure
+ */
+static int encode_file(const char *input_path, void *ctx, json_arena_t *arena, bej_buffer_t *out)
+{
+    const encode_job_ctx_t *job = ctx;
+    count_input(input_path);
+    if (job->streaming)
+        return encode_file_streaming(input_path, job, out);
+
+    // parse the input JSON file into a value tree
+    json_value_t *root = json_parse_file_in(input_path, arena);
+    if (!root)
+    {
+        fprintf(stderr, "Failed to parse JSON: %s\n", input_path);
+        return 0;
+    }
+
+    return bej_encode_buffer_parallel(out, root, job->schema, job->annot, &job->parallel);
+}
+
 /**
  * @brief runs the BEJ encoding process
  *
- * This function opens the input JSON file, parses it, loads the necessary
- * dictionaries, encodes the data into BEJ format, and writes the result
- * to the specified output file or to stdout
+ * This function loads the necessary dictionaries once, then parses and
+ * encodes every input JSON file and writes the results to the specified
+ * output file, output directory, framed stream or stdout
  *
  * @param args a pointer to a populated args_t structure with all required paths
  * @return 0 on success, or a non-zero value on failure
  */
 int cli_run_encode(const args_t *args)
 {
-    // parse the input JSON file into a value tree
-    json_value_t *root = json_parse_file(args->input_path);
-    if (!root)
-    {
-        fprintf(stderr, "Failed to parse JSON: %s\n", args->input_path);
+    cli_batch_t batch;
+    if (!cli_batch_collect(args, &batch))
         return 1;
-    }
 
     // load the main schema dictionary
     bej_dictionary_t *schema = bej_dictionary_load_map(args->schema_path);
     if (!schema)
     {
         fprintf(stderr, "Failed to load schema dictionary\n");
-        json_free(root);
+        cli_batch_free(&batch);
         return 1;
     }
 
@@ -48,31 +132,23 @@ int cli_run_encode(const args_t *args)
         if (!annot)
         {
             fprintf(stderr, "Failed to load annotation dictionary\n");
-            json_free(root);
             bej_dictionary_free(schema);
+            cli_batch_free(&batch);
             return 1;
         }
     }
 
-    // determine output stream (file or stdout)
-    FILE *out = args->output_path ? fopen(args->output_path, "wb") : stdout;
-    if (!out)
-    {
-        perror("fopen output");
-        json_free(root);
-        bej_dictionary_free(schema);
-        if (annot) bej_dictionary_free(annot);
-        return 1;
-    }
-
-    // call the main encoder function from the library
-    const int ok = bej_encode_stream(out, root, schema, annot);
+    // a lone document gets the threads of -j, a batch keeps one document per thread
+    encode_job_ctx_t ctx = {.schema = schema, .annot = annot, .streaming = args->streaming};
+    if (batch.count == 1 && args->jobs > 1 && !args->streaming)
+        ctx.parallel.pool = bej_pool_create((size_t)args->jobs - 1);
+    const int status = cli_batch_run(args, &batch, encode_file, &ctx, ".bej");
 
     // cleanup all allocated resources
-    if (out != stdout) fclose(out);
-    json_free(root);
+    bej_pool_free(ctx.parallel.pool);
+    cli_batch_free(&batch);
     bej_dictionary_free(schema);
     if (annot) bej_dictionary_free(annot);
 
-    return ok ? 0 : 1;
+    return status;
 }
@@ -0,0 +1,84 @@
+/**
+ * @file cli_index.c
+ * @brief implementation of the command-line BEJ index builder
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cli_index.h"
+#include "cli_batch.h"
+#include "bej_dictionary.h"
+#include "bej_file.h"
+#include "bej_index.h"
+
+/**
+ * @brief dictionaries shared by every document of a run
+ */
+typedef struct {
+    const bej_dictionary_t *schema; /**< main schema dictionary */
+    const bej_dictionary_t *annot;  /**< annotation dictionary (or NULL) */
+} index_job_ctx_t;
+
+/**
+ * @brief builds the index sidecar of a single BEJ file
+ * @param input_path path of the BEJ file
+ * @param ctx the index_job_ctx_t of the run
+ * @param arena unused, no JSON tree is built
+ * @param out buffer receiving the sidecar
+ * @return 1 on success, 0 on failure
+ */
+static int index_file(const char *input_path, void *ctx, json_arena_t *arena, bej_buffer_t *out) {
+    const index_job_ctx_t *job = ctx;
+    (void)arena;
+
+    // map (or read) the entire input file
+    bej_file_view_t view;
+    if (!bej_file_view_path(input_path, &view)) {
+        perror(input_path);
+        return 0;
+    }
+
+    const int ok = bej_index_build(out, view.data, view.size, job->schema, job->annot);
+    bej_file_view_release(&view);
+    if (!ok)
+        fprintf(stderr, "Failed to index BEJ: %s\n", input_path);
+    return ok;
+}
+
+// this function is documented in the header file (cli_index.h)
+int cli_run_index(const args_t *args) {
+    cli_batch_t batch;
+    if (!cli_batch_collect(args, &batch))
+        return 1;
+
+    // load the main schema dictionary
+    bej_dictionary_t *schema = bej_dictionary_load_map(args->schema_path);
+    if (!schema) {
+        fprintf(stderr, "Failed to load schema dictionary\n");
+        cli_batch_free(&batch);
+        return 1;
+    }
+
+    // optionally, load the annotation dictionary
+    bej_dictionary_t *annot = NULL;
+    if (args->annot_path) {
+        annot = bej_dictionary_load_map(args->annot_path);
+        if (!annot) {
+            fprintf(stderr, "Failed to load annotation dictionary\n");
+            bej_dictionary_free(schema);
+            cli_batch_free(&batch);
+            return 1;
+        }
+    }
+
+    index_job_ctx_t ctx = {.schema = schema, .annot = annot};
+    const int status = cli_batch_run(args, &batch, index_file, &ctx, ".idx");
+
+    // cleanup all allocated resources
+    cli_batch_free(&batch);
+    bej_dictionary_free(schema);
+    if (annot) bej_dictionary_free(annot);
+
+    return status;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file cli_stats.c
+ * @brief implementation of the command-line statistics report
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cli_stats.h"
+#include "bej_stats.h"
+#include "json.h"
+
+/**
+ * @brief appends one `"name": value` member to the report
+ * @param writer the report
+ * @param first 1 for the first member of the object
+ * @param name the member name
+ * @param value the value
+ */
+static void write_member(json_writer_t *writer, const int first, const char *name, const uint64_t value) {
+    json_writer_raw(writer, first ? "\n  " : ",\n  ", first ? 3 : 4);
+    json_writer_string(writer, name, strlen(name));
+    json_writer_raw(writer, ": ", 2);
+    json_writer_int(writer, value > INT64_MAX ? INT64_MAX : (int64_t)value);
+}
+
+// this function is documented in the header file (cli_stats.h)
+int cli_print_stats(FILE *out) {
+    bej_stats_t stats;
+    bej_stats_snapshot(&stats);
+
+    json_writer_t writer;
+    json_writer_init(&writer, JSON_WRITE_COMPACT);
+    json_writer_raw(&writer, "{", 1);
+    write_member(&writer, 1, "documents", stats.documents);
+    write_member(&writer, 0, "bytes_in", stats.bytes_in);
+    write_member(&writer, 0, "bytes_out", stats.bytes_out);
+    write_member(&writer, 0, "properties", stats.properties);
+    write_member(&writer, 0, "dict_lookups", stats.dict_lookups);
+    write_member(&writer, 0, "dict_probes", stats.dict_probes);
+    write_member(&writer, 0, "allocations", stats.allocations);
+    write_member(&writer, 0, "encode_ns", stats.encode_ns);
+    write_member(&writer, 0, "decode_ns", stats.decode_ns);
+    write_member(&writer, 0, "dict_ns", stats.dict_ns);
+    write_member(&writer, 0, "sfl_ns", stats.sfl_ns);
+    write_member(&writer, 0, "format_ns", stats.format_ns);
+    write_member(&writer, 0, "io_ns", stats.io_ns);
+    json_writer_raw(&writer, "\n}\n", 3);
+
+    const int ok = json_writer_flush(&writer, out);
+    json_writer_free(&writer);
+    return ok ? 0 : 1;
+}
@@ -10,41 +10,169 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
 #include "json.h"
+#include "json_scan.h"
+
+#define JSON_ARENA_ALIGNMENT (sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double))
+
+/**
+ * @brief one block of an arena; blocks form a list from newest to oldest
+ */
+struct json_arena_block {
+    json_arena_block_t* next; /**< older block */
+    size_t size;              /**< usable bytes in `data` */
+    size_t used;              /**< bytes handed out from `data` */
+    unsigned char data[];     /**< the block memory */
+};
 
 // Prototypes for static functions
 static json_value_t* parse_value(json_parser_t* parser);
 static json_value_t* parse_object(json_parser_t* parser);
 static json_value_t* parse_array(json_parser_t* parser);
 static json_value_t* parse_string(json_parser_t* parser);
+static char* parse_string_chars(json_parser_t* parser);
 static json_value_t* parse_number(json_parser_t* parser);
 static json_value_t* parse_literal(json_parser_t* parser);
 static void skip_whitespace(json_parser_t* parser);
 static bool match_string(json_parser_t* parser, const char* str);
-static bool resize_array(json_array_t* array, size_t new_capacity);
-static bool resize_object(json_object_t* object, size_t new_capacity);
+static bool resize_array(json_array_t* array, size_t new_capacity, json_arena_t* arena);
+static bool resize_object(json_object_t* object, size_t new_capacity, json_arena_t* arena);
+static bool object_push(json_arena_t* arena, json_object_t* object, char* key, json_value_t* value);
 static char* read_file_contents(const char* filename, size_t* size);
 
+void json_arena_init(json_arena_t* arena) {
+    arena->head = NULL;
+    arena->block_size = JSON_ARENA_BLOCK_SIZE;
+}
+
+void json_arena_reset(json_arena_t* arena) {
+    if (!arena->head) return;
+
+    // the newest block is the largest one, keep it for the next tree
+    json_arena_block_t* block = arena->head->next;
+    while (block) {
+        json_arena_block_t* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+void json_arena_destroy(json_arena_t* arena) {
+    if (!arena) return;
+
+    json_arena_block_t* block = arena->head;
+    while (block) {
+        json_arena_block_t* next = block->next;
+        free(block);
+        block = next;
+    }
+    json_arena_init(arena);
+}
+
+void json_arena_adopt(json_arena_t* dst, json_arena_t* src) {
+    if (!src->head) return;
+
+    if (!dst->head) {
+        dst->head = src->head;
+    } else {
+        // behind the head: dst keeps allocating from its own block, a reset frees the adopted ones
+        json_arena_block_t* tail = src->head;
+        while (tail->next) tail = tail->next;
+        tail->next = dst->head->next;
+        dst->head->next = src->head;
+    }
+    json_arena_init(src);
+}
+
+void* json_arena_alloc(json_arena_t* arena, const size_t size) {
+    if (!arena) return NULL;
+
+    json_arena_block_t* block = arena->head;
+    if (block) {
+        // align the address, not just the offset, the block header size is not a multiple of it
+        const uintptr_t base = (uintptr_t)block->data;
+        const uintptr_t start = (base + block->used + JSON_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(JSON_ARENA_ALIGNMENT - 1);
+        const size_t offset = (size_t)(start - base);
+        if (offset <= block->size && size <= block->size - offset) {
+            block->used = offset + size;
+            return block->data + offset;
+        }
+    }
+
+    // start a new block, large enough for this request plus alignment slack
+    size_t block_size = arena->block_size ? arena->block_size : JSON_ARENA_BLOCK_SIZE;
+    if (block_size < size + JSON_ARENA_ALIGNMENT) block_size = size + JSON_ARENA_ALIGNMENT;
+
+    block = malloc(sizeof(json_arena_block_t) + block_size);
+    if (!block) return NULL;
+    block->size = block_size;
+    block->next = arena->head;
+    arena->head = block;
+
+    if (arena->block_size < JSON_ARENA_MAX_BLOCK_SIZE) arena->block_size *= 2;
+
+    const uintptr_t base = (uintptr_t)block->data;
+    const size_t offset = (size_t)(((base + JSON_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(JSON_ARENA_ALIGNMENT - 1)) - base);
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+/**
+ * @brief allocate from an arena, or from the heap when there is none
+ * @param arena arena to allocate from (NULL = malloc)
+ * @param size number of bytes
+ * @return allocated memory or NULL on failure
+ */
+static void* json_alloc(json_arena_t* arena, const size_t size) {
+    return arena ? json_arena_alloc(arena, size) : malloc(size);
+}
+
+/**
+ * @brief release memory from json_alloc (arena memory is released with its arena)
+ * @param arena arena the memory came from (NULL = heap)
+ * @param ptr memory to release
+ */
+static void json_release(json_arena_t* arena, void* ptr) {
+    if (!arena) free(ptr);
+}
+
+char* json_strndup_in(json_arena_t* arena, const char* str, const size_t len) {
+    char* copy = json_alloc(arena, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
 json_value_t* json_create(const json_type_t type) {
-    json_value_t* value = calloc(1, sizeof(json_value_t));
+    return json_create_in(NULL, type);
+}
+
+json_value_t* json_create_in(json_arena_t* arena, const json_type_t type) {
+    json_value_t* value = json_alloc(arena, sizeof(json_value_t));
     if (!value) return NULL;
 
+    memset(value, 0, sizeof(*value));
     value->type = type;
+    value->flags = arena ? JSON_FLAG_ARENA : 0;
 
     if (value->type == JSON_ARRAY) {
         // init array data
-        value->data.array.items = malloc(JSON_INITIAL_CAPACITY * sizeof(json_value_t*));
+        value->data.array.items = json_alloc(arena, JSON_INITIAL_CAPACITY * sizeof(json_value_t*));
         if (!value->data.array.items) {
-            free(value);
+            json_release(arena, value);
             return NULL;
         }
         value->data.array.count = 0;
         value->data.array.capacity = JSON_INITIAL_CAPACITY;
     } else if (value->type == JSON_OBJECT) {
         // init object data
-        value->data.object.entries = malloc(JSON_INITIAL_CAPACITY * sizeof(json_object_entry_t));
+        value->data.object.entries = json_alloc(arena, JSON_INITIAL_CAPACITY * sizeof(json_object_entry_t));
         if (!value->data.object.entries) {
-            free(value);
+            json_release(arena, value);
             return NULL;
         }
         value->data.object.count = 0;
@@ -54,12 +182,22 @@ json_value_t* json_create(const json_type_t type) {
     return value;
 }
 
+json_value_t* json_create_borrowed_string_in(json_arena_t* arena, const char* str) {
+    if (!str) return NULL;
+    json_value_t* value = json_create_in(arena, JSON_STRING);
+    if (!value) return NULL;
+    value->flags |= JSON_FLAG_BORROWED;
+    value->data.string = (char*)str; // never written or freed through a borrowed value
+    return value;
+}
+
 void json_free(json_value_t* value) {
     if (!value) return;
+    if (value->flags & JSON_FLAG_ARENA) return; // released together with the arena
 
     switch (value->type) {
         case JSON_STRING:
-            free(value->data.string);
+            if (!(value->flags & JSON_FLAG_BORROWED)) free(value->data.string);
             break;
         case JSON_ARRAY:
             // recursively free all items in the array
@@ -70,10 +208,11 @@ void json_free(json_value_t* value) {
         case JSON_OBJECT:
             // free each key and recursively free each value
             for (size_t i = 0; i < value->data.object.count; i++) {
-                free(value->data.object.entries[i].key);
+                if (!(value->flags & JSON_FLAG_BORROWED)) free(value->data.object.entries[i].key);
                 json_free(value->data.object.entries[i].value);
             }
             free(value->data.object.entries);
+            free(value->data.object.index);
             break;
         default:
             // for NULL, NUMBER, BOOL no extra data needs to be free
@@ -83,6 +222,138 @@ void json_free(json_value_t* value) {
     free(value);
 }
 
+bool json_array_append(json_value_t* array, json_value_t* item) {
+    return json_array_append_in(NULL, array, item);
+}
+
+bool json_array_append_in(json_arena_t* arena, json_value_t* array, json_value_t* item) {
+    if (!array || !item || array->type != JSON_ARRAY) return false;
+
+    if (array->data.array.count >= array->data.array.capacity &&
+        !resize_array(&array->data.array, array->data.array.capacity * 2, arena))
+        return false;
+
+    array->data.array.items[array->data.array.count++] = item;
+    return true;
+}
+
+bool json_array_reserve_in(json_arena_t* arena, json_value_t* array, const size_t capacity) {
+    if (!array || array->type != JSON_ARRAY) return false;
+    if (capacity <= array->data.array.capacity) return true;
+    if (capacity > SIZE_MAX / sizeof(json_value_t*)) return false;
+    return resize_array(&array->data.array, capacity, arena);
+}
+
+bool json_object_append(json_value_t* object, const char* key, json_value_t* value) {
+    return json_object_append_in(NULL, object, key, value);
+}
+
+bool json_object_append_in(json_arena_t* arena, json_value_t* object, const char* key, json_value_t* value) {
+    if (!object || !key || !value || object->type != JSON_OBJECT) return false;
+
+    // a borrowed key outlives the object by contract, the cast only satisfies the entry type
+    const bool borrowed = object->flags & JSON_FLAG_BORROWED;
+    char* key_copy = borrowed ? (char*)key : json_strndup_in(arena, key, strlen(key));
+    if (!key_copy) return false;
+
+    if (!object_push(arena, &object->data.object, key_copy, value)) {
+        if (!borrowed) json_release(arena, key_copy);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief computes the 32-bit FNV-1a hash of an object key
+ * @param key null-terminated key
+ * @return the hash value
+ */
+static uint32_t hash_key(const char* key) {
+    uint32_t h = 2166136261u;
+    while (*key) {
+        h ^= (uint8_t)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief adds entry `idx` of an object to its hash index
+ * @param object object with an index
+ * @param idx position of the entry
+ */
+static void index_insert(json_object_t* object, const size_t idx) {
+    const size_t mask = object->capacity * 2 - 1;
+    const char* key = object->entries[idx].key;
+    for (size_t slot = hash_key(key) & mask;; slot = (slot + 1) & mask) {
+        const uint32_t e = object->index[slot];
+        if (!e) {
+            object->index[slot] = (uint32_t)(idx + 1);
+            return;
+        }
+        // lookups see the first entry of a key, like a scan in order
+        if (strcmp(object->entries[e - 1].key, key) == 0) return;
+    }
+}
+
+/**
+ * @brief builds the hash index of an object for its current capacity
+ *
+ * Without memory the object drops its index and is scanned instead
+ *
+ * @param object the object
+ * @param arena arena the object lives in (NULL = heap)
+ */
+static void index_build(json_object_t* object, json_arena_t* arena) {
+    json_release(arena, object->index);
+    const size_t size = object->capacity * 2 * sizeof(uint32_t);
+    object->index = object->capacity <= UINT32_MAX / 2 ? json_alloc(arena, size) : NULL;
+    if (!object->index) return;
+
+    memset(object->index, 0, size);
+    for (size_t i = 0; i < object->count; i++) index_insert(object, i);
+}
+
+/**
+ * @brief appends an entry to an object, growing the entries and keeping the index
+ * @param arena arena the object lives in (NULL = heap)
+ * @param object the object
+ * @param key key of the entry (stored as is)
+ * @param value value of the entry
+ * @return true on success, false on allocation failure
+ */
+static bool object_push(json_arena_t* arena, json_object_t* object, char* key, json_value_t* value) {
+    if (object->count >= object->capacity && !resize_object(object, object->capacity * 2, arena)) return false;
+
+    const size_t idx = object->count++;
+    object->entries[idx].key = key;
+    object->entries[idx].value = value;
+    if (object->index) {
+        index_insert(object, idx);
+    } else if (object->count == JSON_OBJECT_INDEX_MIN) {
+        index_build(object, arena);
+    }
+    return true;
+}
+
+json_value_t* json_object_get(const json_value_t* object, const char* key) {
+    if (!object || !key || object->type != JSON_OBJECT) return NULL;
+
+    const json_object_t* obj = &object->data.object;
+    if (obj->index) {
+        const size_t mask = obj->capacity * 2 - 1;
+        for (size_t slot = hash_key(key) & mask; obj->index[slot]; slot = (slot + 1) & mask) {
+            const json_object_entry_t* entry = &obj->entries[obj->index[slot] - 1];
+            if (strcmp(entry->key, key) == 0) return entry->value;
+        }
+        return NULL;
+    }
+    for (size_t i = 0; i < obj->count; i++) {
+        if (strcmp(obj->entries[i].key, key) == 0) return obj->entries[i].value;
+    }
+    return NULL;
+}
+
 /**
  * @brief parse any JSON value (object, array, string, number, literal)
  * @param parser parser context
@@ -117,7 +388,7 @@ static json_value_t* parse_value(json_parser_t* parser) {
  * @return JSON object or NULL on error
  */
 static json_value_t* parse_object(json_parser_t* parser) {
-    json_value_t* object = json_create(JSON_OBJECT);
+    json_value_t* object = json_create_in(parser->arena, JSON_OBJECT);
     if (!object) {
         parser->error = JSON_ERROR_OUT_OF_MEMORY;
         return NULL;
@@ -145,17 +416,9 @@ static json_value_t* parse_object(json_parser_t* parser) {
             return NULL;
         }
 
-        json_value_t* key_value = parse_string(parser);
-        if (!key_value) {
-            json_free(object);
-            return NULL;
-        }
-
-        char* key = strdup(key_value->data.string);
-        json_free(key_value);
-
+        // the key is parsed straight into its final storage, no temporary node
+        char* key = parse_string_chars(parser);
         if (!key) {
-            parser->error = JSON_ERROR_OUT_OF_MEMORY;
             json_free(object);
             return NULL;
         }
@@ -165,7 +428,7 @@ static json_value_t* parse_object(json_parser_t* parser) {
         // expect a colon after the key
         if (*parser->current != ':') {
             parser->error = JSON_ERROR_PARSE_ERROR;
-            free(key);
+            json_release(parser->arena, key);
             json_free(object);
             return NULL;
         }
@@ -175,26 +438,20 @@ static json_value_t* parse_object(json_parser_t* parser) {
 
         json_value_t* value = parse_value(parser);
         if (!value) {
-            free(key);
+            json_release(parser->arena, key);
             json_free(object);
             return NULL;
         }
 
-        // resize object if you need
-        if (object->data.object.count >= object->data.object.capacity &&
-            !resize_object(&object->data.object, object->data.object.capacity * 2)) {
+        // add the parsed key-value pair
+        if (!object_push(parser->arena, &object->data.object, key, value)) {
             parser->error = JSON_ERROR_OUT_OF_MEMORY;
-            free(key);
+            json_release(parser->arena, key);
             json_free(value);
             json_free(object);
             return NULL;
         }
 
-        // add the parsed key-value pair
-        const size_t idx = object->data.object.count++;
-        object->data.object.entries[idx].key = key;
-        object->data.object.entries[idx].value = value;
-
         skip_whitespace(parser);
 
         // check for end of object
@@ -225,7 +482,7 @@ static json_value_t* parse_object(json_parser_t* parser) {
  * @return JSON array or NULL on error
  */
 static json_value_t* parse_array(json_parser_t* parser) {
-    json_value_t* array = json_create(JSON_ARRAY);
+    json_value_t* array = json_create_in(parser->arena, JSON_ARRAY);
     if (!array) {
         parser->error = JSON_ERROR_OUT_OF_MEMORY;
         return NULL;
@@ -252,7 +509,7 @@ static json_value_t* parse_array(json_parser_t* parser) {
 
         // resize array if need
         if (array->data.array.count >= array->data.array.capacity) {
-            if (!resize_array(&array->data.array, array->data.array.capacity * 2)) {
+            if (!resize_array(&array->data.array, array->data.array.capacity * 2, parser->arena)) {
                 parser->error = JSON_ERROR_OUT_OF_MEMORY;
                 json_free(value);
                 json_free(array);
@@ -292,88 +549,122 @@ static json_value_t* parse_array(json_parser_t* parser) {
  * @return JSON string value or NULL on error
  */
 static json_value_t* parse_string(json_parser_t* parser) {
-    parser->current++; // consume opening '"'
-    parser->column++;
+    char* str = parse_string_chars(parser);
+    if (!str) return NULL;
 
-    const char* start = parser->current;
-    size_t length = 0;
+    json_value_t* value = json_create_in(parser->arena, JSON_STRING);
+    if (!value) {
+        parser->error = JSON_ERROR_OUT_OF_MEMORY;
+        json_release(parser->arena, str);
+        return NULL;
+    }
 
-    // calculate required buffer length, handling escapes
-    while (*parser->current && *parser->current != '"') {
-        if (*parser->current == '\\') {
-            parser->current++;
-            parser->column++;
-            if (!*parser->current) break; // end of string after backslash
-
-            if (*parser->current == 'u') { // unicode escape
-                parser->current += 4;
-                parser->column += 4;
-                length += JSON_MAX_UNICODE_LENGTH; // multi-byte UTF-8
-            } else {
-                length++; // simple escape sequence like \n or \"
+    value->data.string = str;
+    return value;
+}
+
+/**
+ * @brief decode the escape sequences of string contents
+ * @param in first character after the opening quote
+ * @param end the closing quote
+ * @param out receives the characters (at least `end - in` bytes; escapes only shrink)
+ * @return number of characters written, or (size_t)-1 on an invalid escape
+ */
+static size_t unescape_string(const char* in, const char* end, char* out) {
+    char* pos = out;
+
+    while (in < end) {
+        // copy the escape-free run up to the next backslash in one go
+        const char* backslash = memchr(in, '\\', (size_t)(end - in));
+        const size_t run = (size_t)((backslash ? backslash : end) - in);
+        memcpy(pos, in, run);
+        pos += run;
+        in += run;
+        if (in == end) break;
+
+        switch (in[1]) {
+            case '"':  *pos++ = '"';  break;
+            case '\\': *pos++ = '\\'; break;
+            case '/':  *pos++ = '/';  break;
+            case 'b':  *pos++ = '\b'; break;
+            case 'f':  *pos++ = '\f'; break;
+            case 'n':  *pos++ = '\n'; break;
+            case 'r':  *pos++ = '\r'; break;
+            case 't':  *pos++ = '\t'; break;
+            case 'u': {
+                uint32_t code_point, low;
+                if (end - in < 6 || !json_scan_hex4(in + 2, &code_point)) return (size_t)-1;
+                in += 6;
+
+                // a high surrogate combines with a directly following low surrogate
+                if (code_point >= 0xD800 && code_point <= 0xDBFF && end - in >= 6 &&
+                    in[0] == '\\' && in[1] == 'u' && json_scan_hex4(in + 2, &low) &&
+                    low >= 0xDC00 && low <= 0xDFFF) {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    in += 6;
+                }
+                pos += json_scan_utf8(code_point, pos);
+                continue;
             }
-        } else {
-            length++;
+            default: // invalid escape
+                return (size_t)-1;
         }
-        parser->current++;
-        parser->column++;
+        in += 2;
+    }
+    return (size_t)(pos - out);
+}
+
+/**
+ * @brief parse the characters of a JSON string (object keys and string values)
+ *
+ * The closing quote is found with the vector scanner, stepping over escaped
+ * characters. Strings without escapes are then copied with a single memcpy
+ *
+ * @param parser parser context, positioned at the opening quote
+ * @return null-terminated characters allocated like the tree, or NULL on error
+ */
+static char* parse_string_chars(json_parser_t* parser) {
+    const char* start = parser->current + 1; // skip opening '"'
+    const char* end = start;
+    bool escaped = false;
+    for (;;) {
+        end = json_scan_string(end);
+        if (*end != '\\') break;
+        escaped = true;
+        if (!end[1]) break; // end of input after backslash
+        end += 2;
     }
 
-    if (*parser->current != '"') {
+    parser->column += (size_t)(end - parser->current);
+    parser->current = end;
+    if (*end != '"') {
         parser->error = JSON_ERROR_PARSE_ERROR;
         return NULL;
     }
 
-    char* str = malloc(length + 1);
+    const size_t raw_length = (size_t)(end - start);
+    char* str = json_alloc(parser->arena, raw_length + 1);
     if (!str) {
         parser->error = JSON_ERROR_OUT_OF_MEMORY;
         return NULL;
     }
 
-    parser->current = start; // reset for next loop
-    size_t pos = 0;
-
-    // copy chars and handle escape sequences
-    while (*parser->current && *parser->current != '"') {
-        if (*parser->current == '\\') {
-            parser->current++;
-            switch (*parser->current) {
-                case '"':  str[pos++] = '"';  break;
-                case '\\': str[pos++] = '\\'; break;
-                case '/':  str[pos++] = '/';  break;
-                case 'b':  str[pos++] = '\b'; break;
-                case 'f':  str[pos++] = '\f'; break;
-                case 'n':  str[pos++] = '\n'; break;
-                case 'r':  str[pos++] = '\r'; break;
-                case 't':  str[pos++] = '\t'; break;
-                case 'u': // placeholder for Unicode
-                    parser->current += 4;
-                    str[pos++] = '?'; // simple placeholder
-                    continue;
-                default: // invalid escape
-                    parser->error = JSON_ERROR_PARSE_ERROR;
-                    free(str);
-                    return NULL;
-            }
-            parser->current++;
-        } else {
-            str[pos++] = *parser->current++;
+    size_t length = raw_length;
+    if (escaped) {
+        length = unescape_string(start, end, str);
+        if (length == (size_t)-1) {
+            parser->error = JSON_ERROR_PARSE_ERROR;
+            json_release(parser->arena, str);
+            return NULL;
         }
+    } else {
+        memcpy(str, start, raw_length);
     }
 
-    str[pos] = '\0';
+    str[length] = '\0';
     parser->current++; // consume closing '"'
     parser->column++;
-
-    json_value_t* value = json_create(JSON_STRING);
-    if (!value) {
-        parser->error = JSON_ERROR_OUT_OF_MEMORY;
-        free(str);
-        return NULL;
-    }
-
-    value->data.string = str;
-    return value;
+    return str;
 }
 
 /**
@@ -436,20 +727,23 @@ static json_value_t* parse_number(json_parser_t* parser) {
         }
     }
 
+    // strtod needs the validated span on its own (it would accept e.g. "0x1f"),
+    // ordinary numbers fit a stack buffer
     const size_t len = parser->current - start;
-    char* num_str = malloc(len + 1);
+    char local[64];
+    char* num_str = len < sizeof(local) ? local : malloc(len + 1);
     if (!num_str) {
         parser->error = JSON_ERROR_OUT_OF_MEMORY;
         return NULL;
     }
 
-    strncpy(num_str, start, len);
+    memcpy(num_str, start, len);
     num_str[len] = '\0';
 
     const double number = strtod(num_str, NULL);
-    free(num_str);
+    if (num_str != local) free(num_str);
 
-    json_value_t* value = json_create(JSON_NUMBER);
+    json_value_t* value = json_create_in(parser->arena, JSON_NUMBER);
     if (!value) {
         parser->error = JSON_ERROR_OUT_OF_MEMORY;
         return NULL;
@@ -467,19 +761,19 @@ static json_value_t* parse_number(json_parser_t* parser) {
  */
 static json_value_t* parse_literal(json_parser_t* parser) {
     if (match_string(parser, "true")) {
-        json_value_t* value = json_create(JSON_BOOL);
+        json_value_t* value = json_create_in(parser->arena, JSON_BOOL);
         if (value) value->data.boolean = true;
         return value;
     }
 
     if (match_string(parser, "false")) {
-        json_value_t* value = json_create(JSON_BOOL);
+        json_value_t* value = json_create_in(parser->arena, JSON_BOOL);
         if (value) value->data.boolean = false;
         return value;
     }
 
     if (match_string(parser, "null")) {
-        return json_create(JSON_NULL);
+        return json_create_in(parser->arena, JSON_NULL);
     }
 
     parser->error = JSON_ERROR_PARSE_ERROR;
@@ -492,15 +786,24 @@ static json_value_t* parse_literal(json_parser_t* parser) {
  * @param parser parser context
  */
 static void skip_whitespace(json_parser_t* parser) {
-    while (*parser->current && isspace((unsigned char)*parser->current)) {
+    for (;;) {
+        size_t newlines = 0;
+        const char* last_newline = NULL;
+        const char* end = json_scan_whitespace(parser->current, &newlines, &last_newline);
+
         // track line and column numbers
-        if (*parser->current == '\n') {
-            parser->line++;
-            parser->column = 1;
+        if (newlines) {
+            parser->line += newlines;
+            parser->column = (size_t)(end - last_newline);
         } else {
-            parser->column++;
+            parser->column += (size_t)(end - parser->current);
         }
+        parser->current = end;
+
+        // the other isspace() characters are accepted too, but not vectorized
+        if (*end != '\v' && *end != '\f') return;
         parser->current++;
+        parser->column++;
     }
 }
 
@@ -524,10 +827,18 @@ static bool match_string(json_parser_t* parser, const char* str) {
  * @brief resize a JSON array
  * @param array array to resize
  * @param new_capacity new capacity
+ * @param arena arena the array lives in (NULL = heap)
  * @return true on success, false on allocation failure
  */
-static bool resize_array(json_array_t* array, const size_t new_capacity) {
-    json_value_t** new_items = realloc(array->items, new_capacity * sizeof(json_value_t*));
+static bool resize_array(json_array_t* array, const size_t new_capacity, json_arena_t* arena) {
+    json_value_t** new_items;
+    if (arena) {
+        // arena memory cannot grow in place; the old slots are reclaimed with the arena
+        new_items = json_arena_alloc(arena, new_capacity * sizeof(json_value_t*));
+        if (new_items) memcpy(new_items, array->items, array->count * sizeof(json_value_t*));
+    } else {
+        new_items = realloc(array->items, new_capacity * sizeof(json_value_t*));
+    }
     if (!new_items) return false;
 
     array->items = new_items;
@@ -539,14 +850,22 @@ static bool resize_array(json_array_t* array, const size_t new_capacity) {
  * @brief resize a JSON object
  * @param object object to resize
  * @param new_capacity new capacity
+ * @param arena arena the object lives in (NULL = heap)
  * @return true on success, false on allocation failure
  */
-static bool resize_object(json_object_t* object, const size_t new_capacity) {
-    json_object_entry_t* new_entries = realloc(object->entries, new_capacity * sizeof(json_object_entry_t));
+static bool resize_object(json_object_t* object, const size_t new_capacity, json_arena_t* arena) {
+    json_object_entry_t* new_entries;
+    if (arena) {
+        new_entries = json_arena_alloc(arena, new_capacity * sizeof(json_object_entry_t));
+        if (new_entries) memcpy(new_entries, object->entries, object->count * sizeof(json_object_entry_t));
+    } else {
+        new_entries = realloc(object->entries, new_capacity * sizeof(json_object_entry_t));
+    }
     if (!new_entries) return false;
 
     object->entries = new_entries;
     object->capacity = new_capacity;
+    if (object->count >= JSON_OBJECT_INDEX_MIN) index_build(object, arena); // slots follow the capacity
     return true;
 }
 
@@ -591,6 +910,10 @@ static char* read_file_contents(const char* filename, size_t* size) {
 }
 
 json_value_t* json_parse(const char* input) {
+    return json_parse_in(input, NULL);
+}
+
+json_value_t* json_parse_in(const char* input, json_arena_t* arena) {
     if (!input) return NULL;
 
     json_parser_t parser = {
@@ -598,7 +921,8 @@ json_value_t* json_parse(const char* input) {
         .current = input,
         .line = 1,
         .column = 1,
-        .error = JSON_OK
+        .error = JSON_OK,
+        .arena = arena
     };
 
     json_value_t* result = parse_value(&parser);
@@ -615,15 +939,250 @@ json_value_t* json_parse(const char* input) {
 }
 
 json_value_t* json_parse_file(const char* filename) {
+    return json_parse_file_in(filename, NULL);
+}
+
+json_value_t* json_parse_file_in(const char* filename, json_arena_t* arena) {
     size_t size;
     char* contents = read_file_contents(filename, &size);
     if (!contents) return NULL;
 
-    json_value_t* result = json_parse(contents);
+    json_value_t* result = json_parse_in(contents, arena);
     free(contents);
     return result;
 }
 
+/**
+ * @brief make room for more output in a writer
+ * @param writer Writer to grow
+ * @param extra Number of bytes that must fit after `size`
+ * @return Pointer to the first free byte, or NULL on allocation failure (sets `failed`)
+ */
+static char* writer_reserve(json_writer_t* writer, const size_t extra) {
+    if (writer->failed) return NULL;
+    if (extra > writer->capacity - writer->size) {
+        size_t new_capacity = writer->capacity ? writer->capacity : JSON_WRITER_INITIAL_CAPACITY;
+        while (new_capacity - writer->size < extra) {
+            if (new_capacity > SIZE_MAX / 2) {
+                writer->failed = true;
+                return NULL;
+            }
+            new_capacity *= 2;
+        }
+        char* new_data = realloc(writer->data, new_capacity);
+        if (!new_data) {
+            writer->failed = true;
+            return NULL;
+        }
+        writer->data = new_data;
+        writer->capacity = new_capacity;
+    }
+    return writer->data + writer->size;
+}
+
+/**
+ * @brief append a newline and the indentation of a nesting level (pretty mode only)
+ * @param writer Writer to append to
+ * @param depth Nesting level relative to the writer's base indentation
+ */
+static void writer_newline(json_writer_t* writer, const int depth) {
+    if (!(writer->mode & JSON_WRITE_PRETTY)) return;
+    const int tabs = writer->indent + depth;
+    char* p = writer_reserve(writer, 1 + (size_t)(tabs > 0 ? tabs : 0));
+    if (!p) return;
+    *p++ = '\n';
+    for (int i = 0; i < tabs; i++) *p++ = '\t';
+    writer->size = (size_t)(p - writer->data);
+}
+
+/**
+ * @brief append any JSON value at a nesting level
+ * @param writer Writer to append to
+ * @param value Value to write
+ * @param depth Nesting level relative to the writer's base indentation
+ */
+static void writer_value(json_writer_t* writer, const json_value_t* value, const int depth) {
+    const bool pretty = (writer->mode & JSON_WRITE_PRETTY) != 0;
+
+    switch (value->type) {
+        case JSON_NULL:
+            json_writer_raw(writer, "null", 4);
+            break;
+        case JSON_BOOL:
+            if (value->data.boolean) json_writer_raw(writer, "true", 4);
+            else json_writer_raw(writer, "false", 5);
+            break;
+        case JSON_NUMBER:
+            json_writer_number(writer, value->data.number);
+            break;
+        case JSON_STRING:
+            json_writer_string(writer, value->data.string, strlen(value->data.string));
+            break;
+        case JSON_ARRAY: {
+            const json_array_t* array = &value->data.array;
+            json_writer_raw(writer, "[", 1);
+            for (size_t i = 0; i < array->count; i++) {
+                if (i) json_writer_raw(writer, ", ", pretty ? 2 : 1);
+                writer_value(writer, array->items[i], depth + 1);
+            }
+            json_writer_raw(writer, "]", 1);
+            break;
+        }
+        case JSON_OBJECT: {
+            const json_object_t* object = &value->data.object;
+            json_writer_raw(writer, "{", 1);
+            for (size_t i = 0; i < object->count; i++) {
+                if (i) json_writer_raw(writer, ",", 1);
+                writer_newline(writer, depth + 1);
+                json_writer_string(writer, object->entries[i].key, strlen(object->entries[i].key));
+                json_writer_raw(writer, ": ", pretty ? 2 : 1);
+                writer_value(writer, object->entries[i].value, depth + 1);
+            }
+            if (object->count) writer_newline(writer, depth);
+            json_writer_raw(writer, "}", 1);
+            break;
+        }
+    }
+}
+
+void json_writer_init(json_writer_t* writer, const unsigned mode) {
+    memset(writer, 0, sizeof(*writer));
+    writer->mode = mode;
+}
+
+void json_writer_free(json_writer_t* writer) {
+    if (!writer) return;
+    free(writer->data);
+    writer->data = NULL;
+    writer->size = writer->capacity = 0;
+}
+
+bool json_writer_raw(json_writer_t* writer, const char* data, const size_t size) {
+    char* p = writer_reserve(writer, size);
+    if (!p) return false;
+    memcpy(p, data, size);
+    writer->size += size;
+    return true;
+}
+
+bool json_writer_escaped(json_writer_t* writer, const char* s, const size_t length) {
+    static const char hex[] = "0123456789abcdef";
+
+    // worst case every character becomes \u00XX
+    if (length > SIZE_MAX / 6) {
+        writer->failed = true;
+        return false;
+    }
+    char* p = writer_reserve(writer, length * 6);
+    if (!p) return false;
+
+    for (size_t i = 0; i < length; i++) {
+        const unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            *p++ = (char)c;
+            continue;
+        }
+        *p++ = '\\';
+        switch (c) {
+            case '"':  *p++ = '"';  break;
+            case '\\': *p++ = '\\'; break;
+            case '\b': *p++ = 'b';  break;
+            case '\f': *p++ = 'f';  break;
+            case '\n': *p++ = 'n';  break;
+            case '\r': *p++ = 'r';  break;
+            case '\t': *p++ = 't';  break;
+            default:
+                *p++ = 'u'; *p++ = '0'; *p++ = '0';
+                *p++ = hex[c >> 4];
+                *p++ = hex[c & 0x0F];
+        }
+    }
+    writer->size = (size_t)(p - writer->data);
+    return true;
+}
+
+bool json_writer_string(json_writer_t* writer, const char* s, const size_t length) {
+    json_writer_raw(writer, "\"", 1);
+    json_writer_escaped(writer, s, length);
+    return json_writer_raw(writer, "\"", 1);
+}
+
+bool json_writer_int(json_writer_t* writer, const int64_t value) {
+    char digits[20];
+    size_t n = 0;
+
+    // negate in unsigned arithmetic so INT64_MIN does not overflow
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    char* p = writer_reserve(writer, n + 1);
+    if (!p) return false;
+    if (value < 0) *p++ = '-';
+    while (n) *p++ = digits[--n];
+    writer->size = (size_t)(p - writer->data);
+    return true;
+}
+
+bool json_writer_number(json_writer_t* writer, const double num) {
+    // JSON has no NaN or infinity
+    if (num != num || num > 1.7976931348623157e308 || num < -1.7976931348623157e308)
+        return json_writer_raw(writer, "null", 4);
+
+    // integral values below 2^53 are exact as int64_t
+    if (num > -9007199254740992.0 && num < 9007199254740992.0 && num == (double)(int64_t)num)
+        return json_writer_int(writer, (int64_t)num);
+
+    // shortest of 15, 16 or 17 significant digits that parses back to the same double
+    char text[32];
+    int n = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        n = snprintf(text, sizeof(text), "%.*g", precision, num);
+        if (strtod(text, NULL) == num) break;
+    }
+    return json_writer_raw(writer, text, (size_t)n);
+}
+
+bool json_writer_value(json_writer_t* writer, const json_value_t* value) {
+    if (!value) {
+        writer->failed = true;
+        return false;
+    }
+    writer_value(writer, value, 0);
+    return !writer->failed;
+}
+
+bool json_writer_flush(json_writer_t* writer, FILE* file) {
+    if (writer->failed) return false;
+    if (writer->size && fwrite(writer->data, 1, writer->size, file) != writer->size) {
+        writer->failed = true;
+        return false;
+    }
+    writer->size = 0;
+    return true;
+}
+
+/**
+ * @brief run a writer over a value and flush it to a stream
+ * @param f Output file stream
+ * @param value Value to write
+ * @param indent Base indentation level
+ * @param newline Whether a trailing newline is appended
+ * @return true on success
+ */
+static bool write_to_file(FILE* f, const json_value_t* value, const int indent, const bool newline) {
+    json_writer_t writer;
+    json_writer_init(&writer, JSON_WRITE_PRETTY);
+    writer.indent = indent;
+    json_writer_value(&writer, value);
+    if (newline) json_writer_raw(&writer, "\n", 1);
+    const bool ok = json_writer_flush(&writer, f);
+    json_writer_free(&writer);
+    return ok;
+}
+
 void json_write_indent(FILE* f, const int indent) {
     for (int i = 0; i < indent; i++) {
         fputc('\t', f);
@@ -631,66 +1190,42 @@ void json_write_indent(FILE* f, const int indent) {
 }
 
 void json_write_null(FILE* f) {
-    fprintf(f, "null");
+    fputs("null", f);
 }
 
 void json_write_bool(FILE* f, const bool b) {
-    fprintf(f, b ? "true" : "false");
+    fputs(b ? "true" : "false", f);
 }
 
 void json_write_number(FILE* f, const double num) {
-    fprintf(f, "%g", num);
+    const json_value_t value = {.type = JSON_NUMBER, .data.number = num};
+    write_to_file(f, &value, 0, false);
 }
 
 void json_write_string(FILE* f, const char* s) {
-    fprintf(f, "\"%s\"", s);
+    json_writer_t writer;
+    json_writer_init(&writer, JSON_WRITE_COMPACT);
+    json_writer_string(&writer, s, strlen(s));
+    json_writer_flush(&writer, f);
+    json_writer_free(&writer);
 }
 
 void json_write_array(FILE* f, const json_array_t* array, const int indent) {
-    fprintf(f, "[");
-    if (array->count > 0) {
-        for (size_t i = 0; i < array->count; i++) {
-            json_write_value(f, array->items[i], indent + 1);
-            if (i < array->count - 1)
-                fprintf(f, ", ");
-        }
-    }
-    fprintf(f, "]");
+    const json_value_t value = {.type = JSON_ARRAY, .data.array = *array};
+    write_to_file(f, &value, indent, false);
 }
 
 void json_write_object(FILE* f, const json_object_t* object, const int indent) {
-    fprintf(f, "{");
-    if (object->count > 0) {
-        fprintf(f, "\n");
-        for (size_t i = 0; i < object->count; i++) {
-            // add newline and indentation for pretty printing
-            json_write_indent(f, indent + 1);
-            fprintf(f, "\"%s\": ", object->entries[i].key);
-            json_write_value(f, object->entries[i].value, indent + 1);
-            if (i < object->count - 1)
-                fprintf(f, ",");
-            fprintf(f, "\n");
-        }
-        json_write_indent(f, indent);
-    }
-    fprintf(f, "}");
+    const json_value_t value = {.type = JSON_OBJECT, .data.object = *object};
+    write_to_file(f, &value, indent, false);
 }
 
 void json_write_value(FILE* f, const json_value_t* value, const int indent) {
-    switch (value->type) {
-        case JSON_NULL:   json_write_null(f); break;
-        case JSON_BOOL:   json_write_bool(f, value->data.boolean); break;
-        case JSON_NUMBER: json_write_number(f, value->data.number); break;
-        case JSON_STRING: json_write_string(f, value->data.string); break;
-        case JSON_ARRAY:  json_write_array(f, &value->data.array, indent); break;
-        case JSON_OBJECT: json_write_object(f, &value->data.object, indent); break;
-    }
+    write_to_file(f, value, indent, false);
 }
 
 int json_write_file(FILE* file, const json_value_t* root) {
-    json_write_value(file, root, 0);
-    fprintf(file, "\n");
-    return 0;
+    return write_to_file(file, root, 0, true) ? 0 : -1;
 }
 
 bool json_compare(const json_value_t* a, const json_value_t* b) {
@@ -715,21 +1250,11 @@ bool json_compare(const json_value_t* a, const json_value_t* b) {
         case JSON_OBJECT:
             if (a->data.object.count != b->data.object.count) return false;
 
-            // compare objects regardless of key order using nested loops
+            // compare objects regardless of key order, looking each key of 'a' up in 'b'
             for (size_t i = 0; i < a->data.object.count; ++i) {
-                const char* key = a->data.object.entries[i].key;
-                const json_value_t* val_a = a->data.object.entries[i].value;
-                bool found = false;
-
-                for (size_t j = 0; j < b->data.object.count; ++j) {
-                    if (strcmp(key, b->data.object.entries[j].key) == 0) {
-                        found = true;
-                        // recursively compare the values for the same key
-                        if (!json_compare(val_a, b->data.object.entries[j].value)) return false;
-                        break;
-                    }
-                }
-                if (!found) return false; // key from object 'a' not found in object 'b'
+                const json_value_t* val_b = json_object_get(b, a->data.object.entries[i].key);
+                // a key from object 'a' missing in object 'b' is a mismatch too
+                if (!json_compare(a->data.object.entries[i].value, val_b)) return false;
             }
             return true;
         default:
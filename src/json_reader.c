@@ -0,0 +1,522 @@
+/**
+* @file json_reader.c
+* @brief implementation of the streaming (pull) JSON reader
+*
+* The reader is a small state machine: `expect` records what the grammar
+* allows next and a byte stack records whether each open container is an
+* object or an array. Input is consumed through a fixed-size window that is
+* refilled from the stream on demand. A fed reader keeps the unread part of
+* the chunks it was given instead, and an event that runs out of them is
+* rolled back by json_reader_next()
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "json.h"
+#include "json_scan.h"
+
+/**
+ * @brief kinds of open containers on the reader stack
+ */
+enum {
+    READER_IN_OBJECT = 0, /**< inside '{' */
+    READER_IN_ARRAY       /**< inside '[' */
+};
+
+/**
+ * @brief grammar positions of the reader
+ */
+enum {
+    READER_EXPECT_VALUE = 0,     /**< a value (document start, after ':' or ',' in an array) */
+    READER_EXPECT_VALUE_OR_END,  /**< a value or ']' (after '[') */
+    READER_EXPECT_KEY,           /**< a key (after ',' in an object) */
+    READER_EXPECT_KEY_OR_END,    /**< a key or '}' (after '{') */
+    READER_EXPECT_COMMA_OR_END,  /**< ',' or the closing bracket (after a value) */
+    READER_EXPECT_DONE           /**< only whitespace (after the root value) */
+};
+
+/**
+ * @brief refill the input window from the stream
+ * @param reader reader context
+ * @return true if at least one character is available
+ */
+static bool refill(json_reader_t* reader) {
+    if (reader->pos < reader->end) return true;
+    if (reader->feeding) {
+        reader->starved = 1; // the next chunk may continue the event
+        return false;
+    }
+    if (!reader->stream || reader->at_eof) return false;
+
+    const size_t n = fread(reader->buffer, 1, JSON_READER_BUFFER_SIZE, reader->stream);
+    if (n == 0) {
+        reader->at_eof = 1;
+        if (ferror(reader->stream)) reader->error = JSON_ERROR_INVALID_INPUT;
+        return false;
+    }
+    reader->pos = reader->buffer;
+    reader->end = reader->buffer + n;
+    return true;
+}
+
+/**
+ * @brief look at the next character without consuming it
+ * @param reader reader context
+ * @return the character, or -1 at the end of the input
+ */
+static int peek_char(json_reader_t* reader) {
+    return refill(reader) ? (unsigned char)*reader->pos : -1;
+}
+
+/**
+ * @brief consume the next character
+ * @param reader reader context
+ * @return the character, or -1 at the end of the input
+ */
+static int next_char(json_reader_t* reader) {
+    if (!refill(reader)) return -1;
+    const int c = (unsigned char)*reader->pos++;
+    if (c == '\n') {
+        reader->line++;
+        reader->column = 1;
+    } else {
+        reader->column++;
+    }
+    return c;
+}
+
+/**
+ * @brief skip whitespace characters
+ * @param reader reader context
+ */
+static void skip_whitespace(json_reader_t* reader) {
+    int c;
+    while ((c = peek_char(reader)) != -1 && isspace(c))
+        next_char(reader);
+}
+
+/**
+ * @brief put the reader into the (sticky) error state
+ * @param reader reader context
+ * @param error error code to report
+ * @return JSON_EVENT_ERROR
+ */
+static json_event_t fail(json_reader_t* reader, const json_error_t error) {
+    if (reader->error == JSON_OK) reader->error = error;
+    reader->expect = -1;
+    return JSON_EVENT_ERROR;
+}
+
+/**
+ * @brief append a character to the token buffer
+ * @param reader reader context
+ * @param c character to append
+ * @return true on success, false on allocation failure
+ */
+static bool token_push(json_reader_t* reader, const char c) {
+    if (reader->token_length + 1 >= reader->token_capacity) {
+        const size_t new_capacity = reader->token_capacity ? reader->token_capacity * 2 : 64;
+        char* new_token = realloc(reader->token, new_capacity);
+        if (!new_token) return false;
+        reader->token = new_token;
+        reader->token_capacity = new_capacity;
+    }
+    reader->token[reader->token_length++] = c;
+    reader->token[reader->token_length] = '\0';
+    return true;
+}
+
+/**
+ * @brief push an open container
+ * @param reader reader context
+ * @param kind READER_IN_OBJECT or READER_IN_ARRAY
+ * @return true on success, false on allocation failure
+ */
+static bool push_container(json_reader_t* reader, const unsigned char kind) {
+    if (reader->depth == reader->stack_capacity) {
+        const size_t new_capacity = reader->stack_capacity ? reader->stack_capacity * 2 : 32;
+        unsigned char* new_stack = realloc(reader->stack, new_capacity);
+        if (!new_stack) return false;
+        reader->stack = new_stack;
+        reader->stack_capacity = new_capacity;
+    }
+    reader->stack[reader->depth++] = kind;
+    return true;
+}
+
+/**
+ * @brief move past a completed value (scalar or closed container)
+ * @param reader reader context
+ */
+static void value_done(json_reader_t* reader) {
+    reader->expect = reader->depth ? READER_EXPECT_COMMA_OR_END : READER_EXPECT_DONE;
+}
+
+/**
+ * @brief append a code point to the token buffer as UTF-8
+ * @param reader reader context
+ * @param code_point the code point (surrogates become U+FFFD)
+ * @return true on success, false on allocation failure
+ */
+static bool token_push_code_point(json_reader_t* reader, const uint32_t code_point) {
+    char utf8[JSON_UTF8_MAX_LENGTH];
+    const size_t n = json_scan_utf8(code_point, utf8);
+    for (size_t i = 0; i < n; i++)
+        if (!token_push(reader, utf8[i])) return false;
+    return true;
+}
+
+/**
+ * @brief read the four hex digits of a \u escape
+ * @param reader reader context
+ * @param value pointer to store the UTF-16 code unit
+ * @return true on success, false on invalid or missing digits
+ */
+static bool read_hex4(json_reader_t* reader, uint32_t* value) {
+    char hex[4];
+    for (int i = 0; i < 4; i++) {
+        const int c = next_char(reader);
+        if (c == -1) return false;
+        hex[i] = (char)c;
+    }
+    return json_scan_hex4(hex, value);
+}
+
+/**
+ * @brief decode one escape sequence into the token buffer, the backslash has been consumed
+ * @param reader reader context
+ * @param c the character after the backslash
+ * @return true on success, false on error
+ */
+static bool read_escape(json_reader_t* reader, const int c) {
+    switch (c) {
+        case '"':  return token_push(reader, '"');
+        case '\\': return token_push(reader, '\\');
+        case '/':  return token_push(reader, '/');
+        case 'b':  return token_push(reader, '\b');
+        case 'f':  return token_push(reader, '\f');
+        case 'n':  return token_push(reader, '\n');
+        case 'r':  return token_push(reader, '\r');
+        case 't':  return token_push(reader, '\t');
+        case 'u': {
+            uint32_t code_point;
+            if (!read_hex4(reader, &code_point)) return false;
+            if (code_point < 0xD800 || code_point > 0xDBFF || peek_char(reader) != '\\')
+                return token_push_code_point(reader, code_point);
+
+            // a high surrogate combines with a directly following low surrogate
+            next_char(reader);
+            const int next = next_char(reader);
+            if (next != 'u')
+                return token_push_code_point(reader, JSON_REPLACEMENT_CHARACTER) && read_escape(reader, next);
+            uint32_t low;
+            if (!read_hex4(reader, &low)) return false;
+            if (low >= 0xDC00 && low <= 0xDFFF)
+                return token_push_code_point(reader, 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00));
+            return token_push_code_point(reader, JSON_REPLACEMENT_CHARACTER) &&
+                   token_push_code_point(reader, low);
+        }
+        default: // invalid escape
+            return false;
+    }
+}
+
+/**
+ * @brief read a JSON string into the token buffer, the opening quote is the next character
+ * @param reader reader context
+ * @return true on success, false on error
+ */
+static bool read_string(json_reader_t* reader) {
+    next_char(reader); // consume opening '"'
+    reader->token_length = 0;
+    if (!token_push(reader, '\0')) return false; // make sure `token` exists for empty strings
+    reader->token_length = 0;
+
+    for (;;) {
+        const int c = next_char(reader);
+        if (c == -1) return false;
+        if (c == '"') return true;
+
+        if (c == '\\') {
+            if (!read_escape(reader, next_char(reader))) return false;
+        } else if (!token_push(reader, (char)c)) {
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief read a JSON number, validating it with the same grammar as json_parse
+ * @param reader reader context
+ * @return true on success, false on error
+ */
+static bool read_number(json_reader_t* reader) {
+    reader->token_length = 0;
+
+    if (peek_char(reader) == '-' && !token_push(reader, (char)next_char(reader))) return false;
+
+    // integer part
+    if (peek_char(reader) == '0') {
+        if (!token_push(reader, (char)next_char(reader))) return false;
+    } else if (peek_char(reader) != -1 && isdigit(peek_char(reader))) {
+        while (peek_char(reader) != -1 && isdigit(peek_char(reader)))
+            if (!token_push(reader, (char)next_char(reader))) return false;
+    } else {
+        return false;
+    }
+
+    // fractional part
+    if (peek_char(reader) == '.') {
+        if (!token_push(reader, (char)next_char(reader))) return false;
+        if (peek_char(reader) == -1 || !isdigit(peek_char(reader))) return false;
+        while (peek_char(reader) != -1 && isdigit(peek_char(reader)))
+            if (!token_push(reader, (char)next_char(reader))) return false;
+    }
+
+    // exponent part
+    if (peek_char(reader) == 'e' || peek_char(reader) == 'E') {
+        if (!token_push(reader, (char)next_char(reader))) return false;
+        if ((peek_char(reader) == '+' || peek_char(reader) == '-') &&
+            !token_push(reader, (char)next_char(reader))) return false;
+        if (peek_char(reader) == -1 || !isdigit(peek_char(reader))) return false;
+        while (peek_char(reader) != -1 && isdigit(peek_char(reader)))
+            if (!token_push(reader, (char)next_char(reader))) return false;
+    }
+
+    reader->number = strtod(reader->token, NULL);
+    return true;
+}
+
+/**
+ * @brief consume a fixed literal
+ * @param reader reader context
+ * @param literal the expected characters
+ * @return true if the input matched
+ */
+static bool read_literal(json_reader_t* reader, const char* literal) {
+    for (; *literal; literal++)
+        if (next_char(reader) != (unsigned char)*literal) return false;
+    return true;
+}
+
+/**
+ * @brief read a value starting at the current position
+ * @param reader reader context
+ * @return the event of the value
+ */
+static json_event_t read_value(json_reader_t* reader) {
+    const int c = peek_char(reader);
+    switch (c) {
+        case '{':
+            next_char(reader);
+            if (!push_container(reader, READER_IN_OBJECT)) return fail(reader, JSON_ERROR_OUT_OF_MEMORY);
+            reader->expect = READER_EXPECT_KEY_OR_END;
+            return JSON_EVENT_BEGIN_OBJECT;
+        case '[':
+            next_char(reader);
+            if (!push_container(reader, READER_IN_ARRAY)) return fail(reader, JSON_ERROR_OUT_OF_MEMORY);
+            reader->expect = READER_EXPECT_VALUE_OR_END;
+            return JSON_EVENT_BEGIN_ARRAY;
+        case '"':
+            if (!read_string(reader)) return fail(reader, JSON_ERROR_PARSE_ERROR);
+            value_done(reader);
+            return JSON_EVENT_STRING;
+        case 't':
+        case 'f':
+            reader->boolean = c == 't';
+            if (!read_literal(reader, reader->boolean ? "true" : "false"))
+                return fail(reader, JSON_ERROR_PARSE_ERROR);
+            value_done(reader);
+            return JSON_EVENT_BOOL;
+        case 'n':
+            if (!read_literal(reader, "null")) return fail(reader, JSON_ERROR_PARSE_ERROR);
+            value_done(reader);
+            return JSON_EVENT_NULL;
+        default:
+            if (c == '-' || (c != -1 && isdigit(c))) {
+                if (!read_number(reader)) return fail(reader, JSON_ERROR_PARSE_ERROR);
+                value_done(reader);
+                return JSON_EVENT_NUMBER;
+            }
+            return fail(reader, JSON_ERROR_PARSE_ERROR);
+    }
+}
+
+/**
+ * @brief close the innermost container
+ * @param reader reader context
+ * @param kind the kind the closing bracket belongs to
+ * @return the END_* event, or an error on a mismatched bracket
+ */
+static json_event_t close_container(json_reader_t* reader, const unsigned char kind) {
+    if (!reader->depth || reader->stack[reader->depth - 1] != kind)
+        return fail(reader, JSON_ERROR_PARSE_ERROR);
+    next_char(reader);
+    reader->depth--;
+    value_done(reader);
+    return kind == READER_IN_OBJECT ? JSON_EVENT_END_OBJECT : JSON_EVENT_END_ARRAY;
+}
+
+bool json_reader_init_stream(json_reader_t* reader, FILE* stream) {
+    memset(reader, 0, sizeof(*reader));
+    reader->buffer = malloc(JSON_READER_BUFFER_SIZE);
+    if (!reader->buffer) return false;
+    reader->stream = stream;
+    reader->pos = reader->end = reader->buffer;
+    reader->line = 1;
+    reader->column = 1;
+    reader->expect = READER_EXPECT_VALUE;
+    return true;
+}
+
+void json_reader_init_string(json_reader_t* reader, const char* input, const size_t length) {
+    memset(reader, 0, sizeof(*reader));
+    reader->pos = input;
+    reader->end = input + length;
+    reader->line = 1;
+    reader->column = 1;
+    reader->expect = READER_EXPECT_VALUE;
+}
+
+void json_reader_init_feed(json_reader_t* reader) {
+    memset(reader, 0, sizeof(*reader));
+    reader->feeding = 1;
+    reader->line = 1;
+    reader->column = 1;
+    reader->expect = READER_EXPECT_VALUE;
+}
+
+bool json_reader_feed(json_reader_t* reader, const char* input, const size_t length) {
+    if (!length) {
+        reader->feeding = 0;
+        return true;
+    }
+
+    // the unread bytes, a partial event among them, move to the front
+    const size_t unread = reader->pos ? (size_t)(reader->end - reader->pos) : 0;
+    if (unread + length > reader->buffer_capacity) {
+        size_t new_capacity = reader->buffer_capacity ? reader->buffer_capacity : JSON_READER_BUFFER_SIZE;
+        while (new_capacity < unread + length)
+            new_capacity *= 2;
+        char* new_buffer = malloc(new_capacity);
+        if (!new_buffer) return false;
+        if (unread) memcpy(new_buffer, reader->pos, unread);
+        free(reader->buffer);
+        reader->buffer = new_buffer;
+        reader->buffer_capacity = new_capacity;
+    } else if (unread) {
+        memmove(reader->buffer, reader->pos, unread);
+    }
+    memcpy(reader->buffer + unread, input, length);
+    reader->pos = reader->buffer;
+    reader->end = reader->buffer + unread + length;
+    return true;
+}
+
+/**
+ * @brief read the next event, see json_reader_next()
+ * @param reader reader context
+ * @return the event
+ */
+static json_event_t read_event(json_reader_t* reader) {
+    skip_whitespace(reader);
+    if (reader->error != JSON_OK) return fail(reader, reader->error);
+
+    switch (reader->expect) {
+        case READER_EXPECT_VALUE:
+            return read_value(reader);
+        case READER_EXPECT_VALUE_OR_END:
+            if (peek_char(reader) == ']') return close_container(reader, READER_IN_ARRAY);
+            return read_value(reader);
+        case READER_EXPECT_KEY_OR_END:
+            if (peek_char(reader) == '}') return close_container(reader, READER_IN_OBJECT);
+            // fall through
+        case READER_EXPECT_KEY:
+            if (peek_char(reader) != '"' || !read_string(reader)) return fail(reader, JSON_ERROR_PARSE_ERROR);
+            skip_whitespace(reader);
+            if (next_char(reader) != ':') return fail(reader, JSON_ERROR_PARSE_ERROR);
+            reader->expect = READER_EXPECT_VALUE;
+            return JSON_EVENT_KEY;
+        case READER_EXPECT_COMMA_OR_END: {
+            const int c = peek_char(reader);
+            if (c == '}') return close_container(reader, READER_IN_OBJECT);
+            if (c == ']') return close_container(reader, READER_IN_ARRAY);
+            if (c != ',') return fail(reader, JSON_ERROR_PARSE_ERROR);
+            next_char(reader);
+            reader->expect = reader->stack[reader->depth - 1] == READER_IN_OBJECT ?
+                READER_EXPECT_KEY : READER_EXPECT_VALUE;
+            return read_event(reader);
+        }
+        case READER_EXPECT_DONE:
+            // check for trailing characters after the main value
+            if (peek_char(reader) != -1) return fail(reader, JSON_ERROR_PARSE_ERROR);
+            return JSON_EVENT_END;
+        default:
+            return fail(reader, reader->error != JSON_OK ? reader->error : JSON_ERROR_PARSE_ERROR);
+    }
+}
+
+json_event_t json_reader_next(json_reader_t* reader) {
+    if (!reader->feeding) return read_event(reader);
+
+    // the chunk may end inside the event, remember where it starts
+    const char* pos = reader->pos;
+    const size_t line = reader->line;
+    const size_t column = reader->column;
+    const size_t depth = reader->depth;
+    const int expect = reader->expect;
+    const json_error_t error = reader->error;
+    reader->starved = 0;
+    const json_event_t event = read_event(reader);
+    if (!reader->starved) return event;
+
+    // containers pushed or popped since are undone by the depth, the token is read again
+    reader->pos = pos;
+    reader->line = line;
+    reader->column = column;
+    reader->depth = depth;
+    reader->expect = expect;
+    reader->error = error;
+    return JSON_EVENT_NEED_INPUT;
+}
+
+bool json_reader_skip(json_reader_t* reader, const json_event_t event) {
+    if (event == JSON_EVENT_ERROR) return false;
+    if (event != JSON_EVENT_BEGIN_OBJECT && event != JSON_EVENT_BEGIN_ARRAY) return true;
+
+    // keys and scalars inside do not change the depth
+    size_t depth = 1;
+    while (depth) {
+        switch (json_reader_next(reader)) {
+            case JSON_EVENT_BEGIN_OBJECT:
+            case JSON_EVENT_BEGIN_ARRAY:
+                depth++;
+                break;
+            case JSON_EVENT_END_OBJECT:
+            case JSON_EVENT_END_ARRAY:
+                depth--;
+                break;
+            case JSON_EVENT_ERROR:
+            case JSON_EVENT_END:
+            case JSON_EVENT_NEED_INPUT:
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+void json_reader_free(json_reader_t* reader) {
+    if (!reader) return;
+    free(reader->buffer);
+    free(reader->stack);
+    free(reader->token);
+    reader->buffer = NULL;
+    reader->stack = NULL;
+    reader->token = NULL;
+    reader->depth = reader->stack_capacity = reader->token_capacity = reader->token_length = 0;
+    reader->buffer_capacity = 0;
+}
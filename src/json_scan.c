@@ -0,0 +1,224 @@
+/**
+ * @file json_scan.c
+ * @brief implementation of the vectorized string and whitespace scanners
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include "json_scan.h"
+
+#if !defined(JSON_SCAN_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define JSON_SCAN_X86 1
+#include <immintrin.h>
+#elif !defined(JSON_SCAN_NO_SIMD) && defined(__aarch64__)
+#define JSON_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+// aligned block loads may read past the terminator (never past its page), which sanitizers report
+#if defined(__clang__) || defined(__GNUC__)
+#define JSON_SCAN_OVERREAD __attribute__((no_sanitize_address))
+#else
+#define JSON_SCAN_OVERREAD
+#endif
+
+/**
+ * @brief scalar json_scan_string()
+ */
+static const char* scan_string_scalar(const char* s) {
+    while (*s && *s != '"' && *s != '\\') s++;
+    return s;
+}
+
+/**
+ * @brief scalar json_scan_whitespace()
+ */
+static const char* scan_whitespace_scalar(const char* s, size_t* newlines, const char** last_newline) {
+    for (;; s++) {
+        if (*s == '\n') {
+            ++*newlines;
+            *last_newline = s;
+        } else if (*s != ' ' && *s != '\t' && *s != '\r') {
+            return s;
+        }
+    }
+}
+
+#if defined(JSON_SCAN_X86)
+/**
+ * @brief SSE2 json_scan_string(), 16 bytes per step
+ */
+JSON_SCAN_OVERREAD
+static const char* scan_string_sse2(const char* s) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i zero = _mm_setzero_si128();
+
+    const unsigned misalign = (unsigned)((uintptr_t)s & 15);
+    const char* p = s - misalign;
+    unsigned skip = ~0u << misalign; // ignore bytes before `s` in the first block
+    for (;; p += 16, skip = ~0u) {
+        const __m128i v = _mm_load_si128((const __m128i*)p);
+        const __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                         _mm_cmpeq_epi8(v, zero));
+        const unsigned mask = (unsigned)_mm_movemask_epi8(hit) & skip;
+        if (mask) return p + __builtin_ctz(mask);
+    }
+}
+
+/**
+ * @brief AVX2 json_scan_string(), 32 bytes per step
+ */
+JSON_SCAN_OVERREAD __attribute__((target("avx2")))
+static const char* scan_string_avx2(const char* s) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i zero = _mm256_setzero_si256();
+
+    const unsigned misalign = (unsigned)((uintptr_t)s & 31);
+    const char* p = s - misalign;
+    uint32_t skip = ~0u << misalign;
+    for (;; p += 32, skip = ~0u) {
+        const __m256i v = _mm256_load_si256((const __m256i*)p);
+        const __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                                            _mm256_cmpeq_epi8(v, backslash)),
+                                            _mm256_cmpeq_epi8(v, zero));
+        const uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit) & skip;
+        if (mask) return p + __builtin_ctz(mask);
+    }
+}
+
+/**
+ * @brief SSE2 json_scan_whitespace(), 16 bytes per step
+ */
+JSON_SCAN_OVERREAD
+static const char* scan_whitespace_sse2(const char* s, size_t* newlines, const char** last_newline) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    const unsigned misalign = (unsigned)((uintptr_t)s & 15);
+    const char* p = s - misalign;
+    unsigned before = (1u << misalign) - 1; // bytes before `s` count as skipped whitespace
+    for (;; p += 16, before = 0) {
+        const __m128i v = _mm_load_si128((const __m128i*)p);
+        const __m128i is_lf = _mm_cmpeq_epi8(v, lf);
+        const __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                        _mm_or_si128(is_lf, _mm_cmpeq_epi8(v, cr)));
+        const unsigned stop = ~((unsigned)_mm_movemask_epi8(ws) | before) & 0xFFFFu;
+        unsigned lf_mask = (unsigned)_mm_movemask_epi8(is_lf) & ~before;
+        if (stop) lf_mask &= (1u << __builtin_ctz(stop)) - 1; // only newlines before the stop
+        if (lf_mask) {
+            *newlines += (size_t)__builtin_popcount(lf_mask);
+            *last_newline = p + 31 - __builtin_clz(lf_mask);
+        }
+        if (stop) return p + __builtin_ctz(stop);
+    }
+}
+#elif defined(JSON_SCAN_NEON)
+/**
+ * @brief returns a 64-bit mask with one nibble per byte lane that is set in a NEON comparison
+ */
+static inline uint64_t neon_mask(const uint8x16_t hit) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+}
+
+/**
+ * @brief NEON json_scan_string(), 16 bytes per step
+ */
+JSON_SCAN_OVERREAD
+static const char* scan_string_neon(const char* s) {
+    const unsigned misalign = (unsigned)((uintptr_t)s & 15);
+    const char* p = s - misalign;
+    uint64_t skip = ~0ull << (4 * misalign);
+    for (;; p += 16, skip = ~0ull) {
+        const uint8x16_t v = vld1q_u8((const uint8_t*)p);
+        const uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))),
+                                        vceqq_u8(v, vdupq_n_u8(0)));
+        const uint64_t mask = neon_mask(hit) & skip;
+        if (mask) return p + (__builtin_ctzll(mask) >> 2);
+    }
+}
+#endif
+
+static const char* (*scan_string_impl)(const char*) = scan_string_scalar;
+static const char* (*scan_whitespace_impl)(const char*, size_t*, const char**) = scan_whitespace_scalar;
+static const char* scan_variant = "scalar";
+
+#if defined(JSON_SCAN_X86)
+/**
+ * @brief picks the widest scanners the CPU supports before main() runs
+ */
+__attribute__((constructor))
+static void select_scanners(void) {
+    __builtin_cpu_init();
+    scan_string_impl = scan_string_sse2;
+    scan_whitespace_impl = scan_whitespace_sse2;
+    scan_variant = "sse2";
+    if (__builtin_cpu_supports("avx2")) {
+        scan_string_impl = scan_string_avx2;
+        scan_variant = "avx2";
+    }
+}
+#elif defined(JSON_SCAN_NEON)
+/**
+ * @brief NEON is part of the AArch64 baseline, no runtime check is needed
+ */
+__attribute__((constructor))
+static void select_scanners(void) {
+    scan_string_impl = scan_string_neon;
+    scan_variant = "neon";
+}
+#endif
+
+const char* json_scan_string(const char* s) {
+    return scan_string_impl(s);
+}
+
+const char* json_scan_whitespace(const char* s, size_t* newlines, const char** last_newline) {
+    // most gaps between tokens are a single space or nothing at all
+    if (*s != ' ' && *s != '\t' && *s != '\n' && *s != '\r') return s;
+    return scan_whitespace_impl(s, newlines, last_newline);
+}
+
+const char* json_scan_variant(void) {
+    return scan_variant;
+}
+
+bool json_scan_hex4(const char* hex, uint32_t* value) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        const unsigned char c = (unsigned char)hex[i];
+        if (!isxdigit(c)) return false;
+        v = (v << 4) | (uint32_t)(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    *value = v;
+    return true;
+}
+
+size_t json_scan_utf8(uint32_t code_point, char* out) {
+    if ((code_point >= 0xD800 && code_point <= 0xDFFF) || code_point > 0x10FFFF)
+        code_point = JSON_REPLACEMENT_CHARACTER;
+
+    if (code_point < 0x80) {
+        out[0] = (char)code_point;
+        return 1;
+    }
+    if (code_point < 0x800) {
+        out[0] = (char)(0xC0 | (code_point >> 6));
+        out[1] = (char)(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if (code_point < 0x10000) {
+        out[0] = (char)(0xE0 | (code_point >> 12));
+        out[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code_point >> 18));
+    out[1] = (char)(0x80 | ((code_point >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code_point & 0x3F));
+    return 4;
+}
@@ -1,6 +1,9 @@
 #include "cli_encode.h"
 #include "cli_decode.h"
+#include "cli_index.h"
 #include "cli_args.h"
+#include "cli_stats.h"
+#include "bej_stats.h"
 
 int main(int argc, char **argv) {
     args_t args;
@@ -8,8 +11,16 @@ int main(int argc, char **argv) {
     if (parse_args(argc, argv, &args) != 0)
         return 1;
 
-    if (args.mode_encode)
-        return cli_run_encode(&args);
+    if (args.stats)
+        bej_stats_set_timing(1);
 
-    return cli_run_decode(&args);
+    int status;
+    if (args.mode_index)
+        status = cli_run_index(&args);
+    else
+        status = args.mode_encode ? cli_run_encode(&args) : cli_run_decode(&args);
+    if (args.stats && cli_print_stats(stderr) != 0)
+        status = 1;
+    free_args(&args);
+    return status;
 }
@@ -0,0 +1,51 @@
+/**
+ * @file fuzz_bej_decode.cpp
+ * @brief fuzz target decoding arbitrary bytes against the Memory and annotation dictionaries
+ *
+ * Both dictionaries are compiled in by bej_dictgen, so they are trusted and
+ * every lookup runs on the unchecked dictionary paths. Each decoder has to
+ * decode or reject the input without reading outside of it
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" {
+    #include "json.h"
+    #include "bej_decode.h"
+    #include "bej_dict_Memory_v1.h"
+    #include "bej_dict_annotation.h"
+}
+
+/**
+ * @brief Write callback that drops the text.
+ */
+static int discard(void *, const char *, size_t)
+{
+    return 1;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    const bej_dictionary_t *schema = bej_dictionary_Memory_v1();
+    const bej_dictionary_t *annot = bej_dictionary_annotation();
+    if (!schema->trusted || !annot->trusted)
+        abort();
+
+    json_free(bej_decode_buffer(data, size, schema, annot));
+
+    json_arena_t arena;
+    json_arena_init(&arena);
+    bej_decode_buffer_borrowed(data, size, schema, annot, &arena, nullptr);
+    json_arena_destroy(&arena);
+
+    // two chunks, so that headers and values also get split between feeds
+    bej_stream_decoder_t dec;
+    bej_stream_decoder_init(&dec, schema, annot, discard, nullptr);
+    const size_t half = size / 2;
+    if (bej_stream_decoder_feed(&dec, data, half))
+        bej_stream_decoder_feed(&dec, data + half, size - half);
+    bej_stream_decoder_finish(&dec);
+    return 0;
+}
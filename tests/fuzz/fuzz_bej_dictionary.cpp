@@ -0,0 +1,90 @@
+/**
+ * @file fuzz_bej_dictionary.cpp
+ * @brief fuzz target loading arbitrary bytes as a dictionary and looking up every child it declares
+ *
+ * Subsets of a trusted dictionary are read without per-entry checks, so a
+ * dictionary that passes bej_dictionary_validate() and still leads a lookup
+ * outside its bytes is a bug in the validation. Every child read from a
+ * subset must also be found again by sequence number and by name
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+    #include "bej_dictionary.h"
+}
+
+#define FUZZ_MAX_LOOKUPS 128 /**< children looked up per input, keeps inputs with wide subsets fast */
+
+/**
+ * @brief Looks up the children of one entry and checks that every one of them is found again.
+ *
+ * @param dict The dictionary.
+ * @param parent The entry.
+ * @param budget Children left to look up, decremented for every child.
+ */
+static void check_children(const bej_dictionary_t *dict, const bej_dict_entry_t *parent, size_t *budget)
+{
+    bej_dict_stream_t stream;
+    bej_dict_stream_init_subset(&stream, dict, parent->child_pointer, parent->child_count);
+    bej_dict_entry_t child, found;
+    for (; *budget && bej_dict_stream_next(&stream, &child); --*budget) {
+        if (!bej_dict_find_child_by_seq(dict, parent->child_pointer, parent->child_count, child.sequence, &found) ||
+            found.sequence != child.sequence)
+            abort();
+        if (!child.name)
+            continue;
+        if (!bej_dict_find_child_by_name(dict, parent->child_pointer, parent->child_count, child.name, &found) ||
+            !found.name || strcmp(found.name, child.name) != 0)
+            abort();
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // the dictionary owns a heap copy of the bytes, like a file the loaders could not map
+    auto *bytes = static_cast<uint8_t *>(malloc(size ? size : 1));
+    auto *dict = static_cast<bej_dictionary_t *>(calloc(1, sizeof(bej_dictionary_t)));
+    if (!bytes || !dict) {
+        free(bytes);
+        free(dict);
+        return 0;
+    }
+    if (size)
+        memcpy(bytes, data, size);
+    dict->bytes = bytes;
+    dict->size = size;
+    bej_dictionary_build_index(dict);
+    if (dict->trusted != bej_dictionary_validate(dict))
+        abort();
+
+    // every 10-byte slot after the header, whether the header counts it or not
+    size_t budget = FUZZ_MAX_LOOKUPS;
+    for (size_t offset = BEJ_OFFSET_ENTRIES_START; offset + BEJ_DICTIONARY_ENTRY_SIZE <= size && offset <= 0xFFFF;
+         offset += BEJ_DICTIONARY_ENTRY_SIZE) {
+        bej_dict_stream_t stream;
+        bej_dict_entry_t entry;
+        bej_dict_stream_init_subset(&stream, dict, static_cast<uint16_t>(offset), 1);
+        if (!bej_dict_stream_next(&stream, &entry))
+            continue;
+        if (entry.name && strlen(entry.name) >= size)
+            abort();
+        if (entry.child_count != 0)
+            check_children(dict, &entry, &budget);
+    }
+
+    bej_dict_entry_t found;
+    bej_dict_stream_t root;
+    bej_dict_stream_init(&root, dict);
+    size_t root_budget = FUZZ_MAX_LOOKUPS;
+    if (bej_dict_stream_next(&root, &found))
+        check_children(dict, &found, &root_budget);
+    bej_dict_find_annotation_by_name(dict, "@odata.id", &found);
+    bej_dict_find_annotation_by_seq(dict, 0, &found);
+
+    bej_dictionary_free(dict);
+    return 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file fuzz_main.cpp
+ * @brief runs a fuzz target without libFuzzer over a seed corpus and simple mutations of it
+ *
+ * Builds without BEJ_BUILD_FUZZERS link the targets against this driver, so
+ * ctest replays the corpus on every build and under whatever sanitizers the
+ * build uses. Every input runs cut at up to MAX_CUTS lengths and with every
+ * byte flipped, each time from a heap block of exactly its size
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#define MAX_CUTS 512 /**< truncations of one input, spread evenly over its length */
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/**
+ * @brief Runs the target on a copy of some bytes that ends where the input does.
+ *
+ * @param data The bytes.
+ * @param size The number of bytes.
+ */
+static void run(const uint8_t *data, const size_t size)
+{
+    // like libFuzzer, never pass a null pointer, not even for an empty input
+    const std::vector<uint8_t> copy(data, data + size);
+    const uint8_t empty = 0;
+    LLVMFuzzerTestOneInput(size ? copy.data() : &empty, size);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (!std::filesystem::is_directory(argv[i])) {
+            paths.emplace_back(argv[i]);
+            continue;
+        }
+        for (const auto &file : std::filesystem::directory_iterator(argv[i])) {
+            if (file.is_regular_file())
+                paths.push_back(file.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        std::fprintf(stderr, "Usage: %s <input file or directory>...\n", argv[0]);
+        return 1;
+    }
+
+    size_t runs = 0;
+    for (const std::string &path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!file.good() && !file.eof()) {
+            std::fprintf(stderr, "Failed to read %s\n", path.c_str());
+            return 1;
+        }
+
+        // cuts of large inputs mostly fail at the header, a few hundred of them are enough
+        const size_t step = std::max<size_t>(1, input.size() / MAX_CUTS);
+        for (size_t n = 0; n <= input.size(); n += step, runs++)
+            run(input.data(), n);
+        for (size_t i = 0; i < input.size(); i++) {
+            for (const uint8_t mask : {0x01, 0xFF}) {
+                input[i] ^= mask;
+                run(input.data(), input.size());
+                input[i] ^= mask;
+                runs++;
+            }
+        }
+    }
+    std::printf("%zu inputs, %zu runs\n", paths.size(), runs);
+    return 0;
+}
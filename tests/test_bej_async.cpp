@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <coroutine>
+#include <deque>
+
+#include "bej.hpp"
+#include "test_util.h"
+
+using async_decoder_ptr = std::unique_ptr<bej_async_decoder_t, void(*)(bej_async_decoder_t*)>;
+using async_encoder_ptr = std::unique_ptr<bej_async_encoder_t, void(*)(bej_async_encoder_t*)>;
+
+/**
+ * @brief Source handing out a few bytes per call and nothing on every third call.
+ */
+struct trickle_source {
+    std::string data;        /**< the input */
+    size_t step = 1;         /**< bytes per call */
+    size_t pos = 0;          /**< bytes handed out */
+    unsigned calls = 0;      /**< calls so far */
+    size_t fail_at = SIZE_MAX; /**< position at which the source fails */
+
+    static size_t read(void *ctx, uint8_t *out, size_t size)
+    {
+        auto *self = static_cast<trickle_source *>(ctx);
+        if (++self->calls % 3 == 0) return BEJ_IO_AGAIN;
+        if (self->pos >= self->fail_at) return BEJ_IO_ERROR;
+        const size_t n = std::min({self->step, size, self->data.size() - self->pos});
+        std::copy_n(self->data.data() + self->pos, n, out);
+        self->pos += n;
+        return n;
+    }
+};
+
+/**
+ * @brief Sink taking a few bytes per call and nothing on every other call.
+ */
+struct trickle_sink {
+    std::string data;        /**< the output */
+    size_t step = 1;         /**< bytes per call */
+    unsigned calls = 0;      /**< calls so far */
+    bool broken = false;     /**< fail every call */
+
+    static size_t write(void *ctx, const uint8_t *in, size_t size)
+    {
+        auto *self = static_cast<trickle_sink *>(ctx);
+        if (self->broken) return BEJ_IO_ERROR;
+        if (++self->calls % 2 == 0) return self->calls % 4 ? 0 : BEJ_IO_AGAIN;
+        const size_t n = std::min(self->step, size);
+        self->data.append(reinterpret_cast<const char *>(in), n);
+        return n;
+    }
+};
+
+/**
+ * @brief Runs an async codec until it stops for good, counting the times it yields.
+ *
+ * @param run Advances the codec.
+ * @param yields Receives the number of BEJ_IO_NEED_INPUT and BEJ_IO_OUTPUT_FULL results.
+ * @return The final status.
+ */
+template <class Run>
+static bej_io_status_t run_to_end(Run run, size_t &yields)
+{
+    yields = 0;
+    for (;;) {
+        const bej_io_status_t status = run();
+        if (status == BEJ_IO_DONE || status == BEJ_IO_FAILED) return status;
+        yields++;
+    }
+}
+
+class BejAsync : public MemoryDictionaryTest {
+protected:
+    void SetUp() override
+    {
+        MemoryDictionaryTest::SetUp();
+        if (HasFatalFailure()) return;
+
+        text = read_file(test_path("data/example5.json"));
+        const json_ptr root(json_parse(text.c_str()), json_free);
+        ASSERT_NE(root.get(), nullptr);
+        const std::vector<uint8_t> bytes = encode_tree(root.get());
+        ASSERT_FALSE(bytes.empty());
+        bej.assign(bytes.begin(), bytes.end());
+
+        FILE *in = fmemopen(bej.data(), bej.size(), "rb");
+        FILE *decoded = tmpfile();
+        ASSERT_NE(in, nullptr);
+        ASSERT_NE(decoded, nullptr);
+        ASSERT_TRUE(bej_decode_stream(decoded, in, schema.get(), annot.get()));
+        rewind(decoded);
+        char chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), decoded)) > 0)
+            decoded_text.append(chunk, n);
+        fclose(decoded);
+        fclose(in);
+    }
+
+    std::string text;
+    std::string bej;
+    std::string decoded_text;
+};
+
+TEST_F(BejAsync, DecoderYieldsAndResumes)
+{
+    for (const size_t step : {size_t(1), size_t(7), size_t(1) << 20}) {
+        trickle_source source{bej, step};
+        trickle_sink sink{"", step};
+        async_decoder_ptr decoder(bej_async_decoder_create(schema.get(), annot.get(), nullptr, trickle_source::read,
+                                                           &source, trickle_sink::write, &sink),
+                                  bej_async_decoder_free);
+        ASSERT_NE(decoder.get(), nullptr);
+        size_t yields;
+        ASSERT_EQ(run_to_end([&] { return bej_async_decoder_run(decoder.get()); }, yields), BEJ_IO_DONE) << step;
+        EXPECT_EQ(sink.data, decoded_text) << step;
+        if (step < bej.size()) {
+            EXPECT_GT(yields, 0u) << step;
+        }
+        EXPECT_EQ(bej_async_decoder_run(decoder.get()), BEJ_IO_DONE); // finished decodes stay finished
+    }
+}
+
+TEST_F(BejAsync, EncoderYieldsAndResumes)
+{
+    for (const size_t step : {size_t(1), size_t(7), size_t(1) << 20}) {
+        trickle_source source{text, step};
+        trickle_sink sink{"", step};
+        async_encoder_ptr encoder(bej_async_encoder_create(schema.get(), annot.get(), BEJ_ENCODE_CANONICAL,
+                                                           trickle_source::read, &source, trickle_sink::write, &sink),
+                                  bej_async_encoder_free);
+        ASSERT_NE(encoder.get(), nullptr);
+        size_t yields;
+        ASSERT_EQ(run_to_end([&] { return bej_async_encoder_run(encoder.get()); }, yields), BEJ_IO_DONE) << step;
+        EXPECT_EQ(sink.data, bej) << step;
+        if (step < bej.size()) {
+            EXPECT_GT(yields, 0u) << step;
+        }
+    }
+}
+
+TEST_F(BejAsync, EncoderMatchesTheOtherEncoders)
+{
+    for (const char *name : {"data/example1.json", "data/example2.json", "data/example3.json", "data/example4.json",
+                             "data/example5.json"}) {
+        const std::string json = read_file(test_path(name));
+        const json_ptr root(json_parse(json.c_str()), json_free);
+        ASSERT_NE(root.get(), nullptr) << name;
+
+        // canonical output is the tree encoder's, fixed width output the streaming encoder's
+        const std::vector<uint8_t> canonical = encode_tree(root.get());
+        bej_buffer_t out;
+        bej_buffer_init(&out);
+        json_reader_t reader;
+        json_reader_init_string(&reader, json.data(), json.size());
+        ASSERT_TRUE(bej_encode_reader_buffer(&out, &reader, schema.get(), annot.get())) << name;
+        json_reader_free(&reader);
+        const std::string fixed(reinterpret_cast<const char *>(out.data), out.size);
+        bej_buffer_free(&out);
+
+        for (const unsigned flags : {BEJ_ENCODE_CANONICAL, BEJ_ENCODE_FIXED_WIDTH}) {
+            for (const size_t step : {size_t(3), size_t(1) << 20}) {
+                trickle_source source{json, step};
+                trickle_sink sink{"", 1 << 20};
+                async_encoder_ptr encoder(bej_async_encoder_create(schema.get(), annot.get(), flags,
+                                                                   trickle_source::read, &source, trickle_sink::write,
+                                                                   &sink),
+                                          bej_async_encoder_free);
+                ASSERT_NE(encoder.get(), nullptr);
+                size_t yields;
+                ASSERT_EQ(run_to_end([&] { return bej_async_encoder_run(encoder.get()); }, yields), BEJ_IO_DONE)
+                    << name << " " << flags << " " << step;
+                EXPECT_EQ(sink.data, flags == BEJ_ENCODE_CANONICAL ? std::string(canonical.begin(), canonical.end())
+                                                                   : fixed)
+                    << name << " " << flags << " " << step;
+            }
+        }
+    }
+}
+
+TEST_F(BejAsync, FailuresAreSticky)
+{
+    size_t yields;
+
+    // input that ends before the root Set, a failing source and a failing sink
+    for (const int failure : {0, 1, 2}) {
+        trickle_source source{failure == 0 ? bej.substr(0, bej.size() / 2) : bej, 64};
+        trickle_sink sink{"", 64};
+        if (failure == 1) source.fail_at = 10;
+        if (failure == 2) sink.broken = true;
+        async_decoder_ptr decoder(bej_async_decoder_create(schema.get(), annot.get(), nullptr, trickle_source::read,
+                                                           &source, trickle_sink::write, &sink),
+                                  bej_async_decoder_free);
+        ASSERT_NE(decoder.get(), nullptr);
+        EXPECT_EQ(run_to_end([&] { return bej_async_decoder_run(decoder.get()); }, yields), BEJ_IO_FAILED) << failure;
+        EXPECT_EQ(bej_async_decoder_run(decoder.get()), BEJ_IO_FAILED) << failure;
+    }
+
+    // malformed text and a limit
+    trickle_source source{text.substr(0, text.size() / 2), 64};
+    trickle_sink sink{"", 64};
+    async_encoder_ptr encoder(bej_async_encoder_create(schema.get(), annot.get(), BEJ_ENCODE_CANONICAL,
+                                                       trickle_source::read, &source, trickle_sink::write, &sink),
+                              bej_async_encoder_free);
+    ASSERT_NE(encoder.get(), nullptr);
+    EXPECT_EQ(run_to_end([&] { return bej_async_encoder_run(encoder.get()); }, yields), BEJ_IO_FAILED);
+    EXPECT_EQ(bej_async_encoder_run(encoder.get()), BEJ_IO_FAILED);
+    EXPECT_TRUE(sink.data.empty());
+
+    const bej_decode_limits_t limits = {1, 0};
+    trickle_source bej_source{bej, 64};
+    async_decoder_ptr limited(bej_async_decoder_create(schema.get(), annot.get(), &limits, trickle_source::read,
+                                                       &bej_source, trickle_sink::write, &sink),
+                              bej_async_decoder_free);
+    EXPECT_EQ(run_to_end([&] { return bej_async_decoder_run(limited.get()); }, yields), BEJ_IO_FAILED);
+
+    EXPECT_EQ(bej_async_decoder_create(nullptr, annot.get(), nullptr, trickle_source::read, &source,
+                                       trickle_sink::write, &sink), nullptr);
+    EXPECT_EQ(bej_async_encoder_create(schema.get(), annot.get(), 0, nullptr, &source, trickle_sink::write, &sink),
+              nullptr);
+}
+
+/**
+ * @brief Single-threaded event loop resuming coroutines in turn.
+ */
+struct event_loop {
+    std::deque<std::coroutine_handle<>> ready; /**< coroutines to resume */
+    size_t waits = 0;                          /**< suspensions so far */
+
+    /**
+     * @brief Awaitable putting the coroutine at the back of the queue.
+     */
+    struct next_turn {
+        event_loop *loop;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) const
+        {
+            loop->ready.push_back(handle);
+            loop->waits++;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    next_turn operator()(bej_io_status_t) { return next_turn{this}; }
+
+    void run()
+    {
+        while (!ready.empty()) {
+            const std::coroutine_handle<> next = ready.front();
+            ready.pop_front();
+            next.resume();
+        }
+    }
+};
+
+/**
+ * @brief Encodes a document and decodes the result, both over trickling sources and sinks.
+ *
+ * @param schema Schema dictionary.
+ * @param annot Annotation dictionary.
+ * @param text The JSON text.
+ * @param loop The event loop.
+ * @param decoded Receives the decoded text.
+ * @return A task producing true if both conversions succeeded.
+ */
+static bej::task<bool> round_trip(const bej_dictionary_t *schema, const bej_dictionary_t *annot,
+                                  const std::string &text, event_loop &loop, std::string &decoded)
+{
+    trickle_source json_source{text, 97};
+    trickle_sink bej_sink{"", 31};
+    bej::async_encoder encoder(schema, annot, BEJ_ENCODE_CANONICAL, trickle_source::read, &json_source,
+                               trickle_sink::write, &bej_sink);
+    if (!encoder || !co_await bej::convert(encoder, std::ref(loop))) co_return false;
+
+    trickle_source bej_source{bej_sink.data, 13};
+    trickle_sink json_sink{"", 53};
+    bej::async_decoder decoder(schema, annot, nullptr, trickle_source::read, &bej_source, trickle_sink::write,
+                               &json_sink);
+    if (!decoder || !co_await bej::convert(decoder, std::ref(loop))) co_return false;
+    decoded = std::move(json_sink.data);
+    co_return true;
+}
+
+TEST_F(BejAsync, OneThreadRunsManyConversions)
+{
+    event_loop loop;
+    const size_t count = 200;
+    std::vector<std::string> decoded(count);
+    std::vector<bej::task<bool>> tasks;
+    for (size_t i = 0; i < count; i++) {
+        tasks.push_back(round_trip(schema.get(), annot.get(), text, loop, decoded[i]));
+        tasks.back().start();
+    }
+    loop.run();
+
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_TRUE(tasks[i].done()) << i;
+        EXPECT_TRUE(tasks[i].result()) << i;
+        EXPECT_EQ(decoded[i], decoded_text) << i;
+    }
+    EXPECT_GT(loop.waits, count * 10);
+}
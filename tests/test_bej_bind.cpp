@@ -0,0 +1,172 @@
+#include "test_util.h"
+
+extern "C" {
+    #include "bej_bind.h"
+    #include "bej_view.h"
+}
+
+/**
+ * @brief The struct a consumer would fill from a Memory resource.
+ */
+struct memory_t {
+    int64_t capacity;
+    const char *id;
+    const char *odata_id;
+    int health;
+    int state;
+    const char *status_odata_id;
+    int spare;
+};
+
+static const bej_bind_field_t memory_fields[] = {
+    BEJ_BIND_FIELD(memory_t, capacity, "/CapacityMiB", BEJ_FORMAT_INTEGER),
+    BEJ_BIND_FIELD(memory_t, id, "/Id", BEJ_FORMAT_STRING),
+    BEJ_BIND_FIELD(memory_t, odata_id, "/@odata.id", BEJ_FORMAT_STRING),
+    BEJ_BIND_FIELD(memory_t, health, "/Status/Health", BEJ_FORMAT_ENUM),
+    BEJ_BIND_FIELD(memory_t, state, "/Status/State", BEJ_FORMAT_ENUM),
+    BEJ_BIND_FIELD(memory_t, status_odata_id, "/Status/@odata.id", BEJ_FORMAT_STRING),
+    BEJ_BIND_FIELD(memory_t, spare, "/IsSpareDeviceEnabled", BEJ_FORMAT_BOOLEAN),
+};
+static const size_t memory_field_count = sizeof(memory_fields) / sizeof(memory_fields[0]);
+
+class BejBind : public MemoryDictionaryTest {
+protected:
+    void SetUp() override
+    {
+        MemoryDictionaryTest::SetUp();
+        if (HasFatalFailure()) return;
+        ASSERT_TRUE(bej_binding_init(&binding, memory_fields, memory_field_count, schema.get(), annot.get()));
+    }
+
+    void TearDown() override
+    {
+        bej_binding_free(&binding);
+    }
+
+    /**
+     * @brief Returns the sequence number of an enum option.
+     *
+     * @param path Path of the enum property.
+     * @param option Option name.
+     * @return The sequence number, or -1.
+     */
+    int option(const char *path, const char *option_name)
+    {
+        for (size_t i = 0; i < binding.node_count; i++) {
+            const bej_bind_node_t &node = binding.nodes[i];
+            bej_dict_entry_t entry;
+            if (node.field != BEJ_BIND_NONE && strcmp(memory_fields[node.field].path, path) == 0 &&
+                bej_dict_find_child_by_name(schema.get(), node.entry.child_pointer, node.entry.child_count,
+                                            option_name, &entry))
+                return entry.sequence;
+        }
+        return -1;
+    }
+
+    bej_binding_t binding{};
+};
+
+TEST_F(BejBind, DecodeFillsBoundMembersOnly) {
+    const json_ptr root(json_parse_file(test_path("data/example5.json").c_str()), json_free);
+    ASSERT_NE(root.get(), nullptr);
+    const std::vector<uint8_t> bej = encode_tree(root.get());
+    ASSERT_FALSE(bej.empty());
+
+    memory_t memory{};
+    memory.spare = 7;
+    uint64_t present = 0;
+    ASSERT_TRUE(bej_decode_bound(bej.data(), bej.size(), &binding, &memory, &present));
+
+    EXPECT_EQ(memory.capacity, 65536);
+    EXPECT_STREQ(memory.id, "DIMM1");
+    EXPECT_STREQ(memory.odata_id, "/redfish/v1/Systems/1/Memory/DIMM1");
+    EXPECT_STREQ(memory.status_odata_id, "/redfish/v1/Systems/1/Memory/DIMM1#/Status");
+    EXPECT_EQ(memory.health, option("/Status/Health", "OK"));
+    EXPECT_EQ(memory.state, option("/Status/State", "Enabled"));
+    EXPECT_GE(memory.health, 0);
+
+    // strings point into the document, absent fields are left alone
+    EXPECT_GE(reinterpret_cast<const uint8_t *>(memory.id), bej.data());
+    EXPECT_LT(reinterpret_cast<const uint8_t *>(memory.id), bej.data() + bej.size());
+    EXPECT_EQ(memory.spare, 7);
+    EXPECT_EQ(present, (uint64_t{1} << memory_field_count) - 1 - (uint64_t{1} << 6));
+
+    // every truncation fails cleanly
+    for (size_t cut = 0; cut < bej.size(); cut++) {
+        memory_t scratch{};
+        EXPECT_FALSE(bej_decode_bound(bej.data(), cut, &binding, &scratch, nullptr)) << cut;
+    }
+}
+
+TEST_F(BejBind, EncodeMatchesTheGenericEncoder) {
+    memory_t memory{};
+    memory.capacity = -4096;
+    memory.id = "DIMM7";
+    memory.odata_id = "/redfish/v1/Systems/1/Memory/DIMM7";
+    memory.health = option("/Status/Health", "Warning");
+    memory.state = option("/Status/State", "Enabled");
+    memory.spare = 1;
+    const uint64_t present = 0x5F; // everything but status_odata_id
+
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+    ASSERT_TRUE(bej_encode_bound(&out, &binding, &memory, present));
+    const std::vector<uint8_t> bound(out.data, out.data + out.size);
+    bej_buffer_free(&out);
+
+    const json_ptr expected(json_parse("{\"CapacityMiB\": -4096, \"Id\": \"DIMM7\","
+                                       " \"@odata.id\": \"/redfish/v1/Systems/1/Memory/DIMM7\","
+                                       " \"Status\": {\"Health\": \"Warning\", \"State\": \"Enabled\"},"
+                                       " \"IsSpareDeviceEnabled\": true}"), json_free);
+    ASSERT_NE(expected.get(), nullptr);
+    EXPECT_EQ(bound, encode_tree(expected.get()));
+
+    memory_t decoded{};
+    uint64_t found = 0;
+    ASSERT_TRUE(bej_decode_bound(bound.data(), bound.size(), &binding, &decoded, &found));
+    EXPECT_EQ(found, present);
+    EXPECT_EQ(decoded.capacity, -4096);
+    EXPECT_STREQ(decoded.id, "DIMM7");
+    EXPECT_EQ(decoded.health, memory.health);
+
+    // no Status member at all once none of its fields is present
+    bej_buffer_init(&out);
+    ASSERT_TRUE(bej_encode_bound(&out, &binding, &memory, 0x03));
+    bej_view_t view, status;
+    ASSERT_TRUE(bej_view_open(&view, out.data, out.size, schema.get(), annot.get()));
+    EXPECT_TRUE(bej_view_get(&view, "/Id", &status));
+    EXPECT_FALSE(bej_view_get(&view, "/Status", &status));
+    bej_buffer_free(&out);
+
+    // NULL strings and unknown enum options are rejected
+    memory.id = nullptr;
+    bej_buffer_init(&out);
+    EXPECT_FALSE(bej_encode_bound(&out, &binding, &memory, 0x02));
+    memory.health = 0x7FFF;
+    EXPECT_FALSE(bej_encode_bound(&out, &binding, &memory, 0x08));
+    EXPECT_EQ(out.size, 0u);
+    bej_buffer_free(&out);
+}
+
+TEST_F(BejBind, InvalidFieldTablesAreRejected) {
+    struct wrong_t { int64_t a; int64_t b; };
+    const bej_bind_field_t unknown[] = {BEJ_BIND_FIELD(wrong_t, a, "/NoSuchProperty", BEJ_FORMAT_INTEGER)};
+    const bej_bind_field_t mismatch[] = {BEJ_BIND_FIELD(wrong_t, a, "/Id", BEJ_FORMAT_INTEGER)};
+    const bej_bind_field_t through_leaf[] = {BEJ_BIND_FIELD(wrong_t, a, "/Id/Name", BEJ_FORMAT_STRING)};
+    const bej_bind_field_t set_leaf[] = {BEJ_BIND_FIELD(wrong_t, a, "/Status", BEJ_FORMAT_INTEGER)};
+    const bej_bind_field_t twice[] = {BEJ_BIND_FIELD(wrong_t, a, "/CapacityMiB", BEJ_FORMAT_INTEGER),
+                                      BEJ_BIND_FIELD(wrong_t, b, "/CapacityMiB", BEJ_FORMAT_INTEGER)};
+    const bej_bind_field_t root[] = {BEJ_BIND_FIELD(wrong_t, a, "", BEJ_FORMAT_INTEGER)};
+    const bej_bind_field_t array[] = {BEJ_BIND_FIELD(wrong_t, a, "/Regions/0/SizeMiB", BEJ_FORMAT_INTEGER)};
+
+    bej_binding_t b;
+    EXPECT_FALSE(bej_binding_init(&b, unknown, 1, schema.get(), annot.get()));
+    EXPECT_FALSE(bej_binding_init(&b, mismatch, 1, schema.get(), annot.get()));
+    EXPECT_FALSE(bej_binding_init(&b, through_leaf, 1, schema.get(), annot.get()));
+    EXPECT_FALSE(bej_binding_init(&b, set_leaf, 1, schema.get(), annot.get()));
+    EXPECT_FALSE(bej_binding_init(&b, twice, 2, schema.get(), annot.get()));
+    EXPECT_FALSE(bej_binding_init(&b, root, 1, schema.get(), annot.get()));
+    EXPECT_FALSE(bej_binding_init(&b, array, 1, schema.get(), annot.get()));
+    EXPECT_FALSE(bej_binding_init(&b, memory_fields, memory_field_count, schema.get(), nullptr));
+    EXPECT_EQ(b.nodes, nullptr);
+}
@@ -0,0 +1,138 @@
+#include <functional>
+
+#include "test_util.h"
+
+/**
+ * @brief Tells whether a string lies within a block of bytes, terminator included.
+ *
+ * @param str The string.
+ * @param data Start of the block.
+ * @param size Size of the block.
+ * @return True if the whole string is inside the block.
+ */
+static bool points_into(const char *str, const void *data, const size_t size)
+{
+    const auto *begin = static_cast<const char *>(data);
+    return str >= begin && str + strlen(str) < begin + size;
+}
+
+/**
+ * @brief Calls a function on every value of a tree, parents first.
+ *
+ * @param value The tree.
+ * @param visit The function.
+ */
+static void for_each_value(const json_value_t *value, const std::function<void(const json_value_t *)> &visit)
+{
+    visit(value);
+    if (value->type == JSON_OBJECT) {
+        for (size_t i = 0; i < value->data.object.count; i++)
+            for_each_value(value->data.object.entries[i].value, visit);
+    } else if (value->type == JSON_ARRAY) {
+        for (size_t i = 0; i < value->data.array.count; i++)
+            for_each_value(value->data.array.items[i], visit);
+    }
+}
+
+class BejBorrowed : public MemoryDictionaryTest {
+protected:
+    void SetUp() override
+    {
+        MemoryDictionaryTest::SetUp();
+        if (HasFatalFailure()) return;
+
+        // Strings, an empty String, Enums, an array of Enums and annotations
+        const json_ptr root(json_parse(
+            "{\"@odata.id\": \"/redfish/v1/Systems/1/Memory/DIMM1\", \"Id\": \"DIMM1\", \"Name\": \"\", "
+            "\"Status\": {\"Health\": \"OK\", \"State\": \"Enabled\"}, \"CapacityMiB\": 65536, "
+            "\"MemoryMedia\": [\"DRAM\", \"NAND\", \"DRAM\"], "
+            "\"Regions\": [{\"RegionId\": \"r1\", \"SizeMiB\": 1024, \"PassphraseState\": true}]}"), json_free);
+        ASSERT_NE(root.get(), nullptr);
+        bej = encode_tree(root.get());
+        ASSERT_FALSE(bej.empty());
+
+        expected.reset(bej_decode_buffer(bej.data(), bej.size(), schema.get(), annot.get()));
+        ASSERT_NE(expected.get(), nullptr);
+    }
+
+    /**
+     * @brief Checks that a tree equals the copying decode and owns none of its characters.
+     *
+     * @param tree The borrowed tree.
+     */
+    void expect_borrowed(const json_value_t *tree)
+    {
+        ASSERT_NE(tree, nullptr);
+        EXPECT_TRUE(json_compare(tree, expected.get()));
+        size_t strings = 0, keys = 0;
+        for_each_value(tree, [&](const json_value_t *value) {
+            if (value->type == JSON_OBJECT) {
+                EXPECT_TRUE(value->flags & JSON_FLAG_BORROWED);
+                for (size_t i = 0; i < value->data.object.count; i++, keys++) {
+                    const char *key = value->data.object.entries[i].key;
+                    EXPECT_TRUE(points_into(key, schema->bytes, schema->size) ||
+                                points_into(key, annot->bytes, annot->size)) << key;
+                }
+            } else if (value->type == JSON_STRING) {
+                strings++;
+                EXPECT_TRUE(value->flags & JSON_FLAG_BORROWED) << value->data.string;
+                const char *str = value->data.string;
+                EXPECT_TRUE(points_into(str, bej.data(), bej.size()) ||
+                            points_into(str, schema->bytes, schema->size)) << str;
+            }
+        });
+        EXPECT_EQ(strings, 9u);
+        EXPECT_EQ(keys, 12u);
+    }
+
+    std::vector<uint8_t> bej;
+    json_ptr expected{nullptr, json_free};
+};
+
+TEST_F(BejBorrowed, KeysAndStringsPointIntoTheirSources)
+{
+    // json_free() releases the nodes and leaves the borrowed characters alone
+    json_ptr heap(bej_decode_buffer_borrowed(bej.data(), bej.size(), schema.get(), annot.get(), nullptr, nullptr),
+                  json_free);
+    expect_borrowed(heap.get());
+
+    json_arena_t arena;
+    json_arena_init(&arena);
+    expect_borrowed(bej_decode_buffer_borrowed(bej.data(), bej.size(), schema.get(), annot.get(), &arena, nullptr));
+    json_arena_destroy(&arena);
+
+    decoder_ptr decoder(bej_decoder_create(schema.get(), annot.get()), bej_decoder_free);
+    ASSERT_NE(decoder.get(), nullptr);
+    for (int round = 0; round < 2; round++) {
+        expect_borrowed(bej_decoder_decode_borrowed(decoder.get(), bej.data(), bej.size()));
+        const json_value_t *copied = bej_decoder_decode(decoder.get(), bej.data(), bej.size());
+        ASSERT_NE(copied, nullptr);
+        EXPECT_FALSE(copied->flags & JSON_FLAG_BORROWED);
+    }
+}
+
+TEST_F(BejBorrowed, BorrowedTreesTakeLessOutput)
+{
+    // only the nodes count against the output limit
+    std::vector<size_t> nodes;
+    for_each_value(expected.get(), [&](const json_value_t *value) { nodes.push_back(value->type); });
+    const bej_decode_limits_t exact = {0, nodes.size() * sizeof(json_value_t)};
+    const bej_decode_limits_t below = {0, nodes.size() * sizeof(json_value_t) - 1};
+    json_ptr tree(bej_decode_buffer_borrowed(bej.data(), bej.size(), schema.get(), annot.get(), nullptr, &exact),
+                  json_free);
+    EXPECT_NE(tree.get(), nullptr);
+    EXPECT_EQ(bej_decode_buffer_borrowed(bej.data(), bej.size(), schema.get(), annot.get(), nullptr, &below), nullptr);
+    EXPECT_EQ(bej_decode_buffer_limited(bej.data(), bej.size(), schema.get(), annot.get(), nullptr, &exact), nullptr);
+}
+
+TEST(JsonBorrowed, BorrowedObjectsKeepTheirKeys)
+{
+    static const char key[] = "Name";
+    json_ptr object(json_create(JSON_OBJECT), json_free);
+    ASSERT_NE(object.get(), nullptr);
+    object->flags |= JSON_FLAG_BORROWED;
+    ASSERT_TRUE(json_object_append(object.get(), key, json_create_borrowed_string_in(nullptr, key)));
+    EXPECT_EQ(object->data.object.entries[0].key, key);
+    EXPECT_EQ(object->data.object.entries[0].value->data.string, key);
+    EXPECT_EQ(json_create_borrowed_string_in(nullptr, nullptr), nullptr);
+}
@@ -0,0 +1,160 @@
+#include "test_util.h"
+
+extern "C" {
+    #include "bej_stats.h"
+}
+
+/**
+ * @brief Returns the contents of a stream from its start.
+ *
+ * @param file The stream.
+ * @return The bytes.
+ */
+static std::string read_all(FILE *file)
+{
+    std::string data;
+    rewind(file);
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        data.append(chunk, n);
+    return data;
+}
+
+class BejContext : public MemoryDictionaryTest {
+protected:
+    void SetUp() override
+    {
+        MemoryDictionaryTest::SetUp();
+        if (HasFatalFailure()) return;
+
+        root.reset(json_parse_file(test_path("data/example5.json").c_str()));
+        ASSERT_NE(root.get(), nullptr);
+        bej = encode_tree(root.get());
+        ASSERT_FALSE(bej.empty());
+
+        encoder.reset(bej_encoder_create(schema.get(), annot.get()));
+        decoder.reset(bej_decoder_create(schema.get(), annot.get()));
+        ASSERT_NE(encoder.get(), nullptr);
+        ASSERT_NE(decoder.get(), nullptr);
+    }
+
+    json_ptr root{nullptr, json_free};
+    std::vector<uint8_t> bej;
+    encoder_ptr encoder{nullptr, bej_encoder_free};
+    decoder_ptr decoder{nullptr, bej_decoder_free};
+};
+
+TEST_F(BejContext, EncoderMatchesTheOneShotEncoder)
+{
+    bej_buffer_t fixed;
+    bej_buffer_init(&fixed);
+    ASSERT_TRUE(bej_encode_buffer(&fixed, root.get(), schema.get(), annot.get(), BEJ_ENCODE_FIXED_WIDTH));
+
+    for (int round = 0; round < 3; round++) {
+        const uint8_t *data;
+        size_t size;
+        ASSERT_TRUE(bej_encoder_encode(encoder.get(), root.get(), BEJ_ENCODE_CANONICAL, &data, &size));
+        EXPECT_EQ(std::vector<uint8_t>(data, data + size), bej);
+        ASSERT_TRUE(bej_encoder_encode(encoder.get(), root.get(), BEJ_ENCODE_FIXED_WIDTH, &data, &size));
+        EXPECT_EQ(std::vector<uint8_t>(data, data + size), std::vector<uint8_t>(fixed.data, fixed.data + fixed.size));
+    }
+    bej_buffer_free(&fixed);
+
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    ASSERT_TRUE(bej_encoder_encode_stream(encoder.get(), file, root.get()));
+    EXPECT_EQ(read_all(file), std::string(bej.begin(), bej.end()));
+    fclose(file);
+
+    // a document the dictionary cannot encode leaves the encoder usable
+    json_ptr array(json_create(JSON_ARRAY), json_free);
+    const uint8_t *data;
+    size_t size;
+    EXPECT_FALSE(bej_encoder_encode(encoder.get(), array.get(), BEJ_ENCODE_CANONICAL, &data, &size));
+    ASSERT_TRUE(bej_encoder_encode(encoder.get(), root.get(), BEJ_ENCODE_CANONICAL, &data, &size));
+    EXPECT_EQ(std::vector<uint8_t>(data, data + size), bej);
+}
+
+TEST_F(BejContext, DecoderMatchesTheOneShotDecoders)
+{
+    json_ptr expected(bej_decode_buffer(bej.data(), bej.size(), schema.get(), annot.get()), json_free);
+    ASSERT_NE(expected.get(), nullptr);
+
+    FILE *in = fmemopen(bej.data(), bej.size(), "rb");
+    FILE *out = tmpfile();
+    ASSERT_NE(in, nullptr);
+    ASSERT_NE(out, nullptr);
+    ASSERT_TRUE(bej_decode_stream(out, in, schema.get(), annot.get()));
+    const std::string expected_text = read_all(out);
+    fclose(out);
+
+    for (int round = 0; round < 3; round++) {
+        const json_value_t *tree = bej_decoder_decode(decoder.get(), bej.data(), bej.size());
+        ASSERT_NE(tree, nullptr);
+        EXPECT_EQ(to_text(tree), to_text(expected.get()));
+
+        const char *text;
+        size_t length;
+        ASSERT_TRUE(bej_decoder_decode_text(decoder.get(), bej.data(), bej.size(), &text, &length));
+        EXPECT_EQ(std::string(text, length), expected_text);
+
+        rewind(in);
+        out = tmpfile();
+        ASSERT_NE(out, nullptr);
+        ASSERT_TRUE(bej_decoder_decode_stream(decoder.get(), out, in));
+        EXPECT_EQ(read_all(out), expected_text);
+        fclose(out);
+    }
+    fclose(in);
+}
+
+TEST_F(BejContext, MalformedInputLeavesTheDecoderUsable)
+{
+    const char *text;
+    size_t length;
+    EXPECT_EQ(bej_decoder_decode(decoder.get(), bej.data(), bej.size() / 2), nullptr);
+    EXPECT_FALSE(bej_decoder_decode_text(decoder.get(), bej.data(), bej.size() / 2, &text, &length));
+
+    const json_value_t *tree = bej_decoder_decode(decoder.get(), bej.data(), bej.size());
+    ASSERT_NE(tree, nullptr);
+    EXPECT_EQ(tree->type, JSON_OBJECT);
+    ASSERT_TRUE(bej_decoder_decode_text(decoder.get(), bej.data(), bej.size(), &text, &length));
+    ASSERT_GT(length, 0u);
+    EXPECT_EQ(text[0], '{');
+    EXPECT_EQ(text[length - 1], '}');
+}
+
+TEST_F(BejContext, SteadyStateReusesMemory)
+{
+    const uint8_t *data;
+    size_t size;
+    const char *text;
+    size_t length;
+
+    // the arena reaches a single block large enough for the document within a few rounds
+    for (int round = 0; round < 8; round++) {
+        ASSERT_TRUE(bej_encoder_encode(encoder.get(), root.get(), BEJ_ENCODE_CANONICAL, &data, &size));
+        ASSERT_NE(bej_decoder_decode(decoder.get(), bej.data(), bej.size()), nullptr);
+        ASSERT_TRUE(bej_decoder_decode_text(decoder.get(), bej.data(), bej.size(), &text, &length));
+    }
+
+    const uint8_t *first_data = data;
+    const char *first_text = text;
+    const json_value_t *first_tree = bej_decoder_decode(decoder.get(), bej.data(), bej.size());
+    bej_stats_t before;
+    bej_stats_snapshot(&before);
+
+    for (int round = 0; round < 100; round++) {
+        ASSERT_TRUE(bej_encoder_encode(encoder.get(), root.get(), BEJ_ENCODE_CANONICAL, &data, &size));
+        EXPECT_EQ(data, first_data);
+        const json_value_t *tree = bej_decoder_decode(decoder.get(), bej.data(), bej.size());
+        EXPECT_EQ(tree, first_tree);
+        ASSERT_TRUE(bej_decoder_decode_text(decoder.get(), bej.data(), bej.size(), &text, &length));
+        EXPECT_EQ(text, first_text);
+    }
+
+    bej_stats_t after;
+    bej_stats_snapshot(&after);
+    EXPECT_EQ(after.allocations, before.allocations);
+}
@@ -0,0 +1,79 @@
+#include "test_util.h"
+
+extern "C" {
+    #include "bej_dict_Memory_v1.h"
+}
+
+/**
+ * @brief Builds a private heap copy of a built-in dictionary with a runtime index.
+ *
+ * @param builtin The built-in dictionary.
+ * @return Owning pointer to the copy.
+ */
+static dict_ptr runtime_copy(const bej_dictionary_t *builtin)
+{
+    return dictionary_from(builtin->bytes, builtin->size);
+}
+
+TEST(BejDictgen, GeneratedTablesMatchTheRuntimeIndex) {
+    const bej_dictionary_t *builtin = bej_dictionary_Memory_v1();
+    ASSERT_EQ(builtin->builtin, 1);
+    const dict_ptr runtime = runtime_copy(builtin);
+    ASSERT_NE(runtime->index, nullptr);
+
+    const bej_dict_index_t *a = builtin->index;
+    const bej_dict_index_t *b = runtime->index;
+    ASSERT_EQ(a->entry_count, b->entry_count);
+    ASSERT_EQ(a->subset_count, b->subset_count);
+    ASSERT_EQ(a->table_size, b->table_size);
+    EXPECT_EQ(a->root_subset, b->root_subset);
+    EXPECT_EQ(builtin->trusted, 1);
+    EXPECT_EQ(runtime->trusted, 1);
+    for (uint16_t i = 0; i < a->entry_count; i++) {
+        EXPECT_EQ(a->format[i], b->format[i]) << i;
+        EXPECT_EQ(a->flags[i], b->flags[i]) << i;
+        EXPECT_EQ(a->sequence[i], b->sequence[i]) << i;
+        EXPECT_EQ(a->child_pointer[i], b->child_pointer[i]) << i;
+        EXPECT_EQ(a->child_count[i], b->child_count[i]) << i;
+        EXPECT_EQ(a->name_hash[i], b->name_hash[i]) << i;
+        EXPECT_EQ(a->sfl_prefix[i], b->sfl_prefix[i]) << i;
+        EXPECT_EQ(a->subset_by_entry[i], b->subset_by_entry[i]) << i;
+        ASSERT_EQ(a->name[i] == nullptr, b->name[i] == nullptr) << i;
+        if (a->name[i]) {
+            EXPECT_STREQ(a->name[i], b->name[i]) << i;
+            EXPECT_EQ(a->name[i] - reinterpret_cast<const char *>(builtin->bytes),
+                      b->name[i] - reinterpret_cast<const char *>(runtime->bytes)) << i;
+        }
+    }
+    EXPECT_EQ(memcmp(a->subsets, b->subsets, a->subset_count * sizeof(*a->subsets)), 0);
+    EXPECT_EQ(memcmp(a->tables, b->tables, a->table_size * sizeof(*a->tables)), 0);
+}
+
+TEST(BejDictgen, LoadingTheSameFileReturnsTheBuiltin) {
+    bej_dictionary_t *builtin = bej_dictionary_Memory_v1();
+    const dict_ptr loaded(bej_dictionary_load_map(test_path("dictionaries/Memory_v1.bin").c_str()), bej_dictionary_free);
+    EXPECT_EQ(loaded.get(), builtin);
+    bej_dictionary_free(builtin); // a no-op for built-ins
+
+    // other dictionaries still go through the generic loader
+    const dict_ptr annot(bej_dictionary_load_map(test_path("dictionaries/annotation.bin").c_str()), bej_dictionary_free);
+    ASSERT_NE(annot.get(), nullptr);
+    EXPECT_EQ(annot->builtin, 0);
+    EXPECT_EQ(annot->mapped, 1);
+}
+
+TEST(BejDictgen, EncodingIsIdenticalToTheGenericEngine) {
+    const dict_ptr runtime = runtime_copy(bej_dictionary_Memory_v1());
+    const dict_ptr annot(bej_dictionary_load_map(test_path("dictionaries/annotation.bin").c_str()), bej_dictionary_free);
+    ASSERT_NE(annot.get(), nullptr);
+
+    for (const char *name : {"data/example1.json", "data/example4.json", "data/example5.json"}) {
+        const json_ptr root(json_parse_file(test_path(name).c_str()), json_free);
+        ASSERT_NE(root.get(), nullptr) << name;
+
+        const std::vector<uint8_t> generic = encode_tree(root.get(), runtime.get(), annot.get(), BEJ_ENCODE_CANONICAL);
+        EXPECT_FALSE(generic.empty()) << name;
+        EXPECT_EQ(encode_tree(root.get(), bej_dictionary_Memory_v1(), annot.get(), BEJ_ENCODE_CANONICAL), generic)
+            << name;
+    }
+}
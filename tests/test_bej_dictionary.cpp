@@ -0,0 +1,246 @@
+#include "test_util.h"
+
+/**
+ * @brief Loads a dictionary from the tests/dictionaries directory.
+ *
+ * @param name File name of the dictionary.
+ * @return Owning pointer (null on failure).
+ */
+static dict_ptr load_dictionary(const std::string &name)
+{
+    return dict_ptr(bej_dictionary_load_map(test_path("dictionaries/" + name).c_str()), bej_dictionary_free);
+}
+
+/**
+ * @brief Checks every child lookup of a dictionary against a linear scan of the raw entries.
+ *
+ * @param dict Dictionary with a compiled index.
+ */
+static void expect_index_matches_linear_scan(const bej_dictionary_t *dict)
+{
+    ASSERT_NE(dict->index, nullptr);
+    const bej_dict_index_t *index = dict->index;
+
+    for (uint16_t i = 0; i < index->entry_count; i++) {
+        const uint16_t offset = index->child_pointer[i];
+        const uint16_t count = index->child_count[i];
+        if (count == 0 || count == BEJ_CHILD_COUNT_WILDCARD)
+            continue;
+
+        bej_dict_stream_t stream;
+        bej_dict_stream_init_subset(&stream, dict, offset, count);
+        bej_dict_entry_t expected;
+        while (bej_dict_stream_next(&stream, &expected)) {
+            bej_dict_entry_t found;
+            ASSERT_TRUE(bej_dict_find_child_by_seq(dict, offset, count, expected.sequence, &found));
+            EXPECT_EQ(found.sequence, expected.sequence);
+
+            if (!expected.name)
+                continue;
+            ASSERT_TRUE(bej_dict_find_child_by_name(dict, offset, count, expected.name, &found))
+                << "Child not found by name: " << expected.name;
+            EXPECT_STREQ(found.name, expected.name);
+            EXPECT_EQ(found.child_pointer, expected.child_pointer);
+        }
+
+        bej_dict_entry_t missing;
+        EXPECT_FALSE(bej_dict_find_child_by_name(dict, offset, count, "NoSuchProperty", &missing));
+    }
+}
+
+TEST(BejDictionaryIndex, SchemaLookupsMatchLinearScan) {
+    const dict_ptr dict = load_dictionary("Memory_v1.bin");
+    ASSERT_NE(dict.get(), nullptr);
+    expect_index_matches_linear_scan(dict.get());
+}
+
+TEST(BejDictionaryIndex, AnnotationLookupsMatchLinearScan) {
+    const dict_ptr dict = load_dictionary("annotation.bin");
+    ASSERT_NE(dict.get(), nullptr);
+    expect_index_matches_linear_scan(dict.get());
+}
+
+TEST(BejDictionaryIndex, SflPrefixesMatchTheHeaderEmitter) {
+    for (const char *name : {"Memory_v1.bin", "annotation.bin"}) {
+        const dict_ptr dict = load_dictionary(name);
+        ASSERT_NE(dict.get(), nullptr);
+        ASSERT_NE(dict->index, nullptr);
+
+        // the index and a stream over the raw entries agree with packing each header from scratch
+        bej_dict_stream_t stream;
+        bej_dict_stream_init(&stream, dict.get());
+        bej_dict_entry_t entry;
+        for (uint16_t i = 0; bej_dict_stream_next(&stream, &entry); i++) {
+            ASSERT_LT(i, dict->index->entry_count);
+            EXPECT_EQ(entry.sfl_prefix, dict->index->sfl_prefix[i]) << i;
+            for (const uint64_t selector : {0, 1}) {
+                for (const uint64_t length : {uint64_t(0), uint64_t(200), uint64_t(1) << 40}) {
+                    uint8_t expected[BEJ_SFL_MAX_SIZE], packed[BEJ_SFL_MAX_SIZE];
+                    const size_t n = bej_put_sfl(expected, (uint64_t(entry.sequence) << 1) | selector, entry.format,
+                                                 length);
+                    ASSERT_EQ(bej_put_sfl_prefix(packed, entry.sfl_prefix | selector << 8, length), n) << i;
+                    EXPECT_EQ(memcmp(packed, expected, n), 0) << i;
+                }
+            }
+        }
+
+        bej_dict_entry_t found;
+        ASSERT_TRUE(bej_dict_find_child_by_seq(dict.get(), dict->index->child_pointer[0], dict->index->child_count[0],
+                                               0, &found));
+        EXPECT_EQ(found.sfl_prefix, bej_sfl_prefix(uint64_t(found.sequence) << 1, found.format));
+    }
+}
+
+/**
+ * @brief Stores a little-endian 16-bit value.
+ *
+ * @param p Destination.
+ * @param value The value.
+ */
+static void put_u16(uint8_t *p, const uint16_t value)
+{
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+TEST(BejDictionaryValidate, WellFormedDictionariesAreTrusted) {
+    for (const char *name : {"Memory_v1.bin", "annotation.bin"}) {
+        const dict_ptr dict = load_dictionary(name);
+        ASSERT_NE(dict.get(), nullptr);
+        EXPECT_EQ(dict->trusted, 1) << name;
+        EXPECT_TRUE(bej_dictionary_validate(dict.get())) << name;
+
+        const dict_ptr copy = dictionary_from(std::vector<uint8_t>(dict->bytes, dict->bytes + dict->size));
+        EXPECT_EQ(copy->trusted, 1) << name;
+        expect_index_matches_linear_scan(copy.get());
+    }
+    EXPECT_FALSE(bej_dictionary_validate(nullptr));
+}
+
+TEST(BejDictionaryValidate, MalformedEntriesAreNotTrusted) {
+    const dict_ptr source = load_dictionary("Memory_v1.bin");
+    ASSERT_NE(source.get(), nullptr);
+    const std::vector<uint8_t> bytes(source->bytes, source->bytes + source->size);
+    const uint16_t entry_count = static_cast<uint16_t>(bytes[BEJ_OFFSET_ENTRY_COUNT] |
+                                                       bytes[BEJ_OFFSET_ENTRY_COUNT + 1] << 8);
+    const size_t root = BEJ_OFFSET_ENTRIES_START;
+    const size_t first_child = root + BEJ_DICTIONARY_ENTRY_SIZE;
+    const uint16_t root_pointer = static_cast<uint16_t>(bytes[root + BEJ_ENTRY_OFFSET_CHILD_POINTER] |
+                                                        bytes[root + BEJ_ENTRY_OFFSET_CHILD_POINTER + 1] << 8);
+
+    std::vector<std::vector<uint8_t>> cases;
+    auto edited = [&](const size_t at, const uint16_t value) {
+        std::vector<uint8_t> copy = bytes;
+        put_u16(copy.data() + at, value);
+        cases.push_back(copy);
+    };
+    edited(BEJ_OFFSET_ENTRY_COUNT, 0);                                      // no root entry
+    edited(BEJ_OFFSET_ENTRY_COUNT, 0xFFFF);                                 // entries past the bytes
+    edited(root + BEJ_ENTRY_OFFSET_CHILD_COUNT, 0xFFFE);                    // children past the entry table
+    edited(root + BEJ_ENTRY_OFFSET_CHILD_POINTER, root_pointer + 1);         // children between two entries
+    edited(root + BEJ_ENTRY_OFFSET_CHILD_POINTER, 4);                        // children in the header
+    edited(first_child + BEJ_ENTRY_OFFSET_NAME_OFFSET, 0xFFFF);              // name past the bytes
+    edited(first_child + BEJ_ENTRY_OFFSET_NAME_OFFSET, BEJ_OFFSET_ENTRIES_START); // name without its terminator
+    for (size_t i = 0; i < cases.size(); i++) {
+        const dict_ptr dict = dictionary_from(cases[i]);
+        EXPECT_FALSE(bej_dictionary_validate(dict.get())) << i;
+        EXPECT_EQ(dict->trusted, 0) << i;
+    }
+    ASSERT_GT(entry_count, 1);
+
+    // a name running into the end of the bytes is dropped by the checked paths instead of being read past the end
+    std::vector<uint8_t> unterminated = bytes;
+    put_u16(unterminated.data() + first_child + BEJ_ENTRY_OFFSET_NAME_OFFSET, static_cast<uint16_t>(bytes.size()));
+    unterminated.insert(unterminated.end(), {'N', 'a', 'm', 'e'});
+    const dict_ptr dict = dictionary_from(unterminated);
+    ASSERT_NE(dict->index, nullptr);
+    EXPECT_EQ(dict->trusted, 0);
+    EXPECT_EQ(dict->index->name[1], nullptr);
+
+    bej_dict_stream_t stream;
+    bej_dict_stream_init_subset(&stream, dict.get(), static_cast<uint16_t>(first_child), 1);
+    EXPECT_EQ(stream.trusted, 0);
+    bej_dict_entry_t entry;
+    ASSERT_TRUE(bej_dict_stream_next(&stream, &entry));
+    EXPECT_EQ(entry.name, nullptr);
+    expect_index_matches_linear_scan(dict.get());
+}
+
+TEST(BejDictionaryValidate, TrustedStreamsStayInsideTheEntryTable) {
+    const dict_ptr dict = load_dictionary("Memory_v1.bin");
+    ASSERT_NE(dict.get(), nullptr);
+    ASSERT_EQ(dict->trusted, 1);
+    const uint16_t entry_count = dict->index->entry_count;
+    const uint16_t last = static_cast<uint16_t>(BEJ_OFFSET_ENTRIES_START + (entry_count - 1) * BEJ_DICTIONARY_ENTRY_SIZE);
+
+    // whatever the caller passes, only subsets of whole entries skip the checks
+    const struct { uint16_t offset, count; int trusted; } cases[] = {
+        {BEJ_OFFSET_ENTRIES_START, entry_count, 1},
+        {last, 1, 1},
+        {last, 2, 0},
+        {static_cast<uint16_t>(last + 1), 1, 0},
+        {0, 1, 0},
+        {BEJ_OFFSET_ENTRIES_START, BEJ_CHILD_COUNT_WILDCARD, 0},
+    };
+    for (const auto &c : cases) {
+        bej_dict_stream_t stream;
+        bej_dict_stream_init_subset(&stream, dict.get(), c.offset, c.count);
+        EXPECT_EQ(stream.trusted, c.trusted) << c.offset << " " << c.count;
+        bej_dict_entry_t entry;
+        size_t read = 0;
+        while (bej_dict_stream_next(&stream, &entry))
+            read++;
+        EXPECT_LE(read, dict->size / BEJ_DICTIONARY_ENTRY_SIZE) << c.offset << " " << c.count;
+    }
+}
+
+TEST(BejDictionaryCache, RepeatedLoadsShareOneMapping) {
+    const dict_ptr first = load_dictionary("Memory_v1.bin");
+    const dict_ptr second = load_dictionary("Memory_v1.bin");
+    ASSERT_NE(first.get(), nullptr);
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_EQ(first->mapped, 1);
+    EXPECT_NE(first->index, nullptr);
+}
+
+TEST(BejDictionaryCache, RewrittenFileIsReloaded) {
+    char cwd[1024];
+    const std::string source = std::string(getcwd(cwd, sizeof(cwd))) + "/dictionaries/Memory_v1.bin";
+    const std::string copy = std::string(getcwd(cwd, sizeof(cwd))) + "/cache_test_copy.bin";
+
+    std::FILE *in = std::fopen(source.c_str(), "rb");
+    ASSERT_NE(in, nullptr);
+    std::string bytes;
+    char chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), in)) > 0)
+        bytes.append(chunk, n);
+    std::fclose(in);
+
+    std::FILE *out = std::fopen(copy.c_str(), "wb");
+    ASSERT_NE(out, nullptr);
+    std::fwrite(bytes.data(), 1, bytes.size(), out);
+    std::fclose(out);
+
+    size_t old_size;
+    {
+        const dict_ptr dict(bej_dictionary_load(copy.c_str()), bej_dictionary_free);
+        ASSERT_NE(dict.get(), nullptr);
+        old_size = dict->size;
+    }
+
+    // a trailing byte changes the size, so the cached mapping must not be reused
+    out = std::fopen(copy.c_str(), "ab");
+    ASSERT_NE(out, nullptr);
+    std::fputc(0, out);
+    std::fclose(out);
+
+    {
+        const dict_ptr dict(bej_dictionary_load(copy.c_str()), bej_dictionary_free);
+        ASSERT_NE(dict.get(), nullptr);
+        EXPECT_EQ(dict->size, old_size + 1);
+    }
+
+    EXPECT_GE(bej_dictionary_cache_flush(), 1u);
+    std::remove(copy.c_str());
+}
@@ -0,0 +1,167 @@
+#include "test_util.h"
+
+extern "C" {
+    #include "bej_index.h"
+    #include "bej_view.h"
+}
+
+/**
+ * @brief Builds a Memory document with many Regions.
+ *
+ * @param count Number of Regions.
+ * @return JSON text.
+ */
+static std::string regions_document(const int count)
+{
+    std::string text = "{\"Id\": \"DIMM1\", \"Status\": {\"Health\": \"OK\"}, \"Regions\": [";
+    for (int i = 0; i < count; i++) {
+        if (i) text += ",";
+        text += "{\"RegionId\": \"region-" + std::to_string(i) + "\", \"SizeMiB\": " + std::to_string(i) + "}";
+    }
+    text += "], \"CapacityMiB\": 65536}";
+    return text;
+}
+
+class BejIndex : public MemoryDictionaryTest {
+protected:
+    /**
+     * @brief Encodes a document and builds its index sidecar.
+     *
+     * @param root The document.
+     * @param bej Receives the BEJ encoding.
+     * @param sidecar Receives the index.
+     */
+    void encode(const json_value_t *root, std::vector<uint8_t> &bej, std::vector<uint8_t> &sidecar)
+    {
+        bej = encode_tree(root);
+        ASSERT_FALSE(bej.empty());
+        bej_buffer_t out;
+        bej_buffer_init(&out);
+        ASSERT_TRUE(bej_index_build(&out, bej.data(), bej.size(), schema.get(), annot.get()));
+        sidecar.assign(out.data, out.data + out.size);
+        bej_buffer_free(&out);
+    }
+
+    /**
+     * @brief Checks that an indexed lookup lands on the same value as a scanning one.
+     *
+     * @param index The opened index.
+     * @param root The root view of the document.
+     * @param path Path to resolve.
+     */
+    static void expect_same(const bej_index_t *index, const bej_view_t *root, const char *path)
+    {
+        bej_view_t scanned, indexed;
+        const int found = bej_view_get(root, path, &scanned);
+        ASSERT_EQ(bej_index_get(index, root, path, &indexed), found) << path;
+        if (found) {
+            EXPECT_EQ(indexed.payload.pos, scanned.payload.pos) << path;
+            EXPECT_EQ(indexed.payload.end, scanned.payload.end) << path;
+            EXPECT_EQ(indexed.entry.format, scanned.entry.format) << path;
+            EXPECT_EQ(indexed.selector, scanned.selector) << path;
+        }
+    }
+};
+
+TEST_F(BejIndex, IndexedLookupsMatchScanning) {
+    const std::string text = regions_document(5000);
+    const json_ptr root(json_parse(text.c_str()), json_free);
+    ASSERT_NE(root.get(), nullptr);
+    std::vector<uint8_t> bej, sidecar;
+    encode(root.get(), bej, sidecar);
+
+    bej_index_t index;
+    bej_view_t view;
+    ASSERT_TRUE(bej_index_open(&index, sidecar.data(), sidecar.size()));
+    ASSERT_TRUE(bej_view_open(&view, bej.data(), bej.size(), schema.get(), annot.get()));
+    ASSERT_TRUE(bej_index_attach(&index, &view));
+    EXPECT_EQ(index.array_count, 1u);
+
+    for (const char *path : {"", "/Id", "/Status", "/Status/Health", "/Regions", "/Regions/0",
+                             "/Regions/4999/SizeMiB", "/Regions/2500/RegionId", "/CapacityMiB",
+                             "/Regions/5000", "/Regions/01", "/PartNumber", "/NoSuchProperty", "Id"})
+        expect_same(&index, &view, path);
+
+    bej_view_t v;
+    const char *str;
+    size_t len;
+    ASSERT_TRUE(bej_index_get(&index, &view, "/Regions/4321/RegionId", &v));
+    ASSERT_TRUE(bej_view_string(&v, &str, &len));
+    EXPECT_EQ(std::string(str, len), "region-4321");
+}
+
+TEST_F(BejIndex, AnnotationsAndSmallNestedArrays) {
+    const json_ptr root(json_parse_file(test_path("data/example5.json").c_str()), json_free);
+    ASSERT_NE(root.get(), nullptr);
+    std::vector<uint8_t> bej, sidecar;
+    encode(root.get(), bej, sidecar);
+
+    bej_index_t index;
+    bej_view_t view;
+    ASSERT_TRUE(bej_index_open(&index, sidecar.data(), sidecar.size()));
+    ASSERT_TRUE(bej_view_open(&view, bej.data(), bej.size(), schema.get(), annot.get()));
+    ASSERT_TRUE(bej_index_attach(&index, &view));
+
+    for (const char *path : {"/@odata.id", "/Status/@odata.id", "/@Message.ExtendedInfo",
+                             "/@Message.ExtendedInfo/1/MessageId", "/@Message.ExtendedInfo/2"})
+        expect_same(&index, &view, path);
+}
+
+TEST_F(BejIndex, StaleAndDamagedSidecars) {
+    const std::string text = regions_document(100);
+    const json_ptr root(json_parse(text.c_str()), json_free);
+    const json_ptr other(json_parse(regions_document(99).c_str()), json_free);
+    ASSERT_NE(root.get(), nullptr);
+    ASSERT_NE(other.get(), nullptr);
+    std::vector<uint8_t> bej, sidecar, other_bej, other_sidecar;
+    encode(root.get(), bej, sidecar);
+    encode(other.get(), other_bej, other_sidecar);
+
+    bej_view_t view;
+    ASSERT_TRUE(bej_view_open(&view, bej.data(), bej.size(), schema.get(), annot.get()));
+
+    // an index of another document does not attach and is ignored
+    bej_index_t index;
+    ASSERT_TRUE(bej_index_open(&index, other_sidecar.data(), other_sidecar.size()));
+    EXPECT_FALSE(bej_index_attach(&index, &view));
+    expect_same(&index, &view, "/Regions/99/RegionId");
+    expect_same(&index, &view, "/CapacityMiB");
+
+    // so is an index of a document with a root Set of the same length
+    std::string edited = text;
+    edited.replace(edited.find("65536"), 5, "65537");
+    const json_ptr same_length(json_parse(edited.c_str()), json_free);
+    ASSERT_NE(same_length.get(), nullptr);
+    std::vector<uint8_t> edited_bej, edited_sidecar;
+    encode(same_length.get(), edited_bej, edited_sidecar);
+    ASSERT_EQ(edited_bej.size(), bej.size());
+    ASSERT_TRUE(bej_index_open(&index, edited_sidecar.data(), edited_sidecar.size()));
+    EXPECT_EQ(index.root_length, bej_cursor_remaining(&view.payload));
+    EXPECT_FALSE(bej_index_attach(&index, &view));
+    expect_same(&index, &view, "/Regions/42/SizeMiB");
+
+    // and an index attached to one copy of a document is not used for another copy
+    std::vector<uint8_t> copy = bej;
+    bej_view_t copy_view;
+    ASSERT_TRUE(bej_view_open(&copy_view, copy.data(), copy.size(), schema.get(), annot.get()));
+    ASSERT_TRUE(bej_index_open(&index, sidecar.data(), sidecar.size()));
+    ASSERT_TRUE(bej_index_attach(&index, &copy_view));
+    expect_same(&index, &view, "/Regions/7/RegionId");
+
+    // element offsets pointing at the wrong element are caught by the sequence check
+    std::vector<uint8_t> shifted = sidecar;
+    ASSERT_TRUE(bej_index_open(&index, shifted.data(), shifted.size()));
+    ASSERT_TRUE(bej_index_attach(&index, &view));
+    const size_t table = shifted.size() - 100 * sizeof(uint64_t);
+    std::copy(sidecar.begin() + static_cast<std::ptrdiff_t>(table + sizeof(uint64_t)), sidecar.end(),
+              shifted.begin() + static_cast<std::ptrdiff_t>(table));
+    expect_same(&index, &view, "/Regions/10/SizeMiB");
+
+    // truncated or foreign sidecars do not open
+    for (size_t cut = 0; cut < BEJ_INDEX_HEADER_SIZE + BEJ_INDEX_PATH_RECORD_SIZE; cut++)
+        EXPECT_FALSE(bej_index_open(&index, sidecar.data(), cut)) << cut;
+    EXPECT_FALSE(bej_index_open(&index, sidecar.data(), sidecar.size() - 1));
+    std::vector<uint8_t> foreign = sidecar;
+    foreign[0] = 'X';
+    EXPECT_FALSE(bej_index_open(&index, foreign.data(), foreign.size()));
+}
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include "test_util.h"
+
+extern "C" {
+    #include "bej_pool.h"
+}
+
+using pool_ptr = std::unique_ptr<bej_pool_t, void(*)(bej_pool_t*)>;
+
+/**
+ * @brief Decodes a document with a streaming decoder in one chunk.
+ *
+ * @param bej The BEJ document.
+ * @param schema Schema dictionary.
+ * @param annot Annotation dictionary.
+ * @param limits Limits of the decode (NULL = defaults).
+ * @param text Receives the JSON text.
+ * @return 1 if the document was decoded.
+ */
+static int decode_text(const std::vector<uint8_t> &bej, const bej_dictionary_t *schema,
+                       const bej_dictionary_t *annot, const bej_decode_limits_t *limits, std::string &text)
+{
+    bej_stream_decoder_t dec;
+    bej_stream_decoder_init(&dec, schema, annot, append_to_string, &text);
+    bej_stream_decoder_set_limits(&dec, limits);
+    const int ok = bej_stream_decoder_feed(&dec, bej.data(), bej.size());
+    return bej_stream_decoder_finish(&dec) && ok;
+}
+
+/**
+ * @brief Returns the nesting depth of a tree, the root being level 1.
+ *
+ * @param value The tree.
+ * @return The depth.
+ */
+static size_t tree_depth(const json_value_t *value)
+{
+    size_t deepest = 0;
+    if (value->type == JSON_OBJECT) {
+        for (size_t i = 0; i < value->data.object.count; i++)
+            deepest = std::max(deepest, tree_depth(value->data.object.entries[i].value));
+    } else if (value->type == JSON_ARRAY) {
+        for (size_t i = 0; i < value->data.array.count; i++)
+            deepest = std::max(deepest, tree_depth(value->data.array.items[i]));
+    } else {
+        return 0;
+    }
+    return deepest + 1;
+}
+
+/**
+ * @brief Builds a dictionary whose only property, "Next", is a Set of itself.
+ *
+ * @return Owning pointer to the dictionary.
+ */
+static dict_ptr recursive_dictionary()
+{
+    const uint8_t bytes[] = {
+        0x00, 0x00, 0x02, 0x00, 42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // header, 2 entries, 42 bytes
+        0x00, 0x00, 0x00, 22, 0x00, 0x01, 0x00, 5, 32, 0x00,                   // Root: Set of the subset at 22
+        0x00, 0x00, 0x00, 22, 0x00, 0x01, 0x00, 5, 37, 0x00,                   // Next: Set of the subset at 22
+        'R', 'o', 'o', 't', 0, 'N', 'e', 'x', 't', 0,
+    };
+    return dictionary_from(bytes, sizeof(bytes));
+}
+
+/**
+ * @brief Builds a document of Sets nested in "Next" down to a given depth.
+ *
+ * @param depth Nesting depth, the root Set being level 1.
+ * @return The BEJ document.
+ */
+static std::vector<uint8_t> nested_document(const size_t depth)
+{
+    // payload sizes from the innermost Set out: a count, then the SFL and payload of "Next"
+    std::vector<uint64_t> payload(depth + 1);
+    payload[depth] = bej_nnint_size(0);
+    for (size_t level = depth - 1; level >= 1; level--)
+        payload[level] = bej_nnint_size(1) + bej_nnint_size(0) + 1 + bej_nnint_size(payload[level + 1]) +
+                         payload[level + 1];
+
+    std::vector<uint8_t> bej = {0x00, 0xF0, 0xF1, 0xF1, 0x00, 0x00, 0x00};
+    const auto put = [&bej](const uint64_t value) {
+        uint8_t p[BEJ_NNINT_MAX_SIZE];
+        bej.insert(bej.end(), p, p + bej_put_nnint(p, value));
+    };
+    put(0);
+    bej.push_back(BEJ_FORMAT_SET << 4);
+    put(payload[1]);
+    for (size_t level = 1; level < depth; level++) {
+        put(1);
+        put(0);
+        bej.push_back(BEJ_FORMAT_SET << 4);
+        put(payload[level + 1]);
+    }
+    put(0);
+    return bej;
+}
+
+class BejDecodeLimits : public MemoryDictionaryTest {
+protected:
+    void SetUp() override
+    {
+        MemoryDictionaryTest::SetUp();
+        if (HasFatalFailure()) return;
+
+        const json_ptr root(json_parse_file(test_path("data/example5.json").c_str()), json_free);
+        ASSERT_NE(root.get(), nullptr);
+        bej = encode_tree(root.get());
+        ASSERT_FALSE(bej.empty());
+    }
+
+    std::vector<uint8_t> bej;
+};
+
+TEST_F(BejDecodeLimits, DepthLimitIsExact)
+{
+    const json_ptr tree(bej_decode_buffer(bej.data(), bej.size(), schema.get(), annot.get()), json_free);
+    ASSERT_NE(tree.get(), nullptr);
+    const size_t depth = tree_depth(tree.get());
+    ASSERT_GE(depth, 3u);
+
+    decoder_ptr decoder(bej_decoder_create(schema.get(), annot.get()), bej_decoder_free);
+    ASSERT_NE(decoder.get(), nullptr);
+    for (const size_t max_depth : {depth - 1, depth}) {
+        const bej_decode_limits_t limits = {max_depth, 0};
+        const bool fits = max_depth >= depth;
+        const json_ptr limited(bej_decode_buffer_limited(bej.data(), bej.size(), schema.get(), annot.get(),
+                                                         nullptr, &limits), json_free);
+        EXPECT_EQ(limited != nullptr, fits) << max_depth;
+        std::string text;
+        EXPECT_EQ(decode_text(bej, schema.get(), annot.get(), &limits, text) == 1, fits) << max_depth;
+
+        bej_decoder_set_limits(decoder.get(), &limits);
+        const char *chars;
+        size_t length;
+        EXPECT_EQ(bej_decoder_decode(decoder.get(), bej.data(), bej.size()) != nullptr, fits) << max_depth;
+        EXPECT_EQ(bej_decoder_decode_text(decoder.get(), bej.data(), bej.size(), &chars, &length) == 1, fits)
+            << max_depth;
+    }
+}
+
+TEST_F(BejDecodeLimits, OutputLimitIsExact)
+{
+    std::string text;
+    ASSERT_TRUE(decode_text(bej, schema.get(), annot.get(), nullptr, text));
+    for (const uint64_t max_output : {uint64_t(1), uint64_t(text.size() - 1), uint64_t(text.size())}) {
+        const bej_decode_limits_t limits = {0, max_output};
+        const bool fits = max_output >= text.size();
+        std::string limited;
+        EXPECT_EQ(decode_text(bej, schema.get(), annot.get(), &limits, limited) == 1, fits) << max_output;
+
+        decoder_ptr decoder(bej_decoder_create(schema.get(), annot.get()), bej_decoder_free);
+        ASSERT_NE(decoder.get(), nullptr);
+        bej_decoder_set_limits(decoder.get(), &limits);
+        const char *chars;
+        size_t length;
+        EXPECT_EQ(bej_decoder_decode_text(decoder.get(), bej.data(), bej.size(), &chars, &length) == 1, fits)
+            << max_output;
+    }
+
+    // the tree fails at every limit below its size and leaves nothing behind
+    uint64_t size = 1;
+    for (;; size++) {
+        const bej_decode_limits_t limits = {0, size};
+        json_value_t *tree = bej_decode_buffer_limited(bej.data(), bej.size(), schema.get(), annot.get(), nullptr,
+                                                       &limits);
+        if (tree) {
+            json_free(tree);
+            break;
+        }
+        ASSERT_LT(size, 1u << 20);
+    }
+    EXPECT_GT(size, sizeof(json_value_t));
+
+    json_arena_t arena;
+    json_arena_init(&arena);
+    const bej_decode_limits_t exact = {0, size}, below = {0, size - 1};
+    EXPECT_NE(bej_decode_buffer_limited(bej.data(), bej.size(), schema.get(), annot.get(), &arena, &exact), nullptr);
+    EXPECT_EQ(bej_decode_buffer_limited(bej.data(), bej.size(), schema.get(), annot.get(), &arena, &below), nullptr);
+    json_arena_destroy(&arena);
+}
+
+TEST(BejDecodeLimitsDeep, DeepNestingNeedsNoRecursion)
+{
+    const dict_ptr dict = recursive_dictionary();
+    ASSERT_NE(dict->index, nullptr);
+
+    // the default limit accepts the default depth and nothing deeper
+    for (const size_t depth : {size_t(BEJ_DECODE_MAX_DEPTH), size_t(BEJ_DECODE_MAX_DEPTH + 1)}) {
+        const std::vector<uint8_t> bej = nested_document(depth);
+        const json_ptr tree(bej_decode_buffer(bej.data(), bej.size(), dict.get(), nullptr), json_free);
+        EXPECT_EQ(tree != nullptr, depth <= BEJ_DECODE_MAX_DEPTH) << depth;
+        std::string text;
+        EXPECT_EQ(decode_text(bej, dict.get(), nullptr, nullptr, text) == 1, depth <= BEJ_DECODE_MAX_DEPTH) << depth;
+    }
+
+    // far deeper than the C stack would allow for a recursive decoder
+    const size_t depth = 200000;
+    const std::vector<uint8_t> bej = nested_document(depth);
+    EXPECT_EQ(bej_decode_buffer(bej.data(), bej.size(), dict.get(), nullptr), nullptr);
+    pool_ptr pool(bej_pool_create(1), bej_pool_free);
+    const bej_parallel_t parallel = {pool.get(), 1};
+    EXPECT_EQ(bej_decode_buffer_parallel(bej.data(), bej.size(), dict.get(), nullptr, nullptr, &parallel), nullptr);
+
+    const bej_decode_limits_t limits = {depth, 0};
+    json_arena_t arena;
+    json_arena_init(&arena);
+    const json_value_t *tree = bej_decode_buffer_limited(bej.data(), bej.size(), dict.get(), nullptr, &arena,
+                                                         &limits);
+    ASSERT_NE(tree, nullptr);
+    size_t levels = 1;
+    for (; tree->data.object.count; levels++) {
+        ASSERT_STREQ(tree->data.object.entries[0].key, "Next");
+        tree = tree->data.object.entries[0].value;
+    }
+    EXPECT_EQ(levels, depth);
+    json_arena_destroy(&arena);
+
+    std::string text;
+    ASSERT_TRUE(decode_text(bej, dict.get(), nullptr, &limits, text));
+    EXPECT_EQ(text.size(), (depth - 1) * std::strlen("{\"Next\":}") + 2);
+}
@@ -0,0 +1,148 @@
+#include <atomic>
+#include "test_util.h"
+
+extern "C" {
+    #include "bej_pool.h"
+}
+
+using pool_ptr = std::unique_ptr<bej_pool_t, void(*)(bej_pool_t*)>;
+
+/**
+ * @brief Builds a Memory document with large root-level arrays of Sets, Integers and Enums.
+ *
+ * @return JSON text.
+ */
+static std::string large_document()
+{
+    const char *media[] = {"DRAM", "NAND", "Intel3DXPoint", "Proprietary"};
+    std::string text = "{\"@odata.id\": \"/redfish/v1/Systems/1/Memory/DIMM1\", \"Id\": \"DIMM1\", "
+                       "\"Status\": {\"Health\": \"OK\", \"State\": \"Enabled\"}, \"Regions\": [";
+    for (int i = 0; i < 3000; i++) {
+        if (i) text += ",";
+        text += "{\"RegionId\": \"region-" + std::to_string(i) + "\", \"SizeMiB\": " + std::to_string(i * 1024) +
+                ", \"Unknown\": 1, \"PassphraseState\": " + (i % 3 ? "true" : "false") + "}";
+    }
+    text += "], \"AllowedSpeedsMHz\": [";
+    for (int i = 0; i < 5000; i++)
+        text += (i ? "," : "") + std::to_string(i * 2654435761LL % 70000 - 1000);
+    text += "], \"MemoryMedia\": [";
+    for (int i = 0; i < 600; i++)
+        text += std::string(i ? "," : "") + "\"" + media[i % 4] + "\"";
+    text += "], \"NotInTheSchema\": [1, 2, 3], \"CapacityMiB\": 65536, \"Name\": \"DIMM 1\"}";
+    return text;
+}
+
+class BejParallel : public MemoryDictionaryTest {
+protected:
+    void SetUp() override
+    {
+        MemoryDictionaryTest::SetUp();
+        if (HasFatalFailure()) return;
+        pool.reset(bej_pool_create(3));
+        ASSERT_NE(pool.get(), nullptr);
+
+        large.reset(json_parse(large_document().c_str()));
+        small.reset(json_parse_file(test_path("data/example5.json").c_str()));
+        ASSERT_NE(large.get(), nullptr);
+        ASSERT_NE(small.get(), nullptr);
+    }
+
+    pool_ptr pool{nullptr, bej_pool_free};
+    json_ptr large{nullptr, json_free};
+    json_ptr small{nullptr, json_free};
+};
+
+TEST(BejPool, RunsEveryTaskOnce)
+{
+    for (const size_t threads : {0, 1, 4}) {
+        pool_ptr pool(bej_pool_create(threads), bej_pool_free);
+        ASSERT_NE(pool.get(), nullptr);
+        EXPECT_EQ(bej_pool_concurrency(pool.get()), threads + 1);
+
+        for (const size_t count : {0, 1, 2, 1000}) {
+            std::vector<std::atomic<int>> runs(count);
+            bej_pool_run(pool.get(), [](void *arg, size_t index) {
+                static_cast<std::atomic<int> *>(arg)[index]++;
+            }, runs.data(), count);
+            for (size_t i = 0; i < count; i++)
+                EXPECT_EQ(runs[i].load(), 1) << "task " << i << " of " << count;
+        }
+    }
+    EXPECT_EQ(bej_pool_concurrency(nullptr), 1u);
+    EXPECT_EQ(bej_pool_create(BEJ_POOL_MAX_THREADS + 1), nullptr);
+}
+
+TEST_F(BejParallel, EncodeMatchesTheSerialEncoder)
+{
+    pool_ptr idle(bej_pool_create(0), bej_pool_free);
+    for (const json_value_t *root : {large.get(), small.get()}) {
+        const std::vector<uint8_t> expected = encode_tree(root);
+        ASSERT_FALSE(expected.empty());
+        for (bej_pool_t *p : {pool.get(), idle.get(), static_cast<bej_pool_t *>(nullptr)}) {
+            for (const size_t min_subtree : {size_t(0), size_t(1), size_t(4096)}) {
+                const bej_parallel_t parallel = {p, min_subtree};
+                bej_buffer_t out;
+                bej_buffer_init(&out);
+                ASSERT_TRUE(bej_buffer_append(&out, "xy", 2)); // documents are appended
+                ASSERT_TRUE(bej_encode_buffer_parallel(&out, root, schema.get(), annot.get(), &parallel));
+                ASSERT_EQ(out.size, expected.size() + 2);
+                EXPECT_EQ(std::vector<uint8_t>(out.data + 2, out.data + out.size), expected)
+                    << "min_subtree " << min_subtree;
+                bej_buffer_free(&out);
+            }
+        }
+    }
+}
+
+TEST_F(BejParallel, DecodeMatchesTheSerialDecoder)
+{
+    for (const json_value_t *root : {large.get(), small.get()}) {
+        const std::vector<uint8_t> bej = encode_tree(root);
+        json_ptr expected(bej_decode_buffer(bej.data(), bej.size(), schema.get(), annot.get()), json_free);
+        ASSERT_NE(expected.get(), nullptr);
+        const std::string expected_text = to_text(expected.get());
+
+        for (const size_t min_subtree : {size_t(0), size_t(1), size_t(4096)}) {
+            const bej_parallel_t parallel = {pool.get(), min_subtree};
+            json_ptr tree(bej_decode_buffer_parallel(bej.data(), bej.size(), schema.get(), annot.get(), nullptr,
+                                                     &parallel), json_free);
+            ASSERT_NE(tree.get(), nullptr);
+            EXPECT_EQ(to_text(tree.get()), expected_text) << "min_subtree " << min_subtree;
+
+            json_arena_t arena;
+            json_arena_init(&arena);
+            const json_value_t *in_arena = bej_decode_buffer_parallel(bej.data(), bej.size(), schema.get(),
+                                                                      annot.get(), &arena, &parallel);
+            ASSERT_NE(in_arena, nullptr);
+            EXPECT_EQ(to_text(in_arena), expected_text) << "min_subtree " << min_subtree;
+            json_arena_destroy(&arena);
+        }
+    }
+}
+
+TEST_F(BejParallel, FailuresLeaveNoPartialResult)
+{
+    const bej_parallel_t parallel = {pool.get(), 1};
+
+    // an element of the wrong type in a split array fails the whole document
+    json_ptr bad(json_parse(large_document().replace(large_document().find("\"AllowedSpeedsMHz\": [") + 21, 1,
+                                                     "\"x\",").c_str()), json_free);
+    ASSERT_NE(bad.get(), nullptr);
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+    ASSERT_TRUE(bej_buffer_append(&out, "xy", 2));
+    EXPECT_FALSE(bej_encode_buffer_parallel(&out, bad.get(), schema.get(), annot.get(), &parallel));
+    EXPECT_EQ(out.size, 2u);
+    bej_buffer_free(&out);
+
+    // truncated documents fail, wherever the cut falls
+    const std::vector<uint8_t> bej = encode_tree(large.get());
+    ASSERT_FALSE(bej.empty());
+    for (const size_t size : {size_t(3), bej.size() / 5, bej.size() / 2, bej.size() - 1}) {
+        EXPECT_EQ(bej_decode_buffer_parallel(bej.data(), size, schema.get(), annot.get(), nullptr, &parallel), nullptr);
+        json_arena_t arena;
+        json_arena_init(&arena);
+        EXPECT_EQ(bej_decode_buffer_parallel(bej.data(), size, schema.get(), annot.get(), &arena, &parallel), nullptr);
+        json_arena_destroy(&arena);
+    }
+}
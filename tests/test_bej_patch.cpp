@@ -0,0 +1,193 @@
+#include <fstream>
+#include <sstream>
+#include "test_util.h"
+
+/**
+ * @brief Returns a copy of a text with its first occurrence of a substring replaced.
+ *
+ * @param text The text.
+ * @param from The substring, which must occur in the text.
+ * @param to Its replacement.
+ * @return The edited text.
+ */
+static std::string replaced(std::string text, const std::string &from, const std::string &to)
+{
+    const size_t at = text.find(from);
+    EXPECT_NE(at, std::string::npos) << from;
+    return at == std::string::npos ? text : text.replace(at, from.size(), to);
+}
+
+class BejPatch : public MemoryDictionaryTest {
+protected:
+    void SetUp() override
+    {
+        MemoryDictionaryTest::SetUp();
+        if (HasFatalFailure()) return;
+
+        std::ifstream file(test_path("data/example5.json"));
+        std::stringstream content;
+        content << file.rdbuf();
+        text = content.str();
+        bej = encode(text, BEJ_ENCODE_CANONICAL);
+        ASSERT_FALSE(bej.empty());
+    }
+
+    /**
+     * @brief Encodes a JSON text.
+     *
+     * @param json The text.
+     * @param flags BEJ_ENCODE_* flags.
+     * @return The BEJ document, empty if it could not be encoded.
+     */
+    std::vector<uint8_t> encode(const std::string &json, const unsigned flags)
+    {
+        const json_ptr root(json_parse(json.c_str()), json_free);
+        EXPECT_NE(root.get(), nullptr) << json;
+        return encode_tree(root.get(), flags);
+    }
+
+    /**
+     * @brief Patches a document.
+     *
+     * @param document The BEJ document.
+     * @param patch The patch as JSON text.
+     * @param patched Receives the patched document.
+     * @return 1 if the document was patched.
+     */
+    int patch(const std::vector<uint8_t> &document, const std::string &patch, std::vector<uint8_t> &patched)
+    {
+        const json_ptr value(json_parse(patch.c_str()), json_free);
+        EXPECT_NE(value.get(), nullptr) << patch;
+        bej_buffer_t out;
+        bej_buffer_init(&out);
+        const int ok = bej_patch_buffer(&out, document.data(), document.size(), value.get(), schema.get(),
+                                        annot.get());
+        patched.assign(out.data, out.data + out.size);
+        bej_buffer_free(&out);
+        return ok;
+    }
+
+    std::string text;
+    std::vector<uint8_t> bej;
+};
+
+TEST_F(BejPatch, MatchesEncodingThePatchedDocument)
+{
+    const std::string status = "\"Health\": \"OK\",\n    \"State\": \"Enabled\"";
+    const std::pair<std::string, std::string> cases[] = {
+        {"{}", text},
+        {"{\"Name\": \"DIMM Slot 2\"}", replaced(text, "DIMM Slot 1", "DIMM Slot 2")},
+        {"{\"CapacityMiB\": 1048576, \"NotInTheSchema\": 1}", replaced(text, "65536", "1048576")},
+        {"{\"Status\": {\"Health\": \"Warning\"}}", replaced(text, "\"OK\",\n    \"State\"", "\"Warning\",\n    \"State\"")},
+        {"{\"Status\": {\"State\": \"Disabled\", \"HealthRollup\": \"Critical\"}}",
+         replaced(text, status, "\"Health\": \"OK\", \"State\": \"Disabled\", \"HealthRollup\": \"Critical\"")},
+        {"{\"@odata.etag\": \"W/\\\"4b1c\\\"\", \"Status\": {\"@odata.id\": \"/x\"}}",
+         replaced(replaced(text, "3f2a", "4b1c"), "/redfish/v1/Systems/1/Memory/DIMM1#/Status", "/x")},
+        {"{\"@Message.ExtendedInfo\": [{\"MessageId\": \"Base.1.8.Created\"}]}",
+         replaced(text, text.substr(text.find('[', text.find("ExtendedInfo")),
+                                    text.find(']') - text.find('[', text.find("ExtendedInfo")) + 1),
+                  "[{\"MessageId\": \"Base.1.8.Created\"}]")},
+        {"{\"AllowedSpeedsMHz\": [2400, 3200], \"Id\": \"DIMM2\"}",
+         replaced(replaced(text, "\"DIMM1\",", "\"DIMM2\","), "\n}", ", \"AllowedSpeedsMHz\": [2400, 3200]}")},
+    };
+    for (const auto &[patch_text, expected_text] : cases) {
+        const std::vector<uint8_t> expected = encode(expected_text, BEJ_ENCODE_CANONICAL);
+        ASSERT_FALSE(expected.empty()) << expected_text;
+        std::vector<uint8_t> patched;
+        ASSERT_TRUE(patch(bej, patch_text, patched)) << patch_text;
+        EXPECT_EQ(patched, expected) << patch_text;
+    }
+}
+
+TEST_F(BejPatch, NullRemovesMembers)
+{
+    const size_t status = text.find(",\n  \"Status\"");
+    const std::pair<std::string, std::string> cases[] = {
+        {"{\"Name\": null}", replaced(text, "\"Name\": \"DIMM Slot 1\",", "")},
+        {"{\"Name\": null, \"Id\": null, \"CapacityMiB\": 1}",
+         replaced(replaced(replaced(text, "\"Name\": \"DIMM Slot 1\",", ""), "\"Id\": \"DIMM1\",", ""), "65536", "1")},
+        {"{\"Status\": {\"Health\": null, \"State\": \"Disabled\"}}",
+         replaced(text, "\"Health\": \"OK\",\n    \"State\": \"Enabled\"", "\"State\": \"Disabled\"")},
+        {"{\"Status\": null}", text.substr(0, status) + "\n}"},
+    };
+    for (const auto &[patch_text, expected_text] : cases) {
+        const std::vector<uint8_t> expected = encode(expected_text, BEJ_ENCODE_CANONICAL);
+        ASSERT_FALSE(expected.empty()) << expected_text;
+        std::vector<uint8_t> patched;
+        ASSERT_TRUE(patch(bej, patch_text, patched)) << patch_text;
+        EXPECT_EQ(patched, expected) << patch_text;
+    }
+}
+
+TEST_F(BejPatch, NullForAMissingMemberIsIgnored)
+{
+    const std::pair<std::string, std::string> cases[] = {
+        {"{\"PartNumber\": null}", text},
+        {"{\"Status\": {\"HealthRollup\": null}}", text},
+        {"{\"MemoryLocation\": {\"Slot\": 2, \"Socket\": null}}",
+         replaced(text, "\n}", ", \"MemoryLocation\": {\"Slot\": 2}}")},
+    };
+    for (const auto &[patch_text, expected_text] : cases) {
+        const std::vector<uint8_t> expected = encode(expected_text, BEJ_ENCODE_CANONICAL);
+        ASSERT_FALSE(expected.empty()) << expected_text;
+        std::vector<uint8_t> patched;
+        ASSERT_TRUE(patch(bej, patch_text, patched)) << patch_text;
+        EXPECT_EQ(patched, expected) << patch_text;
+    }
+}
+
+TEST_F(BejPatch, CopiesUntouchedMembersVerbatim)
+{
+    // members of a fixed-width document keep their padded lengths, the path to the root is rewritten
+    const std::vector<uint8_t> fixed = encode(text, BEJ_ENCODE_FIXED_WIDTH);
+    ASSERT_GT(fixed.size(), bej.size());
+    std::vector<uint8_t> patched;
+    ASSERT_TRUE(patch(fixed, "{\"Status\": {\"Health\": \"Critical\"}}", patched));
+    EXPECT_LT(patched.size(), fixed.size());
+    EXPECT_GT(patched.size(), bej.size());
+
+    const json_ptr tree(bej_decode_buffer(patched.data(), patched.size(), schema.get(), annot.get()), json_free);
+    const json_ptr expected(json_parse(replaced(text, "\"OK\",\n    \"State\"", "\"Critical\",\n    \"State\"").c_str()),
+                            json_free);
+    ASSERT_NE(tree.get(), nullptr);
+    ASSERT_NE(expected.get(), nullptr);
+    EXPECT_TRUE(json_compare(tree.get(), expected.get()));
+
+    // patching a patched document applies both
+    std::vector<uint8_t> twice;
+    ASSERT_TRUE(patch(patched, "{\"Name\": \"DIMM Slot 2\"}", twice));
+    const json_ptr again(bej_decode_buffer(twice.data(), twice.size(), schema.get(), annot.get()), json_free);
+    ASSERT_NE(again.get(), nullptr);
+    EXPECT_STREQ(json_object_get(again.get(), "Name")->data.string, "DIMM Slot 2");
+    EXPECT_STREQ(json_object_get(json_object_get(again.get(), "Status"), "Health")->data.string, "Critical");
+}
+
+TEST_F(BejPatch, FailuresLeaveTheBufferUnchanged)
+{
+    const json_ptr name(json_parse("{\"Name\": \"x\"}"), json_free);
+    const std::pair<std::vector<uint8_t>, std::string> cases[] = {
+        {std::vector<uint8_t>(bej.begin(), bej.end() - 1), "{\"Name\": \"x\"}"},
+        {std::vector<uint8_t>(bej.begin(), bej.begin() + 5), "{\"Name\": \"x\"}"},
+        {bej, "{\"CapacityMiB\": \"large\"}"},
+        {bej, "{\"Status\": {\"Health\": \"NotAHealth\"}}"},
+        {bej, "[1, 2]"},
+        {bej, "\"Name\""},
+    };
+    for (const auto &[document, patch_text] : cases) {
+        const json_ptr value(json_parse(patch_text.c_str()), json_free);
+        ASSERT_NE(value.get(), nullptr);
+        bej_buffer_t out;
+        bej_buffer_init(&out);
+        ASSERT_TRUE(bej_buffer_append(&out, "xy", 2)); // documents are appended
+        EXPECT_FALSE(bej_patch_buffer(&out, document.data(), document.size(), value.get(), schema.get(), annot.get()))
+            << patch_text << " on " << document.size() << " bytes";
+        EXPECT_EQ(out.size, 2u);
+        bej_buffer_free(&out);
+    }
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+    EXPECT_FALSE(bej_patch_buffer(&out, bej.data(), bej.size(), nullptr, schema.get(), annot.get()));
+    EXPECT_FALSE(bej_patch_buffer(&out, bej.data(), bej.size(), name.get(), nullptr, annot.get()));
+    EXPECT_EQ(out.size, 0u);
+    bej_buffer_free(&out);
+}
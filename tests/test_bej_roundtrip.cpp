@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cstdio>
 #include <vector>
 #include <string>
@@ -92,3 +93,218 @@ TEST(BejRoundTrip, Example3) {
         "dictionaries/annotation.bin"
     );
 }
+
+TEST(BejRoundTrip, Example4NestedSetsAndArrays) {
+    test_json_bej_roundtrip(
+        "data/example4.json",
+        "dictionaries/Memory_v1.bin",
+        "dictionaries/annotation.bin"
+    );
+}
+
+TEST(BejRoundTrip, Example5Annotations) {
+    test_json_bej_roundtrip(
+        "data/example5.json",
+        "dictionaries/Memory_v1.bin",
+        "dictionaries/annotation.bin"
+    );
+}
+
+TEST(BejEncode, FixedWidthLengthsRoundTrip) {
+    char cwd[1024];
+    const std::string path_curr = getcwd(cwd, sizeof(cwd));
+
+    std::unique_ptr<json_value_t, void(*)(json_value_t*)> json_root(
+        json_parse_file((path_curr + "/data/example3.json").c_str()), json_free
+    );
+    ASSERT_NE(json_root.get(), nullptr);
+
+    std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)> schema_dict(
+        bej_dictionary_load_map((path_curr + "/dictionaries/Memory_v1.bin").c_str()), bej_dictionary_free
+    );
+    std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)> annot_dict(
+        bej_dictionary_load_map((path_curr + "/dictionaries/annotation.bin").c_str()), bej_dictionary_free
+    );
+    ASSERT_NE(schema_dict.get(), nullptr);
+    ASSERT_NE(annot_dict.get(), nullptr);
+
+    bej_buffer_t canonical, fixed;
+    bej_buffer_init(&canonical);
+    bej_buffer_init(&fixed);
+    ASSERT_NE(bej_encode_buffer(&canonical, json_root.get(), schema_dict.get(), annot_dict.get(),
+                                BEJ_ENCODE_CANONICAL), 0);
+    ASSERT_NE(bej_encode_buffer(&fixed, json_root.get(), schema_dict.get(), annot_dict.get(),
+                                BEJ_ENCODE_FIXED_WIDTH), 0);
+    EXPECT_GT(fixed.size, canonical.size) << "Fixed-width lengths should not be minimal";
+
+    json_value_t *decoded_raw = bej_decode_buffer(fixed.data, fixed.size, schema_dict.get(), annot_dict.get());
+    bej_buffer_free(&canonical);
+    bej_buffer_free(&fixed);
+    ASSERT_NE(decoded_raw, nullptr) << "Failed to decode fixed-width BEJ";
+
+    const std::unique_ptr<json_value_t, void(*)(json_value_t*)> decoded_json(decoded_raw, json_free);
+    ASSERT_TRUE(json_compare(json_root.get(), decoded_json.get())) << "Round-trip JSON mismatch";
+}
+
+TEST(BejDecode, StreamTextMatchesTree) {
+    char cwd[1024];
+    const std::string path_curr = getcwd(cwd, sizeof(cwd));
+
+    std::unique_ptr<json_value_t, void(*)(json_value_t*)> json_root(
+        json_parse_file((path_curr + "/data/example4.json").c_str()), json_free
+    );
+    ASSERT_NE(json_root.get(), nullptr);
+
+    std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)> schema_dict(
+        bej_dictionary_load_map((path_curr + "/dictionaries/Memory_v1.bin").c_str()), bej_dictionary_free
+    );
+    std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)> annot_dict(
+        bej_dictionary_load_map((path_curr + "/dictionaries/annotation.bin").c_str()), bej_dictionary_free
+    );
+    ASSERT_NE(schema_dict.get(), nullptr);
+    ASSERT_NE(annot_dict.get(), nullptr);
+
+    FILE *bej = tmpfile();
+    ASSERT_NE(bej, nullptr);
+    ASSERT_NE(bej_encode_stream(bej, json_root.get(), schema_dict.get(), annot_dict.get()), 0);
+    rewind(bej);
+
+    FILE *text = tmpfile();
+    ASSERT_NE(text, nullptr);
+    ASSERT_NE(bej_decode_stream(text, bej, schema_dict.get(), annot_dict.get()), 0);
+    fclose(bej);
+
+    fseek(text, 0, SEEK_END);
+    std::string json_text(static_cast<size_t>(ftell(text)), '\0');
+    rewind(text);
+    ASSERT_EQ(fread(&json_text[0], 1, json_text.size(), text), json_text.size());
+    fclose(text);
+
+    const std::unique_ptr<json_value_t, void(*)(json_value_t*)> decoded_json(json_parse(json_text.c_str()), json_free);
+    ASSERT_NE(decoded_json.get(), nullptr) << "Decoder produced invalid JSON: " << json_text;
+    ASSERT_TRUE(json_compare(json_root.get(), decoded_json.get())) << "Round-trip JSON mismatch";
+}
+
+TEST(BejEncode, LargeScalarArraysRoundTrip) {
+    char cwd[1024];
+    const std::string path_curr = getcwd(cwd, sizeof(cwd));
+
+    std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)> schema_dict(
+        bej_dictionary_load_map((path_curr + "/dictionaries/Memory_v1.bin").c_str()), bej_dictionary_free
+    );
+    std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)> annot_dict(
+        bej_dictionary_load_map((path_curr + "/dictionaries/annotation.bin").c_str()), bej_dictionary_free
+    );
+    ASSERT_NE(schema_dict.get(), nullptr);
+    ASSERT_NE(annot_dict.get(), nullptr);
+
+    // every integer width, both signs, and enum runs that change option on every element
+    const long long edges[] = {0, -1, 1, 127, 128, -128, -129, 255, 256, 32767, -32768, 8388607, -8388609,
+                               2147483647LL, -2147483648LL, 1099511627776LL, -1099511627777LL, 9007199254740992LL};
+    const char *media[] = {"DRAM", "NAND", "Intel3DXPoint", "Proprietary"};
+    std::string text = "{\"AllowedSpeedsMHz\": [";
+    for (size_t i = 0; i < 12000; i++)
+        text += (i ? "," : "") + std::to_string(edges[i % (sizeof(edges) / sizeof(edges[0]))]);
+    text += "], \"MemoryMedia\": [";
+    for (size_t i = 0; i < 12000; i++)
+        text += std::string(i ? "," : "") + "\"" + media[(i * 7 / 3) % 4] + "\"";
+    text += "], \"OperatingMemoryModes\": [], \"Id\": \"DIMM1\"}";
+
+    std::unique_ptr<json_value_t, void(*)(json_value_t*)> json_root(json_parse(text.c_str()), json_free);
+    ASSERT_NE(json_root.get(), nullptr);
+
+    for (const unsigned flags : {BEJ_ENCODE_CANONICAL, BEJ_ENCODE_FIXED_WIDTH}) {
+        bej_buffer_t out;
+        bej_buffer_init(&out);
+        ASSERT_NE(bej_encode_buffer(&out, json_root.get(), schema_dict.get(), annot_dict.get(), flags), 0);
+
+        if (flags == BEJ_ENCODE_CANONICAL) {
+            // elements 5 and 6 of AllowedSpeedsMHz: -128 in one byte, -129 in two
+            const uint8_t expected[] = {0x01, 0x0A, 0x30, 0x01, 0x03, 0x01, 0x01, 0x80,
+                                        0x01, 0x0C, 0x30, 0x01, 0x04, 0x01, 0x02, 0x7F, 0xFF};
+            const std::vector<uint8_t> bytes(out.data, out.data + out.size);
+            EXPECT_NE(std::search(bytes.begin(), bytes.end(), std::begin(expected), std::end(expected)), bytes.end());
+        }
+
+        const std::unique_ptr<json_value_t, void(*)(json_value_t*)> heap_tree(
+            bej_decode_buffer(out.data, out.size, schema_dict.get(), annot_dict.get()), json_free);
+        ASSERT_NE(heap_tree.get(), nullptr);
+        EXPECT_TRUE(json_compare(json_root.get(), heap_tree.get()));
+
+        json_arena_t arena;
+        json_arena_init(&arena);
+        const json_value_t *arena_tree = bej_decode_buffer_in(out.data, out.size, schema_dict.get(),
+                                                              annot_dict.get(), &arena);
+        ASSERT_NE(arena_tree, nullptr);
+        EXPECT_TRUE(json_compare(json_root.get(), arena_tree));
+        json_arena_destroy(&arena);
+
+        // a truncated document fails
+        EXPECT_EQ(bej_decode_buffer(out.data, out.size - 100, schema_dict.get(), annot_dict.get()), nullptr);
+        bej_buffer_free(&out);
+    }
+
+    // an unknown option or a mistyped element fails the whole document
+    for (const char *bad : {"{\"MemoryMedia\": [\"DRAM\", \"Floppy\"]}", "{\"AllowedSpeedsMHz\": [1, \"2\"]}"}) {
+        std::unique_ptr<json_value_t, void(*)(json_value_t*)> bad_root(json_parse(bad), json_free);
+        ASSERT_NE(bad_root.get(), nullptr);
+        bej_buffer_t out;
+        bej_buffer_init(&out);
+        EXPECT_EQ(bej_encode_buffer(&out, bad_root.get(), schema_dict.get(), annot_dict.get(), BEJ_ENCODE_CANONICAL), 0) << bad;
+        EXPECT_EQ(out.size, 0u);
+        bej_buffer_free(&out);
+    }
+}
+
+TEST(BejEncode, MistypedScalarElementsFail) {
+    char cwd[1024];
+    const std::string path_curr = getcwd(cwd, sizeof(cwd));
+
+    std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)> schema_dict(
+        bej_dictionary_load_map((path_curr + "/dictionaries/Memory_v1.bin").c_str()), bej_dictionary_free
+    );
+    ASSERT_NE(schema_dict.get(), nullptr);
+
+    // an element of any other type fails like it does for a single property, whatever its position
+    for (const char *bad : {"{\"AllowedSpeedsMHz\": [\"2400\"]}", "{\"AllowedSpeedsMHz\": [2400, \"3200\", 4800]}",
+                            "{\"AllowedSpeedsMHz\": [1, {\"x\": 2}]}", "{\"AllowedSpeedsMHz\": [[1], 2]}",
+                            "{\"AllowedSpeedsMHz\": [1, null]}", "{\"AllowedSpeedsMHz\": [true]}",
+                            "{\"MemoryMedia\": [\"DRAM\", 1]}", "{\"CapacityMiB\": \"2400\"}"}) {
+        std::unique_ptr<json_value_t, void(*)(json_value_t*)> bad_root(json_parse(bad), json_free);
+        ASSERT_NE(bad_root.get(), nullptr) << bad;
+        for (const unsigned flags : {BEJ_ENCODE_CANONICAL, BEJ_ENCODE_FIXED_WIDTH}) {
+            bej_buffer_t out;
+            bej_buffer_init(&out);
+            EXPECT_EQ(bej_encode_buffer(&out, bad_root.get(), schema_dict.get(), nullptr, flags), 0) << bad;
+            EXPECT_EQ(out.size, 0u);
+            bej_buffer_free(&out);
+        }
+        FILE *tmp = tmpfile();
+        ASSERT_NE(tmp, nullptr);
+        EXPECT_EQ(bej_encode_stream(tmp, bad_root.get(), schema_dict.get(), nullptr), 0) << bad;
+        fclose(tmp);
+    }
+}
+
+TEST(BejBuffer, EmittersWriteShortestAndFixedWidthFields) {
+    struct { uint64_t value; std::vector<uint8_t> bytes; } cases[] = {
+        {0, {1, 0}},
+        {255, {1, 0xFF}},
+        {256, {2, 0x00, 0x01}},
+        {0x123456, {3, 0x56, 0x34, 0x12}},
+        {1ull << 56, {8, 0, 0, 0, 0, 0, 0, 0, 1}},
+        {UINT64_MAX, {8, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}},
+    };
+    for (const auto &c : cases) {
+        uint8_t p[BEJ_NNINT_MAX_SIZE];
+        ASSERT_EQ(bej_nnint_size(c.value), c.bytes.size()) << c.value;
+        ASSERT_EQ(bej_put_nnint(p, c.value), c.bytes.size()) << c.value;
+        EXPECT_EQ(std::vector<uint8_t>(p, p + c.bytes.size()), c.bytes) << c.value;
+    }
+
+    uint8_t p[BEJ_SFL_MAX_SIZE];
+    ASSERT_EQ(bej_put_sfl(p, 0x203, BEJ_FORMAT_ARRAY, 300), 7u);
+    EXPECT_EQ(std::vector<uint8_t>(p, p + 7), (std::vector<uint8_t>{2, 0x03, 0x02, 0x10, 2, 0x2C, 0x01}));
+    ASSERT_EQ(bej_put_sfl_fixed(p, 4, BEJ_FORMAT_SET, 5, 4), 8u);
+    EXPECT_EQ(std::vector<uint8_t>(p, p + 8), (std::vector<uint8_t>{1, 4, 0x00, 4, 5, 0, 0, 0}));
+}
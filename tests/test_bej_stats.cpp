@@ -0,0 +1,149 @@
+#include <atomic>
+#include <thread>
+#include "test_util.h"
+
+extern "C" {
+    #include "bej_stats.h"
+}
+
+/**
+ * @brief Write callback that discards the decoded text.
+ */
+static int discard_text(void *, const char *, size_t)
+{
+    return 1;
+}
+
+class BejStats : public MemoryDictionaryTest {
+protected:
+    void SetUp() override
+    {
+        if (!bej_stats_enabled())
+            GTEST_SKIP() << "built without BEJ_ENABLE_STATS";
+        MemoryDictionaryTest::SetUp();
+        if (HasFatalFailure()) return;
+
+        root.reset(json_parse_file(test_path("data/example5.json").c_str()));
+        ASSERT_NE(root.get(), nullptr);
+        bej = encode_tree(root.get());
+        ASSERT_FALSE(bej.empty());
+        bej_stats_reset();
+    }
+
+    void TearDown() override
+    {
+        bej_stats_set_timing(0);
+    }
+
+    json_ptr root{nullptr, json_free};
+    std::vector<uint8_t> bej;
+};
+
+TEST_F(BejStats, CountersFollowTheDocument) {
+    const json_ptr decoded(bej_decode_buffer(bej.data(), bej.size(), schema.get(), annot.get()), json_free);
+    ASSERT_NE(decoded.get(), nullptr);
+
+    bej_stats_t stats;
+    bej_stats_snapshot(&stats);
+    EXPECT_EQ(stats.documents, 1u);
+    EXPECT_EQ(stats.bytes_in, bej.size());
+    // root, 8 members, 2 info entries with 3 + 1 members, 3 Status members
+    EXPECT_EQ(stats.properties, 1u + 8u + 2u + 4u + 3u);
+    EXPECT_GE(stats.dict_lookups, stats.properties - 1);
+    EXPECT_GE(stats.dict_probes, stats.dict_lookups);
+    EXPECT_GT(stats.allocations, 0u);
+    EXPECT_EQ(stats.decode_ns, 0u); // timings are off by default
+
+    // the encoder counts the same properties and reports its output
+    bej_stats_reset();
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+    ASSERT_TRUE(bej_encode_buffer(&out, root.get(), schema.get(), annot.get(), BEJ_ENCODE_CANONICAL));
+    bej_buffer_free(&out);
+    bej_stats_snapshot(&stats);
+    EXPECT_EQ(stats.documents, 1u);
+    EXPECT_EQ(stats.bytes_out, bej.size());
+    EXPECT_EQ(stats.properties, 1u + 8u + 2u + 4u + 3u);
+}
+
+TEST_F(BejStats, TimingsAreOptIn) {
+    bej_stats_set_timing(1);
+    bej_stream_decoder_t dec;
+    bej_stream_decoder_init(&dec, schema.get(), annot.get(), discard_text, nullptr);
+    ASSERT_TRUE(bej_stream_decoder_feed(&dec, bej.data(), bej.size()));
+    ASSERT_TRUE(bej_stream_decoder_finish(&dec));
+
+    bej_stats_t stats;
+    bej_stats_snapshot(&stats);
+    EXPECT_EQ(stats.documents, 1u);
+    EXPECT_EQ(stats.bytes_in, bej.size());
+    EXPECT_GT(stats.bytes_out, 0u);
+    EXPECT_GT(stats.decode_ns, 0u);
+    EXPECT_GT(stats.dict_ns, 0u);
+    EXPECT_LE(stats.dict_ns, stats.decode_ns);
+
+    bej_stats_reset();
+    bej_stats_snapshot(&stats);
+    EXPECT_EQ(stats.documents, 0u);
+    EXPECT_EQ(stats.decode_ns, 0u);
+}
+
+TEST_F(BejStats, ExitedThreadsAreKept) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([this] {
+            for (int i = 0; i < 10; i++) {
+                json_value_t *decoded = bej_decode_buffer(bej.data(), bej.size(), schema.get(), annot.get());
+                EXPECT_NE(decoded, nullptr);
+                json_free(decoded);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    bej_stats_t stats;
+    bej_stats_snapshot(&stats);
+    EXPECT_EQ(stats.documents, 40u);
+    EXPECT_EQ(stats.bytes_in, 40u * bej.size());
+}
+
+TEST_F(BejStats, ResetWhileThreadsCount) {
+    std::atomic<int> counted{0}, released{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([this, &counted, &released] {
+            const auto decode = [this](const int documents) {
+                for (int i = 0; i < documents; i++) {
+                    json_value_t *decoded = bej_decode_buffer(bej.data(), bej.size(), schema.get(), annot.get());
+                    EXPECT_NE(decoded, nullptr);
+                    json_free(decoded);
+                }
+            };
+            decode(10);
+            counted++;
+            while (!released)
+                std::this_thread::yield();
+            decode(5);
+        });
+    }
+
+    // resets and snapshots race with the counting threads, totals never exceed what was counted
+    bej_stats_t stats;
+    while (counted < 4) {
+        bej_stats_reset();
+        bej_stats_snapshot(&stats);
+        EXPECT_LE(stats.documents, 40u);
+    }
+
+    // what the threads counted before the reset stays reset, also once they have exited
+    bej_stats_reset();
+    bej_stats_snapshot(&stats);
+    EXPECT_EQ(stats.documents, 0u);
+    released = 1;
+    for (std::thread &thread : threads)
+        thread.join();
+    bej_stats_snapshot(&stats);
+    EXPECT_EQ(stats.documents, 20u);
+    EXPECT_EQ(stats.bytes_in, 20u * bej.size());
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include "test_util.h"
+
+/**
+ * @brief Feeds a BEJ document to a streaming decoder in fixed-size chunks.
+ *
+ * @param bej The BEJ document.
+ * @param chunk Bytes per feed call.
+ * @param schema Schema dictionary.
+ * @param annot Annotation dictionary.
+ * @param text Receives the JSON text.
+ * @return Result of bej_stream_decoder_finish().
+ */
+static int decode_in_chunks(const std::vector<uint8_t> &bej, size_t chunk,
+                            const bej_dictionary_t *schema, const bej_dictionary_t *annot,
+                            std::string &text)
+{
+    bej_stream_decoder_t dec;
+    bej_stream_decoder_init(&dec, schema, annot, append_to_string, &text);
+    int ok = 1;
+    for (size_t pos = 0; ok && pos < bej.size(); pos += chunk)
+        ok = bej_stream_decoder_feed(&dec, bej.data() + pos, std::min(chunk, bej.size() - pos));
+    return bej_stream_decoder_finish(&dec) && ok;
+}
+
+/**
+ * @brief Builds a dictionary whose root Set has one Integer member, named "A" or without a name.
+ *
+ * @param named Whether the member has a name.
+ * @return Owning pointer to the dictionary.
+ */
+static dict_ptr single_member_dictionary(const bool named)
+{
+    const uint8_t bytes[] = {
+        0x00, 0x00, 0x02, 0x00, 39, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // header, 2 entries, 39 bytes
+        0x00, 0x00, 0x00, 22, 0x00, 0x01, 0x00, 5, 32, 0x00,                   // Root: Set of the subset at 22
+        0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                               // Integer, sequence 0
+        uint8_t(named ? 2 : 0), uint8_t(named ? 37 : 0), 0x00,                  // its name, if any
+        'R', 'o', 'o', 't', 0, 'A', 0,
+    };
+    return dictionary_from(bytes, sizeof(bytes));
+}
+
+class BejStreamDecoder : public MemoryDictionaryTest {
+protected:
+    /**
+     * @brief Encodes a test data file.
+     *
+     * @param name Path of the JSON file relative to the test directory.
+     * @param flags BEJ_ENCODE_* flags.
+     * @return The BEJ document (empty on failure).
+     */
+    std::vector<uint8_t> encode(const std::string &name, unsigned flags)
+    {
+        const json_ptr root(json_parse_file(test_path(name).c_str()), json_free);
+        return encode_tree(root.get(), flags);
+    }
+};
+
+TEST_F(BejStreamDecoder, ChunkBoundariesDoNotChangeTheOutput) {
+    for (const char *name : {"data/example1.json", "data/example4.json", "data/example5.json"}) {
+        for (const unsigned flags : {BEJ_ENCODE_CANONICAL, BEJ_ENCODE_FIXED_WIDTH}) {
+            const std::vector<uint8_t> bej = encode(name, flags);
+            ASSERT_FALSE(bej.empty()) << name;
+
+            std::string whole;
+            ASSERT_TRUE(decode_in_chunks(bej, bej.size(), schema.get(), annot.get(), whole)) << name;
+
+            const json_ptr expected(json_parse_file(test_path(name).c_str()), json_free);
+            const json_ptr decoded(json_parse(whole.c_str()), json_free);
+            ASSERT_NE(decoded.get(), nullptr) << whole;
+            EXPECT_TRUE(json_compare(expected.get(), decoded.get())) << name;
+
+            // every split point, including ones inside SFL headers and nnints
+            for (const size_t chunk : {1, 2, 3, 7, 64}) {
+                std::string text;
+                ASSERT_TRUE(decode_in_chunks(bej, chunk, schema.get(), annot.get(), text)) << name << " " << chunk;
+                EXPECT_EQ(text, whole) << name << " " << chunk;
+            }
+        }
+    }
+}
+
+TEST_F(BejStreamDecoder, TruncatedAndOverlongPayloadsFail) {
+    const std::vector<uint8_t> bej = encode("data/example4.json", BEJ_ENCODE_CANONICAL);
+    ASSERT_FALSE(bej.empty());
+
+    // a document cut anywhere is incomplete
+    for (size_t cut = 0; cut < bej.size(); cut += 13) {
+        const std::vector<uint8_t> prefix(bej.begin(), bej.begin() + static_cast<std::ptrdiff_t>(cut));
+        std::string text;
+        EXPECT_FALSE(decode_in_chunks(prefix, 5, schema.get(), annot.get(), text)) << cut;
+    }
+
+    // a root length shorter than its members makes them run past the payload
+    std::vector<uint8_t> broken = bej;
+    ASSERT_EQ(broken[BEJ_HEADER_SIZE + 3], 2); // two-byte length nnint of the root SFL
+    broken[BEJ_HEADER_SIZE + 4] = 4;
+    broken[BEJ_HEADER_SIZE + 5] = 0;
+    std::string text;
+    EXPECT_FALSE(decode_in_chunks(broken, broken.size(), schema.get(), annot.get(), text));
+}
+
+TEST(BejStreamDecoderNames, NamelessMembersFailLikeTheTree) {
+    // root Set with one member: sequence 0, Integer 7 in one byte
+    const std::vector<uint8_t> bej = {0x00, 0xF0, 0xF1, 0xF1, 0x00, 0x00, 0x00,
+                                      0x01, 0x00, 0x00, 0x01, 0x0A, 0x01, 0x01,
+                                      0x01, 0x00, 0x30, 0x01, 0x03, 0x01, 0x01, 0x07};
+    for (const bool named : {true, false}) {
+        const dict_ptr dict = single_member_dictionary(named);
+        const json_ptr tree(bej_decode_buffer(bej.data(), bej.size(), dict.get(), nullptr), json_free);
+        EXPECT_EQ(tree != nullptr, named);
+
+        std::string text;
+        EXPECT_EQ(decode_in_chunks(bej, bej.size(), dict.get(), nullptr, text) == 1, named);
+        if (named) {
+            EXPECT_EQ(text, "{\"A\":7}");
+        }
+
+        std::unique_ptr<bej_decoder_t, void(*)(bej_decoder_t*)> decoder(bej_decoder_create(dict.get(), nullptr),
+                                                                          bej_decoder_free);
+        ASSERT_NE(decoder.get(), nullptr);
+        const char *chars;
+        size_t length;
+        EXPECT_EQ(bej_decoder_decode_text(decoder.get(), bej.data(), bej.size(), &chars, &length) == 1, named);
+    }
+}
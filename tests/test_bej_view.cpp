@@ -0,0 +1,168 @@
+#include "test_util.h"
+
+extern "C" {
+    #include "bej_view.h"
+}
+
+class BejView : public MemoryDictionaryTest {
+protected:
+    /**
+     * @brief Encodes a test data file and opens a view on it.
+     *
+     * @param name Path of the JSON file relative to the test directory.
+     */
+    void open(const std::string &name)
+    {
+        const json_ptr root(json_parse_file(test_path(name).c_str()), json_free);
+        ASSERT_NE(root.get(), nullptr);
+        bej = encode_tree(root.get());
+        ASSERT_FALSE(bej.empty());
+        ASSERT_TRUE(bej_view_open(&view, bej.data(), bej.size(), schema.get(), annot.get()));
+    }
+
+    /**
+     * @brief Resolves a path and reads it as a string or enum option.
+     *
+     * @param path Path to resolve.
+     * @return The text, or "<missing>".
+     */
+    std::string text_at(const char *path)
+    {
+        bej_view_t v;
+        const char *str;
+        size_t len;
+        if (!bej_view_get(&view, path, &v))
+            return "<missing>";
+        if (bej_view_string(&v, &str, &len))
+            return std::string(str, len);
+        if (bej_view_enum(&v, &str))
+            return str;
+        return "<not text>";
+    }
+
+    /**
+     * @brief Resolves a path and reads it as an integer.
+     *
+     * @param path Path to resolve.
+     * @return The value, or INT64_MIN if missing.
+     */
+    int64_t integer_at(const char *path)
+    {
+        bej_view_t v;
+        int64_t value;
+        return bej_view_get(&view, path, &v) && bej_view_integer(&v, &value) ? value : INT64_MIN;
+    }
+
+    std::vector<uint8_t> bej;
+    bej_view_t view{};
+};
+
+TEST_F(BejView, PathsResolveThroughSetsAndArrays) {
+    open("data/example4.json");
+
+    EXPECT_EQ(text_at("/Status/Health"), "OK");
+    EXPECT_EQ(text_at("/Id"), "DIMM1");
+    EXPECT_EQ(text_at("/MemoryDeviceType"), "DDR5");
+    EXPECT_EQ(text_at("/PartNumber"), "");
+    EXPECT_EQ(text_at("/Regions/0/RegionId"), "R0");
+    EXPECT_EQ(text_at("/SecurityCapabilities/SecurityStates/1"), "Locked");
+    EXPECT_EQ(integer_at("/CapacityMiB"), 65536);
+    EXPECT_EQ(integer_at("/BusWidthBits"), -72);
+    EXPECT_EQ(integer_at("/Regions/1/SizeMiB"), 2048);
+    EXPECT_EQ(integer_at("/AllowedSpeedsMHz/4"), 300000);
+
+    bej_view_t v;
+    int b;
+    ASSERT_TRUE(bej_view_get(&view, "/IsSpareDeviceEnabled", &v));
+    ASSERT_TRUE(bej_view_boolean(&v, &b));
+    EXPECT_EQ(b, 1);
+
+    uint64_t count;
+    ASSERT_TRUE(bej_view_get(&view, "/Regions", &v));
+    ASSERT_TRUE(bej_view_count(&v, &count));
+    EXPECT_EQ(count, 2u);
+    ASSERT_TRUE(bej_view_get(&view, "", &v));
+    EXPECT_EQ(v.entry.format, BEJ_FORMAT_SET);
+}
+
+TEST_F(BejView, AnnotationsAndMissingPaths) {
+    open("data/example5.json");
+
+    EXPECT_EQ(text_at("/@odata.id"), "/redfish/v1/Systems/1/Memory/DIMM1");
+    EXPECT_EQ(text_at("/Status/@odata.id"), "/redfish/v1/Systems/1/Memory/DIMM1#/Status");
+    EXPECT_EQ(text_at("/@Message.ExtendedInfo/0/MessageId"), "Base.1.8.Success");
+    EXPECT_EQ(text_at("/@Message.ExtendedInfo/1/MessageId"), "Base.1.8.PropertyValueModified");
+
+    // known to the dictionary but absent from the document, unknown names, bad indices
+    EXPECT_EQ(text_at("/PartNumber"), "<missing>");
+    EXPECT_EQ(text_at("/NoSuchProperty"), "<missing>");
+    EXPECT_EQ(text_at("/@Message.ExtendedInfo/2/MessageId"), "<missing>");
+    EXPECT_EQ(text_at("/@Message.ExtendedInfo/01/MessageId"), "<missing>");
+    EXPECT_EQ(text_at("Status"), "<missing>");
+    EXPECT_EQ(integer_at("/Name"), INT64_MIN);
+}
+
+TEST_F(BejView, TruncatedDocumentsAreRejected) {
+    open("data/example4.json");
+
+    // every prefix either fails to open or fails the lookup, none reads past its end
+    for (size_t cut = 0; cut < bej.size(); cut++) {
+        const std::vector<uint8_t> prefix(bej.begin(), bej.begin() + static_cast<std::ptrdiff_t>(cut));
+        bej_view_t root, v;
+        if (bej_view_open(&root, prefix.data(), prefix.size(), schema.get(), annot.get())) {
+            EXPECT_FALSE(bej_view_get(&root, "/PartNumber", &v)) << cut;
+        }
+    }
+}
+
+TEST_F(BejView, EnumOptionsMustMatchTheirLengthAndFitASequence) {
+    open("data/example4.json");
+
+    bej_view_t health;
+    ASSERT_TRUE(bej_view_get(&view, "/Status/Health", &health));
+    const std::vector<uint8_t> payload(health.payload.pos, health.payload.end);
+    ASSERT_EQ(payload.size(), 4u); // length 1, length byte 2, then the option nnint 01 <seq>
+    const uint8_t seq = payload[3];
+
+    const auto enum_of = [&health](const std::vector<uint8_t> &bytes) -> std::string {
+        bej_view_t v = health;
+        bej_cursor_init(&v.payload, bytes.data(), bytes.size());
+        const char *name;
+        return bej_view_enum(&v, &name) ? name : "<rejected>";
+    };
+    EXPECT_EQ(enum_of(payload), "OK");
+    EXPECT_EQ(enum_of({0x01, 0x09, 0x08, seq, 0, 0, 0, 0, 0, 0, 0}), "OK"); // wider than needed but consistent
+
+    // options past the 16-bit sequence numbers must not wrap onto a real one
+    EXPECT_EQ(enum_of({0x01, 0x04, 0x03, seq, 0x00, 0x01}), "<rejected>");
+    EXPECT_EQ(enum_of({0x01, 0x09, 0x08, seq, 0, 0, 0, 0, 0, 0, 0x01}), "<rejected>");
+    // the option nnint must take exactly the stated length, within the payload
+    EXPECT_EQ(enum_of({0x01, 0x03, 0x01, seq}), "<rejected>");
+    EXPECT_EQ(enum_of({0x01, 0x03, 0x01, seq, 0x00}), "<rejected>");
+    EXPECT_EQ(enum_of({0x01, 0x01, 0x01, seq}), "<rejected>");
+}
+
+TEST_F(BejView, ElementsPastTheDictionarySequenceRangeKeepTheirIndex) {
+    // Set elements past 0xFFFF must not wrap their sequence number to the 16 bits of a dictionary entry
+    const size_t count = 0x10000 + 8;
+    std::string text = "{\"Regions\": [";
+    for (size_t i = 0; i < count; i++)
+        text += i ? ",{}" : "{}";
+    const json_ptr root(json_parse((text + "]}").c_str()), json_free);
+    ASSERT_NE(root.get(), nullptr);
+
+    for (const unsigned flags : {BEJ_ENCODE_CANONICAL, BEJ_ENCODE_FIXED_WIDTH}) {
+        bej_buffer_t out;
+        bej_buffer_init(&out);
+        ASSERT_TRUE(bej_encode_buffer(&out, root.get(), schema.get(), annot.get(), flags));
+        bej_view_t root_view, regions, previous, element;
+        ASSERT_TRUE(bej_view_open(&root_view, out.data, out.size, schema.get(), annot.get()));
+        ASSERT_TRUE(bej_view_member(&root_view, "Regions", &regions));
+        ASSERT_TRUE(bej_view_element(&regions, count - 2, &previous));
+
+        // the last element starts where the one before it ends and carries its own index
+        EXPECT_TRUE(bej_view_element_at(&regions, count - 1, previous.payload.end, &element)) << flags;
+        EXPECT_FALSE(bej_view_element_at(&regions, (count - 1) & 0xFFFF, previous.payload.end, &element)) << flags;
+        bej_buffer_free(&out);
+    }
+}
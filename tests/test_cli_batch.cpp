@@ -0,0 +1,97 @@
+#include <cstdint>
+#include <set>
+#include "test_util.h"
+
+extern "C" {
+    #include "cli_args.h"
+    #include "cli_batch.h"
+    #include "cli_encode.h"
+}
+
+TEST(CliArgs, AcceptsMultipleInputsAndBatchOptions) {
+    const char *argv[] = {"bej_parser", "encode", "a.json", "b.json", "-s", "schema.bin", "-O", "out"};
+    args_t args;
+    ASSERT_EQ(parse_args(8, const_cast<char **>(argv), &args), 0);
+    ASSERT_EQ(args.input_count, 2u);
+    EXPECT_STREQ(args.input_paths[0], "a.json");
+    EXPECT_STREQ(args.input_paths[1], "b.json");
+    EXPECT_STREQ(args.output_dir, "out");
+    EXPECT_EQ(args.mode_encode, 1);
+    free_args(&args);
+}
+
+/**
+ * @brief Encodes the data directory into a framed stream and decodes every frame again.
+ *
+ * @param jobs Value of the -j option.
+ * @param expect_sorted Whether frames must appear in input (sorted) order.
+ */
+static void encode_data_directory_framed(const char *jobs, bool expect_sorted)
+{
+    const std::string data_dir = test_path("data");
+    const std::string schema = test_path("dictionaries/Memory_v1.bin");
+    const std::string annot = test_path("dictionaries/annotation.bin");
+    const std::string framed = test_path(std::string("batch_test_output_") + jobs + ".frames");
+
+    const char *argv[] = {"bej_parser", "encode", data_dir.c_str(), "-s", schema.c_str(),
+                          "-a", annot.c_str(), "-f", "-o", framed.c_str(), "-j", jobs};
+    args_t args;
+    ASSERT_EQ(parse_args(12, const_cast<char **>(argv), &args), 0);
+    cli_batch_t batch;
+    ASSERT_TRUE(cli_batch_collect(&args, &batch));
+    const size_t input_count = batch.count;
+    cli_batch_free(&batch);
+    ASSERT_EQ(cli_run_encode(&args), 0);
+    free_args(&args);
+
+    std::FILE *in = std::fopen(framed.c_str(), "rb");
+    ASSERT_NE(in, nullptr);
+    std::vector<uint8_t> stream;
+    int c;
+    while ((c = std::fgetc(in)) != EOF)
+        stream.push_back(static_cast<uint8_t>(c));
+    std::fclose(in);
+    std::remove(framed.c_str());
+
+    const dict_ptr schema_dict(bej_dictionary_load(schema.c_str()), bej_dictionary_free);
+    const dict_ptr annot_dict(bej_dictionary_load(annot.c_str()), bej_dictionary_free);
+    ASSERT_NE(schema_dict.get(), nullptr);
+
+    // every frame decodes back to the JSON file named in its header
+    size_t pos = 0, frames = 0;
+    std::string previous;
+    std::set<std::string> seen;
+    while (pos < stream.size()) {
+        ASSERT_LE(pos + CLI_FRAME_HEADER_SIZE, stream.size());
+        const uint32_t payload_len = stream[pos] | (stream[pos + 1] << 8) |
+                                     (stream[pos + 2] << 16) | (uint32_t(stream[pos + 3]) << 24);
+        const uint16_t name_len = stream[pos + 4] | (stream[pos + 5] << 8);
+        pos += CLI_FRAME_HEADER_SIZE;
+        ASSERT_LE(pos + name_len + payload_len, stream.size());
+
+        const std::string name(reinterpret_cast<const char *>(&stream[pos]), name_len);
+        pos += name_len;
+        if (expect_sorted) {
+            EXPECT_LT(previous, name);
+        }
+        previous = name;
+        EXPECT_TRUE(seen.insert(name).second) << "Converted twice: " << name;
+
+        const json_ptr expected(json_parse_file(name.c_str()), json_free);
+        const json_ptr decoded(bej_decode_buffer(&stream[pos], payload_len, schema_dict.get(), annot_dict.get()),
+                               json_free);
+        ASSERT_NE(decoded.get(), nullptr) << name;
+        EXPECT_TRUE(json_compare(expected.get(), decoded.get())) << name;
+        pos += payload_len;
+        frames++;
+    }
+    EXPECT_EQ(frames, input_count);
+}
+
+TEST(CliBatch, DirectoryEncodesToFramedStream) {
+    encode_data_directory_framed("1", true);
+}
+
+TEST(CliBatch, WorkersConvertEveryInputOnce) {
+    encode_data_directory_framed("4", false);
+}
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include "test_util.h"
+
+TEST(JsonArena, ParsedTreeMatchesHeapTree) {
+    const std::string path = test_path("data/example4.json");
+    const json_ptr heap(json_parse_file(path.c_str()), json_free);
+    ASSERT_NE(heap.get(), nullptr);
+
+    json_arena_t arena;
+    json_arena_init(&arena);
+    for (int round = 0; round < 3; round++) {
+        // the arena is reused after a reset
+        json_value_t *tree = json_parse_file_in(path.c_str(), &arena);
+        ASSERT_NE(tree, nullptr);
+        EXPECT_TRUE(tree->flags & JSON_FLAG_ARENA);
+        EXPECT_TRUE(json_compare(heap.get(), tree));
+        json_free(tree); // no-op for arena trees
+        json_arena_reset(&arena);
+    }
+    json_arena_destroy(&arena);
+}
+
+TEST(JsonArena, ContainersGrowBeyondInitialCapacity) {
+    std::string input = "{\"items\": [";
+    for (int i = 0; i < 1000; i++)
+        input += (i ? "," : "") + std::to_string(i);
+    input += "]";
+    for (int i = 0; i < 100; i++)
+        input += ", \"key" + std::to_string(i) + "\": \"value" + std::to_string(i) + "\"";
+    input += "}";
+
+    json_arena_t arena;
+    json_arena_init(&arena);
+    const json_value_t *tree = json_parse_in(input.c_str(), &arena);
+    ASSERT_NE(tree, nullptr);
+    ASSERT_EQ(tree->data.object.count, 101u);
+    const json_value_t *items = tree->data.object.entries[0].value;
+    ASSERT_EQ(items->data.array.count, 1000u);
+    for (size_t i = 0; i < items->data.array.count; i++)
+        EXPECT_EQ(items->data.array.items[i]->data.number, static_cast<double>(i));
+    EXPECT_STREQ(tree->data.object.entries[100].key, "key99");
+    EXPECT_STREQ(tree->data.object.entries[100].value->data.string, "value99");
+    json_arena_destroy(&arena);
+}
+
+TEST(JsonArena, DecodedTreeMatchesHeapTree) {
+    const json_ptr source(json_parse_file(test_path("data/example5.json").c_str()), json_free);
+    const dict_ptr schema(bej_dictionary_load(test_path("dictionaries/Memory_v1.bin").c_str()), bej_dictionary_free);
+    const dict_ptr annot(bej_dictionary_load(test_path("dictionaries/annotation.bin").c_str()), bej_dictionary_free);
+    ASSERT_NE(source.get(), nullptr);
+    ASSERT_NE(schema.get(), nullptr);
+
+    bej_buffer_t bej;
+    bej_buffer_init(&bej);
+    ASSERT_TRUE(bej_encode_buffer(&bej, source.get(), schema.get(), annot.get(), BEJ_ENCODE_CANONICAL));
+
+    json_arena_t arena;
+    json_arena_init(&arena);
+    const json_value_t *decoded = bej_decode_buffer_in(bej.data, bej.size, schema.get(), annot.get(), &arena);
+    ASSERT_NE(decoded, nullptr);
+    EXPECT_TRUE(json_compare(source.get(), decoded));
+
+    json_arena_destroy(&arena);
+    bej_buffer_free(&bej);
+}
+
+TEST(JsonObject, LookupsMatchAScanInOrder) {
+    json_arena_t arena;
+    json_arena_init(&arena);
+    for (json_arena_t *in : {static_cast<json_arena_t *>(nullptr), &arena}) {
+        json_value_t *object = json_create_in(in, JSON_OBJECT);
+        ASSERT_NE(object, nullptr);
+        for (int i = 0; i < 300; i++) {
+            EXPECT_EQ(object->data.object.index != nullptr, object->data.object.count >= JSON_OBJECT_INDEX_MIN) << i;
+            json_value_t *value = json_create_in(in, JSON_NUMBER);
+            value->data.number = i;
+            ASSERT_TRUE(json_object_append_in(in, object, ("key" + std::to_string(i % 200)).c_str(), value));
+
+            // earlier entries win over later ones with the same key
+            for (int k = 0; k <= std::min(i, 199); k++) {
+                const json_value_t *found = json_object_get(object, ("key" + std::to_string(k)).c_str());
+                ASSERT_NE(found, nullptr) << i << " " << k;
+                ASSERT_EQ(found->data.number, k) << i << " " << k;
+            }
+            EXPECT_EQ(json_object_get(object, "key200"), nullptr);
+        }
+        EXPECT_EQ(json_object_get(object, nullptr), nullptr);
+        EXPECT_EQ(json_object_get(object->data.object.entries[0].value, "key0"), nullptr);
+        json_free(object);
+    }
+    json_arena_destroy(&arena);
+}
+
+TEST(JsonObject, CompareIgnoresKeyOrderOfWideObjects) {
+    std::string forward = "{", backward = "{";
+    for (int i = 0; i < 500; i++) {
+        forward += (i ? ", \"p" : "\"p") + std::to_string(i) + "\": " + std::to_string(i);
+        backward += (i ? ", \"p" : "\"p") + std::to_string(499 - i) + "\": " + std::to_string(499 - i);
+    }
+    const json_ptr a(json_parse((forward + "}").c_str()), json_free);
+    const json_ptr b(json_parse((backward + "}").c_str()), json_free);
+    const json_ptr other_value(json_parse((backward + ", \"p500\": 1}").c_str()), json_free);
+    ASSERT_NE(a.get(), nullptr);
+    ASSERT_NE(b.get(), nullptr);
+    ASSERT_NE(other_value.get(), nullptr);
+    EXPECT_TRUE(json_compare(a.get(), b.get()));
+    EXPECT_TRUE(json_compare(b.get(), a.get()));
+    EXPECT_FALSE(json_compare(a.get(), other_value.get()));
+
+    // same count, one key renamed
+    backward.replace(backward.find("\"p0\""), 4, "\"q0\"");
+    const json_ptr renamed(json_parse((backward + "}").c_str()), json_free);
+    ASSERT_NE(renamed.get(), nullptr);
+    EXPECT_FALSE(json_compare(a.get(), renamed.get()));
+    EXPECT_FALSE(json_compare(renamed.get(), a.get()));
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include "test_util.h"
+
+/**
+ * @brief Reads every event of a reader, rendering tokens and values as text.
+ *
+ * @param reader Initialized reader.
+ * @return One string per event, up to and including END or ERROR.
+ */
+static std::vector<std::string> collect_events(json_reader_t *reader)
+{
+    std::vector<std::string> events;
+    for (;;) {
+        const json_event_t event = json_reader_next(reader);
+        switch (event) {
+            case JSON_EVENT_BEGIN_OBJECT: events.push_back("{"); break;
+            case JSON_EVENT_END_OBJECT:   events.push_back("}"); break;
+            case JSON_EVENT_BEGIN_ARRAY:  events.push_back("["); break;
+            case JSON_EVENT_END_ARRAY:    events.push_back("]"); break;
+            case JSON_EVENT_KEY:          events.push_back("key:" + std::string(reader->token)); break;
+            case JSON_EVENT_STRING:       events.push_back("str:" + std::string(reader->token)); break;
+            case JSON_EVENT_NUMBER:       events.push_back("num:" + std::to_string(reader->number)); break;
+            case JSON_EVENT_BOOL:         events.push_back(reader->boolean ? "true" : "false"); break;
+            case JSON_EVENT_NULL:         events.push_back("null"); break;
+            case JSON_EVENT_END:          events.push_back("end"); return events;
+            case JSON_EVENT_ERROR:        events.push_back("error"); return events;
+        }
+    }
+}
+
+/**
+ * @brief Reads every event of a fed reader, feeding a text in fixed-size chunks.
+ *
+ * @param text The JSON text.
+ * @param chunk Bytes per json_reader_feed() call.
+ * @param needs Receives the number of JSON_EVENT_NEED_INPUT events.
+ * @return One string per event as in collect_events(), without NEED_INPUT.
+ */
+static std::vector<std::string> collect_fed_events(const std::string &text, const size_t chunk, size_t &needs)
+{
+    json_reader_t reader;
+    json_reader_init_feed(&reader);
+    size_t pos = 0;
+    needs = 0;
+    std::vector<std::string> events;
+    for (;;) {
+        const json_event_t event = json_reader_next(&reader);
+        if (event == JSON_EVENT_NEED_INPUT) {
+            const size_t n = std::min(chunk, text.size() - pos);
+            EXPECT_TRUE(json_reader_feed(&reader, text.data() + pos, n));
+            pos += n;
+            needs++;
+            continue;
+        }
+        switch (event) {
+            case JSON_EVENT_BEGIN_OBJECT: events.push_back("{"); break;
+            case JSON_EVENT_END_OBJECT:   events.push_back("}"); break;
+            case JSON_EVENT_BEGIN_ARRAY:  events.push_back("["); break;
+            case JSON_EVENT_END_ARRAY:    events.push_back("]"); break;
+            case JSON_EVENT_KEY:          events.push_back("key:" + std::string(reader.token)); break;
+            case JSON_EVENT_STRING:       events.push_back("str:" + std::string(reader.token)); break;
+            case JSON_EVENT_NUMBER:       events.push_back("num:" + std::to_string(reader.number)); break;
+            case JSON_EVENT_BOOL:         events.push_back(reader.boolean ? "true" : "false"); break;
+            case JSON_EVENT_NULL:         events.push_back("null"); break;
+            default:                      events.push_back(event == JSON_EVENT_END ? "end" : "error"); break;
+        }
+        if (event == JSON_EVENT_END || event == JSON_EVENT_ERROR) break;
+    }
+    json_reader_free(&reader);
+    return events;
+}
+
+/**
+ * @brief Encodes a file through the streaming reader and decodes the result.
+ *
+ * @param json Path of the JSON document.
+ * @param schema Schema dictionary.
+ * @param annot Annotation dictionary.
+ * @return The decoded tree (nullptr on failure).
+ */
+static json_value_t *stream_encode_decode(const std::string &json,
+                                          const bej_dictionary_t *schema,
+                                          const bej_dictionary_t *annot)
+{
+    FILE *in = fopen(json.c_str(), "rb");
+    FILE *out = tmpfile();
+    if (!in || !out)
+        return nullptr;
+
+    json_reader_t reader;
+    json_reader_init_stream(&reader, in);
+    const int ok = bej_encode_reader(out, &reader, schema, annot);
+    json_reader_free(&reader);
+    fclose(in);
+
+    std::vector<uint8_t> bej;
+    if (ok) {
+        bej.resize(static_cast<size_t>(ftell(out)));
+        rewind(out);
+        if (fread(bej.data(), 1, bej.size(), out) != bej.size())
+            bej.clear();
+    }
+    fclose(out);
+    return bej.empty() ? nullptr : bej_decode_buffer(bej.data(), bej.size(), schema, annot);
+}
+
+TEST(JsonReader, EventsFollowDocumentOrder) {
+    const std::string text = "{\"a\": [1, -2.5e1, \"x\\ny\"], \"b\": {\"c\": true, \"d\": null}, \"e\": []}";
+    const std::vector<std::string> expected = {
+        "{", "key:a", "[", "num:1.000000", "num:-25.000000", "str:x\ny", "]",
+        "key:b", "{", "key:c", "true", "key:d", "null", "}", "key:e", "[", "]", "}", "end"
+    };
+
+    json_reader_t reader;
+    json_reader_init_string(&reader, text.data(), text.size());
+    EXPECT_EQ(collect_events(&reader), expected);
+    json_reader_free(&reader);
+
+    // the same events come out of a stream-backed reader
+    FILE *stream = tmpfile();
+    ASSERT_NE(stream, nullptr);
+    fwrite(text.data(), 1, text.size(), stream);
+    rewind(stream);
+    ASSERT_TRUE(json_reader_init_stream(&reader, stream));
+    EXPECT_EQ(collect_events(&reader), expected);
+    json_reader_free(&reader);
+    fclose(stream);
+}
+
+TEST(JsonReader, FedChunksGiveTheSameEvents) {
+    const std::string text = "{\"a\": [1, -2.5e1, \"x\\ny\\u00e9\\ud83d\\ude00\"], \"b\": {\"c\": true, \"d\": null},"
+                             " \"e\": [], \"f\": false, \"g\": 12345}  ";
+    json_reader_t reader;
+    json_reader_init_string(&reader, text.data(), text.size());
+    const std::vector<std::string> expected = collect_events(&reader);
+    json_reader_free(&reader);
+    ASSERT_EQ(expected.back(), "end");
+
+    // a chunk may end anywhere, inside a token, an escape or the whitespace between them
+    for (const size_t chunk : {size_t(1), size_t(2), size_t(5), size_t(64), text.size()}) {
+        size_t needs;
+        EXPECT_EQ(collect_fed_events(text, chunk, needs), expected) << chunk;
+        EXPECT_GE(needs, text.size() / chunk) << chunk;
+    }
+
+    // malformed and truncated texts still fail, however they are cut
+    for (const char *bad : {"{\"a\" 1}", "[1, 2}", "{\"a\": 1} x", "[01]", "{\"a\": tru}", "{\"a\": 1", "[\"x"}) {
+        for (const size_t chunk : {size_t(1), size_t(3), size_t(64)}) {
+            size_t needs;
+            EXPECT_EQ(collect_fed_events(bad, chunk, needs).back(), "error") << bad << " " << chunk;
+        }
+    }
+}
+
+TEST(JsonReader, MalformedInputIsAStickyError) {
+    for (const char *text : {"{\"a\" 1}", "[1, 2}", "{\"a\": 1} x", "[01]", "{\"a\": tru}", "[1,]"}) {
+        json_reader_t reader;
+        json_reader_init_string(&reader, text, strlen(text));
+        const std::vector<std::string> events = collect_events(&reader);
+        EXPECT_EQ(events.back(), "error") << text;
+        EXPECT_NE(reader.error, JSON_OK) << text;
+        EXPECT_EQ(json_reader_next(&reader), JSON_EVENT_ERROR) << text;
+        json_reader_free(&reader);
+    }
+}
+
+TEST(BejEncodeReader, StreamedDocumentsMatchTreeEncoding) {
+    const dict_ptr schema(bej_dictionary_load_map(test_path("dictionaries/Memory_v1.bin").c_str()), bej_dictionary_free);
+    const dict_ptr annot(bej_dictionary_load_map(test_path("dictionaries/annotation.bin").c_str()), bej_dictionary_free);
+    ASSERT_NE(schema.get(), nullptr);
+    ASSERT_NE(annot.get(), nullptr);
+
+    for (const char *name : {"data/example1.json", "data/example4.json", "data/example5.json"}) {
+        const std::string path = test_path(name);
+        const json_ptr expected(json_parse_file(path.c_str()), json_free);
+        ASSERT_NE(expected.get(), nullptr) << name;
+
+        const json_ptr decoded(stream_encode_decode(path, schema.get(), annot.get()), json_free);
+        ASSERT_NE(decoded.get(), nullptr) << name;
+        EXPECT_TRUE(json_compare(expected.get(), decoded.get())) << name;
+    }
+}
+
+TEST(BejEncodeReader, LargeDocumentIsPatchedAfterFlushing) {
+    const dict_ptr schema(bej_dictionary_load_map(test_path("dictionaries/Memory_v1.bin").c_str()), bej_dictionary_free);
+    ASSERT_NE(schema.get(), nullptr);
+
+    // well past the flush threshold, with members the dictionary does not know
+    std::string text = "{\"Id\": \"DIMM1\", \"Unknown\": {\"a\": [1, {\"b\": null}]}, \"Regions\": [";
+    for (int i = 0; i < 5000; i++) {
+        if (i) text += ",";
+        text += "{\"RegionId\": \"region-" + std::to_string(i) + "\", \"SizeMiB\": " + std::to_string(i) + "}";
+    }
+    text += "]}";
+
+    const std::string path = test_path("stream_large.json");
+    FILE *file = fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+
+    const json_ptr input(json_parse(text.c_str()), json_free);
+    ASSERT_NE(input.get(), nullptr);
+    bej_buffer_t tree_bej;
+    bej_buffer_init(&tree_bej);
+    ASSERT_TRUE(bej_encode_buffer(&tree_bej, input.get(), schema.get(), nullptr, BEJ_ENCODE_CANONICAL));
+    const json_ptr expected(bej_decode_buffer(tree_bej.data, tree_bej.size, schema.get(), nullptr), json_free);
+    bej_buffer_free(&tree_bej);
+    ASSERT_NE(expected.get(), nullptr);
+
+    const json_ptr decoded(stream_encode_decode(path, schema.get(), nullptr), json_free);
+    ASSERT_NE(decoded.get(), nullptr);
+    EXPECT_TRUE(json_compare(expected.get(), decoded.get()));
+    remove(path.c_str());
+}
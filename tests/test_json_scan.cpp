@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern "C" {
+    #include "json.h"
+    #include "json_scan.h"
+}
+
+using json_ptr = std::unique_ptr<json_value_t, void(*)(json_value_t*)>;
+
+/**
+ * @brief Two pages where the second one is inaccessible.
+ *
+ * Text placed at the end of the first page makes any read past the
+ * terminator that crosses into the next page fault.
+ */
+class GuardedPage {
+public:
+    GuardedPage()
+    {
+        page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        void *mem = mmap(nullptr, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        base = mem == MAP_FAILED ? nullptr : static_cast<char *>(mem);
+        if (base) mprotect(base + page, page, PROT_NONE);
+    }
+
+    ~GuardedPage()
+    {
+        if (base) munmap(base, 2 * page);
+    }
+
+    /**
+     * @brief Copies text so that its terminator is the last byte of the first page.
+     *
+     * @param text Text to place.
+     * @return Pointer to the copy.
+     */
+    const char *place(const std::string &text)
+    {
+        char *p = base + page - text.size() - 1;
+        memcpy(p, text.c_str(), text.size() + 1);
+        return p;
+    }
+
+    char *base = nullptr;
+    size_t page = 0;
+};
+
+TEST(JsonScan, StringScanStopsAtFirstSpecialCharacter) {
+    GuardedPage guard;
+    ASSERT_NE(guard.base, nullptr);
+
+    for (size_t length = 0; length < 80; length++) {
+        // no special character: the scan ends at the terminator right before the guard page
+        const std::string plain(length, 'a');
+        const char *s = guard.place(plain);
+        EXPECT_EQ(json_scan_string(s), s + length) << json_scan_variant() << " " << length;
+
+        for (const char special : {'"', '\\'}) {
+            for (size_t at = 0; at < length; at++) {
+                std::string text = plain;
+                text[at] = special;
+                if (at + 1 < length) text[length - 1] = special; // a later hit must not win
+                const char *t = guard.place(text);
+                EXPECT_EQ(json_scan_string(t), t + at) << json_scan_variant() << " " << length << " " << at;
+            }
+        }
+    }
+}
+
+TEST(JsonScan, WhitespaceScanCountsNewlines) {
+    GuardedPage guard;
+    ASSERT_NE(guard.base, nullptr);
+
+    const std::string pattern = " \t\r\n  \n\t";
+    for (size_t length = 0; length < 70; length++) {
+        std::string text;
+        size_t expected_newlines = 0;
+        size_t last = std::string::npos;
+        for (size_t i = 0; i < length; i++) {
+            text += pattern[i % pattern.size()];
+            if (text.back() == '\n') {
+                expected_newlines++;
+                last = i;
+            }
+        }
+        text += "x \n"; // whitespace after the stop must not be counted
+
+        const char *s = guard.place(text);
+        size_t newlines = 0;
+        const char *last_newline = nullptr;
+        EXPECT_EQ(json_scan_whitespace(s, &newlines, &last_newline), s + length) << length;
+        EXPECT_EQ(newlines, expected_newlines) << length;
+        EXPECT_EQ(last_newline, last == std::string::npos ? nullptr : s + last) << length;
+    }
+}
+
+TEST(JsonScan, UnicodeEscapesDecodeToUtf8) {
+    const char *text = "[\"caf\\u00e9 \\ud83d\\ude00 \\ud800x \\u20AC\", \"line\\nnext \\\"q\\\" \\\\\"]";
+    const std::string first = "caf\xc3\xa9 \xf0\x9f\x98\x80 \xef\xbf\xbdx \xe2\x82\xac";
+    const std::string second = "line\nnext \"q\" \\";
+
+    const json_ptr root(json_parse(text), json_free);
+    ASSERT_NE(root.get(), nullptr);
+    ASSERT_EQ(root->data.array.count, 2u);
+    EXPECT_EQ(std::string(root->data.array.items[0]->data.string), first);
+    EXPECT_EQ(std::string(root->data.array.items[1]->data.string), second);
+
+    // the streaming reader decodes the same escapes
+    json_reader_t reader;
+    json_reader_init_string(&reader, text, strlen(text));
+    ASSERT_EQ(json_reader_next(&reader), JSON_EVENT_BEGIN_ARRAY);
+    ASSERT_EQ(json_reader_next(&reader), JSON_EVENT_STRING);
+    EXPECT_EQ(std::string(reader.token, reader.token_length), first);
+    ASSERT_EQ(json_reader_next(&reader), JSON_EVENT_STRING);
+    EXPECT_EQ(std::string(reader.token, reader.token_length), second);
+    json_reader_free(&reader);
+
+    for (const char *bad : {"\"\\u12\"", "\"\\u12g4\"", "\"\\x\"", "\"unterminated", "\"ends in backslash\\"}) {
+        const json_ptr value(json_parse(bad), json_free);
+        EXPECT_EQ(value.get(), nullptr) << bad;
+    }
+}
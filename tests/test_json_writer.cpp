@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <unistd.h>
+
+extern "C" {
+    #include "json.h"
+}
+
+using json_ptr = std::unique_ptr<json_value_t, void(*)(json_value_t*)>;
+
+/**
+ * @brief Serializes a value with a fresh writer.
+ *
+ * @param value Value to write.
+ * @param mode JSON_WRITE_* mode.
+ * @return The JSON text.
+ */
+static std::string write_value(const json_value_t *value, unsigned mode)
+{
+    json_writer_t writer;
+    json_writer_init(&writer, mode);
+    EXPECT_TRUE(json_writer_value(&writer, value));
+    std::string text(writer.data ? writer.data : "", writer.size);
+    json_writer_free(&writer);
+    return text;
+}
+
+/**
+ * @brief Formats a single number with a fresh writer.
+ *
+ * @param num Value to format.
+ * @return The JSON text.
+ */
+static std::string write_number(double num)
+{
+    json_writer_t writer;
+    json_writer_init(&writer, JSON_WRITE_COMPACT);
+    EXPECT_TRUE(json_writer_number(&writer, num));
+    std::string text(writer.data, writer.size);
+    json_writer_free(&writer);
+    return text;
+}
+
+TEST(JsonWriter, CompactAndPrettyLayouts) {
+    const json_ptr root(json_parse("{\"a\": [1, 2], \"b\": {\"c\": null}, \"d\": {}, \"e\": []}"), json_free);
+    ASSERT_NE(root.get(), nullptr);
+
+    EXPECT_EQ(write_value(root.get(), JSON_WRITE_COMPACT), "{\"a\":[1,2],\"b\":{\"c\":null},\"d\":{},\"e\":[]}");
+    EXPECT_EQ(write_value(root.get(), JSON_WRITE_PRETTY),
+              "{\n\t\"a\": [1, 2],\n\t\"b\": {\n\t\t\"c\": null\n\t},\n\t\"d\": {},\n\t\"e\": []\n}");
+
+    // json_write_file keeps the pretty layout and adds a newline
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(json_write_file(file, root.get()), 0);
+    std::string text(static_cast<size_t>(ftell(file)), '\0');
+    rewind(file);
+    ASSERT_EQ(fread(&text[0], 1, text.size(), file), text.size());
+    fclose(file);
+    EXPECT_EQ(text, write_value(root.get(), JSON_WRITE_PRETTY) + "\n");
+}
+
+TEST(JsonWriter, StringsAreEscapedAndParseBack) {
+    const std::string raw = std::string("quote\" backslash\\ tab\t newline\n bell\x07 nul-free \xc3\xa9");
+    json_writer_t writer;
+    json_writer_init(&writer, JSON_WRITE_COMPACT);
+    ASSERT_TRUE(json_writer_string(&writer, raw.data(), raw.size()));
+    const std::string text(writer.data, writer.size);
+    json_writer_free(&writer);
+
+    EXPECT_EQ(text, "\"quote\\\" backslash\\\\ tab\\t newline\\n bell\\u0007 nul-free \xc3\xa9\"");
+
+    // the parser turns \u escapes into placeholders, everything else must come back unchanged
+    const std::string without_control = "x\"y\\z\t\n\r\b\f";
+    json_writer_init(&writer, JSON_WRITE_COMPACT);
+    ASSERT_TRUE(json_writer_string(&writer, without_control.data(), without_control.size()));
+    const std::string quoted(writer.data, writer.size);
+    json_writer_free(&writer);
+    const json_ptr parsed(json_parse(quoted.c_str()), json_free);
+    ASSERT_NE(parsed.get(), nullptr);
+    ASSERT_EQ(parsed->type, JSON_STRING);
+    EXPECT_EQ(std::string(parsed->data.string), without_control);
+}
+
+TEST(JsonWriter, NumbersUseShortestRoundTripForm) {
+    EXPECT_EQ(write_number(0), "0");
+    EXPECT_EQ(write_number(65536), "65536");
+    EXPECT_EQ(write_number(-72), "-72");
+    EXPECT_EQ(write_number(1e6), "1000000");
+    EXPECT_EQ(write_number(0.1), "0.1");
+    EXPECT_EQ(write_number(-2.5), "-2.5");
+    EXPECT_EQ(write_number(1e300), "1e+300");
+    EXPECT_EQ(write_number(0.1 + 0.2), "0.30000000000000004");
+    EXPECT_EQ(write_number(0.0 / 0.0), "null");
+
+    for (const double num : {0.1 + 0.2, 1.0 / 3.0, 123456.789, 5e-324, 1.7976931348623157e308, 9007199254740993.0}) {
+        const std::string text = write_number(num);
+        EXPECT_EQ(std::strtod(text.c_str(), nullptr), num) << text;
+    }
+
+    json_writer_t writer;
+    json_writer_init(&writer, JSON_WRITE_COMPACT);
+    ASSERT_TRUE(json_writer_int(&writer, INT64_MIN));
+    EXPECT_EQ(std::string(writer.data, writer.size), "-9223372036854775808");
+    json_writer_free(&writer);
+}
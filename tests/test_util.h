@@ -0,0 +1,164 @@
+/**
+ * @file test_util.h
+ * @brief helpers shared by the test suites
+ */
+
+#ifndef BEJ_PARSER_TEST_UTIL_H
+#define BEJ_PARSER_TEST_UTIL_H
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+extern "C" {
+    #include "json.h"
+    #include "bej_buffer.h"
+    #include "bej_decode.h"
+    #include "bej_encode.h"
+    #include "bej_dictionary.h"
+}
+
+using json_ptr = std::unique_ptr<json_value_t, void(*)(json_value_t*)>;
+using dict_ptr = std::unique_ptr<bej_dictionary_t, void(*)(bej_dictionary_t*)>;
+using encoder_ptr = std::unique_ptr<bej_encoder_t, void(*)(bej_encoder_t*)>;
+using decoder_ptr = std::unique_ptr<bej_decoder_t, void(*)(bej_decoder_t*)>;
+
+/**
+ * @brief Returns the absolute path of a file in the test working directory.
+ *
+ * @param name Path relative to the test directory.
+ * @return Absolute path.
+ */
+inline std::string test_path(const std::string &name)
+{
+    char cwd[1024];
+    return std::string(getcwd(cwd, sizeof(cwd))) + "/" + name;
+}
+
+/**
+ * @brief Reads a whole file.
+ *
+ * @param path Path of the file.
+ * @return The contents, empty if the file cannot be read.
+ */
+inline std::string read_file(const std::string &path)
+{
+    std::string data;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return data;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        data.append(chunk, n);
+    fclose(file);
+    return data;
+}
+
+/**
+ * @brief Serializes a tree as compact JSON text.
+ *
+ * @param value The tree.
+ * @return The text.
+ */
+inline std::string to_text(const json_value_t *value)
+{
+    json_writer_t writer;
+    json_writer_init(&writer, JSON_WRITE_COMPACT);
+    EXPECT_TRUE(json_writer_value(&writer, value));
+    std::string text(writer.data ? writer.data : "", writer.size);
+    json_writer_free(&writer);
+    return text;
+}
+
+/**
+ * @brief Write callback appending to a std::string.
+ */
+inline int append_to_string(void *ctx, const char *data, size_t size)
+{
+    static_cast<std::string *>(ctx)->append(data, size);
+    return 1;
+}
+
+/**
+ * @brief Encodes a tree with the one-shot encoder.
+ *
+ * @param root The document.
+ * @param schema Schema dictionary.
+ * @param annot Annotation dictionary.
+ * @param flags BEJ_ENCODE_* flags.
+ * @return The BEJ document, empty if it could not be encoded.
+ */
+inline std::vector<uint8_t> encode_tree(const json_value_t *root, const bej_dictionary_t *schema,
+                                        const bej_dictionary_t *annot, const unsigned flags)
+{
+    bej_buffer_t out;
+    bej_buffer_init(&out);
+    std::vector<uint8_t> bytes;
+    if (root && bej_encode_buffer(&out, root, schema, annot, flags))
+        bytes.assign(out.data, out.data + out.size);
+    bej_buffer_free(&out);
+    return bytes;
+}
+
+/**
+ * @brief Builds a dictionary from a heap copy of some bytes, with a runtime index.
+ *
+ * @param bytes The dictionary bytes.
+ * @param size The number of bytes.
+ * @return Owning pointer to the dictionary.
+ */
+inline dict_ptr dictionary_from(const uint8_t *bytes, const size_t size)
+{
+    auto *copy = static_cast<uint8_t *>(malloc(size ? size : 1));
+    auto *dict = static_cast<bej_dictionary_t *>(calloc(1, sizeof(bej_dictionary_t)));
+    if (size)
+        memcpy(copy, bytes, size);
+    dict->bytes = copy;
+    dict->size = size;
+    bej_dictionary_build_index(dict);
+    return dict_ptr(dict, bej_dictionary_free);
+}
+
+/** @brief dictionary_from() for bytes in a vector */
+inline dict_ptr dictionary_from(const std::vector<uint8_t> &bytes)
+{
+    return dictionary_from(bytes.data(), bytes.size());
+}
+
+/**
+ * @brief Fixture loading the Memory_v1 schema and the annotation dictionary.
+ *
+ * Fixtures overriding SetUp() call this one first and return on HasFatalFailure().
+ */
+class MemoryDictionaryTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        schema.reset(bej_dictionary_load_map(test_path("dictionaries/Memory_v1.bin").c_str()));
+        annot.reset(bej_dictionary_load_map(test_path("dictionaries/annotation.bin").c_str()));
+        ASSERT_NE(schema.get(), nullptr);
+        ASSERT_NE(annot.get(), nullptr);
+    }
+
+    /**
+     * @brief Encodes a tree with the fixture's dictionaries.
+     *
+     * @param root The document.
+     * @param flags BEJ_ENCODE_* flags.
+     * @return The BEJ document, empty if it could not be encoded.
+     */
+    std::vector<uint8_t> encode_tree(const json_value_t *root, const unsigned flags = BEJ_ENCODE_CANONICAL) const
+    {
+        return ::encode_tree(root, schema.get(), annot.get(), flags);
+    }
+
+    dict_ptr schema{nullptr, bej_dictionary_free};
+    dict_ptr annot{nullptr, bej_dictionary_free};
+};
+
+#endif // BEJ_PARSER_TEST_UTIL_H